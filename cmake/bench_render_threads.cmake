@@ -0,0 +1,93 @@
+# Checks that rendering map on several threads draws exactly the same frames as
+# rendering on one thread, by comparing bench checksums (see
+# src/bench/bench.cc). Run in script mode:
+#
+#   cmake -DBENCH=<path to fallout2-ce-bench> -DDATA_DIR=<game data directory>
+#         [-DTHREADS=2;4;7] [-DMAP=artemple.map] [-DFRAMES=120]
+#         [-DWORK_DIR=<scratch directory>] -P bench_render_threads.cmake
+#
+# Bench needs game data, without it the check prints SKIPPED and succeeds.
+
+if(NOT BENCH)
+    message(FATAL_ERROR "BENCH is not set")
+endif()
+
+if((NOT DATA_DIR) OR (NOT EXISTS "${DATA_DIR}"))
+    message("bench_render_threads: SKIPPED (game data directory is not set, see FALLOUT_BENCH_DATA_DIR)")
+    return()
+endif()
+
+if(NOT THREADS)
+    set(THREADS 2 4 7)
+endif()
+
+if(NOT MAP)
+    set(MAP "artemple.map")
+endif()
+
+if(NOT FRAMES)
+    set(FRAMES 120)
+endif()
+
+if(NOT WORK_DIR)
+    set(WORK_DIR "${CMAKE_CURRENT_BINARY_DIR}")
+endif()
+
+# Game saves configuration on exit, command line overrides included. Keep
+# the one from data directory intact.
+set(CONFIG_PATH "${DATA_DIR}/fallout2.cfg")
+set(CONFIG_BACKUP_PATH "${WORK_DIR}/fallout2.cfg.bench_render_threads")
+
+file(REMOVE "${CONFIG_BACKUP_PATH}")
+if(EXISTS "${CONFIG_PATH}")
+    configure_file("${CONFIG_PATH}" "${CONFIG_BACKUP_PATH}" COPYONLY)
+endif()
+
+function(bench_checksum threads result)
+    execute_process(
+        COMMAND "${BENCH}" "--map=${MAP}" "--frames=${FRAMES}" "--warmup=0" "--checksum" "[screen]render_threads=${threads}"
+        WORKING_DIRECTORY "${DATA_DIR}"
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE output
+        RESULT_VARIABLE rc
+    )
+
+    string(REGEX MATCH "checksum: ([0-9a-f]+)" match "${output}")
+    if((NOT rc EQUAL 0) OR (NOT match))
+        message("${output}")
+        set(${result} "" PARENT_SCOPE)
+    else()
+        set(${result} "${CMAKE_MATCH_1}" PARENT_SCOPE)
+    endif()
+endfunction()
+
+set(FAILED OFF)
+
+bench_checksum(1 EXPECTED)
+if(NOT EXPECTED)
+    message("bench_render_threads: bench failed with render_threads=1")
+    set(FAILED ON)
+else()
+    message("render_threads=1: ${EXPECTED}")
+
+    foreach(threads ${THREADS})
+        bench_checksum(${threads} ACTUAL)
+        message("render_threads=${threads}: ${ACTUAL}")
+
+        if(NOT ACTUAL STREQUAL EXPECTED)
+            message("bench_render_threads: checksum mismatch with render_threads=${threads}")
+            set(FAILED ON)
+        endif()
+    endforeach()
+endif()
+
+if(EXISTS "${CONFIG_BACKUP_PATH}")
+    configure_file("${CONFIG_BACKUP_PATH}" "${CONFIG_PATH}" COPYONLY)
+    file(REMOVE "${CONFIG_BACKUP_PATH}")
+else()
+    file(REMOVE "${CONFIG_PATH}")
+endif()
+
+if(FAILED)
+    message(FATAL_ERROR "bench_render_threads: FAILED")
+endif()
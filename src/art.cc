@@ -10,6 +10,7 @@
 
 #include "animation.h"
 #include "art_defs.h"
+#include "cache_stats.h"
 #include "content_config.h"
 #include "datafile.h"
 #include "debug.h"
@@ -20,7 +21,12 @@
 #include "settings.h"
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -40,12 +46,61 @@ typedef struct HeadDescription {
     int badFidgetCount;
 } HeadDescription;
 
+typedef enum ArtPrefetchState {
+    ART_PREFETCH_STATE_QUEUED,
+    ART_PREFETCH_STATE_LOADING,
+    ART_PREFETCH_STATE_READY,
+    ART_PREFETCH_STATE_FAILED,
+} ArtPrefetchState;
+
+typedef struct ArtPrefetchEntry {
+    ArtPrefetchState state;
+
+    // Path to localized art (if any), which takes precedence over [path].
+    std::string localizedPath;
+    std::string path;
+
+    // Decoded art (allocated with `malloc`), available in
+    // [ART_PREFETCH_STATE_READY] state.
+    unsigned char* data;
+    int size;
+} ArtPrefetchEntry;
+
+// Span encoded frames of a single art, see [artGetFrameSpans].
+typedef struct ArtSpanData {
+    // Index into [rows] of the first row of every frame, indexed by
+    // `rotation * frameCount + frame`.
+    std::vector<int> frames;
+
+    // Index into [spans] of the first span of every row, there is one extra
+    // entry after the last row of each frame.
+    std::vector<int> rows;
+
+    std::vector<ArtSpan> spans;
+} ArtSpanData;
+
 static int artReadList(const char* path, char** out_arr, int* out_count);
 static int artCacheGetFileSizeImpl(int fid, int* out_size);
 static int artCacheReadDataImpl(int fid, int* sizePtr, unsigned char* data);
 static void artCacheFreeImpl(void* ptr);
 static int artReadFrameData(unsigned char* data, File* stream, int count, int* paddingPtr);
 static int artReadHeader(Art* art, File* stream);
+static int artReadHeaderAtPath(Art* art, const char* path);
+static bool artViewReadInt16(const unsigned char* view, int size, int* offsetPtr, short* valuePtr);
+static bool artViewReadInt32(const unsigned char* view, int size, int* offsetPtr, int* valuePtr);
+static int artReadHeaderFromView(Art* art, const unsigned char* view, int size, int* offsetPtr);
+static int artReadFrameDataFromView(unsigned char* data, const unsigned char* view, int size, int* offsetPtr, int count, int* paddingPtr);
+static int artReadFromView(const unsigned char* view, int size, unsigned char* data);
+static bool artGetLocalizedPath(const char* basePath, const char** outPath);
+static void artPrefetchStart();
+static void artPrefetchStop();
+static void artPrefetchThreadProc();
+static unsigned char* artPrefetchLoad(const char* path, int* sizePtr);
+static ArtPrefetchEntry* artPrefetchAcquire(std::unique_lock<std::mutex>& lock, int fid);
+static bool artPrefetchGetSize(int fid, int* sizePtr);
+static bool artPrefetchTake(int fid, int* sizePtr, unsigned char* data);
+static void artAttachSpans(const Art* art);
+static std::unique_ptr<ArtSpanData> artBuildSpans(const Art* art);
 static int artGetDataSize(const Art* art);
 static int paddingForSize(int size);
 static char artGetCritterWeaponCode(WeaponAnimation weaponType);
@@ -157,6 +212,27 @@ constexpr size_t kMaxNamedPngPixels = 16 * 1024 * 1024;
 static unsigned int gNamedArtCacheMruCounter = 0;
 static int gNamedArtCacheCurrentBytes = 0;
 
+// Background art loading state. Everything below is guarded by
+// [gArtPrefetchMutex], except for the thread object itself which is only
+// touched by the main thread.
+static std::thread gArtPrefetchThread;
+static bool gArtPrefetchThreadStarted = false;
+static std::mutex gArtPrefetchMutex;
+static std::condition_variable gArtPrefetchCondition;
+static bool gArtPrefetchThreadShouldExit = false;
+static std::deque<int> gArtPrefetchQueue;
+static std::unordered_map<int, ArtPrefetchEntry> gArtPrefetchEntries;
+
+// The amount of decoded art waiting to be consumed by art cache. The worker
+// pauses when it reaches [gArtPrefetchBudget].
+static size_t gArtPrefetchBytes = 0;
+static size_t gArtPrefetchBudget = 0;
+
+// Span encoded frames of art in [gArtCache], keyed by cache entry data. Built
+// when art is loaded into cache and released when it is evicted.
+static bool gArtSpansEnabled = false;
+static std::unordered_map<const Art*, std::unique_ptr<ArtSpanData>> gArtSpans;
+
 // 0x418840
 int artInit()
 {
@@ -164,6 +240,8 @@ int artInit()
     File* stream;
     char string[200];
 
+    gArtSpansEnabled = settings.system.art_spans;
+
     int cacheSize = settings.system.art_cache_size;
     if (!cacheInit(&gArtCache, artCacheGetFileSizeImpl, artCacheReadDataImpl, artCacheFreeImpl, cacheSize << 20)) {
         debugPrint("cache_init failed in art_init\n");
@@ -336,6 +414,8 @@ int artInit()
 
     fileClose(stream);
 
+    cacheStatsRegister("art", &gArtCache);
+
     return 0;
 }
 
@@ -347,7 +427,11 @@ void artReset()
 // 0x418EBC
 void artExit()
 {
+    artPrefetchStop();
+
+    cacheStatsUnregister(&gArtCache);
     cacheFree(&gArtCache);
+    gArtSpans.clear();
 
     internal_free(_anon_alias);
     internal_free(gArtCritterFidShoudRunData);
@@ -555,6 +639,305 @@ int artCacheFlush()
     return cacheFlush(&gArtCache);
 }
 
+void artPrefetch(const int* fids, int fidsLength)
+{
+    artPrefetchCancel();
+
+#if defined(__EMSCRIPTEN__)
+    // NOTE: Web build does not support threads.
+    bool prefetchEnabled = false;
+#else
+    bool prefetchEnabled = settings.system.art_prefetch;
+#endif
+
+    if (!prefetchEnabled) {
+        for (int index = 0; index < fidsLength; index++) {
+            CacheEntry* cacheEntry;
+            if (artLock(fids[index], &cacheEntry) != nullptr) {
+                artUnlock(cacheEntry);
+            }
+        }
+        return;
+    }
+
+    // Resolve paths on the calling thread, [artBuildFilePath] is not
+    // reentrant.
+    artPrefetchStart();
+
+    std::vector<std::pair<int, ArtPrefetchEntry>> entries;
+    entries.reserve(fidsLength);
+
+    for (int index = 0; index < fidsLength; index++) {
+        int fid = fids[index];
+        if (cacheContains(&gArtCache, fid)) {
+            continue;
+        }
+
+        char* path = artBuildFilePath(fid);
+        if (path == nullptr) {
+            continue;
+        }
+
+        ArtPrefetchEntry entry;
+        entry.state = ART_PREFETCH_STATE_QUEUED;
+        entry.path = path;
+        entry.data = nullptr;
+        entry.size = 0;
+
+        const char* localizedPath;
+        if (artGetLocalizedPath(path, &localizedPath)) {
+            entry.localizedPath = localizedPath;
+        }
+
+        entries.emplace_back(fid, std::move(entry));
+    }
+
+    std::lock_guard<std::mutex> lock(gArtPrefetchMutex);
+
+    for (auto& entry : entries) {
+        if (gArtPrefetchEntries.emplace(entry.first, std::move(entry.second)).second) {
+            gArtPrefetchQueue.push_back(entry.first);
+        }
+    }
+
+    gArtPrefetchCondition.notify_all();
+}
+
+void artPrefetchCancel()
+{
+    if (!gArtPrefetchThreadStarted) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(gArtPrefetchMutex);
+
+    gArtPrefetchQueue.clear();
+
+    // Art which is being loaded cannot be interrupted, wait for it.
+    gArtPrefetchCondition.wait(lock, []() {
+        for (const auto& entry : gArtPrefetchEntries) {
+            if (entry.second.state == ART_PREFETCH_STATE_LOADING) {
+                return false;
+            }
+        }
+        return true;
+    });
+
+    for (auto& entry : gArtPrefetchEntries) {
+        free(entry.second.data);
+    }
+
+    gArtPrefetchEntries.clear();
+    gArtPrefetchBytes = 0;
+}
+
+static void artPrefetchStart()
+{
+    if (gArtPrefetchThreadStarted) {
+        return;
+    }
+
+    // There is no point in keeping more decoded art than the cache can hold.
+    gArtPrefetchBudget = static_cast<size_t>(settings.system.art_cache_size) << 20;
+    gArtPrefetchThreadShouldExit = false;
+
+    // File functions skip locking unless asked otherwise, prefetch thread is
+    // the only one reading files besides the main thread.
+    dbSetThreadSafe(true);
+
+    gArtPrefetchThread = std::thread(artPrefetchThreadProc);
+    gArtPrefetchThreadStarted = true;
+}
+
+static void artPrefetchStop()
+{
+    if (!gArtPrefetchThreadStarted) {
+        return;
+    }
+
+    artPrefetchCancel();
+
+    {
+        std::lock_guard<std::mutex> lock(gArtPrefetchMutex);
+        gArtPrefetchThreadShouldExit = true;
+        gArtPrefetchCondition.notify_all();
+    }
+
+    gArtPrefetchThread.join();
+    gArtPrefetchThreadStarted = false;
+
+    dbSetThreadSafe(false);
+}
+
+static void artPrefetchThreadProc()
+{
+    std::unique_lock<std::mutex> lock(gArtPrefetchMutex);
+
+    while (true) {
+        gArtPrefetchCondition.wait(lock, []() {
+            return gArtPrefetchThreadShouldExit
+                || (!gArtPrefetchQueue.empty() && gArtPrefetchBytes < gArtPrefetchBudget);
+        });
+
+        if (gArtPrefetchThreadShouldExit) {
+            break;
+        }
+
+        int fid = gArtPrefetchQueue.front();
+        gArtPrefetchQueue.pop_front();
+
+        // Entry might have been claimed by the main thread in the meantime.
+        auto it = gArtPrefetchEntries.find(fid);
+        if (it == gArtPrefetchEntries.end() || it->second.state != ART_PREFETCH_STATE_QUEUED) {
+            continue;
+        }
+
+        ArtPrefetchEntry* entry = &(it->second);
+        entry->state = ART_PREFETCH_STATE_LOADING;
+
+        std::string localizedPath = entry->localizedPath;
+        std::string path = entry->path;
+
+        lock.unlock();
+
+        int size = 0;
+        unsigned char* data = nullptr;
+        if (!localizedPath.empty()) {
+            data = artPrefetchLoad(localizedPath.c_str(), &size);
+        }
+
+        if (data == nullptr) {
+            data = artPrefetchLoad(path.c_str(), &size);
+        }
+
+        lock.lock();
+
+        // NOTE: Entries in loading state are never removed by the main thread,
+        // so [entry] is still valid.
+        if (data != nullptr) {
+            entry->state = ART_PREFETCH_STATE_READY;
+            entry->data = data;
+            entry->size = size;
+            gArtPrefetchBytes += size;
+        } else {
+            entry->state = ART_PREFETCH_STATE_FAILED;
+        }
+
+        gArtPrefetchCondition.notify_all();
+    }
+}
+
+// Reads and decodes art at [path] into a buffer allocated with `malloc`.
+//
+// NOTE: Runs on prefetch thread.
+static unsigned char* artPrefetchLoad(const char* path, int* sizePtr)
+{
+    int viewSize;
+    unsigned char* contents = nullptr;
+    const unsigned char* view = dbGetFileView(path, &viewSize);
+    if (view == nullptr) {
+        contents = dbLoadFileContents(path, &viewSize);
+        if (contents == nullptr) {
+            return nullptr;
+        }
+        view = contents;
+    }
+
+    unsigned char* data = nullptr;
+
+    Art art;
+    int offset = 0;
+    if (artReadHeaderFromView(&art, view, viewSize, &offset) == 0) {
+        int size = artGetDataSize(&art);
+        data = (unsigned char*)malloc(size);
+        if (data != nullptr) {
+            if (artReadFromView(view, viewSize, data) == 0) {
+                *sizePtr = size;
+            } else {
+                free(data);
+                data = nullptr;
+            }
+        }
+    }
+
+    free(contents);
+
+    return data;
+}
+
+// Waits until prefetched art for [fid] is decoded.
+//
+// Returns NULL if [fid] is not scheduled, failed to load, or was not picked up
+// by the worker yet (in which case it's removed from the queue, and the caller
+// is expected to load it on its own).
+static ArtPrefetchEntry* artPrefetchAcquire(std::unique_lock<std::mutex>& lock, int fid)
+{
+    auto it = gArtPrefetchEntries.find(fid);
+    if (it == gArtPrefetchEntries.end()) {
+        return nullptr;
+    }
+
+    if (it->second.state == ART_PREFETCH_STATE_QUEUED) {
+        gArtPrefetchEntries.erase(it);
+        return nullptr;
+    }
+
+    gArtPrefetchCondition.wait(lock, [&it]() {
+        return it->second.state != ART_PREFETCH_STATE_LOADING;
+    });
+
+    if (it->second.state == ART_PREFETCH_STATE_FAILED) {
+        gArtPrefetchEntries.erase(it);
+        return nullptr;
+    }
+
+    return &(it->second);
+}
+
+static bool artPrefetchGetSize(int fid, int* sizePtr)
+{
+    if (!gArtPrefetchThreadStarted) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(gArtPrefetchMutex);
+
+    ArtPrefetchEntry* entry = artPrefetchAcquire(lock, fid);
+    if (entry == nullptr) {
+        return false;
+    }
+
+    *sizePtr = entry->size;
+
+    return true;
+}
+
+static bool artPrefetchTake(int fid, int* sizePtr, unsigned char* data)
+{
+    if (!gArtPrefetchThreadStarted) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(gArtPrefetchMutex);
+
+    ArtPrefetchEntry* entry = artPrefetchAcquire(lock, fid);
+    if (entry == nullptr) {
+        return false;
+    }
+
+    memcpy(data, entry->data, entry->size);
+    *sizePtr = entry->size;
+
+    free(entry->data);
+    gArtPrefetchBytes -= entry->size;
+    gArtPrefetchEntries.erase(fid);
+
+    // Let the worker continue if it was paused due to budget.
+    gArtPrefetchCondition.notify_all();
+
+    return true;
+}
+
 // 0x4192B0
 int artCopyFileName(ObjectType objectType, int id, char* dest)
 {
@@ -923,6 +1306,28 @@ ConstBuffer2D artGetFrameBuffer(const Art* art, int frame, Rotation rotation)
     return { data, width, height };
 }
 
+bool artGetFrameSpans(const Art* art, int frame, Rotation rotation, ArtFrameSpans* frameSpans)
+{
+    if (gArtSpans.empty()) {
+        return false;
+    }
+
+    if (art == nullptr || !rotationIsValid(rotation) || frame < 0 || frame >= art->frameCount) {
+        return false;
+    }
+
+    auto it = gArtSpans.find(art);
+    if (it == gArtSpans.end()) {
+        return false;
+    }
+
+    const ArtSpanData* spanData = it->second.get();
+    frameSpans->rows = spanData->rows.data() + spanData->frames[rotation * art->frameCount + frame];
+    frameSpans->spans = spanData->spans.data();
+
+    return true;
+}
+
 // 0x4198C8
 bool artExists(int fid)
 {
@@ -1018,26 +1423,27 @@ static bool artGetLocalizedPath(const char* basePath, const char** outPath)
 // 0x419A78
 static int artCacheGetFileSizeImpl(int fid, int* sizePtr)
 {
+    if (artPrefetchGetSize(fid, sizePtr)) {
+        return 0;
+    }
+
     int result = -1;
 
     char* artFilePath = artBuildFilePath(fid);
     if (artFilePath != nullptr) {
-        File* stream = nullptr;
+        Art art;
+        int rc = -2;
         const char* localizedPath;
         if (artGetLocalizedPath(artFilePath, &localizedPath)) {
-            stream = fileOpen(localizedPath, "rb");
+            rc = artReadHeaderAtPath(&art, localizedPath);
         }
-        if (stream == nullptr) {
-            stream = fileOpen(artFilePath, "rb");
+        if (rc == -2) {
+            rc = artReadHeaderAtPath(&art, artFilePath);
         }
 
-        if (stream != nullptr) {
-            Art art;
-            if (artReadHeader(&art, stream) == 0) {
-                *sizePtr = artGetDataSize(&art);
-                result = 0;
-            }
-            fileClose(stream);
+        if (rc == 0) {
+            *sizePtr = artGetDataSize(&art);
+            result = 0;
         }
     }
 
@@ -1047,6 +1453,11 @@ static int artCacheGetFileSizeImpl(int fid, int* sizePtr)
 // 0x419B78
 static int artCacheReadDataImpl(int fid, int* sizePtr, unsigned char* data)
 {
+    if (artPrefetchTake(fid, sizePtr, data)) {
+        artAttachSpans(reinterpret_cast<const Art*>(data));
+        return 0;
+    }
+
     int result = -1;
 
     char* artFileName = artBuildFilePath(fid);
@@ -1067,6 +1478,7 @@ static int artCacheReadDataImpl(int fid, int* sizePtr, unsigned char* data)
 
         if (loaded) {
             *sizePtr = artGetDataSize((Art*)data);
+            artAttachSpans(reinterpret_cast<const Art*>(data));
             result = 0;
         }
     }
@@ -1077,7 +1489,7 @@ static int artCacheReadDataImpl(int fid, int* sizePtr, unsigned char* data)
 // 0x419C80
 static void artCacheFreeImpl(void* ptr)
 {
-    internal_free(ptr);
+    gArtSpans.erase(reinterpret_cast<const Art*>(ptr));
 }
 
 /* FID Structure:
@@ -1158,6 +1570,148 @@ static int artReadHeader(Art* art, File* stream)
     return 0;
 }
 
+// Reads art header from file at [path].
+//
+// Returns -2 if file is not found, -3 if header cannot be read, 0 on success.
+static int artReadHeaderAtPath(Art* art, const char* path)
+{
+    int viewSize;
+    const unsigned char* view = dbGetFileView(path, &viewSize);
+    if (view != nullptr) {
+        int offset = 0;
+        return artReadHeaderFromView(art, view, viewSize, &offset) == 0 ? 0 : -3;
+    }
+
+    File* stream = fileOpen(path, "rb");
+    if (stream == nullptr) {
+        return -2;
+    }
+
+    int rc = artReadHeader(art, stream) == 0 ? 0 : -3;
+    fileClose(stream);
+
+    return rc;
+}
+
+// Reads a 16-bit big-endian integer from [view] at [offsetPtr] and advances
+// it.
+static bool artViewReadInt16(const unsigned char* view, int size, int* offsetPtr, short* valuePtr)
+{
+    int offset = *offsetPtr;
+    if (size - offset < 2) {
+        return false;
+    }
+
+    *valuePtr = static_cast<short>((view[offset] << 8) | view[offset + 1]);
+    *offsetPtr = offset + 2;
+
+    return true;
+}
+
+// Reads a 32-bit big-endian integer from [view] at [offsetPtr] and advances
+// it.
+static bool artViewReadInt32(const unsigned char* view, int size, int* offsetPtr, int* valuePtr)
+{
+    int offset = *offsetPtr;
+    if (size - offset < 4) {
+        return false;
+    }
+
+    *valuePtr = static_cast<int>((static_cast<unsigned int>(view[offset]) << 24)
+        | (static_cast<unsigned int>(view[offset + 1]) << 16)
+        | (static_cast<unsigned int>(view[offset + 2]) << 8)
+        | static_cast<unsigned int>(view[offset + 3]));
+    *offsetPtr = offset + 4;
+
+    return true;
+}
+
+// Same as [artReadHeader], but reads from in-memory file contents.
+static int artReadHeaderFromView(Art* art, const unsigned char* view, int size, int* offsetPtr)
+{
+    if (!artViewReadInt32(view, size, offsetPtr, &(art->version))) return -1;
+    if (!artViewReadInt16(view, size, offsetPtr, &(art->framesPerSecond))) return -1;
+    if (!artViewReadInt16(view, size, offsetPtr, &(art->actionFrame))) return -1;
+    if (!artViewReadInt16(view, size, offsetPtr, &(art->frameCount))) return -1;
+
+    for (int index = 0; index < ROTATION_COUNT; index++) {
+        if (!artViewReadInt16(view, size, offsetPtr, &(art->xOffsets[index]))) return -1;
+    }
+
+    for (int index = 0; index < ROTATION_COUNT; index++) {
+        if (!artViewReadInt16(view, size, offsetPtr, &(art->yOffsets[index]))) return -1;
+    }
+
+    for (int index = 0; index < ROTATION_COUNT; index++) {
+        if (!artViewReadInt32(view, size, offsetPtr, &(art->dataOffsets[index]))) return -1;
+    }
+
+    if (!artViewReadInt32(view, size, offsetPtr, &(art->dataSize))) return -1;
+
+    // CE: Fix malformed `frm` files with `dataSize` set to 0 in Nevada.
+    if (art->dataSize == 0) {
+        art->dataSize = size;
+    }
+
+    return 0;
+}
+
+// Same as [artReadFrameData], but reads from in-memory file contents.
+static int artReadFrameDataFromView(unsigned char* data, const unsigned char* view, int size, int* offsetPtr, int count, int* paddingPtr)
+{
+    unsigned char* ptr = data;
+    int padding = 0;
+    for (int index = 0; index < count; index++) {
+        ArtFrame* frame = (ArtFrame*)ptr;
+
+        if (!artViewReadInt16(view, size, offsetPtr, &(frame->width))) return -1;
+        if (!artViewReadInt16(view, size, offsetPtr, &(frame->height))) return -1;
+        if (!artViewReadInt32(view, size, offsetPtr, &(frame->size))) return -1;
+        if (!artViewReadInt16(view, size, offsetPtr, &(frame->x))) return -1;
+        if (!artViewReadInt16(view, size, offsetPtr, &(frame->y))) return -1;
+        if (frame->size < 0 || size - *offsetPtr < frame->size) return -1;
+
+        memcpy(ptr + sizeof(ArtFrame), view + *offsetPtr, frame->size);
+        *offsetPtr += frame->size;
+
+        ptr += sizeof(ArtFrame) + frame->size;
+        ptr += paddingForSize(frame->size);
+        padding += paddingForSize(frame->size);
+    }
+
+    *paddingPtr = padding;
+
+    return 0;
+}
+
+// Same as [artRead], but reads from in-memory file contents.
+static int artReadFromView(const unsigned char* view, int size, unsigned char* data)
+{
+    int offset = 0;
+
+    Art* art = (Art*)data;
+    if (artReadHeaderFromView(art, view, size, &offset) != 0) {
+        return -3;
+    }
+
+    int currentPadding = paddingForSize(sizeof(Art));
+    int previousPadding = 0;
+
+    for (int index = 0; index < ROTATION_COUNT; index++) {
+        art->padding[index] = currentPadding;
+
+        if (index == 0 || art->dataOffsets[index - 1] != art->dataOffsets[index]) {
+            art->padding[index] += previousPadding;
+            currentPadding += previousPadding;
+            if (artReadFrameDataFromView(data + sizeof(Art) + art->dataOffsets[index] + art->padding[index], view, size, &offset, art->frameCount, &previousPadding) != 0) {
+                return -5;
+            }
+        }
+    }
+
+    return 0;
+}
+
 static bool artPathHasExtension(const char* path, const char* extension)
 {
     size_t pathLength = strlen(path);
@@ -1367,19 +1921,11 @@ static Art* artLoadPcx(const char* path)
 
 static Art* artLoadFrm(const char* path)
 {
-    File* stream = fileOpen(path, "rb");
-    if (stream == nullptr) {
-        return nullptr;
-    }
-
     Art header;
-    if (artReadHeader(&header, stream) != 0) {
-        fileClose(stream);
+    if (artReadHeaderAtPath(&header, path) != 0) {
         return nullptr;
     }
 
-    fileClose(stream);
-
     unsigned char* data = reinterpret_cast<unsigned char*>(internal_malloc(artGetDataSize(&header)));
     if (data == nullptr) {
         return nullptr;
@@ -1434,6 +1980,13 @@ static Art* artLoadLocalized(const char* path)
 // 0x419FC0
 int artRead(const char* path, unsigned char* data)
 {
+    // Parse file in place if it's directly accessible.
+    int viewSize;
+    const unsigned char* view = dbGetFileView(path, &viewSize);
+    if (view != nullptr) {
+        return artReadFromView(view, viewSize, data);
+    }
+
     File* stream = fileOpen(path, "rb");
     if (stream == nullptr) {
         return -2;
@@ -1538,6 +2091,73 @@ int artWrite(const char* path, unsigned char* data)
     return 0;
 }
 
+static void artAttachSpans(const Art* art)
+{
+    if (gArtSpansEnabled) {
+        gArtSpans[art] = artBuildSpans(art);
+    }
+}
+
+// Encodes every frame of [art] as runs of opaque pixels, so that blitters
+// can skip transparent areas without looking at them. Rotations sharing the
+// same frames share spans too.
+static std::unique_ptr<ArtSpanData> artBuildSpans(const Art* art)
+{
+    std::unique_ptr<ArtSpanData> spanData = std::make_unique<ArtSpanData>();
+    spanData->frames.resize(ROTATION_COUNT * art->frameCount);
+
+    for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
+        int sharedRotation = 0;
+        while (sharedRotation < rotation && art->dataOffsets[sharedRotation] != art->dataOffsets[rotation]) {
+            sharedRotation++;
+        }
+
+        for (int frame = 0; frame < art->frameCount; frame++) {
+            if (sharedRotation != rotation) {
+                spanData->frames[rotation * art->frameCount + frame] = spanData->frames[sharedRotation * art->frameCount + frame];
+                continue;
+            }
+
+            const ArtFrame* frm = artGetFrame(art, frame, static_cast<Rotation>(rotation));
+            const unsigned char* row = artFrameData(frm);
+
+            spanData->frames[rotation * art->frameCount + frame] = static_cast<int>(spanData->rows.size());
+
+            for (int y = 0; y < frm->height; y++) {
+                spanData->rows.push_back(static_cast<int>(spanData->spans.size()));
+
+                int x = 0;
+                while (x < frm->width) {
+                    while (x < frm->width && row[x] == 0) {
+                        x++;
+                    }
+
+                    int start = x;
+                    while (x < frm->width && row[x] != 0) {
+                        x++;
+                    }
+
+                    if (x > start) {
+                        ArtSpan span;
+                        span.x = static_cast<unsigned short>(start);
+                        span.length = static_cast<unsigned short>(x - start);
+                        spanData->spans.push_back(span);
+                    }
+                }
+
+                row += frm->width;
+            }
+
+            spanData->rows.push_back(static_cast<int>(spanData->spans.size()));
+        }
+    }
+
+    spanData->rows.shrink_to_fit();
+    spanData->spans.shrink_to_fit();
+
+    return spanData;
+}
+
 static int artGetDataSize(const Art* art)
 {
     int dataSize = sizeof(*art) + art->dataSize;
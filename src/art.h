@@ -33,6 +33,21 @@ typedef struct ArtFrame {
     short y;
 } ArtFrame;
 
+// A run of opaque (non-zero) pixels within a single row of a frame.
+typedef struct ArtSpan {
+    unsigned short x;
+    unsigned short length;
+} ArtSpan;
+
+// Span encoded frame, see [artGetFrameSpans].
+//
+// Spans of row `y` are `spans[rows[y]]` up to (but not including)
+// `spans[rows[y + 1]]`, ordered by `x`. Everything in between is transparent.
+typedef struct ArtFrameSpans {
+    const int* rows;
+    const ArtSpan* spans;
+} ArtFrameSpans;
+
 extern int _art_vault_guy_num;
 extern int _art_vault_person_nums[DUDE_NATIVE_LOOK_COUNT][GENDER_COUNT];
 
@@ -51,6 +66,16 @@ Art* artLock(int fid, CacheEntry** cache_entry);
 unsigned char* artLockFrameData(int fid, int frame, Rotation rotation, CacheEntry** out_cache_entry);
 int artUnlock(CacheEntry* cache_entry);
 int artCacheFlush();
+
+// Schedules art specified by [fids] to be loaded into art cache.
+//
+// When background prefetching is enabled, art is decoded on a worker thread
+// and handed over to the cache once requested via [artLock]. Otherwise it's
+// loaded into cache immediately.
+void artPrefetch(const int* fids, int fidsLength);
+
+// Discards art scheduled via [artPrefetch] which was not consumed yet.
+void artPrefetchCancel();
 int artCopyFileName(ObjectType objectType, int id, char* dest);
 int _art_get_code(AnimationType animation, WeaponAnimation weaponType, char* weaponCodePtr, char* animationCodePtr);
 char* artBuildFilePath(int fid);
@@ -66,6 +91,11 @@ unsigned char* artGetFrameData(Art* art, int frame = 0, Rotation rotation = ROTA
 unsigned char* artGetFrameData(const Art* art, int frame, Rotation rotation, int* widthPtr, int* heightPtr, int* xOffsetPtr, int* yOffsetPtr);
 ArtFrame* artGetFrame(const Art* art, int frame, Rotation rotation);
 ConstBuffer2D artGetFrameBuffer(const Art* art, int frame, Rotation rotation);
+
+// Obtains span encoded version of the frame. Only art locked from art cache
+// has spans, and only when `art_spans` is enabled. Returns `false` when spans
+// are not available, in which case callers should use frame data as is.
+bool artGetFrameSpans(const Art* art, int frame, Rotation rotation, ArtFrameSpans* frameSpans);
 bool artExists(int fid);
 bool _art_fid_valid(int fid);
 int _art_alias_num(int index);
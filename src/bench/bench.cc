@@ -0,0 +1,332 @@
+#include "bench/bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "color.h"
+#include "frame_profiler.h"
+#include "game.h"
+#include "game_mouse.h"
+#include "light.h"
+#include "map.h"
+#include "object.h"
+#include "palette.h"
+#include "platform_compat.h"
+#include "random.h"
+#include "svga.h"
+#include "tile.h"
+#include "window_manager.h"
+
+namespace fallout {
+
+// Number of tiles the camera moves in one direction before turning. Six legs
+// make a closed hexagon, so long runs keep panning over the same area.
+#define BENCH_DEFAULT_LEG_LENGTH (40)
+
+#define BENCH_DEFAULT_FRAMES (600)
+#define BENCH_DEFAULT_WARMUP_FRAMES (30)
+
+typedef struct BenchOptions {
+    char mapName[COMPAT_MAX_PATH];
+    int frames;
+    int warmupFrames;
+    int legLength;
+    bool printChecksum;
+    bool hasExpectedChecksum;
+    unsigned int expectedChecksum;
+    const char* tracePath;
+} BenchOptions;
+
+typedef struct BenchCameraPath {
+    Rotation rotation;
+    int step;
+    int legLength;
+} BenchCameraPath;
+
+static bool benchParseCommandLineArguments(int argc, char** argv, BenchOptions* options);
+static bool benchParseInt(const char* value, int min, int* valuePtr);
+static bool benchLoadMap(const BenchOptions* options);
+static void benchMoveCamera(BenchCameraPath* path);
+static void benchRenderFrame();
+static unsigned int benchGetWindowChecksum(int win);
+static void benchPrintReport(const BenchOptions* options, const std::vector<FrameProfilerFrameTimes>& frames);
+
+// Renders the map at a fixed camera path and reports frame times.
+//
+// Runs without scripts, input and timers, so every run with the same map and
+// options draws exactly the same frames. Video and audio default to SDL dummy
+// drivers (see [main]), which can be overridden with `SDL_VIDEODRIVER` and
+// `SDL_AUDIODRIVER` environment variables.
+int benchMain(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!benchParseCommandLineArguments(argc, argv, &options)) {
+        printf("usage: fallout2-ce-bench [--map=artemple.map] [--frames=%d] [--warmup=%d] [--leg=%d] [--checksum] [--expect-checksum=HEX] [--trace=PATH]\n",
+            BENCH_DEFAULT_FRAMES,
+            BENCH_DEFAULT_WARMUP_FRAMES,
+            BENCH_DEFAULT_LEG_LENGTH);
+        return EXIT_FAILURE;
+    }
+
+    if (gameInitWithOptions("FALLOUT II", false, 0, WINDOW_MANAGER_INIT_FLAG_BUFFERED, argc, argv) == -1) {
+        printf("bench: unable to initialize game\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!benchLoadMap(&options)) {
+        printf("bench: unable to load %s\n", options.mapName);
+        gameExit();
+        return EXIT_FAILURE;
+    }
+
+    frameProfilerStart();
+
+    BenchCameraPath path;
+    path.rotation = ROTATION_NE;
+    path.step = 0;
+    path.legLength = options.legLength;
+
+    // Establishes frame boundary, first frame includes everything since
+    // profiler start.
+    benchRenderFrame();
+
+    std::vector<FrameProfilerFrameTimes> frames;
+    frames.reserve(options.frames);
+
+    for (int frame = 0; frame < options.warmupFrames + options.frames; frame++) {
+        benchMoveCamera(&path);
+        benchRenderFrame();
+
+        if (frame >= options.warmupFrames) {
+            FrameProfilerFrameTimes times;
+            if (frameProfilerGetRecentFrames(&times, 1) == 1) {
+                frames.push_back(times);
+            }
+        }
+    }
+
+    benchPrintReport(&options, frames);
+
+    int rc = EXIT_SUCCESS;
+
+    if (options.printChecksum || options.hasExpectedChecksum) {
+        unsigned int checksum = benchGetWindowChecksum(gIsoWindow);
+        printf("checksum: %08x\n", checksum);
+
+        if (options.hasExpectedChecksum && checksum != options.expectedChecksum) {
+            printf("checksum mismatch, expected %08x\n", options.expectedChecksum);
+            rc = EXIT_FAILURE;
+        }
+    }
+
+    if (options.tracePath != nullptr) {
+        frameProfilerExportTrace(options.tracePath);
+    }
+
+    objectHide(gDude, nullptr);
+    mapExit();
+    gameExit();
+
+    return rc;
+}
+
+static bool benchParseCommandLineArguments(int argc, char** argv, BenchOptions* options)
+{
+    strcpy(options->mapName, "artemple.map");
+    options->frames = BENCH_DEFAULT_FRAMES;
+    options->warmupFrames = BENCH_DEFAULT_WARMUP_FRAMES;
+    options->legLength = BENCH_DEFAULT_LEG_LENGTH;
+    options->printChecksum = false;
+    options->hasExpectedChecksum = false;
+    options->expectedChecksum = 0;
+    options->tracePath = nullptr;
+
+    for (int arg = 1; arg < argc; arg++) {
+        const char* value = argv[arg];
+        if (strncmp(value, "--map=", 6) == 0) {
+            if (strlen(value + 6) >= sizeof(options->mapName)) {
+                return false;
+            }
+            strcpy(options->mapName, value + 6);
+        } else if (strncmp(value, "--frames=", 9) == 0) {
+            if (!benchParseInt(value + 9, 1, &(options->frames))) {
+                return false;
+            }
+        } else if (strncmp(value, "--warmup=", 9) == 0) {
+            if (!benchParseInt(value + 9, 0, &(options->warmupFrames))) {
+                return false;
+            }
+        } else if (strncmp(value, "--leg=", 6) == 0) {
+            if (!benchParseInt(value + 6, 1, &(options->legLength))) {
+                return false;
+            }
+        } else if (strcmp(value, "--checksum") == 0) {
+            options->printChecksum = true;
+        } else if (strncmp(value, "--expect-checksum=", 18) == 0) {
+            char* end;
+            options->expectedChecksum = static_cast<unsigned int>(strtoul(value + 18, &end, 16));
+            if (end == value + 18 || *end != '\0') {
+                return false;
+            }
+            options->hasExpectedChecksum = true;
+        } else if (strncmp(value, "--trace=", 8) == 0) {
+            options->tracePath = value + 8;
+        } else if (strcmp(value, "--help") == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool benchParseInt(const char* value, int min, int* valuePtr)
+{
+    char* end;
+    long number = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || number < min || number > 1000000) {
+        return false;
+    }
+
+    *valuePtr = static_cast<int>(number);
+    return true;
+}
+
+// Loads map the way new game does, without fades and music.
+static bool benchLoadMap(const BenchOptions* options)
+{
+    // Map scripts can roll dice when placing critters.
+    randomSeedPrerandom(1);
+
+    gDude->flags &= ~OBJECT_FLAT;
+    objectShow(gDude, nullptr);
+
+    colorPaletteLoad("color.pal");
+    paletteSetEntries(_cmap);
+
+    mapInit();
+    gameMouseSetCursor(MOUSE_CURSOR_NONE);
+
+    char mapName[COMPAT_MAX_PATH];
+    strcpy(mapName, options->mapName);
+    if (mapLoadByName(mapName) != 0) {
+        return false;
+    }
+
+    return true;
+}
+
+// Moves camera one tile along the path, turning at the end of every leg or
+// when map bounds do not allow to go further.
+static void benchMoveCamera(BenchCameraPath* path)
+{
+    int previousTile = gCenterTile;
+    int tile = tileGetTileInDirection(previousTile, path->rotation, 1);
+    tileSetCenter(tile, TILE_SET_CENTER_REFRESH_WINDOW | TILE_SET_CENTER_FLAG_IGNORE_SCROLL_RESTRICTIONS);
+
+    bool blocked = gCenterTile == previousTile;
+    if (blocked) {
+        // Keep frame cost comparable to the moving one.
+        tileWindowRefresh();
+    }
+
+    path->step++;
+    if (path->step == path->legLength || blocked) {
+        path->step = 0;
+        path->rotation = static_cast<Rotation>((path->rotation + 1) % ROTATION_COUNT);
+    }
+}
+
+// Same sequence as the end of the main loop iteration, see [mainLoop].
+static void benchRenderFrame()
+{
+    lightRefreshDirtyRects();
+    windowFlushDamage();
+    renderPresent();
+}
+
+// FNV-1a hash of palette indexes in window buffer. Does not depend on
+// renderer or texture format.
+static unsigned int benchGetWindowChecksum(int win)
+{
+    unsigned char* buffer = windowGetBuffer(win);
+    if (buffer == nullptr) {
+        return 0;
+    }
+
+    int length = windowGetWidth(win) * windowGetHeight(win);
+
+    unsigned int hash = 2166136261u;
+    for (int index = 0; index < length; index++) {
+        hash ^= buffer[index];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static void benchPrintReport(const BenchOptions* options, const std::vector<FrameProfilerFrameTimes>& frames)
+{
+    if (frames.empty()) {
+        printf("bench: no frames recorded\n");
+        return;
+    }
+
+    int framesLength = static_cast<int>(frames.size());
+    int zonesLength = frameProfilerGetZonesLength();
+
+    unsigned long long totalTime = 0;
+    unsigned long long zoneTimes[FRAME_PROFILER_ZONES_MAX] = { 0 };
+    std::vector<unsigned int> frameTimes;
+    frameTimes.reserve(framesLength);
+
+    for (const FrameProfilerFrameTimes& frame : frames) {
+        totalTime += frame.total;
+        frameTimes.push_back(frame.total);
+
+        for (int zone = 0; zone < zonesLength; zone++) {
+            zoneTimes[zone] += frame.zones[zone];
+        }
+    }
+
+    std::sort(frameTimes.begin(), frameTimes.end());
+
+    double averageTime = static_cast<double>(totalTime) / framesLength;
+    unsigned int p50 = frameTimes[(framesLength - 1) * 50 / 100];
+    unsigned int p99 = frameTimes[(framesLength - 1) * 99 / 100];
+
+    printf("map: %s, screen: %dx%d, frames: %d (+%d warmup)\n",
+        options->mapName,
+        screenGetWidth(),
+        screenGetHeight(),
+        framesLength,
+        options->warmupFrames);
+    printf("fps: %.1f\n", totalTime != 0 ? framesLength * 1000000.0 / totalTime : 0.0);
+    printf("frame time: avg %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+        averageTime / 1000.0,
+        p50 / 1000.0,
+        p99 / 1000.0,
+        frameTimes.back() / 1000.0);
+
+    printf("zones (self time per frame):\n");
+
+    unsigned long long zonesTime = 0;
+    for (int zone = 0; zone < zonesLength; zone++) {
+        zonesTime += zoneTimes[zone];
+        printf("  %-24s %8.3f ms %5.1f%%\n",
+            frameProfilerGetZoneName(zone),
+            zoneTimes[zone] / 1000.0 / framesLength,
+            totalTime != 0 ? zoneTimes[zone] * 100.0 / totalTime : 0.0);
+    }
+
+    unsigned long long otherTime = totalTime - std::min(totalTime, zonesTime);
+    printf("  %-24s %8.3f ms %5.1f%%\n",
+        "(other)",
+        otherTime / 1000.0 / framesLength,
+        totalTime != 0 ? otherTime * 100.0 / totalTime : 0.0);
+}
+
+} // namespace fallout
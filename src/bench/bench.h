@@ -0,0 +1,10 @@
+#ifndef FALLOUT_BENCH_BENCH_H_
+#define FALLOUT_BENCH_BENCH_H_
+
+namespace fallout {
+
+int benchMain(int argc, char** argv);
+
+} // namespace fallout
+
+#endif /* FALLOUT_BENCH_BENCH_H_ */
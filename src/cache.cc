@@ -5,30 +5,51 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <chrono>
+
 #include "debug.h"
 #include "memory.h"
 #include "sound.h"
 
 namespace fallout {
 
-// The initial number of cache entries in new cache.
-#define CACHE_ENTRIES_INITIAL_CAPACITY (100)
-
-// The number of cache entries added when cache capacity is reached.
-#define CACHE_ENTRIES_GROW_CAPACITY (50)
-
-static bool cacheFetchEntryForKey(Cache* cache, int key, int* indexPtr);
-static bool cacheInsertEntryAtIndex(Cache* cache, CacheEntry* cacheEntry, int index);
-static int cacheFindIndexForKey(Cache* cache, int key, int* indexPtr);
+// The initial number of hash buckets in new cache.
+#define CACHE_BUCKETS_INITIAL_LENGTH (128)
+
+// The maximum share of cache size (in percents) occupied by protected segment.
+// Once exceeded least recently used protected entries are demoted back to
+// probationary segment.
+#define CACHE_PROTECTED_SEGMENT_RATIO (80)
+
+static void cacheRecordLoadTime(Cache* cache, long long loadTime);
+static bool cacheFetchEntryForKey(Cache* cache, int key, CacheEntry** cacheEntryPtr);
+static CacheEntry* cacheFindEntryForKey(Cache* cache, int key);
+static int cacheBucketIndexForKey(Cache* cache, int key);
+static bool cacheInsertEntry(Cache* cache, CacheEntry* cacheEntry);
+static void cacheRemoveEntry(Cache* cache, CacheEntry* cacheEntry);
+static bool cacheSetBucketsLength(Cache* cache, int bucketsLength);
 static bool cacheEntryInit(CacheEntry* cacheEntry);
 static bool cacheEntryFree(Cache* cache, CacheEntry* cacheEntry);
+static void cacheEvictEntry(Cache* cache, CacheEntry* cacheEntry);
+static CacheList* cacheGetList(Cache* cache, CacheSegment segment);
+static void cacheListAppend(CacheList* list, CacheEntry* cacheEntry);
+static void cacheListRemove(CacheList* list, CacheEntry* cacheEntry);
+static void cachePromoteEntry(Cache* cache, CacheEntry* cacheEntry);
+static void cacheBalanceSegments(Cache* cache);
 static bool cacheClean(Cache* cache);
-static bool cacheResetStatistics(Cache* cache);
 static bool cacheEnsureSize(Cache* cache, int size);
-static bool cacheSweep(Cache* cache);
-static bool cacheSetCapacity(Cache* cache, int newCapacity);
-static int cacheEntriesCompareByUsage(const void* a1, const void* a2);
-static int cacheEntriesCompareByMostRecentHit(const void* a1, const void* a2);
+
+// Upper bounds (exclusive, in microseconds) of load time histogram buckets.
+static const int gCacheLoadTimeBucketLimits[CACHE_LOAD_TIME_BUCKETS_LENGTH] = {
+    100,
+    250,
+    500,
+    1000,
+    2500,
+    5000,
+    10000,
+    -1,
+};
 
 // 0x510938 lock_sound_ticker
 static int _lock_sound_ticker = 0;
@@ -44,19 +65,31 @@ bool cacheInit(Cache* cache, CacheSizeProc* sizeProc, CacheReadProc* readProc, C
     cache->size = 0;
     cache->maxSize = maxSize;
     cache->entriesLength = 0;
-    cache->entriesCapacity = CACHE_ENTRIES_INITIAL_CAPACITY;
-    cache->hits = 0;
-    cache->entries = (CacheEntry**)internal_malloc(sizeof(*cache->entries) * cache->entriesCapacity);
+    cache->lookups = 0;
+    cache->misses = 0;
+    cache->failedLoads = 0;
+    cache->evictions = 0;
+    cache->bytesLoaded = 0;
+    cache->bytesEvicted = 0;
+    cache->lockedEntriesLength = 0;
+    cache->lockedSize = 0;
+    memset(cache->loadTimeHistogram, 0, sizeof(cache->loadTimeHistogram));
+    cache->loadTime = 0;
+    cache->buckets = nullptr;
+    cache->bucketsLength = 0;
+    cache->probationaryList.head = nullptr;
+    cache->probationaryList.tail = nullptr;
+    cache->protectedList.head = nullptr;
+    cache->protectedList.tail = nullptr;
+    cache->protectedSize = 0;
     cache->sizeProc = sizeProc;
     cache->readProc = readProc;
     cache->freeProc = freeProc;
 
-    if (cache->entries == nullptr) {
+    if (!cacheSetBucketsLength(cache, CACHE_BUCKETS_INITIAL_LENGTH)) {
         return false;
     }
 
-    memset(cache->entries, 0, sizeof(*cache->entries) * cache->entriesCapacity);
-
     return true;
 }
 
@@ -75,14 +108,25 @@ bool cacheFree(Cache* cache)
     cache->size = 0;
     cache->maxSize = 0;
     cache->entriesLength = 0;
-    cache->entriesCapacity = 0;
-    cache->hits = 0;
+    cache->lookups = 0;
+    cache->misses = 0;
+    cache->failedLoads = 0;
+    cache->evictions = 0;
+    cache->bytesLoaded = 0;
+    cache->bytesEvicted = 0;
+    cache->lockedEntriesLength = 0;
+    cache->lockedSize = 0;
+    memset(cache->loadTimeHistogram, 0, sizeof(cache->loadTimeHistogram));
+    cache->loadTime = 0;
 
-    if (cache->entries != nullptr) {
-        internal_free(cache->entries);
-        cache->entries = nullptr;
+    if (cache->buckets != nullptr) {
+        internal_free(cache->buckets);
+        cache->buckets = nullptr;
     }
 
+    cache->bucketsLength = 0;
+    cache->protectedSize = 0;
+
     cache->sizeProc = nullptr;
     cache->readProc = nullptr;
     cache->freeProc = nullptr;
@@ -99,46 +143,69 @@ bool cacheLock(Cache* cache, int key, void** data, CacheEntry** cacheEntryPtr)
 
     *cacheEntryPtr = nullptr;
 
-    int index;
-    int rc = cacheFindIndexForKey(cache, key, &index);
-    if (rc == 2) {
+    CacheEntry* cacheEntry = cacheFindEntryForKey(cache, key);
+    bool existing = cacheEntry != nullptr;
+    if (existing) {
         // Use existing cache entry.
-        CacheEntry* cacheEntry = cache->entries[index];
         cacheEntry->hits++;
-    } else if (rc == 3) {
+    } else {
         // New cache entry is required.
         if (cache->entriesLength >= INT_MAX) {
             return false;
         }
 
-        if (!cacheFetchEntryForKey(cache, key, &index)) {
+        auto start = std::chrono::steady_clock::now();
+        if (!cacheFetchEntryForKey(cache, key, &cacheEntry)) {
+            cache->failedLoads++;
             return false;
         }
+        auto end = std::chrono::steady_clock::now();
+
+        cache->bytesLoaded += cacheEntry->size;
+        cacheRecordLoadTime(cache, std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
 
         _lock_sound_ticker %= 4;
         if (_lock_sound_ticker == 0) {
             soundContinueAll();
         }
-    } else {
-        return false;
     }
 
-    CacheEntry* cacheEntry = cache->entries[index];
     if (cacheEntry->referenceCount == 0) {
         if (!heapLock(&(cache->heap), cacheEntry->heapHandleIndex, &(cacheEntry->data))) {
+            if (!existing) {
+                // New entry is not linked into eviction lists yet, nothing
+                // would ever evict it.
+                cacheRemoveEntry(cache, cacheEntry);
+                cacheEntryFree(cache, cacheEntry);
+                cache->failedLoads++;
+            }
+
             return false;
         }
+
+        // Locked entries cannot be evicted, take it out of eviction list (new
+        // entries are not linked yet).
+        if (existing) {
+            cacheListRemove(cacheGetList(cache, cacheEntry->segment), cacheEntry);
+        }
+
+        cache->lockedEntriesLength++;
+        cache->lockedSize += cacheEntry->size;
     }
 
-    cacheEntry->referenceCount++;
+    if (existing) {
+        cachePromoteEntry(cache, cacheEntry);
+    }
 
-    cache->hits++;
-    cacheEntry->mru = cache->hits;
+    cacheEntry->referenceCount++;
 
-    if (cache->hits == UINT_MAX) {
-        cacheResetStatistics(cache);
+    // Only successful locks are counted, so misses never exceed lookups.
+    if (!existing) {
+        cache->misses++;
     }
 
+    cache->lookups++;
+
     *data = cacheEntry->data;
     *cacheEntryPtr = cacheEntry;
 
@@ -160,11 +227,20 @@ bool cacheUnlock(Cache* cache, CacheEntry* cacheEntry)
 
     if (cacheEntry->referenceCount == 0) {
         heapUnlock(&(cache->heap), cacheEntry->heapHandleIndex);
+
+        cache->lockedEntriesLength--;
+        cache->lockedSize -= cacheEntry->size;
+
+        // Entry becomes the most recently used one in its segment.
+        cacheListAppend(cacheGetList(cache, cacheEntry->segment), cacheEntry);
+        cacheBalanceSegments(cache);
     }
 
     return true;
 }
 
+// Evicts all entries which are not locked.
+//
 // cache_flush
 // 0x42012C cache_flush
 bool cacheFlush(Cache* cache)
@@ -173,21 +249,12 @@ bool cacheFlush(Cache* cache)
         return false;
     }
 
-    // Loop thru cache entries and mark those with no references for eviction.
-    for (int index = 0; index < cache->entriesLength; index++) {
-        CacheEntry* cacheEntry = cache->entries[index];
-        if (cacheEntry->referenceCount == 0) {
-            cacheEntry->flags |= CACHE_ENTRY_MARKED_FOR_EVICTION;
-        }
+    while (cache->probationaryList.head != nullptr) {
+        cacheEvictEntry(cache, cache->probationaryList.head);
     }
 
-    // Sweep cache entries marked earlier.
-    cacheSweep(cache);
-
-    // Shrink cache entries array if it's too big.
-    int optimalCapacity = cache->entriesLength + CACHE_ENTRIES_GROW_CAPACITY;
-    if (optimalCapacity < cache->entriesCapacity) {
-        cacheSetCapacity(cache, optimalCapacity);
+    while (cache->protectedList.head != nullptr) {
+        cacheEvictEntry(cache, cache->protectedList.head);
     }
 
     return true;
@@ -200,15 +267,90 @@ bool cachePrintStats(Cache* cache, char* dest, size_t size)
         return false;
     }
 
-    snprintf(dest, size, "Cache stats are disabled.%s", "\n");
+    unsigned int lookups = cache->lookups;
+    unsigned int hits = lookups - cache->misses;
+
+    snprintf(dest, size,
+        "Cache stats:\n"
+        "Entries: %d (%d locked)\n"
+        "Size: %d of %d (%d locked)\n"
+        "Hits: %u of %u (%.1f%%)\n"
+        "Evictions: %u\n"
+        "Failed loads: %u\n"
+        "Loaded: %lld bytes in %lld ms\n",
+        cache->entriesLength,
+        cache->lockedEntriesLength,
+        cache->size,
+        cache->maxSize,
+        cache->lockedSize,
+        hits,
+        lookups,
+        lookups != 0 ? (double)hits * 100.0 / lookups : 0.0,
+        cache->evictions,
+        cache->failedLoads,
+        cache->bytesLoaded,
+        cache->loadTime / 1000);
 
     return true;
 }
 
+bool cacheGetStats(Cache* cache, CacheStats* stats)
+{
+    if (cache == nullptr || stats == nullptr) {
+        return false;
+    }
+
+    stats->size = cache->size;
+    stats->maxSize = cache->maxSize;
+    stats->entriesLength = cache->entriesLength;
+    stats->lockedEntriesLength = cache->lockedEntriesLength;
+    stats->lockedSize = cache->lockedSize;
+    stats->protectedSize = cache->protectedSize;
+    stats->hits = cache->lookups - cache->misses;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->failedLoads = cache->failedLoads;
+    stats->bytesLoaded = cache->bytesLoaded;
+    stats->bytesEvicted = cache->bytesEvicted;
+    stats->loadTime = cache->loadTime;
+    memcpy(stats->loadTimeHistogram, cache->loadTimeHistogram, sizeof(stats->loadTimeHistogram));
+
+    return heapGetStats(&(cache->heap), &(stats->heap));
+}
+
+int cacheGetLoadTimeBucketLimit(int bucket)
+{
+    if (bucket < 0 || bucket >= CACHE_LOAD_TIME_BUCKETS_LENGTH) {
+        return -1;
+    }
+
+    return gCacheLoadTimeBucketLimits[bucket];
+}
+
+bool cacheContains(Cache* cache, int key)
+{
+    if (cache == nullptr) {
+        return false;
+    }
+
+    return cacheFindEntryForKey(cache, key) != nullptr;
+}
+
+static void cacheRecordLoadTime(Cache* cache, long long loadTime)
+{
+    int bucket = 0;
+    while (gCacheLoadTimeBucketLimits[bucket] != -1 && loadTime >= gCacheLoadTimeBucketLimits[bucket]) {
+        bucket++;
+    }
+
+    cache->loadTimeHistogram[bucket]++;
+    cache->loadTime += loadTime;
+}
+
 // Fetches entry for the specified key into the cache.
 //
 // 0x4203AC cache_add
-static bool cacheFetchEntryForKey(Cache* cache, int key, int* indexPtr)
+static bool cacheFetchEntryForKey(Cache* cache, int key, CacheEntry** cacheEntryPtr)
 {
     CacheEntry* cacheEntry = (CacheEntry*)internal_malloc(sizeof(*cacheEntry));
     if (cacheEntry == nullptr) {
@@ -276,25 +418,12 @@ static bool cacheFetchEntryForKey(Cache* cache, int key, int* indexPtr)
             cacheEntry->size = size;
             cacheEntry->key = key;
 
-            bool isNewKey = true;
-            if (*indexPtr < cache->entriesLength) {
-                if (key < cache->entries[*indexPtr]->key) {
-                    if (*indexPtr == 0 || key > cache->entries[*indexPtr - 1]->key) {
-                        isNewKey = false;
-                    }
-                }
-            }
-
-            if (isNewKey) {
-                if (cacheFindIndexForKey(cache, key, indexPtr) != 3) {
-                    break;
-                }
-            }
-
-            if (!cacheInsertEntryAtIndex(cache, cacheEntry, *indexPtr)) {
+            if (!cacheInsertEntry(cache, cacheEntry)) {
                 break;
             }
 
+            *cacheEntryPtr = cacheEntry;
+
             return true;
         } while (0);
 
@@ -307,68 +436,104 @@ static bool cacheFetchEntryForKey(Cache* cache, int key, int* indexPtr)
     return false;
 }
 
+// Returns entry for the specified key, or NULL if it's not in cache.
+//
+// 0x420654 cache_find
+static CacheEntry* cacheFindEntryForKey(Cache* cache, int key)
+{
+    CacheEntry* cacheEntry = cache->buckets[cacheBucketIndexForKey(cache, key)];
+    while (cacheEntry != nullptr) {
+        if (cacheEntry->key == key) {
+            return cacheEntry;
+        }
+        cacheEntry = cacheEntry->bucketNext;
+    }
+
+    return nullptr;
+}
+
+static int cacheBucketIndexForKey(Cache* cache, int key)
+{
+    // Keys are usually FIDs with meaningful bits spread across the whole
+    // integer, mix them before masking.
+    unsigned int hash = static_cast<unsigned int>(key) * 2654435761u;
+    hash ^= hash >> 16;
+    return static_cast<int>(hash & static_cast<unsigned int>(cache->bucketsLength - 1));
+}
+
 // 0x4205E8 cache_insert
-static bool cacheInsertEntryAtIndex(Cache* cache, CacheEntry* cacheEntry, int index)
+static bool cacheInsertEntry(Cache* cache, CacheEntry* cacheEntry)
 {
-    // Ensure cache have enough space for new entry.
-    if (cache->entriesLength == cache->entriesCapacity - 1) {
-        if (!cacheSetCapacity(cache, cache->entriesCapacity + CACHE_ENTRIES_GROW_CAPACITY)) {
+    // Keep load factor below 1.
+    if (cache->entriesLength >= cache->bucketsLength) {
+        if (!cacheSetBucketsLength(cache, cache->bucketsLength * 2)) {
             return false;
         }
     }
 
-    // Move entries below insertion point.
-    memmove(&(cache->entries[index + 1]), &(cache->entries[index]), sizeof(*cache->entries) * (cache->entriesLength - index));
+    int bucketIndex = cacheBucketIndexForKey(cache, cacheEntry->key);
+    cacheEntry->bucketNext = cache->buckets[bucketIndex];
+    cache->buckets[bucketIndex] = cacheEntry;
 
-    cache->entries[index] = cacheEntry;
     cache->entriesLength++;
     cache->size += cacheEntry->size;
 
     return true;
 }
 
-// Finds index for given key.
-//
-// Returns 2 if entry already exists in cache, or 3 if entry does not exist. In
-// this case indexPtr represents insertion point.
-//
-// 0x420654 cache_find
-static int cacheFindIndexForKey(Cache* cache, int key, int* indexPtr)
+// Removes entry from hash table.
+static void cacheRemoveEntry(Cache* cache, CacheEntry* cacheEntry)
 {
-    int length = cache->entriesLength;
-    if (length == 0) {
-        *indexPtr = 0;
-        return 3;
+    CacheEntry** link = &(cache->buckets[cacheBucketIndexForKey(cache, cacheEntry->key)]);
+    while (*link != nullptr) {
+        if (*link == cacheEntry) {
+            *link = cacheEntry->bucketNext;
+            break;
+        }
+        link = &((*link)->bucketNext);
     }
 
-    int r = length - 1;
-    int l = 0;
-    int mid;
-    int cmp;
+    cacheEntry->bucketNext = nullptr;
 
-    do {
-        mid = (l + r) / 2;
+    cache->entriesLength--;
+    cache->size -= cacheEntry->size;
+}
 
-        cmp = key - cache->entries[mid]->key;
-        if (cmp == 0) {
-            *indexPtr = mid;
-            return 2;
-        }
+// 0x420A40 cache_resize_array
+static bool cacheSetBucketsLength(Cache* cache, int bucketsLength)
+{
+    CacheEntry** buckets = (CacheEntry**)internal_malloc(sizeof(*buckets) * bucketsLength);
+    if (buckets == nullptr) {
+        return false;
+    }
+
+    memset(buckets, 0, sizeof(*buckets) * bucketsLength);
+
+    CacheEntry** oldBuckets = cache->buckets;
+    int oldBucketsLength = cache->bucketsLength;
+
+    cache->buckets = buckets;
+    cache->bucketsLength = bucketsLength;
+
+    // Rehash existing entries.
+    for (int index = 0; index < oldBucketsLength; index++) {
+        CacheEntry* cacheEntry = oldBuckets[index];
+        while (cacheEntry != nullptr) {
+            CacheEntry* next = cacheEntry->bucketNext;
+
+            int bucketIndex = cacheBucketIndexForKey(cache, cacheEntry->key);
+            cacheEntry->bucketNext = buckets[bucketIndex];
+            buckets[bucketIndex] = cacheEntry;
 
-        if (cmp > 0) {
-            l = mid + 1;
-        } else {
-            r = mid - 1;
+            cacheEntry = next;
         }
-    } while (r >= l);
+    }
 
-    if (cmp < 0) {
-        *indexPtr = mid;
-    } else {
-        *indexPtr = mid + 1;
+    if (oldBuckets != nullptr) {
+        internal_free(oldBuckets);
     }
 
-    return 3;
+    return true;
 }
 
 // 0x420708 cache_init_item
@@ -379,8 +544,10 @@ static bool cacheEntryInit(CacheEntry* cacheEntry)
     cacheEntry->data = nullptr;
     cacheEntry->referenceCount = 0;
     cacheEntry->hits = 0;
-    cacheEntry->flags = CACHE_ENTRY_NONE;
-    cacheEntry->mru = 0;
+    cacheEntry->segment = CACHE_SEGMENT_PROBATIONARY;
+    cacheEntry->bucketNext = nullptr;
+    cacheEntry->prev = nullptr;
+    cacheEntry->next = nullptr;
     return true;
 }
 
@@ -390,6 +557,10 @@ static bool cacheEntryInit(CacheEntry* cacheEntry)
 static bool cacheEntryFree(Cache* cache, CacheEntry* cacheEntry)
 {
     if (cacheEntry->data != nullptr) {
+        if (cache->freeProc != nullptr) {
+            cache->freeProc(cacheEntry->data);
+        }
+
         heapBlockDeallocate(&(cache->heap), &(cacheEntry->heapHandleIndex));
     }
 
@@ -398,222 +569,143 @@ static bool cacheEntryFree(Cache* cache, CacheEntry* cacheEntry)
     return true;
 }
 
-// 0x420764 cache_unlock_all
-static bool cacheClean(Cache* cache)
+// Removes unlocked entry from cache and releases its memory.
+static void cacheEvictEntry(Cache* cache, CacheEntry* cacheEntry)
 {
-    Heap* heap = &(cache->heap);
-    for (int index = 0; index < cache->entriesLength; index++) {
-        CacheEntry* cacheEntry = cache->entries[index];
-
-        // NOTE: Original code is slightly different. For unknown reason it uses
-        // inner loop to decrement `referenceCount` one by one. Probably using
-        // some inlined function.
-        if (cacheEntry->referenceCount != 0) {
-            heapUnlock(heap, cacheEntry->heapHandleIndex);
-            cacheEntry->referenceCount = 0;
-        }
-    }
+    cacheListRemove(cacheGetList(cache, cacheEntry->segment), cacheEntry);
 
-    return true;
-}
-
-// 0x4207D4 cache_reset_counter
-static bool cacheResetStatistics(Cache* cache)
-{
-    if (cache == nullptr) {
-        return false;
+    if (cacheEntry->segment == CACHE_SEGMENT_PROTECTED) {
+        cache->protectedSize -= cacheEntry->size;
     }
 
-    CacheEntry** entries = (CacheEntry**)internal_malloc(sizeof(*entries) * cache->entriesLength);
-    if (entries == nullptr) {
-        return false;
-    }
+    cacheRemoveEntry(cache, cacheEntry);
 
-    memcpy(entries, cache->entries, sizeof(*entries) * cache->entriesLength);
+    cache->evictions++;
+    cache->bytesEvicted += cacheEntry->size;
 
-    qsort(entries, cache->entriesLength, sizeof(*entries), cacheEntriesCompareByMostRecentHit);
+    // NOTE: Uninline.
+    cacheEntryFree(cache, cacheEntry);
+}
 
-    for (int index = 0; index < cache->entriesLength; index++) {
-        CacheEntry* cacheEntry = entries[index];
-        cacheEntry->mru = index;
-    }
+static CacheList* cacheGetList(Cache* cache, CacheSegment segment)
+{
+    return segment == CACHE_SEGMENT_PROTECTED ? &(cache->protectedList) : &(cache->probationaryList);
+}
 
-    cache->hits = cache->entriesLength;
+// Links entry as the most recently used one.
+static void cacheListAppend(CacheList* list, CacheEntry* cacheEntry)
+{
+    cacheEntry->prev = list->tail;
+    cacheEntry->next = nullptr;
 
-    // FIXME: Obviously leak `entries`.
+    if (list->tail != nullptr) {
+        list->tail->next = cacheEntry;
+    } else {
+        list->head = cacheEntry;
+    }
 
-    return true;
+    list->tail = cacheEntry;
 }
 
-// Prepare cache for storing new entry with the specified size.
-//
-// 0x42084C cache_make_room
-static bool cacheEnsureSize(Cache* cache, int size)
+static void cacheListRemove(CacheList* list, CacheEntry* cacheEntry)
 {
-    if (size > cache->maxSize) {
-        // The entry of given size is too big for caching, no matter what.
-        return false;
+    if (cacheEntry->prev != nullptr) {
+        cacheEntry->prev->next = cacheEntry->next;
+    } else {
+        list->head = cacheEntry->next;
     }
 
-    if (cache->maxSize - cache->size >= size) {
-        // There is space available for entry of given size, there is no need to
-        // evict anything.
-        return true;
-    }
-
-    CacheEntry** entries = (CacheEntry**)internal_malloc(sizeof(*entries) * cache->entriesLength);
-    if (entries != nullptr) {
-        memcpy(entries, cache->entries, sizeof(*entries) * cache->entriesLength);
-        qsort(entries, cache->entriesLength, sizeof(*entries), cacheEntriesCompareByUsage);
-
-        // The sweeping threshold is 20% of cache size plus size for the new
-        // entry. Once the threshold is reached the marking process stops.
-        int threshold = size + (int)((double)cache->size * 0.2);
-
-        int accum = 0;
-        int index;
-        for (index = 0; index < cache->entriesLength; index++) {
-            CacheEntry* entry = entries[index];
-            if (entry->referenceCount == 0) {
-                if (entry->size >= threshold) {
-                    entry->flags |= CACHE_ENTRY_MARKED_FOR_EVICTION;
-
-                    // We've just found one huge entry, there is no point to
-                    // mark individual smaller entries in the code path below,
-                    // reset the accumulator to skip it entirely.
-                    accum = 0;
-                    break;
-                } else {
-                    accum += entry->size;
-
-                    if (accum >= threshold) {
-                        break;
-                    }
-                }
-            }
-        }
-
-        if (accum != 0) {
-            // The loop below assumes index to be positioned on the entry, where
-            // accumulator stopped. If we've reached the end, reposition
-            // it to the last entry.
-            if (index == cache->entriesLength) {
-                index -= 1;
-            }
-
-            // Loop backwards from the point we've stopped and mark all
-            // unreferenced entries for sweeping.
-            for (; index >= 0; index--) {
-                CacheEntry* entry = entries[index];
-                if (entry->referenceCount == 0) {
-                    entry->flags |= CACHE_ENTRY_MARKED_FOR_EVICTION;
-                }
-            }
-        }
-
-        internal_free(entries);
+    if (cacheEntry->next != nullptr) {
+        cacheEntry->next->prev = cacheEntry->prev;
+    } else {
+        list->tail = cacheEntry->prev;
     }
 
-    cacheSweep(cache);
+    cacheEntry->prev = nullptr;
+    cacheEntry->next = nullptr;
+}
 
-    if (cache->maxSize - cache->size >= size) {
-        return true;
+// Moves entry which was hit again to protected segment.
+//
+// NOTE: Entry must not be linked into eviction list.
+static void cachePromoteEntry(Cache* cache, CacheEntry* cacheEntry)
+{
+    if (cacheEntry->segment == CACHE_SEGMENT_PROTECTED) {
+        return;
     }
 
-    return false;
+    cacheEntry->segment = CACHE_SEGMENT_PROTECTED;
+    cache->protectedSize += cacheEntry->size;
 }
 
-// 0x42099C cache_purge
-static bool cacheSweep(Cache* cache)
+// Demotes least recently used protected entries until protected segment fits
+// into its share of cache.
+static void cacheBalanceSegments(Cache* cache)
 {
-    for (int index = 0; index < cache->entriesLength; index++) {
-        CacheEntry* cacheEntry = cache->entries[index];
-        if ((cacheEntry->flags & CACHE_ENTRY_MARKED_FOR_EVICTION) != CACHE_ENTRY_NONE) {
-            if (cacheEntry->referenceCount != 0) {
-                // Entry was marked for eviction but still has references,
-                // unmark it.
-                cacheEntry->flags &= ~CACHE_ENTRY_MARKED_FOR_EVICTION;
-            } else {
-                int cacheEntrySize = cacheEntry->size;
+    int maxProtectedSize = (int)((long long)cache->maxSize * CACHE_PROTECTED_SEGMENT_RATIO / 100);
 
-                // NOTE: Uninline.
-                cacheEntryFree(cache, cacheEntry);
-
-                // Move entries up.
-                memmove(&(cache->entries[index]), &(cache->entries[index + 1]), sizeof(*cache->entries) * ((cache->entriesLength - index) - 1));
+    while (cache->protectedSize > maxProtectedSize && cache->protectedList.head != nullptr) {
+        CacheEntry* cacheEntry = cache->protectedList.head;
+        cacheListRemove(&(cache->protectedList), cacheEntry);
 
-                cache->entriesLength--;
-                cache->size -= cacheEntrySize;
+        cacheEntry->segment = CACHE_SEGMENT_PROBATIONARY;
+        cache->protectedSize -= cacheEntry->size;
 
-                // The entry was removed, compensate index.
-                index--;
-            }
-        }
+        cacheListAppend(&(cache->probationaryList), cacheEntry);
     }
-
-    return true;
 }
 
-// 0x420A40 cache_resize_array
-static bool cacheSetCapacity(Cache* cache, int newCapacity)
+// 0x420764 cache_unlock_all
+static bool cacheClean(Cache* cache)
 {
-    if (newCapacity < cache->entriesLength) {
-        return false;
+    Heap* heap = &(cache->heap);
+    for (int bucketIndex = 0; bucketIndex < cache->bucketsLength; bucketIndex++) {
+        for (CacheEntry* cacheEntry = cache->buckets[bucketIndex]; cacheEntry != nullptr; cacheEntry = cacheEntry->bucketNext) {
+            // NOTE: Original code is slightly different. For unknown reason it
+            // uses inner loop to decrement `referenceCount` one by one.
+            // Probably using some inlined function.
+            if (cacheEntry->referenceCount != 0) {
+                heapUnlock(heap, cacheEntry->heapHandleIndex);
+                cacheEntry->referenceCount = 0;
+                cacheListAppend(cacheGetList(cache, cacheEntry->segment), cacheEntry);
+            }
+        }
     }
 
-    CacheEntry** entries = (CacheEntry**)internal_realloc(cache->entries, sizeof(*cache->entries) * newCapacity);
-    if (entries == nullptr) {
-        return false;
-    }
+    cache->lockedEntriesLength = 0;
+    cache->lockedSize = 0;
 
-    cache->entries = entries;
-    cache->entriesCapacity = newCapacity;
+    cacheBalanceSegments(cache);
 
     return true;
 }
 
-// 0x420A74 cache_compare_make_room
-static int cacheEntriesCompareByUsage(const void* a1, const void* a2)
+// Prepare cache for storing new entry with the specified size.
+//
+// Evicts least recently used unlocked entries, probationary ones first.
+//
+// 0x42084C cache_make_room
+static bool cacheEnsureSize(Cache* cache, int size)
 {
-    CacheEntry* lhs = *(CacheEntry**)a1;
-    CacheEntry* rhs = *(CacheEntry**)a2;
-
-    if (lhs->referenceCount != 0 && rhs->referenceCount == 0) {
-        return 1;
-    }
-
-    if (rhs->referenceCount != 0 && lhs->referenceCount == 0) {
-        return -1;
+    if (size > cache->maxSize) {
+        // The entry of given size is too big for caching, no matter what.
+        return false;
     }
 
-    if (lhs->hits < rhs->hits) {
-        return -1;
-    } else if (lhs->hits > rhs->hits) {
-        return 1;
-    }
+    while (cache->maxSize - cache->size < size) {
+        CacheEntry* cacheEntry = cache->probationaryList.head;
+        if (cacheEntry == nullptr) {
+            cacheEntry = cache->protectedList.head;
+            if (cacheEntry == nullptr) {
+                // Everything left is locked.
+                return false;
+            }
+        }
 
-    if (lhs->mru < rhs->mru) {
-        return -1;
-    } else if (lhs->mru > rhs->mru) {
-        return 1;
+        cacheEvictEntry(cache, cacheEntry);
     }
 
-    return 0;
-}
-
-// 0x420AE8 cache_compare_reset_counter
-static int cacheEntriesCompareByMostRecentHit(const void* a1, const void* a2)
-{
-    CacheEntry* lhs = *(CacheEntry**)a1;
-    CacheEntry* rhs = *(CacheEntry**)a2;
-
-    if (lhs->mru < rhs->mru) {
-        return 1;
-    } else if (lhs->mru > rhs->mru) {
-        return -1;
-    } else {
-        return 0;
-    }
+    return true;
 }
 
 } // namespace fallout
@@ -9,33 +9,24 @@ namespace fallout {
 
 #define INVALID_CACHE_ENTRY ((CacheEntry*)-1)
 
-enum CacheEntryFlags : unsigned int {
-    CACHE_ENTRY_NONE = 0x00,
-
-    // Specifies that cache entry has no references as should be evicted during
-    // the next sweep operation.
-    CACHE_ENTRY_MARKED_FOR_EVICTION = 0x01,
+// The number of buckets in load time histogram.
+#define CACHE_LOAD_TIME_BUCKETS_LENGTH (8)
+
+// Eviction segments of segmented LRU policy.
+//
+// New entries start in probationary segment. Entries which are hit again are
+// promoted to protected segment, so that one-off loads (like scrolling thru
+// large map) do not push out frequently used art.
+enum CacheSegment {
+    CACHE_SEGMENT_PROBATIONARY,
+    CACHE_SEGMENT_PROTECTED,
 };
 
-constexpr inline CacheEntryFlags operator~(CacheEntryFlags rhs)
-{
-    return static_cast<CacheEntryFlags>(~static_cast<unsigned int>(rhs));
-}
-
-inline CacheEntryFlags& operator&=(CacheEntryFlags& lhs, CacheEntryFlags rhs)
-{
-    lhs = static_cast<CacheEntryFlags>(static_cast<unsigned int>(lhs) & static_cast<unsigned int>(rhs));
-    return lhs;
-}
-
-inline CacheEntryFlags& operator|=(CacheEntryFlags& lhs, CacheEntryFlags rhs)
-{
-    lhs = static_cast<CacheEntryFlags>(static_cast<unsigned int>(lhs) | static_cast<unsigned int>(rhs));
-    return lhs;
-}
-
 typedef int CacheSizeProc(int key, int* sizePtr);
 typedef int CacheReadProc(int key, int* sizePtr, unsigned char* buffer);
+// Called with entry data right before it is returned to the cache heap, so
+// that the owner can release anything attached to it. The data itself is
+// owned by the cache and must not be freed.
 typedef void CacheFreeProc(void* ptr);
 
 typedef struct CacheEntry {
@@ -48,15 +39,43 @@ typedef struct CacheEntry {
     // lifetime.
     unsigned int hits;
 
-    CacheEntryFlags flags;
-
-    // The most recent hit in terms of cache hit counter. Used to track most
-    // recently used entries in eviction strategy.
-    unsigned int mru;
+    CacheSegment segment;
 
     int heapHandleIndex;
+
+    // Next entry in the same hash bucket.
+    struct CacheEntry* bucketNext;
+
+    // Neighbours in eviction list of [segment]. Only entries without
+    // references are linked into eviction lists.
+    struct CacheEntry* prev;
+    struct CacheEntry* next;
 } CacheEntry;
 
+// Eviction list, ordered from least recently used to most recently used.
+typedef struct CacheList {
+    CacheEntry* head;
+    CacheEntry* tail;
+} CacheList;
+
+typedef struct CacheStats {
+    int size;
+    int maxSize;
+    int entriesLength;
+    int lockedEntriesLength;
+    int lockedSize;
+    int protectedSize;
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int evictions;
+    unsigned int failedLoads;
+    long long bytesLoaded;
+    long long bytesEvicted;
+    long long loadTime;
+    unsigned int loadTimeHistogram[CACHE_LOAD_TIME_BUCKETS_LENGTH];
+    HeapStats heap;
+} CacheStats;
+
 typedef struct Cache {
     // Current size of entries in cache.
     int size;
@@ -64,17 +83,50 @@ typedef struct Cache {
     // Maximum size of entries in cache.
     int maxSize;
 
-    // The length of `entries` array.
+    // The number of entries in cache.
     int entriesLength;
 
-    // The capacity of `entries` array.
-    int entriesCapacity;
+    // Total number of successful lookups during cache lifetime. Lookups
+    // which found entry in cache are `lookups - misses`.
+    unsigned int lookups;
 
-    // Total number of hits during cache lifetime.
-    unsigned int hits;
+    // Total number of lookups which required loading entry.
+    unsigned int misses;
+
+    // Total number of lookups which failed to load entry (missing file, read
+    // error, etc.). Such lookups are not counted in [lookups] and [misses].
+    unsigned int failedLoads;
+
+    // Total number of entries evicted to make room for new ones (or flushed).
+    unsigned int evictions;
+
+    // Total number of bytes read with [readProc] and evicted during cache
+    // lifetime.
+    long long bytesLoaded;
+    long long bytesEvicted;
+
+    // The number and size of entries which are currently locked.
+    int lockedEntriesLength;
+    int lockedSize;
 
-    // List of cache entries.
-    CacheEntry** entries;
+    // Histogram of time spent in [sizeProc] and [readProc] for every miss.
+    // See [cacheGetLoadTimeBucketLimit] for bucket boundaries.
+    unsigned int loadTimeHistogram[CACHE_LOAD_TIME_BUCKETS_LENGTH];
+
+    // Total time spent loading entries (in microseconds).
+    long long loadTime;
+
+    // Hash table of entries keyed by [CacheEntry.key]. The number of buckets
+    // is always a power of two.
+    CacheEntry** buckets;
+    int bucketsLength;
+
+    CacheList probationaryList;
+    CacheList protectedList;
+
+    // Size of all entries in protected segment (including the ones which are
+    // currently locked and not linked into [protectedList]).
+    int protectedSize;
 
     CacheSizeProc* sizeProc;
     CacheReadProc* readProc;
@@ -88,6 +140,14 @@ bool cacheLock(Cache* cache, int key, void** data, CacheEntry** cacheEntryPtr);
 bool cacheUnlock(Cache* cache, CacheEntry* cacheEntry);
 bool cacheFlush(Cache* cache);
 bool cachePrintStats(Cache* cache, char* dest, size_t size);
+bool cacheGetStats(Cache* cache, CacheStats* stats);
+
+// Returns upper bound (exclusive, in microseconds) of load time histogram
+// bucket, or -1 for the last unbounded one.
+int cacheGetLoadTimeBucketLimit(int bucket);
+
+// Returns true if entry for [key] is already loaded into [cache].
+bool cacheContains(Cache* cache, int key);
 
 } // namespace fallout
 
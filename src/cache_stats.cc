@@ -0,0 +1,288 @@
+#include "cache_stats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "debug.h"
+#include "input.h"
+#include "platform_compat.h"
+#include "settings.h"
+
+namespace fallout {
+
+typedef struct CacheStatsSource {
+    const char* name;
+    Cache* cache;
+} CacheStatsSource;
+
+static bool cacheStatsOpenDump();
+static void cacheStatsCloseDump();
+static void cacheStatsWriteRecord(const CacheStatsSource* source, unsigned int timestamp);
+static int cacheStatsGetLoadTimePercentile(const CacheStats* stats, int percentile);
+
+static std::vector<CacheStatsSource> gCacheStatsSources;
+
+// Stream of stats dump, opened on first tick.
+static FILE* gCacheStatsDumpStream = nullptr;
+
+// Set when dump should be written as JSON lines instead of CSV.
+static bool gCacheStatsDumpJson = false;
+
+// Set when dump file cannot be opened to avoid retrying every frame.
+static bool gCacheStatsDumpFailed = false;
+
+static unsigned int gCacheStatsLastDumpTimestamp = 0;
+
+void cacheStatsRegister(const char* name, Cache* cache)
+{
+    cacheStatsUnregister(cache);
+
+    CacheStatsSource source;
+    source.name = name;
+    source.cache = cache;
+    gCacheStatsSources.push_back(source);
+}
+
+void cacheStatsUnregister(Cache* cache)
+{
+    auto it = std::find_if(gCacheStatsSources.begin(), gCacheStatsSources.end(), [cache](const CacheStatsSource& source) {
+        return source.cache == cache;
+    });
+
+    if (it == gCacheStatsSources.end()) {
+        return;
+    }
+
+    if (gCacheStatsDumpStream != nullptr) {
+        cacheStatsWriteRecord(&(*it), getTicks());
+        fflush(gCacheStatsDumpStream);
+    }
+
+    gCacheStatsSources.erase(it);
+
+    if (gCacheStatsSources.empty()) {
+        cacheStatsCloseDump();
+    }
+}
+
+void cacheStatsTick()
+{
+    if (settings.debug.cache_stats_path.empty() || gCacheStatsSources.empty()) {
+        return;
+    }
+
+    unsigned int now = getTicks();
+    if (gCacheStatsDumpStream != nullptr && getTicksBetween(now, gCacheStatsLastDumpTimestamp) < (unsigned int)settings.debug.cache_stats_interval * 1000) {
+        return;
+    }
+
+    if (!cacheStatsOpenDump()) {
+        return;
+    }
+
+    for (const CacheStatsSource& source : gCacheStatsSources) {
+        cacheStatsWriteRecord(&source, now);
+    }
+
+    fflush(gCacheStatsDumpStream);
+
+    gCacheStatsLastDumpTimestamp = now;
+}
+
+void cacheStatsGetOverlayLines(std::vector<std::string>& lines)
+{
+    for (const CacheStatsSource& source : gCacheStatsSources) {
+        CacheStats stats;
+        if (!cacheGetStats(source.cache, &stats)) {
+            continue;
+        }
+
+        unsigned int lookups = stats.hits + stats.misses;
+        double hitRatio = lookups != 0 ? (double)stats.hits * 100.0 / lookups : 0.0;
+
+        char latency[16];
+        int p95 = cacheStatsGetLoadTimePercentile(&stats, 95);
+        if (p95 == -1) {
+            snprintf(latency, sizeof(latency), ">%.1fms", cacheGetLoadTimeBucketLimit(CACHE_LOAD_TIME_BUCKETS_LENGTH - 2) / 1000.0);
+        } else {
+            snprintf(latency, sizeof(latency), "<%.1fms", p95 / 1000.0);
+        }
+
+        char line[160];
+        snprintf(line, sizeof(line),
+            "%s: %.1f/%.1fM %d ent, hit %.1f%%, ev %u, lck %.1fM, frag %d%%, p95 %s",
+            source.name,
+            stats.size / (1024.0 * 1024.0),
+            stats.maxSize / (1024.0 * 1024.0),
+            stats.entriesLength,
+            hitRatio,
+            stats.evictions,
+            stats.lockedSize / (1024.0 * 1024.0),
+            stats.heap.fragmentation,
+            latency);
+
+        lines.push_back(line);
+    }
+}
+
+static bool cacheStatsOpenDump()
+{
+    if (gCacheStatsDumpStream != nullptr) {
+        return true;
+    }
+
+    if (gCacheStatsDumpFailed) {
+        return false;
+    }
+
+    const std::string& path = settings.debug.cache_stats_path;
+
+    gCacheStatsDumpStream = compat_fopen(path.c_str(), "at");
+    if (gCacheStatsDumpStream == nullptr) {
+        debugPrint("cacheStatsOpenDump: unable to open %s\n", path.c_str());
+        gCacheStatsDumpFailed = true;
+        return false;
+    }
+
+    const char* extension = strrchr(path.c_str(), '.');
+    gCacheStatsDumpJson = extension != nullptr && (compat_stricmp(extension, ".json") == 0 || compat_stricmp(extension, ".jsonl") == 0);
+
+    // Write CSV header only once for new file, appended runs share it.
+    if (!gCacheStatsDumpJson) {
+        fseek(gCacheStatsDumpStream, 0, SEEK_END);
+        if (ftell(gCacheStatsDumpStream) == 0) {
+            fputs("ticks,cache,entries,size,max_size,locked_entries,locked_size,protected_size,hits,misses,evictions,failed_loads,bytes_loaded,bytes_evicted,load_time_us", gCacheStatsDumpStream);
+            for (int bucket = 0; bucket < CACHE_LOAD_TIME_BUCKETS_LENGTH; bucket++) {
+                int limit = cacheGetLoadTimeBucketLimit(bucket);
+                if (limit != -1) {
+                    fprintf(gCacheStatsDumpStream, ",load_lt_%dus", limit);
+                } else {
+                    fputs(",load_rest", gCacheStatsDumpStream);
+                }
+            }
+            fputs(",heap_free_blocks,heap_free_size,heap_largest_free_size,heap_fragmentation,heap_system_blocks,heap_system_size\n", gCacheStatsDumpStream);
+        }
+    }
+
+    return true;
+}
+
+static void cacheStatsCloseDump()
+{
+    if (gCacheStatsDumpStream != nullptr) {
+        fclose(gCacheStatsDumpStream);
+        gCacheStatsDumpStream = nullptr;
+    }
+
+    gCacheStatsDumpFailed = false;
+    gCacheStatsLastDumpTimestamp = 0;
+}
+
+static void cacheStatsWriteRecord(const CacheStatsSource* source, unsigned int timestamp)
+{
+    CacheStats stats;
+    if (!cacheGetStats(source->cache, &stats)) {
+        return;
+    }
+
+    FILE* stream = gCacheStatsDumpStream;
+
+    if (gCacheStatsDumpJson) {
+        fprintf(stream,
+            "{\"ticks\":%u,\"cache\":\"%s\",\"entries\":%d,\"size\":%d,\"max_size\":%d,"
+            "\"locked_entries\":%d,\"locked_size\":%d,\"protected_size\":%d,"
+            "\"hits\":%u,\"misses\":%u,\"evictions\":%u,\"failed_loads\":%u,"
+            "\"bytes_loaded\":%lld,\"bytes_evicted\":%lld,\"load_time_us\":%lld,"
+            "\"load_time_histogram\":[",
+            timestamp,
+            source->name,
+            stats.entriesLength,
+            stats.size,
+            stats.maxSize,
+            stats.lockedEntriesLength,
+            stats.lockedSize,
+            stats.protectedSize,
+            stats.hits,
+            stats.misses,
+            stats.evictions,
+            stats.failedLoads,
+            stats.bytesLoaded,
+            stats.bytesEvicted,
+            stats.loadTime);
+
+        for (int bucket = 0; bucket < CACHE_LOAD_TIME_BUCKETS_LENGTH; bucket++) {
+            fprintf(stream, "%s{\"lt_us\":%d,\"count\":%u}",
+                bucket != 0 ? "," : "",
+                cacheGetLoadTimeBucketLimit(bucket),
+                stats.loadTimeHistogram[bucket]);
+        }
+
+        fprintf(stream,
+            "],\"heap\":{\"free_blocks\":%d,\"free_size\":%d,\"largest_free_size\":%d,"
+            "\"fragmentation\":%d,\"system_blocks\":%d,\"system_size\":%d}}\n",
+            stats.heap.freeBlocks,
+            stats.heap.freeSize,
+            stats.heap.largestFreeSize,
+            stats.heap.fragmentation,
+            stats.heap.systemBlocks,
+            stats.heap.systemSize);
+    } else {
+        fprintf(stream, "%u,%s,%d,%d,%d,%d,%d,%d,%u,%u,%u,%u,%lld,%lld,%lld",
+            timestamp,
+            source->name,
+            stats.entriesLength,
+            stats.size,
+            stats.maxSize,
+            stats.lockedEntriesLength,
+            stats.lockedSize,
+            stats.protectedSize,
+            stats.hits,
+            stats.misses,
+            stats.evictions,
+            stats.failedLoads,
+            stats.bytesLoaded,
+            stats.bytesEvicted,
+            stats.loadTime);
+
+        for (int bucket = 0; bucket < CACHE_LOAD_TIME_BUCKETS_LENGTH; bucket++) {
+            fprintf(stream, ",%u", stats.loadTimeHistogram[bucket]);
+        }
+
+        fprintf(stream, ",%d,%d,%d,%d,%d,%d\n",
+            stats.heap.freeBlocks,
+            stats.heap.freeSize,
+            stats.heap.largestFreeSize,
+            stats.heap.fragmentation,
+            stats.heap.systemBlocks,
+            stats.heap.systemSize);
+    }
+}
+
+// Returns upper bound (in microseconds) of histogram bucket containing given
+// percentile of load times, or -1 if it falls into unbounded bucket.
+static int cacheStatsGetLoadTimePercentile(const CacheStats* stats, int percentile)
+{
+    unsigned int total = 0;
+    for (int bucket = 0; bucket < CACHE_LOAD_TIME_BUCKETS_LENGTH; bucket++) {
+        total += stats->loadTimeHistogram[bucket];
+    }
+
+    if (total == 0) {
+        return cacheGetLoadTimeBucketLimit(0);
+    }
+
+    unsigned long long threshold = ((unsigned long long)total * percentile + 99) / 100;
+    unsigned long long count = 0;
+    for (int bucket = 0; bucket < CACHE_LOAD_TIME_BUCKETS_LENGTH; bucket++) {
+        count += stats->loadTimeHistogram[bucket];
+        if (count >= threshold) {
+            return cacheGetLoadTimeBucketLimit(bucket);
+        }
+    }
+
+    return -1;
+}
+
+} // namespace fallout
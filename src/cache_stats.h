@@ -0,0 +1,29 @@
+#ifndef CACHE_STATS_H
+#define CACHE_STATS_H
+
+#include <string>
+#include <vector>
+
+#include "cache.h"
+
+namespace fallout {
+
+// Adds [cache] to the list of caches reported in debug overlay and periodic
+// stats dump. [name] must outlive registration.
+void cacheStatsRegister(const char* name, Cache* cache);
+
+// Removes [cache] from the stats list. The final stats of the cache are
+// written to stats dump (if enabled).
+void cacheStatsUnregister(Cache* cache);
+
+// Appends stats of every registered cache to dump file once per
+// `cache_stats_interval` seconds. Does nothing when `cache_stats_path` is not
+// set.
+void cacheStatsTick();
+
+// Builds one line of text per registered cache for debug overlay.
+void cacheStatsGetOverlayLines(std::vector<std::string>& lines);
+
+} // namespace fallout
+
+#endif /* CACHE_STATS_H */
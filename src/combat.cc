@@ -26,6 +26,7 @@
 #include "loadsave.h"
 #include "map.h"
 #include "memory.h"
+#include "memory_profiler.h"
 #include "message.h"
 #include "object.h"
 #include "party_member.h"
@@ -3449,6 +3450,7 @@ static bool _combat_should_end()
 void _combat(CombatStartData* csd)
 {
     ScopedGameMode gm(GameMode::kCombat);
+    MemoryProfilerScope memoryProfilerScope("combat");
 
     if (csd == nullptr
         || (csd->attacker == nullptr || csd->attacker->elevation == gElevation)
@@ -15,6 +15,7 @@
 #include "critter.h"
 #include "debug.h"
 #include "display_monitor.h"
+#include "frame_profiler.h"
 #include "game.h"
 #include "game_sound.h"
 #include "input.h"
@@ -3208,6 +3209,8 @@ static int _cai_get_min_hp(AiPacket* ai)
 // 0x42B130
 void _combat_ai(Object* a1, Object* a2)
 {
+    FrameProfilerZone profilerZone("_combat_ai");
+
     // 0x51820C
     static const int aiPartyMemberDistances[DISTANCE_COUNT] = {
         5,
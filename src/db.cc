@@ -79,14 +79,12 @@ int dbGetFileSize(const char* filePath, int* sizePtr)
     assert(filePath); // "filename", "db.c", 108
     assert(sizePtr); // "de", "db.c", 109
 
-    File* stream = xfileOpen(filePath, "rb");
-    if (stream == nullptr) {
+    long size;
+    if (!xfileGetSizeByPath(filePath, &size)) {
         return -1;
     }
 
-    *sizePtr = xfileGetSize(stream);
-
-    xfileClose(stream);
+    *sizePtr = static_cast<int>(size);
 
     return 0;
 }
@@ -132,6 +130,57 @@ int dbGetFileContents(const char* filePath, void* ptr)
     return 0;
 }
 
+const unsigned char* dbGetFileView(const char* filePath, int* sizePtr)
+{
+    assert(filePath);
+    assert(sizePtr);
+
+    return xfileGetView(filePath, sizePtr);
+}
+
+unsigned char* dbLoadFileContents(const char* filePath, int* sizePtr)
+{
+    assert(filePath);
+    assert(sizePtr);
+
+    File* stream = xfileOpen(filePath, "rb");
+    if (stream == nullptr) {
+        return nullptr;
+    }
+
+    long size = xfileGetSize(stream);
+
+    // NOTE: Allocate at least one byte so that empty files are not treated as
+    // errors.
+    unsigned char* data = (unsigned char*)malloc(size > 0 ? size : 1);
+    if (data == nullptr) {
+        xfileClose(stream);
+        return nullptr;
+    }
+
+    if (size > 0 && xfileRead(data, 1, size, stream) != static_cast<size_t>(size)) {
+        free(data);
+        xfileClose(stream);
+        return nullptr;
+    }
+
+    xfileClose(stream);
+
+    *sizePtr = static_cast<int>(size);
+
+    return data;
+}
+
+void dbSetMemoryMapped(bool enabled)
+{
+    dbaseSetMemoryMapped(enabled);
+}
+
+void dbSetThreadSafe(bool enabled)
+{
+    xbaseSetThreadSafe(enabled);
+}
+
 // 0x4C5EB4 db_fclose
 int fileClose(File* stream)
 {
@@ -16,6 +16,27 @@ int db_total();
 void dbCloseAll();
 int dbGetFileSize(const char* filePath, int* sizePtr);
 int dbGetFileContents(const char* filePath, void* ptr);
+
+// Returns borrowed pointer to contents of [filePath] if it can be accessed
+// without copying (see [dbSetMemoryMapped]).
+//
+// Returns NULL if file is not found or must be read via [fileOpen] or
+// [dbGetFileContents]. The pointer remains valid until database is closed.
+const unsigned char* dbGetFileView(const char* filePath, int* sizePtr);
+
+// Reads entire contents of [filePath] into a buffer allocated with `malloc`.
+//
+// Unlike [dbGetFileContents] it does not report read progress, so it can be
+// used from background threads. Returns NULL if file cannot be read.
+unsigned char* dbLoadFileContents(const char* filePath, int* sizePtr);
+
+// Specifies whether .DAT files opened afterwards should be memory mapped.
+void dbSetMemoryMapped(bool enabled);
+
+// Specifies whether files can be read from several threads at once. Locking
+// is skipped otherwise, must only be changed while no background thread reads
+// files.
+void dbSetThreadSafe(bool enabled);
 int fileClose(File* stream);
 File* fileOpen(const char* filename, const char* mode);
 int filePrintFormatted(File* stream, const char* format, ...);
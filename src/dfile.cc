@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include <algorithm>
+#include <mutex>
 
 #include "fpattern_windows.h"
 
@@ -16,6 +17,14 @@ namespace fallout {
 // The size of decompression buffer for reading compressed [DFile]s.
 #define DFILE_DECOMPRESSION_BUFFER_SIZE (0x1000)
 
+// The distance (in uncompressed bytes) between inflate checkpoints in
+// compressed entries.
+//
+// Every checkpoint keeps a copy of inflate state including 32 KB sliding window,
+// so this value is a trade-off between memory and the maximum amount of data
+// that needs to be decompressed to reach arbitrary offset.
+#define DFILE_CHECKPOINT_INTERVAL (0x40000)
+
 // Specifies that [DFile] has unget character.
 //
 // NOTE: There is an unused function at 0x4E5894 which ungets one character and
@@ -53,6 +62,23 @@ static DFile* dfileOpenInternal(DBase* dbase, const char* filename, const char*
 static int dfileReadCharInternal(DFile* stream);
 static bool dfileReadCompressed(DFile* stream, void* ptr, size_t size);
 static void dfileUngetCompressed(DFile* stream, int ch);
+static void dbaseMap(DBase* dbase);
+static DFileCheckpointIndex* dbaseEntryGetCheckpointIndex(DBaseEntry* entry);
+static void dbaseEntryFreeCheckpointIndex(DBaseEntry* entry);
+static void dfileRecordCheckpoint(DFile* stream);
+static bool dfileRestoreCheckpoint(DFile* stream, DFileCheckpoint* checkpoint);
+static bool dfileSkipCompressed(DFile* stream, long offset);
+static std::unique_lock<std::mutex> dfileCheckpointLock();
+
+// Specifies whether [dbaseOpen] should attempt to map archives into memory.
+static bool gDBaseMemoryMapped = false;
+
+// Guards checkpoint indexes, which are shared between all streams of the same
+// entry (these streams can be read from different threads).
+//
+// Only taken when [gDBaseThreadSafe] is set (see [dbaseSetThreadSafe]).
+static std::mutex gDFileCheckpointMutex;
+static bool gDBaseThreadSafe = false;
 
 // Reads .DAT or .ZIP file contents.
 //
@@ -99,6 +125,7 @@ DBase* dbaseOpen(const char* filePath, int* errorFlags)
         }
 
         fclose(stream);
+        dbaseMap(dbase);
         return dbase;
     }
 
@@ -191,6 +218,8 @@ DBase* dbaseOpen(const char* filePath, int* errorFlags)
 
     fclose(stream);
 
+    dbaseMap(dbase);
+
     return dbase;
 
 err:
@@ -224,6 +253,8 @@ bool dbaseClose(DBase* dbase)
             if (entryName != nullptr) {
                 free(entryName);
             }
+
+            dbaseEntryFreeCheckpointIndex(entry);
         }
         free(dbase->entries);
     }
@@ -232,6 +263,10 @@ bool dbaseClose(DBase* dbase)
         free(dbase->path);
     }
 
+    if (dbase->mappedData != nullptr) {
+        compat_munmap(dbase->mappedData, dbase->mappedSize);
+    }
+
     memset(dbase, 0, sizeof(*dbase));
 
     free(dbase);
@@ -239,6 +274,34 @@ bool dbaseClose(DBase* dbase)
     return true;
 }
 
+void dbaseSetMemoryMapped(bool enabled)
+{
+    gDBaseMemoryMapped = enabled;
+}
+
+void dbaseSetThreadSafe(bool enabled)
+{
+    gDBaseThreadSafe = enabled;
+}
+
+bool dbaseGetEntryView(DBase* dbase, const char* filePath, const unsigned char** dataPtr, int* sizePtr)
+{
+    DBaseEntry* entry = (DBaseEntry*)bsearch(filePath, dbase->entries, dbase->entriesLength, sizeof(*dbase->entries), dbaseFindEntryByFilePath);
+    if (entry == nullptr) {
+        return false;
+    }
+
+    if (dbase->mappedData != nullptr && entry->compressed != 1) {
+        *dataPtr = dbase->mappedData + dbase->dataOffset + entry->dataOffset;
+    } else {
+        *dataPtr = nullptr;
+    }
+
+    *sizePtr = entry->uncompressedSize;
+
+    return true;
+}
+
 // 0x4E5308 dbase_findfirst
 bool dbaseFindFirstEntry(DBase* dbase, DFileFindData* findFileData, const char* pattern)
 {
@@ -510,7 +573,12 @@ size_t dfileRead(void* ptr, size_t size, size_t count, DFile* stream)
 
         bytesRead = bytesToRead;
     } else {
-        bytesRead = fread(ptr, 1, bytesToRead, stream->stream) + extraBytesRead;
+        if (stream->mappedData != nullptr) {
+            memcpy(ptr, stream->mappedData + stream->position, bytesToRead);
+            bytesRead = bytesToRead + extraBytesRead;
+        } else {
+            bytesRead = fread(ptr, 1, bytesToRead, stream->stream) + extraBytesRead;
+        }
         stream->position += bytesRead;
     }
 
@@ -578,36 +646,68 @@ int dfileSeek(DFile* stream, long offset, int origin)
 
     if (offsetFromBeginning != 0) {
         if (stream->entry->compressed == 1) {
-            if (offsetFromBeginning < pos) {
+            // Jump to the nearest checkpoint preceding specified offset (if
+            // it's closer than current position), so that at most one
+            // checkpoint interval needs to be decompressed.
+            {
+                std::unique_lock<std::mutex> lock = dfileCheckpointLock();
+
+                DFileCheckpointIndex* checkpointIndex = dbaseEntryGetCheckpointIndex(stream->entry);
+                if (checkpointIndex != nullptr) {
+                    for (int index = std::min(static_cast<int>(offsetFromBeginning / DFILE_CHECKPOINT_INTERVAL), checkpointIndex->checkpointsLength) - 1; index >= 0; index--) {
+                        DFileCheckpoint* checkpoint = &(checkpointIndex->checkpoints[index]);
+                        if (!checkpoint->valid) {
+                            continue;
+                        }
+
+                        long checkpointPosition = static_cast<long>(index + 1) * DFILE_CHECKPOINT_INTERVAL;
+                        if (offsetFromBeginning < pos || checkpointPosition > pos) {
+                            if (!dfileRestoreCheckpoint(stream, checkpoint)) {
+                                stream->flags |= DFILE_ERROR;
+                                return 1;
+                            }
+                        }
+                        break;
+                    }
+                }
+            }
+
+            if (offsetFromBeginning < stream->position) {
                 // We cannot go backwards in compressed stream, so the only way
                 // is to start from the beginning.
                 dfileRewind(stream);
             }
 
-            // Consume characters one by one until we reach specified offset.
-            while (offsetFromBeginning > stream->position) {
-                if (dfileReadCharInternal(stream) == -1) {
-                    return 1;
-                }
+            // Decompress and discard data until we reach specified offset.
+            if (!dfileSkipCompressed(stream, offsetFromBeginning)) {
+                return 1;
             }
         } else {
-            if (fseek(stream->stream, offsetFromBeginning - pos, SEEK_CUR) != 0) {
-                stream->flags |= DFILE_ERROR;
-                return 1;
+            if (stream->stream != nullptr) {
+                if (fseek(stream->stream, offsetFromBeginning - pos, SEEK_CUR) != 0) {
+                    stream->flags |= DFILE_ERROR;
+                    return 1;
+                }
             }
 
             // FIXME: I'm not sure what this assignment means. This field is
             // only meaningful when reading compressed streams.
             stream->compressedBytesRead = offsetFromBeginning;
+
+            // CE: Original code does not update position here, which breaks
+            // subsequent reads (they are bounded by position).
+            stream->position = offsetFromBeginning;
         }
 
         stream->flags &= ~(DFILE_HAS_UNGETC | DFILE_EOF);
         return 0;
     }
 
-    if (fseek(stream->stream, stream->dbase->dataOffset + stream->entry->dataOffset, SEEK_SET) != 0) {
-        stream->flags |= DFILE_ERROR;
-        return 1;
+    if (stream->stream != nullptr) {
+        if (fseek(stream->stream, stream->dbase->dataOffset + stream->entry->dataOffset, SEEK_SET) != 0) {
+            stream->flags |= DFILE_ERROR;
+            return 1;
+        }
     }
 
     if (stream->entry->compressed == 1) {
@@ -969,15 +1069,22 @@ static DFile* dfileOpenInternal(DBase* dbase, const char* filePath, const char*
 
     dfile->entry = entry;
 
-    // Open stream to .DAT file.
-    dfile->stream = compat_fopen(dbase->path, "rb");
-    if (dfile->stream == nullptr) {
-        goto err;
-    }
+    if (dbase->mappedData != nullptr) {
+        // Archive is memory mapped, there is no need for a separate stream.
+        dfile->mappedData = dbase->mappedData + dbase->dataOffset + entry->dataOffset;
+    } else {
+        dfile->mappedData = nullptr;
 
-    // Relocate stream to the beginning of data for specified entry.
-    if (fseek(dfile->stream, dbase->dataOffset + entry->dataOffset, SEEK_SET) != 0) {
-        goto err;
+        // Open stream to .DAT file.
+        dfile->stream = compat_fopen(dbase->path, "rb");
+        if (dfile->stream == nullptr) {
+            goto err;
+        }
+
+        // Relocate stream to the beginning of data for specified entry.
+        if (fseek(dfile->stream, dbase->dataOffset + entry->dataOffset, SEEK_SET) != 0) {
+            goto err;
+        }
     }
 
     if (entry->compressed == 1) {
@@ -1063,6 +1170,25 @@ static int dfileReadCharInternal(DFile* stream)
         return -1;
     }
 
+    if (stream->mappedData != nullptr) {
+        int ch = stream->mappedData[stream->position];
+        if ((stream->flags & DFILE_TEXT) != 0) {
+            // This is a text stream, attempt to detect \r\n sequence.
+            if (ch == '\r') {
+                if (stream->position + 1 < stream->entry->uncompressedSize) {
+                    if (stream->mappedData[stream->position + 1] == '\n') {
+                        ch = '\n';
+                        stream->position++;
+                    }
+                }
+            }
+        }
+
+        stream->position++;
+
+        return ch;
+    }
+
     int ch = fgetc(stream->stream);
     if (ch != -1) {
         if ((stream->flags & DFILE_TEXT) != 0) {
@@ -1104,37 +1230,72 @@ static bool dfileReadCompressed(DFile* stream, void* ptr, size_t size)
         }
     }
 
-    stream->decompressionStream->next_out = (Bytef*)ptr;
-    stream->decompressionStream->avail_out = size;
+    DFileCheckpointIndex* checkpointIndex;
+    {
+        std::unique_lock<std::mutex> lock = dfileCheckpointLock();
+        checkpointIndex = stream->entry->checkpointIndex;
+    }
+
+    unsigned char* dest = (unsigned char*)ptr;
 
-    do {
-        if (stream->decompressionStream->avail_out == 0) {
-            // Everything was decompressed.
-            break;
+    while (size != 0) {
+        size_t chunkSize = size;
+        if (checkpointIndex != nullptr) {
+            // Stop at the next checkpoint boundary so that inflate state can
+            // be captured there.
+            size_t bytesUntilCheckpoint = DFILE_CHECKPOINT_INTERVAL - stream->decompressionStream->total_out % DFILE_CHECKPOINT_INTERVAL;
+            chunkSize = std::min(chunkSize, bytesUntilCheckpoint);
         }
 
-        if (stream->decompressionStream->avail_in == 0) {
-            // No more unprocessed data, request next chunk.
-            size_t bytesToRead = std::min(DFILE_DECOMPRESSION_BUFFER_SIZE, stream->entry->dataSize - stream->compressedBytesRead);
+        stream->decompressionStream->next_out = (Bytef*)dest;
+        stream->decompressionStream->avail_out = chunkSize;
 
-            if (fread(stream->decompressionBuffer, bytesToRead, 1, stream->stream) != 1) {
+        do {
+            if (stream->decompressionStream->avail_out == 0) {
+                // Everything was decompressed.
                 break;
             }
 
-            stream->decompressionStream->avail_in = bytesToRead;
-            stream->decompressionStream->next_in = stream->decompressionBuffer;
+            if (stream->decompressionStream->avail_in == 0 && stream->mappedData != nullptr) {
+                // Archive is memory mapped, feed the rest of compressed data
+                // at once.
+                if (stream->compressedBytesRead >= stream->entry->dataSize) {
+                    break;
+                }
+
+                stream->decompressionStream->next_in = (Bytef*)(stream->mappedData + stream->compressedBytesRead);
+                stream->decompressionStream->avail_in = stream->entry->dataSize - stream->compressedBytesRead;
+
+                stream->compressedBytesRead = stream->entry->dataSize;
+            } else if (stream->decompressionStream->avail_in == 0) {
+                // No more unprocessed data, request next chunk.
+                size_t bytesToRead = std::min(DFILE_DECOMPRESSION_BUFFER_SIZE, stream->entry->dataSize - stream->compressedBytesRead);
 
-            stream->compressedBytesRead += bytesToRead;
+                if (fread(stream->decompressionBuffer, bytesToRead, 1, stream->stream) != 1) {
+                    break;
+                }
+
+                stream->decompressionStream->avail_in = bytesToRead;
+                stream->decompressionStream->next_in = stream->decompressionBuffer;
+
+                stream->compressedBytesRead += bytesToRead;
+            }
+        } while (inflate(stream->decompressionStream, Z_NO_FLUSH) == Z_OK);
+
+        if (stream->decompressionStream->avail_out != 0) {
+            // There are some data still waiting, which means there was in error
+            // during decompression loop above.
+            return false;
         }
-    } while (inflate(stream->decompressionStream, Z_NO_FLUSH) == Z_OK);
 
-    if (stream->decompressionStream->avail_out != 0) {
-        // There are some data still waiting, which means there was in error
-        // during decompression loop above.
-        return false;
-    }
+        stream->position += chunkSize;
+        dest += chunkSize;
+        size -= chunkSize;
 
-    stream->position += size;
+        if (checkpointIndex != nullptr) {
+            dfileRecordCheckpoint(stream);
+        }
+    }
 
     return true;
 }
@@ -1149,4 +1310,181 @@ static void dfileUngetCompressed(DFile* stream, int ch)
     stream->position--;
 }
 
+// Maps archive file of [dbase] into memory if memory mapping is enabled.
+//
+// NOTE: Failure to map archive is not an error, [dbase] falls back to regular
+// file streams.
+static void dbaseMap(DBase* dbase)
+{
+    if (!gDBaseMemoryMapped) {
+        return;
+    }
+
+    size_t mappedSize;
+    unsigned char* mappedData = (unsigned char*)compat_mmap(dbase->path, &mappedSize);
+    if (mappedData == nullptr) {
+        return;
+    }
+
+    // Make sure every entry fits into mapping, so that reads don't need to be
+    // bounds checked.
+    for (int index = 0; index < dbase->entriesLength; index++) {
+        DBaseEntry* entry = &(dbase->entries[index]);
+        size_t entrySize = entry->compressed == 1 ? entry->dataSize : entry->uncompressedSize;
+        if (dbase->dataOffset < 0
+            || entry->dataOffset < 0
+            || entrySize > mappedSize
+            || static_cast<size_t>(dbase->dataOffset) + static_cast<size_t>(entry->dataOffset) > mappedSize - entrySize) {
+            compat_munmap(mappedData, mappedSize);
+            return;
+        }
+    }
+
+    dbase->mappedData = mappedData;
+    dbase->mappedSize = mappedSize;
+}
+
+// Returns checkpoint index for [entry], creating it if needed.
+//
+// Returns NULL if entry is not compressed or too small to benefit from
+// checkpoints.
+static DFileCheckpointIndex* dbaseEntryGetCheckpointIndex(DBaseEntry* entry)
+{
+    if (entry->checkpointIndex != nullptr) {
+        return entry->checkpointIndex;
+    }
+
+    if (entry->compressed != 1 || entry->uncompressedSize <= DFILE_CHECKPOINT_INTERVAL) {
+        return nullptr;
+    }
+
+    DFileCheckpointIndex* checkpointIndex = (DFileCheckpointIndex*)malloc(sizeof(*checkpointIndex));
+    if (checkpointIndex == nullptr) {
+        return nullptr;
+    }
+
+    // There is no need for checkpoint at the end of entry.
+    checkpointIndex->checkpointsLength = (entry->uncompressedSize - 1) / DFILE_CHECKPOINT_INTERVAL;
+    checkpointIndex->checkpoints = (DFileCheckpoint*)malloc(sizeof(*checkpointIndex->checkpoints) * checkpointIndex->checkpointsLength);
+    if (checkpointIndex->checkpoints == nullptr) {
+        free(checkpointIndex);
+        return nullptr;
+    }
+
+    memset(checkpointIndex->checkpoints, 0, sizeof(*checkpointIndex->checkpoints) * checkpointIndex->checkpointsLength);
+
+    entry->checkpointIndex = checkpointIndex;
+
+    return checkpointIndex;
+}
+
+static void dbaseEntryFreeCheckpointIndex(DBaseEntry* entry)
+{
+    DFileCheckpointIndex* checkpointIndex = entry->checkpointIndex;
+    if (checkpointIndex == nullptr) {
+        return;
+    }
+
+    for (int index = 0; index < checkpointIndex->checkpointsLength; index++) {
+        DFileCheckpoint* checkpoint = &(checkpointIndex->checkpoints[index]);
+        if (checkpoint->valid) {
+            inflateEnd(&(checkpoint->stream));
+        }
+    }
+
+    free(checkpointIndex->checkpoints);
+    free(checkpointIndex);
+
+    entry->checkpointIndex = nullptr;
+}
+
+// Captures inflate state of [stream] if it's exactly at checkpoint boundary
+// which was not recorded yet.
+static void dfileRecordCheckpoint(DFile* stream)
+{
+    std::unique_lock<std::mutex> lock = dfileCheckpointLock();
+
+    DFileCheckpointIndex* checkpointIndex = stream->entry->checkpointIndex;
+    z_streamp decompressionStream = stream->decompressionStream;
+
+    if (decompressionStream->total_out == 0 || decompressionStream->total_out % DFILE_CHECKPOINT_INTERVAL != 0) {
+        return;
+    }
+
+    int index = static_cast<int>(decompressionStream->total_out / DFILE_CHECKPOINT_INTERVAL) - 1;
+    if (index >= checkpointIndex->checkpointsLength) {
+        return;
+    }
+
+    DFileCheckpoint* checkpoint = &(checkpointIndex->checkpoints[index]);
+    if (checkpoint->valid) {
+        return;
+    }
+
+    // NOTE: Failure to capture checkpoint is not an error, this position will
+    // simply be reached by decompressing from the previous one.
+    if (inflateCopy(&(checkpoint->stream), decompressionStream) != Z_OK) {
+        return;
+    }
+
+    // Data which is read into decompression buffer but not yet consumed by
+    // inflate is not part of the snapshot.
+    checkpoint->compressedOffset = stream->compressedBytesRead - decompressionStream->avail_in;
+    checkpoint->valid = true;
+}
+
+// Replaces inflate state of [stream] with the one from [checkpoint] and
+// repositions underlying file stream accordingly.
+static bool dfileRestoreCheckpoint(DFile* stream, DFileCheckpoint* checkpoint)
+{
+    if (inflateEnd(stream->decompressionStream) != Z_OK) {
+        return false;
+    }
+
+    if (inflateCopy(stream->decompressionStream, &(checkpoint->stream)) != Z_OK) {
+        // Leave stream in consistent state so that it can be rewound.
+        dfileDecompressInit(stream->decompressionStream, stream->dbase->format, stream->decompressionBuffer);
+        return false;
+    }
+
+    stream->decompressionStream->next_in = stream->decompressionBuffer;
+    stream->decompressionStream->avail_in = 0;
+
+    if (stream->stream != nullptr) {
+        if (fseek(stream->stream, stream->dbase->dataOffset + stream->entry->dataOffset + checkpoint->compressedOffset, SEEK_SET) != 0) {
+            return false;
+        }
+    }
+
+    stream->compressedBytesRead = checkpoint->compressedOffset;
+    stream->position = static_cast<long>(stream->decompressionStream->total_out);
+    stream->flags &= ~DFILE_HAS_COMPRESSED_UNGETC;
+
+    return true;
+}
+
+// Decompresses and discards data until [stream] reaches [offset].
+static bool dfileSkipCompressed(DFile* stream, long offset)
+{
+    unsigned char buffer[DFILE_DECOMPRESSION_BUFFER_SIZE];
+
+    while (offset > stream->position) {
+        size_t bytesToSkip = std::min(static_cast<size_t>(offset - stream->position), sizeof(buffer));
+        if (!dfileReadCompressed(stream, buffer, bytesToSkip)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static std::unique_lock<std::mutex> dfileCheckpointLock()
+{
+    if (!gDBaseThreadSafe) {
+        return std::unique_lock<std::mutex>();
+    }
+
+    return std::unique_lock<std::mutex>(gDFileCheckpointMutex);
+}
+
 } // namespace fallout
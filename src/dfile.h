@@ -26,6 +26,8 @@ enum DBaseErrorFlags : int {
 typedef struct DBase DBase;
 typedef struct DBaseEntry DBaseEntry;
 typedef struct DFile DFile;
+typedef struct DFileCheckpoint DFileCheckpoint;
+typedef struct DFileCheckpointIndex DFileCheckpointIndex;
 
 // A representation of .DAT or .ZIP file.
 typedef struct DBase {
@@ -46,6 +48,17 @@ typedef struct DBase {
 
     // The head of linked list of open file handles.
     DFile* dfileHead;
+
+    // The contents of archive file mapped into memory.
+    //
+    // This value is NULL unless memory mapping is enabled (see
+    // [dbaseSetMemoryMapped]) and archive was successfully mapped. When set,
+    // [DFile]s read entry data directly from the mapping instead of opening
+    // their own streams.
+    unsigned char* mappedData;
+
+    // The size of [mappedData].
+    size_t mappedSize;
 } DBase;
 
 typedef struct DBaseEntry {
@@ -54,8 +67,44 @@ typedef struct DBaseEntry {
     int uncompressedSize;
     int dataSize;
     int dataOffset;
+
+    // The index of inflate checkpoints used to speed up seeks in compressed
+    // entry.
+    //
+    // This value is NULL until the first seek in this entry. Once created it
+    // is shared between all [DFile]s opened for this entry, and is released in
+    // [dbaseClose].
+    DFileCheckpointIndex* checkpointIndex;
 } DBaseEntry;
 
+// A snapshot of inflate stream taken at specific uncompressed offset.
+typedef struct DFileCheckpoint {
+    // Specifies whether this checkpoint was recorded.
+    bool valid;
+
+    // The number of compressed bytes consumed by [stream] when this checkpoint
+    // was taken.
+    int compressedOffset;
+
+    // The copy of inflate stream (including it's sliding window) at this
+    // checkpoint.
+    z_stream stream;
+} DFileCheckpoint;
+
+// A list of inflate checkpoints for compressed [DBaseEntry].
+//
+// Checkpoints are placed at fixed intervals of uncompressed data (see
+// [DFILE_CHECKPOINT_INTERVAL]), so checkpoint at index `n` represents offset
+// `(n + 1) * DFILE_CHECKPOINT_INTERVAL`. They are recorded as compressed data
+// is read by any [DFile] opened for the entry.
+typedef struct DFileCheckpointIndex {
+    // The number of checkpoints.
+    int checkpointsLength;
+
+    // The array of checkpoints.
+    DFileCheckpoint* checkpoints;
+} DFileCheckpointIndex;
+
 // A handle to open entry in .DAT file.
 typedef struct DFile {
     DBase* dbase;
@@ -67,8 +116,15 @@ typedef struct DFile {
     // This stream is not shared across open handles. Instead every [DFile]
     // opens it's own stream via [fopen], which is then closed via [fclose] in
     // [dfileClose].
+    //
+    // This value is NULL if [dbase] is memory mapped.
     FILE* stream;
 
+    // The pointer to the beginning of entry data in [dbase]'s memory mapping.
+    //
+    // This value is NULL if [dbase] is not memory mapped.
+    const unsigned char* mappedData;
+
     // The inflate stream used to decompress data.
     //
     // This value is NULL if entry is not compressed.
@@ -130,6 +186,21 @@ typedef struct DFileFindData {
 // Reads DAT or ZIP file header and table of entries.
 DBase* dbaseOpen(const char* filename, int* errorFlags = nullptr);
 bool dbaseClose(DBase* dbase);
+
+// Specifies whether subsequently opened [DBase]s should be memory mapped.
+void dbaseSetMemoryMapped(bool enabled);
+
+// Specifies whether checkpoint indexes should be guarded, so that streams of
+// the same entry can be read on different threads.
+void dbaseSetThreadSafe(bool enabled);
+
+// Looks up entry at [filePath] and provides direct access to it's contents.
+//
+// Returns false if there is no such entry. Otherwise [dataPtr] is set to the
+// entry data inside the memory mapping of [dbase], or to NULL if the entry is
+// compressed or [dbase] is not memory mapped (in this case the data must be
+// read via [dfileOpen]).
+bool dbaseGetEntryView(DBase* dbase, const char* filePath, const unsigned char** dataPtr, int* sizePtr);
 bool dbaseFindFirstEntry(DBase* dbase, DFileFindData* findFileData, const char* pattern);
 bool dbaseFindNextEntry(DBase* dbase, DFileFindData* findFileData);
 bool dbaseFindClose(DBase* dbase, DFileFindData* findFileData);
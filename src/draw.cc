@@ -3,7 +3,9 @@
 #include <algorithm>
 #include <string.h>
 
+#include "art.h"
 #include "color.h"
+#include "draw_kernels.h"
 #include "svga.h"
 
 namespace fallout {
@@ -472,19 +474,226 @@ void srcCopy(unsigned char* dest, int destPitch, const unsigned char* src, int s
 // 0x4E0ED5
 void transSrcCopy(unsigned char* dest, int destPitch, const unsigned char* src, int srcPitch, int width, int height)
 {
-    int destSkip = destPitch - width;
-    int srcSkip = srcPitch - width;
-
     for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            unsigned char c = *src++;
-            if (c != 0) {
-                *dest = c;
-            }
+        blendTransparentRow(dest, src, src, width);
+        src += srcPitch;
+        dest += destPitch;
+    }
+}
+
+
+// 0x48BDD8 translucent_trans_buf_to_buf
+void _translucent_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, Color* blendTable, Color* colorTable)
+{
+    dest += destPitch * destY + destX;
+    int srcStep = srcPitch - srcWidth;
+    int destStep = destPitch - srcWidth;
+
+    for (int y = 0; y < srcHeight; y++) {
+        for (int x = 0; x < srcWidth; x++) {
+            Color v1 = colorTable[*src];
+            Color* v2 = blendTable + (v1 << 8);
+            unsigned char v3 = *dest;
+
+            *dest = v2[v3];
+
+            src++;
             dest++;
         }
-        src += srcSkip;
-        dest += destSkip;
+
+        src += srcStep;
+        dest += destStep;
+    }
+}
+
+// 0x48BEFC dark_trans_buf_to_buf
+void _dark_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, int intensity)
+{
+    unsigned char* sp = src;
+    unsigned char* dp = dest + destPitch * destY + destX;
+
+    int intensityIndex = intensity / 512;
+
+    // CE: Gather intensity column once, so that lookups below hit one
+    // contiguous table instead of striding across `intensityColorTable`.
+    // Colors from 0xE5 are palette animated and are left as is.
+    unsigned char colorTable[COLOR_COUNT];
+    for (int color = 0; color < COLOR_COUNT; color++) {
+        colorTable[color] = color < 0xE5 ? intensityColorTable[color][intensityIndex] : color;
+    }
+
+    unsigned char colors[DRAW_KERNELS_ROW_CHUNK_SIZE];
+
+    for (int y = 0; y < srcHeight; y++) {
+        for (int x = 0; x < srcWidth; x += DRAW_KERNELS_ROW_CHUNK_SIZE) {
+            int width = std::min(srcWidth - x, DRAW_KERNELS_ROW_CHUNK_SIZE);
+            for (int index = 0; index < width; index++) {
+                colors[index] = colorTable[sp[x + index]];
+            }
+
+            blendTransparentRow(dp + x, sp + x, colors, width);
+        }
+
+        sp += srcPitch;
+        dp += destPitch;
+    }
+}
+
+// 0x48BF88 dark_translucent_trans_buf_to_buf
+void _dark_translucent_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, int intensity, Color* blendTable, Color* colorTable)
+{
+    int intensityIndex = intensity / 512;
+
+    dest += destPitch * destY + destX;
+
+    // CE: See `_dark_trans_buf_to_buf`.
+    unsigned char intensityTable[COLOR_COUNT];
+    for (int color = 0; color < COLOR_COUNT; color++) {
+        intensityTable[color] = intensityColorTable[color][intensityIndex];
+    }
+
+    unsigned char colors[DRAW_KERNELS_ROW_CHUNK_SIZE];
+
+    for (int y = 0; y < srcHeight; y++) {
+        for (int x = 0; x < srcWidth; x += DRAW_KERNELS_ROW_CHUNK_SIZE) {
+            int width = std::min(srcWidth - x, DRAW_KERNELS_ROW_CHUNK_SIZE);
+
+            // Computed for transparent pixels too (without branching), these
+            // are discarded by blend.
+            for (int index = 0; index < width; index++) {
+                unsigned int blendIndex = (colorTable[src[x + index]] << 8) + dest[x + index];
+                colors[index] = intensityTable[blendTable[blendIndex]];
+            }
+
+            blendTransparentRow(dest + x, src + x, colors, width);
+        }
+
+        src += srcPitch;
+        dest += destPitch;
+    }
+}
+
+// 0x48C03C intensity_mask_buf_to_buf
+void _intensity_mask_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destPitch, unsigned char* mask, int maskPitch, int intensity)
+{
+    int intensityIndex = intensity / 512;
+
+    // CE: See `_dark_trans_buf_to_buf`.
+    unsigned char intensityTable[COLOR_COUNT];
+    for (int color = 0; color < COLOR_COUNT; color++) {
+        intensityTable[color] = intensityColorTable[color][intensityIndex];
+    }
+
+    unsigned char colors[DRAW_KERNELS_ROW_CHUNK_SIZE];
+
+    for (int y = 0; y < srcHeight; y++) {
+        for (int x = 0; x < srcWidth; x += DRAW_KERNELS_ROW_CHUNK_SIZE) {
+            int width = std::min(srcWidth - x, DRAW_KERNELS_ROW_CHUNK_SIZE);
+            for (int index = 0; index < width; index++) {
+                unsigned char color = intensityTable[src[x + index]];
+                unsigned char maskValue = mask[x + index];
+                if (maskValue != 0) {
+                    unsigned char v1 = intensityColorTable[dest[x + index]][128 - maskValue];
+                    unsigned char v2 = intensityColorTable[color][maskValue];
+                    color = colorMixAddTable[v2][v1];
+                }
+                colors[index] = color;
+            }
+
+            blendTransparentRow(dest + x, src + x, colors, width);
+        }
+
+        src += srcPitch;
+        dest += destPitch;
+        mask += maskPitch;
+    }
+}
+
+// Same as [_dark_trans_buf_to_buf], but draws opaque spans of the frame
+// instead of testing every pixel. [srcX], [srcY], [srcWidth], [srcHeight]
+// specify area of the frame to draw.
+void darkTransSpansToBuf(const unsigned char* frameData, int frameWidth, const ArtFrameSpans* frameSpans, int srcX, int srcY, int srcWidth, int srcHeight, unsigned char* dest, int destX, int destY, int destPitch, int intensity)
+{
+    const unsigned char* sp = frameData + frameWidth * srcY;
+    unsigned char* dp = dest + destPitch * destY + destX;
+
+    int intensityIndex = intensity / 512;
+
+    // See `_dark_trans_buf_to_buf`. Opaque runs are copied as is when
+    // lighting does not change any color (which is typical for full light).
+    unsigned char colorTable[COLOR_COUNT];
+    bool identity = true;
+    for (int color = 0; color < COLOR_COUNT; color++) {
+        colorTable[color] = color < 0xE5 ? intensityColorTable[color][intensityIndex] : color;
+        if (colorTable[color] != color) {
+            identity = false;
+        }
+    }
+
+    int srcRight = srcX + srcWidth;
+
+    for (int y = 0; y < srcHeight; y++) {
+        const int* row = frameSpans->rows + srcY + y;
+        for (int index = row[0]; index < row[1]; index++) {
+            const ArtSpan* span = &(frameSpans->spans[index]);
+            if (span->x >= srcRight) {
+                break;
+            }
+
+            int left = std::max(static_cast<int>(span->x), srcX);
+            int right = std::min(span->x + span->length, srcRight);
+            if (left >= right) {
+                continue;
+            }
+
+            if (identity) {
+                memcpy(dp + left - srcX, sp + left, right - left);
+            } else {
+                for (int x = left; x < right; x++) {
+                    dp[x - srcX] = colorTable[sp[x]];
+                }
+            }
+        }
+
+        sp += frameWidth;
+        dp += destPitch;
+    }
+}
+
+// Same as [_dark_translucent_trans_buf_to_buf], but blends opaque spans of
+// the frame only, see [darkTransSpansToBuf].
+void darkTranslucentTransSpansToBuf(const unsigned char* frameData, int frameWidth, const ArtFrameSpans* frameSpans, int srcX, int srcY, int srcWidth, int srcHeight, unsigned char* dest, int destX, int destY, int destPitch, int intensity, Color* blendTable, Color* colorTable)
+{
+    const unsigned char* sp = frameData + frameWidth * srcY;
+    unsigned char* dp = dest + destPitch * destY + destX;
+
+    int intensityIndex = intensity / 512;
+
+    unsigned char intensityTable[COLOR_COUNT];
+    for (int color = 0; color < COLOR_COUNT; color++) {
+        intensityTable[color] = intensityColorTable[color][intensityIndex];
+    }
+
+    int srcRight = srcX + srcWidth;
+
+    for (int y = 0; y < srcHeight; y++) {
+        const int* row = frameSpans->rows + srcY + y;
+        for (int index = row[0]; index < row[1]; index++) {
+            const ArtSpan* span = &(frameSpans->spans[index]);
+            if (span->x >= srcRight) {
+                break;
+            }
+
+            int left = std::max(static_cast<int>(span->x), srcX);
+            int right = std::min(span->x + span->length, srcRight);
+            for (int x = left; x < right; x++) {
+                unsigned char* pixel = dp + x - srcX;
+                *pixel = intensityTable[blendTable[(colorTable[sp[x]] << 8) + *pixel]];
+            }
+        }
+
+        sp += frameWidth;
+        dp += destPitch;
     }
 }
 
@@ -7,6 +7,8 @@
 
 namespace fallout {
 
+struct ArtFrameSpans;
+
 template <typename T>
 struct Buffer2DBase {
     T* data = nullptr;
@@ -75,6 +77,12 @@ void _swap_color_buf(unsigned char* buf, int width, int height, int pitch, Color
 void bufferOutline(unsigned char* buf, int width, int height, int pitch, Color color);
 void srcCopy(unsigned char* dest, int destPitch, const unsigned char* src, int srcPitch, int width, int height);
 void transSrcCopy(unsigned char* dest, int destPitch, const unsigned char* src, int srcPitch, int width, int height);
+void _translucent_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, Color* blendTable, Color* colorTable);
+void _dark_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, int light);
+void _dark_translucent_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, int light, Color* blendTable, Color* colorTable);
+void _intensity_mask_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destPitch, unsigned char* mask, int maskPitch, int light);
+void darkTransSpansToBuf(const unsigned char* frameData, int frameWidth, const ArtFrameSpans* frameSpans, int srcX, int srcY, int srcWidth, int srcHeight, unsigned char* dest, int destX, int destY, int destPitch, int intensity);
+void darkTranslucentTransSpansToBuf(const unsigned char* frameData, int frameWidth, const ArtFrameSpans* frameSpans, int srcX, int srcY, int srcWidth, int srcHeight, unsigned char* dest, int destX, int destY, int destPitch, int intensity, Color* blendTable, Color* colorTable);
 
 } // namespace fallout
 
@@ -0,0 +1,303 @@
+#include "draw_kernels.h"
+
+#include <SDL.h>
+
+#include "debug.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DRAW_KERNELS_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__) || defined(_M_ARM64)
+#define DRAW_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang require functions using instructions above the baseline of
+// the target to be marked explicitly, MSVC does not.
+#if defined(DRAW_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define DRAW_KERNELS_TARGET(name) __attribute__((target(name)))
+#else
+#define DRAW_KERNELS_TARGET(name)
+#endif
+
+namespace fallout {
+
+typedef void(BlendTransparentRowProc)(unsigned char* dest, const unsigned char* src, const unsigned char* colors, int width);
+typedef void(ExpandPaletteRowProc)(unsigned int* dest, const unsigned char* src, const unsigned int* palette, int width);
+
+static void drawKernelsSelect();
+static void blendTransparentRowInit(unsigned char* dest, const unsigned char* src, const unsigned char* colors, int width);
+static void expandPaletteRowInit(unsigned int* dest, const unsigned char* src, const unsigned int* palette, int width);
+
+#if defined(DRAW_KERNELS_X86)
+static void blendTransparentRowSse2(unsigned char* dest, const unsigned char* src, const unsigned char* colors, int width);
+static void blendTransparentRowAvx2(unsigned char* dest, const unsigned char* src, const unsigned char* colors, int width);
+static void expandPaletteRowAvx2(unsigned int* dest, const unsigned char* src, const unsigned int* palette, int width);
+#elif defined(DRAW_KERNELS_NEON)
+static void blendTransparentRowNeon(unsigned char* dest, const unsigned char* src, const unsigned char* colors, int width);
+#endif
+
+// Selected on first use, see [drawKernelsSelect].
+static BlendTransparentRowProc* gBlendTransparentRowProc = blendTransparentRowInit;
+static ExpandPaletteRowProc* gExpandPaletteRowProc = expandPaletteRowInit;
+
+void drawKernelsInit()
+{
+    if (gBlendTransparentRowProc == blendTransparentRowInit) {
+        drawKernelsSelect();
+    }
+}
+
+void blendTransparentRow(unsigned char* dest, const unsigned char* src, const unsigned char* colors, int width)
+{
+    gBlendTransparentRowProc(dest, src, colors, width);
+}
+
+void expandPaletteRow(unsigned int* dest, const unsigned char* src, const unsigned int* palette, int width)
+{
+    gExpandPaletteRowProc(dest, src, palette, width);
+}
+
+void blendTransparentRowScalar(unsigned char* dest, const unsigned char* src, const unsigned char* colors, int width)
+{
+    for (int x = 0; x < width; x++) {
+        if (src[x] != 0) {
+            dest[x] = colors[x];
+        }
+    }
+}
+
+void expandPaletteRowScalar(unsigned int* dest, const unsigned char* src, const unsigned int* palette, int width)
+{
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        // Unrolled so that lookups do not wait for each other.
+        unsigned char index0 = src[x];
+        unsigned char index1 = src[x + 1];
+        unsigned char index2 = src[x + 2];
+        unsigned char index3 = src[x + 3];
+
+        dest[x] = palette[index0];
+        dest[x + 1] = palette[index1];
+        dest[x + 2] = palette[index2];
+        dest[x + 3] = palette[index3];
+    }
+
+    for (; x < width; x++) {
+        dest[x] = palette[src[x]];
+    }
+}
+
+bool drawKernelsIsVariantSupported(DrawKernelsVariant variant)
+{
+    switch (variant) {
+    case DRAW_KERNELS_VARIANT_SCALAR:
+        return true;
+#if defined(DRAW_KERNELS_X86)
+    case DRAW_KERNELS_VARIANT_SSE2:
+        return SDL_HasSSE2();
+    case DRAW_KERNELS_VARIANT_AVX2:
+        return SDL_HasAVX2();
+#elif defined(DRAW_KERNELS_NEON)
+    case DRAW_KERNELS_VARIANT_NEON:
+#if defined(__aarch64__) || defined(_M_ARM64)
+        // NEON is mandatory on AArch64.
+        return true;
+#else
+        return SDL_HasNEON();
+#endif
+#endif
+    default:
+        return false;
+    }
+}
+
+bool drawKernelsSetVariant(DrawKernelsVariant variant)
+{
+    if (!drawKernelsIsVariantSupported(variant)) {
+        return false;
+    }
+
+    BlendTransparentRowProc* blendProc = blendTransparentRowScalar;
+    ExpandPaletteRowProc* expandProc = expandPaletteRowScalar;
+
+    switch (variant) {
+#if defined(DRAW_KERNELS_X86)
+    case DRAW_KERNELS_VARIANT_SSE2:
+        blendProc = blendTransparentRowSse2;
+        break;
+    case DRAW_KERNELS_VARIANT_AVX2:
+        blendProc = blendTransparentRowAvx2;
+        expandProc = expandPaletteRowAvx2;
+        break;
+#elif defined(DRAW_KERNELS_NEON)
+    case DRAW_KERNELS_VARIANT_NEON:
+        blendProc = blendTransparentRowNeon;
+        break;
+#endif
+    default:
+        break;
+    }
+
+    gBlendTransparentRowProc = blendProc;
+    gExpandPaletteRowProc = expandProc;
+
+    return true;
+}
+
+const char* drawKernelsGetVariantName(DrawKernelsVariant variant)
+{
+    switch (variant) {
+    case DRAW_KERNELS_VARIANT_SCALAR:
+        return "scalar";
+    case DRAW_KERNELS_VARIANT_SSE2:
+        return "sse2";
+    case DRAW_KERNELS_VARIANT_AVX2:
+        return "avx2";
+    case DRAW_KERNELS_VARIANT_NEON:
+        return "neon";
+    default:
+        return nullptr;
+    }
+}
+
+// Picks the best version of every kernel for the current CPU.
+static void drawKernelsSelect()
+{
+    static const DrawKernelsVariant variants[] = {
+        DRAW_KERNELS_VARIANT_AVX2,
+        DRAW_KERNELS_VARIANT_SSE2,
+        DRAW_KERNELS_VARIANT_NEON,
+    };
+
+    DrawKernelsVariant variant = DRAW_KERNELS_VARIANT_SCALAR;
+    for (DrawKernelsVariant candidate : variants) {
+        if (drawKernelsIsVariantSupported(candidate)) {
+            variant = candidate;
+            break;
+        }
+    }
+
+    drawKernelsSetVariant(variant);
+
+    debugPrint("Using %s blit kernels\n", drawKernelsGetVariantName(variant));
+}
+
+static void blendTransparentRowInit(unsigned char* dest, const unsigned char* src, const unsigned char* colors, int width)
+{
+    drawKernelsSelect();
+    gBlendTransparentRowProc(dest, src, colors, width);
+}
+
+static void expandPaletteRowInit(unsigned int* dest, const unsigned char* src, const unsigned int* palette, int width)
+{
+    drawKernelsSelect();
+    gExpandPaletteRowProc(dest, src, palette, width);
+}
+
+#if defined(DRAW_KERNELS_X86)
+
+DRAW_KERNELS_TARGET("sse2")
+static void blendTransparentRowSse2(unsigned char* dest, const unsigned char* src, const unsigned char* colors, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i transparent = _mm_cmpeq_epi8(s, zero);
+
+        int bits = _mm_movemask_epi8(transparent);
+        if (bits == 0xFFFF) {
+            continue;
+        }
+
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + x));
+        if (bits != 0) {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + x));
+            c = _mm_or_si128(_mm_and_si128(transparent, d), _mm_andnot_si128(transparent, c));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x), c);
+    }
+
+    blendTransparentRowScalar(dest + x, src + x, colors + x, width - x);
+}
+
+DRAW_KERNELS_TARGET("avx2")
+static void blendTransparentRowAvx2(unsigned char* dest, const unsigned char* src, const unsigned char* colors, int width)
+{
+    const __m256i zero = _mm256_setzero_si256();
+
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        __m256i transparent = _mm256_cmpeq_epi8(s, zero);
+
+        unsigned int bits = static_cast<unsigned int>(_mm256_movemask_epi8(transparent));
+        if (bits == 0xFFFFFFFF) {
+            continue;
+        }
+
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(colors + x));
+        if (bits != 0) {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest + x));
+            c = _mm256_blendv_epi8(c, d, transparent);
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + x), c);
+    }
+
+    // Mixing AVX and SSE is fine here, both are VEX encoded in this function.
+    const __m128i zero128 = _mm_setzero_si128();
+    for (; x + 16 <= width; x += 16) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i transparent = _mm_cmpeq_epi8(s, zero128);
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + x));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x), _mm_blendv_epi8(c, d, transparent));
+    }
+
+    blendTransparentRowScalar(dest + x, src + x, colors + x, width - x);
+}
+
+DRAW_KERNELS_TARGET("avx2")
+static void expandPaletteRowAvx2(unsigned int* dest, const unsigned char* src, const unsigned int* palette, int width)
+{
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + x));
+        __m256i indexes = _mm256_cvtepu8_epi32(bytes);
+        __m256i pixels = _mm256_i32gather_epi32(reinterpret_cast<const int*>(palette), indexes, 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + x), pixels);
+    }
+
+    expandPaletteRowScalar(dest + x, src + x, palette, width - x);
+}
+
+#elif defined(DRAW_KERNELS_NEON)
+
+static void blendTransparentRowNeon(unsigned char* dest, const unsigned char* src, const unsigned char* colors, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t s = vld1q_u8(src + x);
+        uint8x16_t transparent = vceqq_u8(s, vdupq_n_u8(0));
+
+        // All lanes transparent when narrowed mask is all ones.
+        uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(transparent), 4);
+        if (vget_lane_u64(vreinterpret_u64_u8(narrowed), 0) == ~0ULL) {
+            continue;
+        }
+
+        uint8x16_t c = vld1q_u8(colors + x);
+        uint8x16_t d = vld1q_u8(dest + x);
+        vst1q_u8(dest + x, vbslq_u8(transparent, d, c));
+    }
+
+    blendTransparentRowScalar(dest + x, src + x, colors + x, width - x);
+}
+
+#endif
+
+} // namespace fallout
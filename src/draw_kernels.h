@@ -0,0 +1,55 @@
+#ifndef DRAW_KERNELS_H
+#define DRAW_KERNELS_H
+
+namespace fallout {
+
+typedef enum DrawKernelsVariant {
+    DRAW_KERNELS_VARIANT_SCALAR,
+    DRAW_KERNELS_VARIANT_SSE2,
+    DRAW_KERNELS_VARIANT_AVX2,
+    DRAW_KERNELS_VARIANT_NEON,
+    DRAW_KERNELS_VARIANT_COUNT,
+} DrawKernelsVariant;
+
+// Selects kernels for the current CPU. Happens on first use of any kernel
+// anyway, call this before using kernels from multiple threads.
+void drawKernelsInit();
+
+// Returns `true` when [variant] is compiled in and supported by the CPU.
+bool drawKernelsIsVariantSupported(DrawKernelsVariant variant);
+
+// Switches every kernel to [variant] (kernels without such version use
+// scalar one). Returns `false` when variant is not supported. Meant for
+// tests, must not be called while kernels are in use.
+bool drawKernelsSetVariant(DrawKernelsVariant variant);
+
+const char* drawKernelsGetVariantName(DrawKernelsVariant variant);
+
+// Number of pixels which lit blits compute into a temporary row before
+// blending it with [blendTransparentRow].
+#define DRAW_KERNELS_ROW_CHUNK_SIZE (256)
+
+// Copies [colors] into [dest] wherever [src] is not transparent (color 0):
+//
+// dest[x] = src[x] != 0 ? colors[x] : dest[x]
+//
+// [colors] can be the same as [src]. Dispatches to SSE2/AVX2/NEON version
+// depending on CPU capabilities, results are identical to the scalar version.
+void blendTransparentRow(unsigned char* dest, const unsigned char* src, const unsigned char* colors, int width);
+
+// Scalar version of [blendTransparentRow], always available.
+void blendTransparentRowScalar(unsigned char* dest, const unsigned char* src, const unsigned char* colors, int width);
+
+// Converts palette indexes in [src] to 32-bit pixels:
+//
+// dest[x] = palette[src[x]]
+//
+// Dispatches to AVX2 version depending on CPU capabilities.
+void expandPaletteRow(unsigned int* dest, const unsigned char* src, const unsigned int* palette, int width);
+
+// Scalar version of [expandPaletteRow], always available.
+void expandPaletteRowScalar(unsigned int* dest, const unsigned char* src, const unsigned int* palette, int width);
+
+} // namespace fallout
+
+#endif /* DRAW_KERNELS_H */
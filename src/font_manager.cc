@@ -23,6 +23,16 @@ typedef struct InterfaceFontGlyph {
     int offset;
 } InterfaceFontGlyph;
 
+// Horizontal run of non-blank pixels in a glyph.
+typedef struct InterfaceFontSpan {
+    short x;
+    short y;
+    short length;
+
+    // Offset of the first pixel into [InterfaceFontDescriptor.data].
+    int dataOffset;
+} InterfaceFontSpan;
+
 typedef struct InterfaceFontDescriptor {
     short maxHeight;
     short letterSpacing;
@@ -32,9 +42,15 @@ typedef struct InterfaceFontDescriptor {
     short field_A;
     InterfaceFontGlyph glyphs[256];
     unsigned char* data;
+
+    // Non-blank runs of all glyphs, see [interfaceFontBuildSpans]. Runs of
+    // glyph `n` are from `spanOffsets[n]` up to `spanOffsets[n + 1]`.
+    InterfaceFontSpan* spans;
+    int spanOffsets[257];
 } InterfaceFontDescriptor;
 
 static int interfaceFontLoad(int font);
+static int interfaceFontBuildSpans(InterfaceFontDescriptor* fontDescriptor, int dataSize);
 static void interfaceFontSetCurrentImpl(int font);
 static int interfaceFontGetLineHeightImpl();
 static int interfaceFontGetStringWidthImpl(const char* string);
@@ -90,6 +106,7 @@ int interfaceFontsInit()
         if (interfaceFontLoad(font) == -1) {
             gInterfaceFontDescriptors[font].maxHeight = 0;
             gInterfaceFontDescriptors[font].data = nullptr;
+            gInterfaceFontDescriptors[font].spans = nullptr;
         } else {
             ++gInterfaceFontsLength;
 
@@ -117,6 +134,10 @@ void interfaceFontsExit()
         if (gInterfaceFontDescriptors[font].data != nullptr) {
             internal_free_safe(gInterfaceFontDescriptors[font].data, __FILE__, __LINE__); // FONTMGR.C, 124
         }
+
+        if (gInterfaceFontDescriptors[font].spans != nullptr) {
+            internal_free_safe(gInterfaceFontDescriptors[font].spans, __FILE__, __LINE__);
+        }
     }
 }
 
@@ -240,6 +261,72 @@ static int interfaceFontLoad(int font_index)
     }
 
     fileClose(stream);
+
+    if (interfaceFontBuildSpans(fontDescriptor, glyphDataSize) == -1) {
+        internal_free_safe(fontDescriptor->data, __FILE__, __LINE__);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Collects runs of non-blank pixels of every glyph. Blank pixels leave
+// destination intact (first row of blend table is identity), so drawing can
+// skip them altogether.
+static int interfaceFontBuildSpans(InterfaceFontDescriptor* fontDescriptor, int dataSize)
+{
+    // Two passes - count runs first, then fill them in.
+    for (int pass = 0; pass < 2; pass++) {
+        int spanCount = 0;
+        for (int index = 0; index < 256; index++) {
+            InterfaceFontGlyph* glyph = &(fontDescriptor->glyphs[index]);
+            fontDescriptor->spanOffsets[index] = spanCount;
+
+            // Glyphs pointing outside of data are left blank.
+            if (glyph->width <= 0 || glyph->height <= 0 || glyph->offset < 0 || glyph->offset + glyph->width * glyph->height > dataSize) {
+                continue;
+            }
+
+            for (int y = 0; y < glyph->height; y++) {
+                int rowOffset = glyph->offset + glyph->width * y;
+                unsigned char* row = fontDescriptor->data + rowOffset;
+
+                int x = 0;
+                while (x < glyph->width) {
+                    if (row[x] == 0) {
+                        x++;
+                        continue;
+                    }
+
+                    int start = x;
+                    while (x < glyph->width && row[x] != 0) {
+                        x++;
+                    }
+
+                    if (pass == 1) {
+                        InterfaceFontSpan* span = &(fontDescriptor->spans[spanCount]);
+                        span->x = static_cast<short>(start);
+                        span->y = static_cast<short>(y);
+                        span->length = static_cast<short>(x - start);
+                        span->dataOffset = rowOffset + start;
+                    }
+                    spanCount++;
+                }
+            }
+        }
+
+        fontDescriptor->spanOffsets[256] = spanCount;
+
+        if (pass == 0) {
+            // Allocate at least one run so that blank font is not confused
+            // with failed allocation.
+            fontDescriptor->spans = (InterfaceFontSpan*)internal_malloc_safe(sizeof(InterfaceFontSpan) * (spanCount + 1), __FILE__, __LINE__);
+            if (fontDescriptor->spans == nullptr) {
+                return -1;
+            }
+        }
+    }
+
     return 0;
 }
 
@@ -404,19 +491,18 @@ static void interfaceFontDrawImpl(unsigned char* buf, const char* string, int le
         }
 
         InterfaceFontGlyph* glyph = &(gCurrentInterfaceFontDescriptor->glyphs[ch]);
-        unsigned char* glyphDataPtr = gCurrentInterfaceFontDescriptor->data + glyph->offset;
 
         // Skip blank pixels (difference between font's line height and glyph height).
         ptr += (gCurrentInterfaceFontDescriptor->maxHeight - glyph->height) * pitch;
 
-        for (int y = 0; y < glyph->height; y++) {
-            for (int x = 0; x < glyph->width; x++) {
-                unsigned char byte = *glyphDataPtr++;
-
-                *ptr++ = palette[(byte << 8) + *ptr];
+        InterfaceFontSpan* span = gCurrentInterfaceFontDescriptor->spans + gCurrentInterfaceFontDescriptor->spanOffsets[ch];
+        InterfaceFontSpan* spanEnd = gCurrentInterfaceFontDescriptor->spans + gCurrentInterfaceFontDescriptor->spanOffsets[ch + 1];
+        for (; span < spanEnd; span++) {
+            unsigned char* dest = ptr + pitch * span->y + span->x;
+            unsigned char* src = gCurrentInterfaceFontDescriptor->data + span->dataOffset;
+            for (int x = 0; x < span->length; x++) {
+                dest[x] = palette[(src[x] << 8) + dest[x]];
             }
-
-            ptr += pitch - glyph->width;
         }
 
         ptr = end;
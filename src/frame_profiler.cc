@@ -0,0 +1,322 @@
+#include "frame_profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "debug.h"
+#include "platform_compat.h"
+#include "settings.h"
+
+namespace fallout {
+
+// The maximum number of zones recorded per frame, extra zones are still
+// timed but not written to trace.
+#define FRAME_PROFILER_EVENTS_CAPACITY (128)
+
+// The maximum nesting of zones.
+#define FRAME_PROFILER_DEPTH_MAX (16)
+
+typedef std::chrono::steady_clock FrameProfilerClock;
+
+// Zone recorded for trace.
+typedef struct FrameProfilerEvent {
+    int zone;
+    int depth;
+
+    // Relative to profiler start, in microseconds.
+    unsigned long long start;
+    unsigned int duration;
+} FrameProfilerEvent;
+
+typedef struct FrameProfilerFrame {
+    // Relative to profiler start, in microseconds.
+    unsigned long long start;
+
+    FrameProfilerFrameTimes times;
+    FrameProfilerEvent events[FRAME_PROFILER_EVENTS_CAPACITY];
+    int eventsLength;
+} FrameProfilerFrame;
+
+// Zone which has been started and not yet ended.
+typedef struct FrameProfilerOpenZone {
+    // -1 when there is no room for zone name, such zone is not recorded.
+    int zone;
+    unsigned long long start;
+
+    // Time of nested zones, excluded from time of this zone.
+    unsigned long long childTime;
+} FrameProfilerOpenZone;
+
+static unsigned long long frameProfilerGetTime();
+static int frameProfilerFindZone(const char* name);
+static void frameProfilerCloseZone(FrameProfilerOpenZone* openZone, int depth, unsigned long long now);
+
+static bool gFrameProfilerEnabled = false;
+
+// Thread zones are recorded on, see [frameProfilerInit].
+static std::thread::id gFrameProfilerThread;
+
+static FrameProfilerClock::time_point gFrameProfilerStartTime;
+
+static const char* gFrameProfilerZoneNames[FRAME_PROFILER_ZONES_MAX];
+static int gFrameProfilerZoneNamesLength = 0;
+
+// Ring buffer of recent frames, the one at [gFrameProfilerFrameIndex] is
+// being recorded.
+static std::vector<FrameProfilerFrame> gFrameProfilerFrames;
+static int gFrameProfilerFrameIndex = 0;
+
+// Number of complete frames in [gFrameProfilerFrames].
+static int gFrameProfilerFramesLength = 0;
+
+static FrameProfilerOpenZone gFrameProfilerOpenZones[FRAME_PROFILER_DEPTH_MAX];
+static int gFrameProfilerDepth = 0;
+
+// Zones started beyond [FRAME_PROFILER_DEPTH_MAX], ignored.
+static int gFrameProfilerExtraDepth = 0;
+
+void frameProfilerInit()
+{
+    if (!settings.debug.show_frame_profiler && settings.debug.frame_profile_path.empty()) {
+        return;
+    }
+
+    frameProfilerStart();
+}
+
+void frameProfilerStart()
+{
+    gFrameProfilerThread = std::this_thread::get_id();
+    gFrameProfilerStartTime = FrameProfilerClock::now();
+    gFrameProfilerZoneNamesLength = 0;
+    gFrameProfilerFrames.assign(FRAME_PROFILER_FRAMES_CAPACITY, FrameProfilerFrame());
+    gFrameProfilerFrameIndex = 0;
+    gFrameProfilerFramesLength = 0;
+    gFrameProfilerDepth = 0;
+    gFrameProfilerExtraDepth = 0;
+
+    FrameProfilerFrame* frame = &(gFrameProfilerFrames[0]);
+    memset(&(frame->times), 0, sizeof(frame->times));
+    frame->start = 0;
+    frame->eventsLength = 0;
+
+    gFrameProfilerEnabled = true;
+}
+
+void frameProfilerExit()
+{
+    if (!gFrameProfilerEnabled) {
+        return;
+    }
+
+    frameProfilerExportTraceToDefaultPath();
+
+    gFrameProfilerEnabled = false;
+    gFrameProfilerFrames.clear();
+    gFrameProfilerFrames.shrink_to_fit();
+}
+
+bool frameProfilerIsEnabled()
+{
+    return gFrameProfilerEnabled;
+}
+
+void frameProfilerBeginZone(const char* name)
+{
+    if (!gFrameProfilerEnabled || std::this_thread::get_id() != gFrameProfilerThread) {
+        return;
+    }
+
+    if (gFrameProfilerDepth == FRAME_PROFILER_DEPTH_MAX) {
+        gFrameProfilerExtraDepth++;
+        return;
+    }
+
+    FrameProfilerOpenZone* openZone = &(gFrameProfilerOpenZones[gFrameProfilerDepth++]);
+    openZone->zone = frameProfilerFindZone(name);
+    openZone->childTime = 0;
+    openZone->start = frameProfilerGetTime();
+}
+
+void frameProfilerEndZone()
+{
+    if (!gFrameProfilerEnabled || std::this_thread::get_id() != gFrameProfilerThread) {
+        return;
+    }
+
+    if (gFrameProfilerExtraDepth != 0) {
+        gFrameProfilerExtraDepth--;
+        return;
+    }
+
+    if (gFrameProfilerDepth == 0) {
+        return;
+    }
+
+    gFrameProfilerDepth--;
+    frameProfilerCloseZone(&(gFrameProfilerOpenZones[gFrameProfilerDepth]), gFrameProfilerDepth, frameProfilerGetTime());
+}
+
+void frameProfilerEndFrame()
+{
+    if (!gFrameProfilerEnabled || std::this_thread::get_id() != gFrameProfilerThread) {
+        return;
+    }
+
+    unsigned long long now = frameProfilerGetTime();
+
+    // Frames can end inside of zones (for instance animations presented
+    // during combat AI turn). Such zones are split - part up to now goes to
+    // the ending frame, the rest to the next one.
+    for (int depth = gFrameProfilerDepth - 1; depth >= 0; depth--) {
+        frameProfilerCloseZone(&(gFrameProfilerOpenZones[depth]), depth, now);
+    }
+
+    FrameProfilerFrame* frame = &(gFrameProfilerFrames[gFrameProfilerFrameIndex]);
+    frame->times.total = static_cast<unsigned int>(now - frame->start);
+
+    gFrameProfilerFrameIndex = (gFrameProfilerFrameIndex + 1) % FRAME_PROFILER_FRAMES_CAPACITY;
+    gFrameProfilerFramesLength = std::min(gFrameProfilerFramesLength + 1, FRAME_PROFILER_FRAMES_CAPACITY - 1);
+
+    frame = &(gFrameProfilerFrames[gFrameProfilerFrameIndex]);
+    memset(&(frame->times), 0, sizeof(frame->times));
+    frame->start = now;
+    frame->eventsLength = 0;
+
+    for (int depth = 0; depth < gFrameProfilerDepth; depth++) {
+        gFrameProfilerOpenZones[depth].start = now;
+        gFrameProfilerOpenZones[depth].childTime = 0;
+    }
+}
+
+int frameProfilerGetZonesLength()
+{
+    return gFrameProfilerZoneNamesLength;
+}
+
+const char* frameProfilerGetZoneName(int zone)
+{
+    if (zone < 0 || zone >= gFrameProfilerZoneNamesLength) {
+        return nullptr;
+    }
+
+    return gFrameProfilerZoneNames[zone];
+}
+
+int frameProfilerGetRecentFrames(FrameProfilerFrameTimes* frames, int capacity)
+{
+    if (!gFrameProfilerEnabled) {
+        return 0;
+    }
+
+    int length = std::min(capacity, gFrameProfilerFramesLength);
+    for (int index = 0; index < length; index++) {
+        int frameIndex = (gFrameProfilerFrameIndex - length + index + FRAME_PROFILER_FRAMES_CAPACITY) % FRAME_PROFILER_FRAMES_CAPACITY;
+        frames[index] = gFrameProfilerFrames[frameIndex].times;
+    }
+
+    return length;
+}
+
+bool frameProfilerExportTrace(const char* path)
+{
+    if (!gFrameProfilerEnabled) {
+        return false;
+    }
+
+    FILE* stream = compat_fopen(path, "wt");
+    if (stream == nullptr) {
+        debugPrint("frameProfilerExportTrace: unable to open %s\n", path);
+        return false;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", stream);
+    fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"main\"}}", stream);
+
+    for (int index = 0; index < gFrameProfilerFramesLength; index++) {
+        int frameIndex = (gFrameProfilerFrameIndex - gFrameProfilerFramesLength + index + FRAME_PROFILER_FRAMES_CAPACITY) % FRAME_PROFILER_FRAMES_CAPACITY;
+        const FrameProfilerFrame* frame = &(gFrameProfilerFrames[frameIndex]);
+
+        fprintf(stream, ",\n{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%llu,\"dur\":%u}",
+            frame->start,
+            frame->times.total);
+
+        for (int eventIndex = 0; eventIndex < frame->eventsLength; eventIndex++) {
+            const FrameProfilerEvent* event = &(frame->events[eventIndex]);
+            fprintf(stream, ",\n{\"name\":\"%s\",\"cat\":\"zone\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%llu,\"dur\":%u,\"args\":{\"depth\":%d}}",
+                gFrameProfilerZoneNames[event->zone],
+                event->start,
+                event->duration,
+                event->depth);
+        }
+    }
+
+    fputs("\n]}\n", stream);
+    fclose(stream);
+
+    debugPrint("frameProfilerExportTrace: %d frames written to %s\n", gFrameProfilerFramesLength, path);
+
+    return true;
+}
+
+void frameProfilerExportTraceToDefaultPath()
+{
+    if (settings.debug.frame_profile_path.empty()) {
+        return;
+    }
+
+    frameProfilerExportTrace(settings.debug.frame_profile_path.c_str());
+}
+
+static unsigned long long frameProfilerGetTime()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(FrameProfilerClock::now() - gFrameProfilerStartTime).count();
+}
+
+static int frameProfilerFindZone(const char* name)
+{
+    for (int zone = 0; zone < gFrameProfilerZoneNamesLength; zone++) {
+        if (gFrameProfilerZoneNames[zone] == name || strcmp(gFrameProfilerZoneNames[zone], name) == 0) {
+            return zone;
+        }
+    }
+
+    if (gFrameProfilerZoneNamesLength == FRAME_PROFILER_ZONES_MAX) {
+        return -1;
+    }
+
+    gFrameProfilerZoneNames[gFrameProfilerZoneNamesLength] = name;
+    return gFrameProfilerZoneNamesLength++;
+}
+
+// Accounts time of [openZone] up to [now] to the current frame.
+static void frameProfilerCloseZone(FrameProfilerOpenZone* openZone, int depth, unsigned long long now)
+{
+    unsigned long long duration = now - openZone->start;
+
+    if (depth > 0) {
+        gFrameProfilerOpenZones[depth - 1].childTime += duration;
+    }
+
+    if (openZone->zone == -1) {
+        return;
+    }
+
+    FrameProfilerFrame* frame = &(gFrameProfilerFrames[gFrameProfilerFrameIndex]);
+    frame->times.zones[openZone->zone] += static_cast<unsigned int>(duration - std::min(duration, openZone->childTime));
+
+    if (frame->eventsLength < FRAME_PROFILER_EVENTS_CAPACITY) {
+        FrameProfilerEvent* event = &(frame->events[frame->eventsLength++]);
+        event->zone = openZone->zone;
+        event->depth = depth;
+        event->start = openZone->start;
+        event->duration = static_cast<unsigned int>(duration);
+    }
+}
+
+} // namespace fallout
@@ -0,0 +1,77 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+namespace fallout {
+
+// The maximum number of distinct zone names.
+#define FRAME_PROFILER_ZONES_MAX (16)
+
+// The number of recent frames kept by profiler.
+#define FRAME_PROFILER_FRAMES_CAPACITY (256)
+
+// Time spent in every zone during one frame, in microseconds. Zone time
+// excludes time of zones nested in it, so zone times of a frame add up to at
+// most [total].
+typedef struct FrameProfilerFrameTimes {
+    unsigned int total;
+    unsigned int zones[FRAME_PROFILER_ZONES_MAX];
+} FrameProfilerFrameTimes;
+
+// Enables profiler when frame profiler overlay or trace path is configured.
+// Zones are recorded on the calling thread only.
+void frameProfilerInit();
+
+// Enables profiler regardless of settings, discards everything recorded so
+// far.
+void frameProfilerStart();
+
+void frameProfilerExit();
+
+bool frameProfilerIsEnabled();
+
+// Starts zone [name]. [name] must be a string literal (or otherwise outlive
+// profiler), zones are told apart by its contents.
+void frameProfilerBeginZone(const char* name);
+
+// Ends the most recently started zone.
+void frameProfilerEndZone();
+
+// Ends current frame and starts the next one.
+void frameProfilerEndFrame();
+
+// Returns number of zone names seen so far, zone index is a position in
+// [FrameProfilerFrameTimes.zones].
+int frameProfilerGetZonesLength();
+const char* frameProfilerGetZoneName(int zone);
+
+// Copies times of up to [capacity] most recent complete frames into
+// [frames], oldest first. Returns number of copied frames.
+int frameProfilerGetRecentFrames(FrameProfilerFrameTimes* frames, int capacity);
+
+// Writes recent frames with their zones to [path] in Chrome trace event
+// format (chrome://tracing, Perfetto).
+bool frameProfilerExportTrace(const char* path);
+
+// Writes trace to configured `frame_profile_path`.
+void frameProfilerExportTraceToDefaultPath();
+
+// Records zone during the lifetime of the object.
+class FrameProfilerZone {
+public:
+    explicit FrameProfilerZone(const char* name)
+    {
+        frameProfilerBeginZone(name);
+    }
+
+    ~FrameProfilerZone()
+    {
+        frameProfilerEndZone();
+    }
+
+    FrameProfilerZone(const FrameProfilerZone&) = delete;
+    FrameProfilerZone& operator=(const FrameProfilerZone&) = delete;
+};
+
+} // namespace fallout
+
+#endif /* FRAME_PROFILER_H */
@@ -23,6 +23,7 @@
 #include "draw.h"
 #include "endgame.h"
 #include "font_manager.h"
+#include "frame_profiler.h"
 #include "game_dialog.h"
 #include "game_memory.h"
 #include "game_mouse.h"
@@ -36,6 +37,7 @@
 #include "loadsave.h"
 #include "map.h"
 #include "memory.h"
+#include "memory_profiler.h"
 #include "mouse.h"
 #include "movie.h"
 #include "movie_effect.h"
@@ -108,7 +110,7 @@ static bool gGameUiDisabled = false;
 static int gGameState = GAME_STATE_0;
 
 // 0x5186BC game_in_mapper
-static bool gIsMapper = false;
+bool gIsMapper = false;
 
 // 0x5186C0 game_global_vars
 int* gGameGlobalVars = nullptr;
@@ -152,6 +154,12 @@ int gameInitWithOptions(const char* windowTitle, bool isMapper, int font, int fl
 
     debugModeInit(settings.debug.mode.c_str());
 
+    if (!settings.debug.memory_profile_path.empty()) {
+        memoryProfilerStart(settings.debug.memory_profile_path.c_str());
+    }
+
+    frameProfilerInit();
+
     gIsMapper = isMapper;
 
     if (gameDbInit() == -1) {
@@ -532,6 +540,9 @@ void gameExit()
     settingsExit(true);
     contentConfigExit();
     sfallConfigExit();
+
+    frameProfilerExit();
+    memoryProfilerStop();
 }
 
 // 0x442D44
@@ -1427,6 +1438,8 @@ static int gameDbInit()
         critter_patches_path = nullptr;
     }
 
+    dbSetMemoryMapped(settings.system.mmap_dat);
+
     // Load archives in reverse priority order (dbOpen prepends to chain).
     // Resulting chain (head = highest priority):
     //   master_patches > critter_patches > mods > patchXXX.dat > ce.dat > f2_res_dat > critter.dat > master.dat
@@ -32,6 +32,7 @@ extern GameQuitRequest _game_user_wants_to_quit;
 extern MessageList gMiscMessageList;
 
 extern bool gGameLoaded;
+extern bool gIsMapper;
 
 int gameInitWithOptions(const char* windowTitle, bool isMapper, int font, int flags, int argc, char** argv);
 void gameReset();
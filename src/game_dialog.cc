@@ -3307,6 +3307,13 @@ static int gameDialogDrawText(unsigned char* buffer, Rect* rect, const char* str
             }
 
             if (*end != '\0') {
+                // Width of the line up to [end]. String width is a sum of
+                // character widths, so it grows word by word instead of
+                // measuring the whole line again for every word.
+                *end = '\0';
+                int width = fontGetStringWidth(start);
+                *end = ' ';
+
                 char* lookahead = end + 1;
                 while (lookahead != nullptr) {
                     while (*lookahead != '\0' && *lookahead != ' ') {
@@ -3317,10 +3324,12 @@ static int gameDialogDrawText(unsigned char* buffer, Rect* rect, const char* str
                         lookahead = nullptr;
                     } else {
                         *lookahead = '\0';
-                        if (fontGetStringWidth(start) >= maxWidth) {
+                        int lookaheadWidth = width + fontGetStringWidth(end);
+                        if (lookaheadWidth >= maxWidth) {
                             *lookahead = ' ';
                             lookahead = nullptr;
                         } else {
+                            width = lookaheadWidth;
                             end = lookahead;
                             *lookahead = ' ';
                             lookahead++;
@@ -12,27 +12,31 @@ namespace fallout {
 #define HEAP_BLOCK_HEADER_GUARD (0xDEADC0DE)
 #define HEAP_BLOCK_FOOTER_GUARD (0xACDCACDC)
 
-#define HEAP_BLOCK_HEADER_SIZE (sizeof(HeapBlockHeader))
+// Alignment of block data. Block data follows block header, so header size
+// is rounded up to this value (on 32-bit targets the header itself is only
+// 20 bytes). Slabs and system blocks come from [internal_malloc] which is at
+// least as aligned.
+#define HEAP_BLOCK_ALIGNMENT (8)
+
+#define HEAP_BLOCK_HEADER_SIZE ((sizeof(HeapBlockHeader) + HEAP_BLOCK_ALIGNMENT - 1) & ~(HEAP_BLOCK_ALIGNMENT - 1))
 #define HEAP_BLOCK_FOOTER_SIZE (sizeof(HeapBlockFooter))
 #define HEAP_BLOCK_OVERHEAD_SIZE (HEAP_BLOCK_HEADER_SIZE + HEAP_BLOCK_FOOTER_SIZE)
 
 // The initial length of [handles] array within [Heap].
 #define HEAP_HANDLES_INITIAL_LENGTH (64)
 
-// The initial length of [gHeapFreeBlocks] array.
-#define HEAP_FREE_BLOCKS_INITIAL_LENGTH (128)
-
-// The initial length of [gHeapMoveableExtents] array.
-#define HEAP_MOVEABLE_EXTENTS_INITIAL_LENGTH (64)
-
-// The initial length of [gHeapMoveableBlocks] array.
-#define HEAP_MOVEABLE_BLOCKS_INITIAL_LENGTH (64)
+// The maximum and minimum size of a single slab (excluding slab header). The
+// actual size is scaled with heap budget, so that small heaps do not waste
+// memory on mostly empty slabs.
+#define HEAP_SLAB_MAX_SIZE (64 * 1024)
+#define HEAP_SLAB_MIN_SIZE (4 * 1024)
 
-// The initial length of [gHeapReservedFreeBlockIndexes] array.
-#define HEAP_RESERVED_FREE_BLOCK_INDEXES_INITIAL_LENGTH (64)
+// Granularity of size classes. Every size class is a multiple of this value.
+#define HEAP_SIZE_CLASS_GRANULARITY (64)
 
-// The minimum size of block for splitting.
-#define HEAP_BLOCK_MIN_SIZE (128 + HEAP_BLOCK_OVERHEAD_SIZE)
+// The maximum size of block served from slabs. Larger blocks are allocated
+// directly from the system.
+#define HEAP_SLAB_MAX_BLOCK_SIZE (8192)
 
 #define HEAP_HANDLE_STATE_INVALID (-1)
 
@@ -49,84 +53,88 @@ typedef struct HeapBlockHeader {
     int size;
     unsigned int state;
     int handle_index;
+
+    // Slab this block belongs to, or NULL for large and system blocks.
+    struct HeapSlab* slab;
 } HeapBlockHeader;
 
 typedef struct HeapBlockFooter {
     int guard;
 } HeapBlockFooter;
 
-typedef struct HeapMoveableExtent {
-    // Pointer to the first block in the extent.
-    unsigned char* data;
+typedef struct HeapSlab {
+    // Neighbours in [Heap.partialSlabs] list (only valid when slab has unused
+    // blocks).
+    struct HeapSlab* prev;
+    struct HeapSlab* next;
+
+    int sizeClass;
 
-    // Total number of free or moveable blocks in the extent.
+    // Total number of blocks and number of blocks in use.
     int blocksLength;
+    int usedBlocksLength;
 
-    // Number of moveable blocks in the extent.
-    int moveableBlocksLength;
+    // Head of unused blocks list. The link to the next unused block is stored
+    // in block data.
+    unsigned char* freeBlocks;
 
-    // Total data size of blocks in the extent. This value does not include
-    // the size of blocks overhead.
+    // Total size of slab allocation, including this header.
     int size;
-} HeapMoveableExtent;
+} HeapSlab;
 
 static bool heapInternalsInit();
 static void heapInternalsFree();
 static bool heapHandleListInit(Heap* heap);
 static bool heapPrintStats(Heap* heap, char* dest, size_t size);
 static bool heapFindFreeHandle(Heap* heap, int* handleIndexPtr);
-static bool heapFindFreeBlock(Heap* heap, int size, void** blockPtr, int disallowSystemAllocation);
-static int heapBlockCompareBySize(const void* leftPtr, const void* rightPtr);
-static int heapMoveableExtentsCompareBySize(const void* leftPtr, const void* rightPtr);
-static bool heapBuildMoveableExtentsList(Heap* heap, int* moveableExtentsLengthPtr, int* maxBlocksLengthPtr);
-static bool heapBuildFreeBlocksList(Heap* heap);
-static bool heapBuildMoveableBlocksList(int extentIndex);
-
-// An array of pointers to free heap blocks.
-//
-// 0x518E9C heap_free_list
-static unsigned char** gHeapFreeBlocks = nullptr;
-
-// An array of moveable extents in heap.
-//
-// 0x518EA0 heap_moveable_list
-static HeapMoveableExtent* gHeapMoveableExtents = nullptr;
-
-// An array of pointers to moveable heap blocks.
-//
-// 0x518EA4 heap_subblock_list
-static unsigned char** gHeapMoveableBlocks = nullptr;
-
-// An array of indexes into [gHeapFreeBlocks] array to track which free blocks
-// were already reserved for subsequent moving.
-//
-// 0x518EA8 heap_fake_move_list
-static int* gHeapReservedFreeBlockIndexes = nullptr;
-
-// The length of the [gHeapFreeBlocks] array.
-//
-// 0x518EAC heap_free_list_size
-static int gHeapFreeBlocksLength = 0;
-
-// The length of [gHeapMoveableExtents] array.
-//
-// 0x518EB0 heap_moveable_list_size
-static int gHeapMoveableExtentsLength = 0;
-
-// The length of [gHeapMoveableBlocks] array.
-//
-// 0x518EB4 heap_subblock_list_size
-static int gHeapMoveableBlocksLength = 0;
-
-// The length of [gHeapReservedFreeBlockIndexes] array.
-//
-// 0x518EB8 heap_fake_move_list_size
-static int gHeapReservedFreeBlockIndexesLength = 0;
+static void heapReleaseHandle(Heap* heap, int handleIndex);
+static int heapGetSizeClass(int size);
+static int heapGetBlockStride(int sizeClass);
+static unsigned char* heapSlabAllocateBlock(Heap* heap, int sizeClass, int disallowSystemAllocation);
+static HeapSlab* heapSlabCreate(Heap* heap, int sizeClass);
+static void heapSlabDeallocateBlock(Heap* heap, unsigned char* block);
+static void heapSlabListAdd(Heap* heap, HeapSlab* slab);
+static void heapSlabListRemove(Heap* heap, HeapSlab* slab);
+static unsigned char* heapSystemAllocateBlock(Heap* heap, int size, unsigned int state);
+static bool heapValidateBlock(unsigned char* block);
+
+// Data size of every size class.
+static const int gHeapSizeClasses[] = {
+    64,
+    128,
+    192,
+    256,
+    320,
+    384,
+    448,
+    512,
+    640,
+    768,
+    896,
+    1024,
+    1280,
+    1536,
+    1792,
+    2048,
+    2560,
+    3072,
+    3584,
+    4096,
+    5120,
+    6144,
+    7168,
+    8192,
+};
+
+#define HEAP_SIZE_CLASSES_LENGTH (sizeof(gHeapSizeClasses) / sizeof(gHeapSizeClasses[0]))
+
+// Maps block size (in [HEAP_SIZE_CLASS_GRANULARITY] units) to the smallest
+// size class which can hold it.
+static unsigned char gHeapSizeClassIndexes[HEAP_SLAB_MAX_BLOCK_SIZE / HEAP_SIZE_CLASS_GRANULARITY];
 
 // The number of heaps.
 //
-// This value is used to init/free internal temporary buffers
-// needed for any heap.
+// This value is used to init/free internal lookup tables needed for any heap.
 //
 // 0x518EBC heap_count
 static int gHeapsCount = 0;
@@ -134,70 +142,21 @@ static int gHeapsCount = 0;
 // 0x453304 heap_create_lists
 static bool heapInternalsInit()
 {
-    // NOTE: Original code is slightly different. It uses deep nesting or a
-    // bunch of goto's to free alloc'ed buffers one by one starting from where
-    // it has failed.
-    do {
-        gHeapFreeBlocks = (unsigned char**)internal_malloc(sizeof(*gHeapFreeBlocks) * HEAP_FREE_BLOCKS_INITIAL_LENGTH);
-        if (gHeapFreeBlocks == nullptr) {
-            break;
-        }
-
-        gHeapFreeBlocksLength = HEAP_FREE_BLOCKS_INITIAL_LENGTH;
-
-        gHeapMoveableExtents = (HeapMoveableExtent*)internal_malloc(sizeof(*gHeapMoveableExtents) * HEAP_MOVEABLE_EXTENTS_INITIAL_LENGTH);
-        if (gHeapMoveableExtents == nullptr) {
-            break;
-        }
-        gHeapMoveableExtentsLength = HEAP_MOVEABLE_EXTENTS_INITIAL_LENGTH;
-
-        gHeapMoveableBlocks = (unsigned char**)internal_malloc(sizeof(*gHeapMoveableBlocks) * HEAP_MOVEABLE_BLOCKS_INITIAL_LENGTH);
-        if (gHeapMoveableBlocks == nullptr) {
-            break;
-        }
-        gHeapMoveableBlocksLength = HEAP_MOVEABLE_BLOCKS_INITIAL_LENGTH;
-
-        gHeapReservedFreeBlockIndexes = (int*)internal_malloc(sizeof(*gHeapReservedFreeBlockIndexes) * HEAP_RESERVED_FREE_BLOCK_INDEXES_INITIAL_LENGTH);
-        if (gHeapReservedFreeBlockIndexes == nullptr) {
-            break;
+    int sizeClass = 0;
+    for (int index = 0; index < HEAP_SLAB_MAX_BLOCK_SIZE / HEAP_SIZE_CLASS_GRANULARITY; index++) {
+        int size = (index + 1) * HEAP_SIZE_CLASS_GRANULARITY;
+        while (gHeapSizeClasses[sizeClass] < size) {
+            sizeClass++;
         }
-        gHeapReservedFreeBlockIndexesLength = HEAP_RESERVED_FREE_BLOCK_INDEXES_INITIAL_LENGTH;
-
-        return true;
-    } while (0);
-
-    // NOTE: Original code frees them one by one without calling this function.
-    heapInternalsFree();
+        gHeapSizeClassIndexes[index] = static_cast<unsigned char>(sizeClass);
+    }
 
-    return false;
+    return true;
 }
 
 // 0x4533A0 heap_destroy_lists
 static void heapInternalsFree()
 {
-    if (gHeapReservedFreeBlockIndexes != nullptr) {
-        internal_free(gHeapReservedFreeBlockIndexes);
-        gHeapReservedFreeBlockIndexes = nullptr;
-    }
-    gHeapReservedFreeBlockIndexesLength = 0;
-
-    if (gHeapMoveableBlocks != nullptr) {
-        internal_free(gHeapMoveableBlocks);
-        gHeapMoveableBlocks = nullptr;
-    }
-    gHeapMoveableBlocksLength = 0;
-
-    if (gHeapMoveableExtents != nullptr) {
-        internal_free(gHeapMoveableExtents);
-        gHeapMoveableExtents = nullptr;
-    }
-    gHeapMoveableExtentsLength = 0;
-
-    if (gHeapFreeBlocks != nullptr) {
-        internal_free(gHeapFreeBlocks);
-        gHeapFreeBlocks = nullptr;
-    }
-    gHeapFreeBlocksLength = 0;
 }
 
 // 0x452974 heap_init
@@ -214,28 +173,33 @@ bool heapInit(Heap* heap, int initialSize)
     }
 
     memset(heap, 0, sizeof(*heap));
+    heap->freeHandleIndex = -1;
 
     if (heapHandleListInit(heap)) {
-        int size = (initialSize >> 10) + initialSize;
-        heap->data = (unsigned char*)internal_malloc(size);
-        if (heap->data != nullptr) {
-            heap->size = size;
-            heap->freeBlocks = 1;
-            heap->freeSize = heap->size - HEAP_BLOCK_OVERHEAD_SIZE;
-
-            HeapBlockHeader* blockHeader = (HeapBlockHeader*)heap->data;
-            blockHeader->guard = HEAP_BLOCK_HEADER_GUARD;
-            blockHeader->size = heap->freeSize;
-            blockHeader->state = 0;
-            blockHeader->handle_index = -1;
-
-            HeapBlockFooter* blockFooter = (HeapBlockFooter*)(heap->data + blockHeader->size + HEAP_BLOCK_HEADER_SIZE);
-            blockFooter->guard = HEAP_BLOCK_FOOTER_GUARD;
+        heap->partialSlabs = (HeapSlab**)internal_malloc(sizeof(*heap->partialSlabs) * HEAP_SIZE_CLASSES_LENGTH);
+        if (heap->partialSlabs != nullptr) {
+            memset(heap->partialSlabs, 0, sizeof(*heap->partialSlabs) * HEAP_SIZE_CLASSES_LENGTH);
+
+            heap->slabSize = initialSize / 64;
+            if (heap->slabSize > HEAP_SLAB_MAX_SIZE) {
+                heap->slabSize = HEAP_SLAB_MAX_SIZE;
+            } else if (heap->slabSize < HEAP_SLAB_MIN_SIZE) {
+                heap->slabSize = HEAP_SLAB_MIN_SIZE;
+            }
+
+            // Leave room for blocks overhead, size class rounding and
+            // partially used slabs. Owners (i.e. cache) enforce their own
+            // limit on the amount of data, heap budget only keeps the slack
+            // bounded.
+            heap->size = initialSize + initialSize / 4 + HEAP_SIZE_CLASSES_LENGTH * heap->slabSize;
 
             gHeapsCount++;
 
             return true;
         }
+
+        internal_free(heap->handles);
+        heap->handles = nullptr;
     }
 
     if (gHeapsCount == 0) {
@@ -252,10 +216,17 @@ bool heapFree(Heap* heap)
         return false;
     }
 
+    // Release blocks which were not deallocated by the owner. Once slab
+    // loses its last block it's released as well.
     for (int index = 0; index < heap->handlesLength; index++) {
         HeapHandle* handle = &(heap->handles[index]);
-        if (handle->state == 4 && handle->data != nullptr) {
-            internal_free(handle->data);
+        if (handle->state != HEAP_HANDLE_STATE_INVALID && handle->data != nullptr) {
+            HeapBlockHeader* blockHeader = (HeapBlockHeader*)handle->data;
+            if (blockHeader->slab != nullptr) {
+                heapSlabDeallocateBlock(heap, handle->data);
+            } else {
+                internal_free(handle->data);
+            }
         }
     }
 
@@ -265,8 +236,8 @@ bool heapFree(Heap* heap)
         heap->handlesLength = 0;
     }
 
-    if (heap->data != nullptr) {
-        internal_free(heap->data);
+    if (heap->partialSlabs != nullptr) {
+        internal_free(heap->partialSlabs);
     }
 
     memset(heap, 0, sizeof(*heap));
@@ -288,10 +259,13 @@ static bool heapHandleListInit(Heap* heap)
         return false;
     }
 
-    for (int index = 0; index < HEAP_HANDLES_INITIAL_LENGTH; index++) {
+    // Chain handles in ascending order so that lower handles are used first.
+    for (int index = HEAP_HANDLES_INITIAL_LENGTH - 1; index >= 0; index--) {
         HeapHandle* handle = &(heap->handles[index]);
         handle->state = HEAP_HANDLE_STATE_INVALID;
         handle->data = nullptr;
+        handle->nextFreeHandleIndex = heap->freeHandleIndex;
+        heap->freeHandleIndex = index;
     }
 
     heap->handlesLength = HEAP_HANDLES_INITIAL_LENGTH;
@@ -302,115 +276,59 @@ static bool heapHandleListInit(Heap* heap)
 // 0x452AD0 heap_allocate
 bool heapBlockAllocate(Heap* heap, int* handleIndexPtr, int size, int disallowSystemAllocation)
 {
+    unsigned char* block;
     HeapBlockHeader* blockHeader;
-    int state;
-    int blockSize;
     HeapHandle* handle;
+    int handleIndex;
 
-    size += 4 - size % 4;
-
-    if (heap == nullptr || handleIndexPtr == nullptr || size == 0) {
+    if (heap == nullptr || handleIndexPtr == nullptr || size <= 0) {
         goto err;
     }
 
+    size = (size + HEAP_BLOCK_ALIGNMENT - 1) & ~(HEAP_BLOCK_ALIGNMENT - 1);
+
     if (disallowSystemAllocation != 0 && disallowSystemAllocation != 1) {
         disallowSystemAllocation = 0;
     }
 
-    void* block;
-    if (!heapFindFreeBlock(heap, size, &block, disallowSystemAllocation)) {
+    if (!heapFindFreeHandle(heap, &handleIndex)) {
+        debugPrint("Heap Error: Could not acquire handle for new block.\n");
         goto err;
     }
 
-    blockHeader = (HeapBlockHeader*)block;
-    state = blockHeader->state;
-
-    int handleIndex;
-    if (!heapFindFreeHandle(heap, &handleIndex)) {
-        goto err_no_handle;
+    if (size <= HEAP_SLAB_MAX_BLOCK_SIZE) {
+        block = heapSlabAllocateBlock(heap, heapGetSizeClass(size), disallowSystemAllocation);
+    } else if (heap->reservedSize + size + (int)HEAP_BLOCK_OVERHEAD_SIZE <= heap->size) {
+        block = heapSystemAllocateBlock(heap, size, HEAP_BLOCK_STATE_MOVABLE);
+    } else if (!disallowSystemAllocation) {
+        block = heapSystemAllocateBlock(heap, size, HEAP_BLOCK_STATE_SYSTEM);
+    } else {
+        block = nullptr;
     }
 
-    blockSize = blockHeader->size;
-    handle = &(heap->handles[handleIndex]);
-
-    if (state == HEAP_BLOCK_STATE_SYSTEM) {
-        // Bind block to handle.
-        blockHeader->handle_index = handleIndex;
-
-        // Bind handle to block and mark it as system
-        handle->state = HEAP_BLOCK_STATE_SYSTEM;
-        handle->data = (unsigned char*)block;
-
-        // Update heap stats
-        heap->systemBlocks++;
-        heap->systemSize += size;
-
-        *handleIndexPtr = handleIndex;
-
-        return true;
+    if (block == nullptr) {
+        heapReleaseHandle(heap, handleIndex);
+        goto err;
     }
 
-    if (state == HEAP_BLOCK_STATE_FREE) {
-        int remainingSize = blockSize - size;
-        if (remainingSize > HEAP_BLOCK_MIN_SIZE) {
-            // The block we've just found is big enough for splitting, first
-            // resize it to take just what was requested.
-            blockHeader->size = size;
-            blockSize = size;
-
-            //
-            HeapBlockFooter* blockFooter = (HeapBlockFooter*)((unsigned char*)block + blockHeader->size + HEAP_BLOCK_HEADER_SIZE);
-            blockFooter->guard = HEAP_BLOCK_FOOTER_GUARD;
-
-            // Obtain beginning of the next block.
-            unsigned char* nextBlock = (unsigned char*)block + blockHeader->size + HEAP_BLOCK_OVERHEAD_SIZE;
-
-            // Setup next block's header...
-            HeapBlockHeader* nextBlockHeader = (HeapBlockHeader*)nextBlock;
-            nextBlockHeader->guard = HEAP_BLOCK_HEADER_GUARD;
-            nextBlockHeader->size = remainingSize - HEAP_BLOCK_OVERHEAD_SIZE;
-            nextBlockHeader->state = HEAP_BLOCK_STATE_FREE;
-            nextBlockHeader->handle_index = -1;
-
-            // ... and footer.
-            HeapBlockFooter* nextBlockFooter = (HeapBlockFooter*)(nextBlock + nextBlockHeader->size + HEAP_BLOCK_HEADER_SIZE);
-            nextBlockFooter->guard = HEAP_BLOCK_FOOTER_GUARD;
-
-            // Update heap stats
-            heap->freeBlocks++;
-            heap->freeSize -= HEAP_BLOCK_OVERHEAD_SIZE;
-        }
-
-        // Bind block to handle and mark it as moveable
-        blockHeader->state = HEAP_BLOCK_STATE_MOVABLE;
-        blockHeader->handle_index = handleIndex;
+    blockHeader = (HeapBlockHeader*)block;
+    blockHeader->handle_index = handleIndex;
 
-        // Bind handle to block and mark it as moveable
-        handle->state = HEAP_BLOCK_STATE_MOVABLE;
-        handle->data = (unsigned char*)block;
+    handle = &(heap->handles[handleIndex]);
+    handle->state = blockHeader->state;
+    handle->data = block;
 
-        // Update heap stats
-        heap->freeBlocks--;
+    if (blockHeader->state == HEAP_BLOCK_STATE_SYSTEM) {
+        heap->systemBlocks++;
+        heap->systemSize += blockHeader->size;
+    } else {
         heap->moveableBlocks++;
-        heap->freeSize -= blockSize;
-        heap->moveableSize += blockSize;
-
-        *handleIndexPtr = handleIndex;
-
-        return true;
+        heap->moveableSize += blockHeader->size;
     }
 
-    handle->state = HEAP_HANDLE_STATE_INVALID;
-    handle->data = nullptr;
+    *handleIndexPtr = handleIndex;
 
-    debugPrint("Heap Error: Unknown block state during allocation.\n");
-
-err_no_handle:
-
-    debugPrint("Heap Error: Could not acquire handle for new block.\n");
-    if (state == HEAP_BLOCK_STATE_SYSTEM) {
-        internal_free(block);
-    }
+    return true;
 
 err:
 
@@ -432,12 +350,12 @@ bool heapBlockDeallocate(Heap* heap, int* handleIndexPtr)
     HeapHandle* handle = &(heap->handles[handleIndex]);
 
     HeapBlockHeader* blockHeader = (HeapBlockHeader*)handle->data;
-    if (blockHeader->guard != HEAP_BLOCK_HEADER_GUARD) {
+    if (blockHeader->guard != (int)HEAP_BLOCK_HEADER_GUARD) {
         debugPrint("Heap Error: Bad guard begin detected during deallocate.\n");
     }
 
     HeapBlockFooter* blockFooter = (HeapBlockFooter*)(handle->data + blockHeader->size + HEAP_BLOCK_HEADER_SIZE);
-    if (blockFooter->guard != HEAP_BLOCK_FOOTER_GUARD) {
+    if (blockFooter->guard != (int)HEAP_BLOCK_FOOTER_GUARD) {
         debugPrint("Heap Error: Bad guard end detected during deallocate.\n");
     }
 
@@ -453,20 +371,17 @@ bool heapBlockDeallocate(Heap* heap, int* handleIndexPtr)
     int size = blockHeader->size;
 
     if (handle->state == HEAP_BLOCK_STATE_MOVABLE) {
-        // Unbind block from handle and mark it as free.
-        blockHeader->handle_index = -1;
-        blockHeader->state = HEAP_BLOCK_STATE_FREE;
-
-        // Update heap stats
-        heap->freeBlocks++;
         heap->moveableBlocks--;
-
-        heap->freeSize += size;
         heap->moveableSize -= size;
 
-        // Reset handle
-        handle->state = HEAP_HANDLE_STATE_INVALID;
-        handle->data = nullptr;
+        if (blockHeader->slab != nullptr) {
+            heapSlabDeallocateBlock(heap, handle->data);
+        } else {
+            heap->reservedSize -= size + HEAP_BLOCK_OVERHEAD_SIZE;
+            internal_free(handle->data);
+        }
+
+        heapReleaseHandle(heap, handleIndex);
 
         return true;
     }
@@ -479,9 +394,7 @@ bool heapBlockDeallocate(Heap* heap, int* handleIndexPtr)
         heap->systemBlocks--;
         heap->systemSize -= size;
 
-        // Reset handle
-        handle->state = HEAP_HANDLE_STATE_INVALID;
-        handle->data = nullptr;
+        heapReleaseHandle(heap, handleIndex);
 
         return true;
     }
@@ -501,13 +414,13 @@ bool heapLock(Heap* heap, int handleIndex, unsigned char** bufferPtr)
     HeapHandle* handle = &(heap->handles[handleIndex]);
 
     HeapBlockHeader* blockHeader = (HeapBlockHeader*)handle->data;
-    if (blockHeader->guard != HEAP_BLOCK_HEADER_GUARD) {
+    if (blockHeader->guard != (int)HEAP_BLOCK_HEADER_GUARD) {
         debugPrint("Heap Error: Bad guard begin detected during lock.\n");
         return false;
     }
 
     HeapBlockFooter* blockFooter = (HeapBlockFooter*)(handle->data + blockHeader->size + HEAP_BLOCK_HEADER_SIZE);
-    if (blockFooter->guard != HEAP_BLOCK_FOOTER_GUARD) {
+    if (blockFooter->guard != (int)HEAP_BLOCK_FOOTER_GUARD) {
         debugPrint("Heap Error: Bad guard end detected during lock.\n");
         return false;
     }
@@ -562,12 +475,12 @@ bool heapUnlock(Heap* heap, int handleIndex)
     HeapHandle* handle = &(heap->handles[handleIndex]);
 
     HeapBlockHeader* blockHeader = (HeapBlockHeader*)handle->data;
-    if (blockHeader->guard != HEAP_BLOCK_HEADER_GUARD) {
+    if (blockHeader->guard != (int)HEAP_BLOCK_HEADER_GUARD) {
         debugPrint("Heap Error: Bad guard begin detected during unlock.\n");
     }
 
     HeapBlockFooter* blockFooter = (HeapBlockFooter*)(handle->data + blockHeader->size + HEAP_BLOCK_HEADER_SIZE);
-    if (blockFooter->guard != HEAP_BLOCK_FOOTER_GUARD) {
+    if (blockFooter->guard != (int)HEAP_BLOCK_FOOTER_GUARD) {
         debugPrint("Heap Error: Bad guard end detected during unlock.\n");
     }
 
@@ -616,6 +529,7 @@ static bool heapPrintStats(Heap* heap, char* dest, size_t size)
                          "Total locked size: %d\n"
                          "Total system blocks: %d\n"
                          "Total system size: %d\n"
+                         "Total reserved size: %d of %d\n"
                          "Total handles: %d\n"
                          "Total heaps: %d";
 
@@ -628,6 +542,8 @@ static bool heapPrintStats(Heap* heap, char* dest, size_t size)
         heap->lockedSize,
         heap->systemBlocks,
         heap->systemSize,
+        heap->reservedSize,
+        heap->size,
         heap->handlesLength,
         gHeapsCount);
 
@@ -637,500 +553,268 @@ static bool heapPrintStats(Heap* heap, char* dest, size_t size)
 // 0x4534B0 heap_acquire_handle
 static bool heapFindFreeHandle(Heap* heap, int* handleIndexPtr)
 {
-    // Loop thru already available handles and find first that is not currently
-    // used.
-    for (int index = 0; index < heap->handlesLength; index++) {
-        HeapHandle* handle = &(heap->handles[index]);
-        if (handle->state == HEAP_HANDLE_STATE_INVALID) {
-            *handleIndexPtr = index;
-            return true;
+    if (heap->freeHandleIndex == -1) {
+        // All handles are used, we have to allocate more handles.
+        HeapHandle* handles = (HeapHandle*)internal_realloc(heap->handles, sizeof(*handles) * (heap->handlesLength + HEAP_HANDLES_INITIAL_LENGTH));
+        if (handles == nullptr) {
+            return false;
         }
-    }
 
-    // If we're here the search above failed, we have to allocate more handles.
-    HeapHandle* handles = (HeapHandle*)internal_realloc(heap->handles, sizeof(*handles) * (heap->handlesLength + HEAP_HANDLES_INITIAL_LENGTH));
-    if (handles == nullptr) {
-        return false;
-    }
+        heap->handles = handles;
 
-    heap->handles = handles;
+        // Loop thru new handles and reset them to default state.
+        for (int index = heap->handlesLength + HEAP_HANDLES_INITIAL_LENGTH - 1; index >= heap->handlesLength; index--) {
+            HeapHandle* handle = &(heap->handles[index]);
+            handle->state = HEAP_HANDLE_STATE_INVALID;
+            handle->data = nullptr;
+            handle->nextFreeHandleIndex = heap->freeHandleIndex;
+            heap->freeHandleIndex = index;
+        }
 
-    // Loop thru new handles and reset them to default state.
-    for (int index = heap->handlesLength; index < heap->handlesLength + HEAP_HANDLES_INITIAL_LENGTH; index++) {
-        HeapHandle* handle = &(heap->handles[index]);
-        handle->state = HEAP_HANDLE_STATE_INVALID;
-        handle->data = nullptr;
+        heap->handlesLength += HEAP_HANDLES_INITIAL_LENGTH;
     }
 
-    *handleIndexPtr = heap->handlesLength;
+    int handleIndex = heap->freeHandleIndex;
+    heap->freeHandleIndex = heap->handles[handleIndex].nextFreeHandleIndex;
+    heap->handles[handleIndex].nextFreeHandleIndex = -1;
 
-    heap->handlesLength += HEAP_HANDLES_INITIAL_LENGTH;
+    *handleIndexPtr = handleIndex;
 
     return true;
 }
 
-// heap_find_free_block
-// 0x453588 heap_find_free_block
-static bool heapFindFreeBlock(Heap* heap, int size, void** blockPtr, int disallowSystemAllocation)
+// Resets handle and returns it to the unused handles list.
+static void heapReleaseHandle(Heap* heap, int handleIndex)
 {
-    unsigned char* biggestFreeBlock;
-    HeapBlockHeader* biggestFreeBlockHeader;
-    int biggestFreeBlockSize;
-    HeapMoveableExtent* extent;
-    int reservedFreeBlockIndex;
-    HeapBlockHeader* blockHeader;
-    HeapBlockFooter* blockFooter;
-
-    if (!heapBuildFreeBlocksList(heap)) {
-        goto system;
-    }
-
-    if (size > heap->freeSize) {
-        goto system;
-    }
+    HeapHandle* handle = &(heap->handles[handleIndex]);
+    handle->state = HEAP_HANDLE_STATE_INVALID;
+    handle->data = nullptr;
+    handle->nextFreeHandleIndex = heap->freeHandleIndex;
+    heap->freeHandleIndex = handleIndex;
+}
 
-    if (heap->freeBlocks > 1) {
-        qsort(gHeapFreeBlocks, heap->freeBlocks, sizeof(*gHeapFreeBlocks), heapBlockCompareBySize);
-    }
+// Returns the smallest size class which can hold block of given size.
+//
+// NOTE: [size] must not exceed [HEAP_SLAB_MAX_BLOCK_SIZE].
+static int heapGetSizeClass(int size)
+{
+    return gHeapSizeClassIndexes[(size - 1) / HEAP_SIZE_CLASS_GRANULARITY];
+}
 
-    // Take last free block (the biggest one).
-    biggestFreeBlock = gHeapFreeBlocks[heap->freeBlocks - 1];
-    biggestFreeBlockHeader = (HeapBlockHeader*)biggestFreeBlock;
-    biggestFreeBlockSize = biggestFreeBlockHeader->size;
+// Returns distance between adjacent blocks in slab of given size class.
+static int heapGetBlockStride(int sizeClass)
+{
+    int stride = gHeapSizeClasses[sizeClass] + HEAP_BLOCK_OVERHEAD_SIZE;
+    return (stride + HEAP_BLOCK_ALIGNMENT - 1) & ~(HEAP_BLOCK_ALIGNMENT - 1);
+}
 
-    // Make sure it can encompass new block of given size.
-    if (biggestFreeBlockSize >= size) {
-        // Now loop thru all free blocks and find the first one that's at least
-        // as large as what was required.
-        int index;
-        for (index = 0; index < heap->freeBlocks; index++) {
-            unsigned char* block = gHeapFreeBlocks[index];
-            HeapBlockHeader* blockHeader = (HeapBlockHeader*)block;
-            if (blockHeader->size >= size) {
-                break;
+// Takes unused block of given size class, creating new slab if needed.
+//
+// When new slab does not fit into heap budget, the block is allocated from the
+// system (unless disallowed).
+static unsigned char* heapSlabAllocateBlock(Heap* heap, int sizeClass, int disallowSystemAllocation)
+{
+    HeapSlab* slab = heap->partialSlabs[sizeClass];
+    if (slab == nullptr) {
+        slab = heapSlabCreate(heap, sizeClass);
+        if (slab == nullptr) {
+            if (disallowSystemAllocation) {
+                return nullptr;
             }
-        }
 
-        *blockPtr = gHeapFreeBlocks[index];
-        return true;
-    }
-
-    int moveableExtentsCount;
-    int maxBlocksCount;
-    if (!heapBuildMoveableExtentsList(heap, &moveableExtentsCount, &maxBlocksCount)) {
-        goto system;
-    }
-
-    // Ensure the length of [gHeapReservedFreeBlockIndexes] array is big enough
-    // to index all blocks for longest moveable extent.
-    if (maxBlocksCount > gHeapReservedFreeBlockIndexesLength) {
-        int* indexes = (int*)internal_realloc(gHeapReservedFreeBlockIndexes, sizeof(*gHeapReservedFreeBlockIndexes) * maxBlocksCount);
-        if (indexes == nullptr) {
-            goto system;
+            return heapSystemAllocateBlock(heap, gHeapSizeClasses[sizeClass], HEAP_BLOCK_STATE_SYSTEM);
         }
-
-        gHeapReservedFreeBlockIndexesLength = maxBlocksCount;
-        gHeapReservedFreeBlockIndexes = indexes;
     }
 
-    qsort(gHeapMoveableExtents, moveableExtentsCount, sizeof(*gHeapMoveableExtents), heapMoveableExtentsCompareBySize);
+    unsigned char* block = slab->freeBlocks;
+    slab->freeBlocks = *(unsigned char**)(block + HEAP_BLOCK_HEADER_SIZE);
+    slab->usedBlocksLength++;
 
-    if (moveableExtentsCount == 0) {
-        goto system;
+    if (slab->usedBlocksLength == slab->blocksLength) {
+        heapSlabListRemove(heap, slab);
     }
 
-    // Loop thru moveable extents and find first one which is big enough for new
-    // block and for which we can move every block somewhere.
-    int extentIndex;
-    for (extentIndex = 0; extentIndex < moveableExtentsCount; extentIndex++) {
-        HeapMoveableExtent* extent = &(gHeapMoveableExtents[extentIndex]);
-
-        // Calculate extent size including the size of the overhead. Exclude the
-        // size of one overhead for current block.
-        int extentSize = extent->size + HEAP_BLOCK_OVERHEAD_SIZE * extent->blocksLength - HEAP_BLOCK_OVERHEAD_SIZE;
-
-        // Make sure current extent is worth moving which means there will be
-        // enough size for new block of given size after moving current extent.
-        if (extentSize < size) {
-            continue;
-        }
-
-        if (!heapBuildMoveableBlocksList(extentIndex)) {
-            continue;
-        }
-
-        // Sort moveable blocks by size (smallest -> largest)
-        qsort(gHeapMoveableBlocks, extent->moveableBlocksLength, sizeof(*gHeapMoveableBlocks), heapBlockCompareBySize);
+    HeapBlockHeader* blockHeader = (HeapBlockHeader*)block;
+    blockHeader->state = HEAP_BLOCK_STATE_MOVABLE;
 
-        int reservedBlocksLength = 0;
+    heap->freeBlocks--;
+    heap->freeSize -= blockHeader->size;
 
-        // Loop thru sorted moveable blocks and build array of reservations.
-        for (int moveableBlockIndex = 0; moveableBlockIndex < extent->moveableBlocksLength; moveableBlockIndex++) {
-            // Grab current moveable block.
-            unsigned char* moveableBlock = gHeapMoveableBlocks[moveableBlockIndex];
-            HeapBlockHeader* moveableBlockHeader = (HeapBlockHeader*)moveableBlock;
+    return block;
+}
 
-            // Make sure there is at least one free block that's big enough
-            // to encompass it.
-            if (biggestFreeBlockSize < moveableBlockHeader->size) {
-                continue;
-            }
+// Allocates new slab of given size class and links it into the partial slabs
+// list. Returns NULL if slab does not fit into heap budget.
+static HeapSlab* heapSlabCreate(Heap* heap, int sizeClass)
+{
+    int stride = heapGetBlockStride(sizeClass);
+    int blocksLength = heap->slabSize / stride;
+    if (blocksLength < 1) {
+        blocksLength = 1;
+    }
+    int headerSize = (sizeof(HeapSlab) + HEAP_BLOCK_ALIGNMENT - 1) & ~(HEAP_BLOCK_ALIGNMENT - 1);
+    int slabSize = headerSize + stride * blocksLength;
 
-            // Loop thru sorted free blocks (smallest -> largest) and find
-            // first unreserved free block that can encompass current moveable
-            // block.
-            int freeBlockIndex;
-            for (freeBlockIndex = 0; freeBlockIndex < heap->freeBlocks; freeBlockIndex++) {
-                // Grab current free block.
-                unsigned char* freeBlock = gHeapFreeBlocks[freeBlockIndex];
-                HeapBlockHeader* freeBlockHeader = (HeapBlockHeader*)freeBlock;
-
-                // Make sure it's size is enough for current moveable block.
-                if (freeBlockHeader->size < moveableBlockHeader->size) {
-                    continue;
-                }
+    if (heap->reservedSize + slabSize > heap->size) {
+        return nullptr;
+    }
 
-                // Make sure it's outside of the current extent, because free
-                // blocks inside it is already taken into account in
-                // `extentSize`.
-                if (freeBlock >= extent->data && freeBlock < extent->data + extentSize + HEAP_BLOCK_OVERHEAD_SIZE) {
-                    continue;
-                }
+    unsigned char* data = (unsigned char*)internal_malloc(slabSize);
+    if (data == nullptr) {
+        return nullptr;
+    }
 
-                // Loop thru reserved free blocks to make to make sure we
-                // can take it.
-                int freeBlocksIndexesIndex;
-                for (freeBlocksIndexesIndex = 0; freeBlocksIndexesIndex < reservedBlocksLength; freeBlocksIndexesIndex++) {
-                    if (freeBlockIndex == gHeapReservedFreeBlockIndexes[freeBlocksIndexesIndex]) {
-                        // This free block was already reserved, there is no
-                        // need to continue.
-                        break;
-                    }
-                }
+    HeapSlab* slab = (HeapSlab*)data;
+    slab->prev = nullptr;
+    slab->next = nullptr;
+    slab->sizeClass = sizeClass;
+    slab->blocksLength = blocksLength;
+    slab->usedBlocksLength = 0;
+    slab->freeBlocks = nullptr;
+    slab->size = slabSize;
 
-                if (freeBlocksIndexesIndex == reservedBlocksLength) {
-                    // We've looked thru entire reserved free blocks array
-                    // and haven't found resevation. That means we can
-                    // reseve current free block, so stop further search.
-                    break;
-                }
-            }
+    // Build unused blocks list in reverse so that blocks are handed out in
+    // address order.
+    unsigned char* blocks = data + headerSize;
+    for (int index = blocksLength - 1; index >= 0; index--) {
+        unsigned char* block = blocks + stride * index;
 
-            if (freeBlockIndex == heap->freeBlocks) {
-                // We've looked thru entire free blocks array and haven't
-                // found suitable free block for current moveable block.
-                // Skip the rest of the search, since we want to move the
-                // entire extent and just found out that at least one block
-                // cannot be moved.
-                break;
-            }
+        HeapBlockHeader* blockHeader = (HeapBlockHeader*)block;
+        blockHeader->guard = HEAP_BLOCK_HEADER_GUARD;
+        blockHeader->size = gHeapSizeClasses[sizeClass];
+        blockHeader->state = HEAP_BLOCK_STATE_FREE;
+        blockHeader->handle_index = -1;
+        blockHeader->slab = slab;
 
-            // If we get this far, we've found suitable free block for
-            // current moveable block, save it for later usage.
-            gHeapReservedFreeBlockIndexes[reservedBlocksLength++] = freeBlockIndex;
-        }
+        HeapBlockFooter* blockFooter = (HeapBlockFooter*)(block + blockHeader->size + HEAP_BLOCK_HEADER_SIZE);
+        blockFooter->guard = HEAP_BLOCK_FOOTER_GUARD;
 
-        if (reservedBlocksLength == extent->moveableBlocksLength) {
-            // We've reserved free block for every movable block in current
-            // extent.
-            break;
-        }
+        *(unsigned char**)(block + HEAP_BLOCK_HEADER_SIZE) = slab->freeBlocks;
+        slab->freeBlocks = block;
     }
 
-    if (extentIndex == moveableExtentsCount) {
-        // We've looked thru entire moveable extents and haven't found one
-        // suitable for moving.
-        goto system;
-    }
+    heap->reservedSize += slabSize;
+    heap->freeBlocks += blocksLength;
+    heap->freeSize += blocksLength * gHeapSizeClasses[sizeClass];
 
-    extent = &(gHeapMoveableExtents[extentIndex]);
-    reservedFreeBlockIndex = 0;
-    for (int moveableBlockIndex = 0; moveableBlockIndex < extent->moveableBlocksLength; moveableBlockIndex++) {
-        unsigned char* moveableBlock = gHeapMoveableBlocks[moveableBlockIndex];
-        HeapBlockHeader* moveableBlockHeader = (HeapBlockHeader*)moveableBlock;
-        int moveableBlockSize = moveableBlockHeader->size;
-        if (biggestFreeBlockSize < moveableBlockSize) {
-            continue;
-        }
+    heapSlabListAdd(heap, slab);
 
-        unsigned char* freeBlock = gHeapFreeBlocks[gHeapReservedFreeBlockIndexes[reservedFreeBlockIndex++]];
-        HeapBlockHeader* freeBlockHeader = (HeapBlockHeader*)freeBlock;
-        int freeBlockSize = freeBlockHeader->size;
-
-        memcpy(freeBlock, moveableBlock, moveableBlockSize + HEAP_BLOCK_OVERHEAD_SIZE);
-        heap->handles[freeBlockHeader->handle_index].data = freeBlock;
-
-        // Calculate remaining size of the free block after moving.
-        int remainingSize = freeBlockSize - moveableBlockSize;
-        if (remainingSize != 0) {
-            if (remainingSize < HEAP_BLOCK_MIN_SIZE) {
-                // The remaining size of the former free block is too small to
-                // become a new free block, merge it into the current one.
-                freeBlockHeader->size += remainingSize;
-                HeapBlockFooter* freeBlockFooter = (HeapBlockFooter*)(freeBlock + freeBlockHeader->size + HEAP_BLOCK_HEADER_SIZE);
-                freeBlockFooter->guard = HEAP_BLOCK_FOOTER_GUARD;
-
-                // The remaining size of the free block was merged into moveable
-                // block, update heap stats accordingly.
-                heap->freeSize -= remainingSize;
-                heap->moveableSize += remainingSize;
-            } else {
-                // The remaining size is enough for a new block. The current
-                // block is already properly formatted - it's header and
-                // footer was copied from moveable block. Since this was a valid
-                // free block it also has it's footer already in place. So the
-                // only thing left is header.
-                unsigned char* nextFreeBlock = freeBlock + freeBlockHeader->size + HEAP_BLOCK_OVERHEAD_SIZE;
-                HeapBlockHeader* nextFreeBlockHeader = (HeapBlockHeader*)nextFreeBlock;
-                nextFreeBlockHeader->state = HEAP_BLOCK_STATE_FREE;
-                nextFreeBlockHeader->handle_index = -1;
-                nextFreeBlockHeader->size = remainingSize - HEAP_BLOCK_OVERHEAD_SIZE;
-                nextFreeBlockHeader->guard = HEAP_BLOCK_HEADER_GUARD;
-
-                heap->freeBlocks++;
-                heap->freeSize -= HEAP_BLOCK_OVERHEAD_SIZE;
-            }
-        }
-    }
+    return slab;
+}
 
-    heap->freeBlocks -= extent->blocksLength - 1;
-    heap->freeSize += (extent->blocksLength - 1) * HEAP_BLOCK_OVERHEAD_SIZE;
+// Returns block to its slab. The slab is released once all of its blocks are
+// unused.
+static void heapSlabDeallocateBlock(Heap* heap, unsigned char* block)
+{
+    HeapBlockHeader* blockHeader = (HeapBlockHeader*)block;
+    HeapSlab* slab = blockHeader->slab;
 
-    // Create one free block from entire moveable extent.
-    blockHeader = (HeapBlockHeader*)extent->data;
-    blockHeader->guard = HEAP_BLOCK_HEADER_GUARD;
-    blockHeader->size = extent->size + (extent->blocksLength - 1) * HEAP_BLOCK_OVERHEAD_SIZE;
     blockHeader->state = HEAP_BLOCK_STATE_FREE;
     blockHeader->handle_index = -1;
 
-    blockFooter = (HeapBlockFooter*)(extent->data + blockHeader->size + HEAP_BLOCK_HEADER_SIZE);
-    blockFooter->guard = HEAP_BLOCK_FOOTER_GUARD;
-
-    *blockPtr = extent->data;
-
-    return true;
+    *(unsigned char**)(block + HEAP_BLOCK_HEADER_SIZE) = slab->freeBlocks;
+    slab->freeBlocks = block;
 
-system:
+    heap->freeBlocks++;
+    heap->freeSize += blockHeader->size;
 
-    if (1) {
-        char stats[512];
-        if (heapPrintStats(heap, stats, sizeof(stats))) {
-            debugPrint("\n%s\n", stats);
-        }
-
-        if (!disallowSystemAllocation) {
-            debugPrint("Allocating block from system memory...\n");
-            unsigned char* block = (unsigned char*)internal_malloc(size + HEAP_BLOCK_OVERHEAD_SIZE);
-            if (block == nullptr) {
-                debugPrint("fatal error: internal_malloc() failed in heap_find_free_block()!\n");
-                return false;
-            }
+    if (slab->usedBlocksLength == slab->blocksLength) {
+        heapSlabListAdd(heap, slab);
+    }
 
-            HeapBlockHeader* blockHeader = (HeapBlockHeader*)block;
-            blockHeader->guard = HEAP_BLOCK_HEADER_GUARD;
-            blockHeader->size = size;
-            blockHeader->state = HEAP_BLOCK_STATE_SYSTEM;
-            blockHeader->handle_index = -1;
+    slab->usedBlocksLength--;
 
-            HeapBlockFooter* blockFooter = (HeapBlockFooter*)(block + blockHeader->size + HEAP_BLOCK_HEADER_SIZE);
-            blockFooter->guard = HEAP_BLOCK_FOOTER_GUARD;
+    if (slab->usedBlocksLength == 0) {
+        heapSlabListRemove(heap, slab);
 
-            *blockPtr = block;
+        heap->reservedSize -= slab->size;
+        heap->freeBlocks -= slab->blocksLength;
+        heap->freeSize -= slab->blocksLength * gHeapSizeClasses[slab->sizeClass];
 
-            return true;
-        }
+        internal_free(slab);
     }
-
-    return false;
 }
 
-// Build list of pointers to moveable blocks in given extent.
-//
-// 0x453E80 heap_build_subblock_list
-static bool heapBuildMoveableBlocksList(int extentIndex)
+static void heapSlabListAdd(Heap* heap, HeapSlab* slab)
 {
-    HeapMoveableExtent* extent = &(gHeapMoveableExtents[extentIndex]);
-    if (extent->moveableBlocksLength > gHeapMoveableBlocksLength) {
-        unsigned char** moveableBlocks = (unsigned char**)internal_realloc(gHeapMoveableBlocks, sizeof(*gHeapMoveableBlocks) * extent->moveableBlocksLength);
-        if (moveableBlocks == nullptr) {
-            return false;
-        }
+    HeapSlab** head = &(heap->partialSlabs[slab->sizeClass]);
 
-        gHeapMoveableBlocks = moveableBlocks;
-        gHeapMoveableBlocksLength = extent->moveableBlocksLength;
-    }
+    slab->prev = nullptr;
+    slab->next = *head;
 
-    unsigned char* ptr = extent->data;
-    int moveableBlockIndex = 0;
-    for (int index = 0; index < extent->blocksLength; index++) {
-        HeapBlockHeader* blockHeader = (HeapBlockHeader*)ptr;
-        if (blockHeader->state == HEAP_BLOCK_STATE_MOVABLE) {
-            gHeapMoveableBlocks[moveableBlockIndex++] = ptr;
-        }
-        ptr += blockHeader->size + HEAP_BLOCK_OVERHEAD_SIZE;
+    if (*head != nullptr) {
+        (*head)->prev = slab;
     }
 
-    return moveableBlockIndex == extent->moveableBlocksLength;
+    *head = slab;
 }
 
-// 0x453E74 heap_qsort_compare_moveable
-static int heapMoveableExtentsCompareBySize(const void* leftPtr, const void* rightPtr)
+static void heapSlabListRemove(Heap* heap, HeapSlab* slab)
 {
-    HeapMoveableExtent* left = (HeapMoveableExtent*)leftPtr;
-    HeapMoveableExtent* right = (HeapMoveableExtent*)rightPtr;
-    return left->size - right->size;
-}
-
-// 0x453BC4 heap_build_free_list
-static bool heapBuildFreeBlocksList(Heap* heap)
-{
-    if (heap->freeBlocks == 0) {
-        return false;
+    if (slab->prev != nullptr) {
+        slab->prev->next = slab->next;
+    } else {
+        heap->partialSlabs[slab->sizeClass] = slab->next;
     }
 
-    if (heap->freeBlocks > gHeapFreeBlocksLength) {
-        unsigned char** freeBlocks = (unsigned char**)internal_realloc(gHeapFreeBlocks, sizeof(*freeBlocks) * heap->freeBlocks);
-        if (freeBlocks == nullptr) {
-            return false;
-        }
-
-        gHeapFreeBlocks = (unsigned char**)freeBlocks;
-        gHeapFreeBlocksLength = heap->freeBlocks;
+    if (slab->next != nullptr) {
+        slab->next->prev = slab->prev;
     }
 
-    int blocksLength = heap->moveableBlocks + heap->freeBlocks + heap->lockedBlocks;
-
-    unsigned char* ptr = heap->data;
+    slab->prev = nullptr;
+    slab->next = nullptr;
+}
 
-    int freeBlockIndex = 0;
-    while (blocksLength != 0) {
-        if (freeBlockIndex >= heap->freeBlocks) {
-            break;
+// Allocates standalone block from the system. Blocks in
+// [HEAP_BLOCK_STATE_MOVABLE] state are accounted in heap budget.
+static unsigned char* heapSystemAllocateBlock(Heap* heap, int size, unsigned int state)
+{
+    if (state == HEAP_BLOCK_STATE_SYSTEM) {
+        char stats[512];
+        if (heapPrintStats(heap, stats, sizeof(stats))) {
+            debugPrint("\n%s\n", stats);
         }
 
-        HeapBlockHeader* blockHeader = (HeapBlockHeader*)ptr;
-        if (blockHeader->state == HEAP_BLOCK_STATE_FREE) {
-            // Join consecutive free blocks if any.
-            while (blocksLength > 1) {
-                // Grab next block and check if's a free block.
-                HeapBlockHeader* nextBlockHeader = (HeapBlockHeader*)(ptr + blockHeader->size + HEAP_BLOCK_OVERHEAD_SIZE);
-                if (nextBlockHeader->state != HEAP_BLOCK_STATE_FREE) {
-                    break;
-                }
-
-                // Accumulate it's size plus size of the overhead in the main
-                // block.
-                blockHeader->size += nextBlockHeader->size + HEAP_BLOCK_OVERHEAD_SIZE;
-
-                // Update heap stats, the free size increased because we've just
-                // remove overhead for one block.
-                heap->freeBlocks--;
-                heap->freeSize += HEAP_BLOCK_OVERHEAD_SIZE;
+        debugPrint("Allocating block from system memory...\n");
+    }
 
-                blocksLength--;
-            }
+    unsigned char* block = (unsigned char*)internal_malloc(size + HEAP_BLOCK_OVERHEAD_SIZE);
+    if (block == nullptr) {
+        debugPrint("fatal error: internal_malloc() failed in heap_find_free_block()!\n");
+        return nullptr;
+    }
 
-            gHeapFreeBlocks[freeBlockIndex++] = ptr;
-        }
+    HeapBlockHeader* blockHeader = (HeapBlockHeader*)block;
+    blockHeader->guard = HEAP_BLOCK_HEADER_GUARD;
+    blockHeader->size = size;
+    blockHeader->state = state;
+    blockHeader->handle_index = -1;
+    blockHeader->slab = nullptr;
 
-        // Move pointer to the header of the next block.
-        ptr += blockHeader->size + HEAP_BLOCK_OVERHEAD_SIZE;
+    HeapBlockFooter* blockFooter = (HeapBlockFooter*)(block + blockHeader->size + HEAP_BLOCK_HEADER_SIZE);
+    blockFooter->guard = HEAP_BLOCK_FOOTER_GUARD;
 
-        blocksLength--;
+    if (state == HEAP_BLOCK_STATE_MOVABLE) {
+        heap->reservedSize += size + HEAP_BLOCK_OVERHEAD_SIZE;
     }
 
-    return true;
+    return block;
 }
 
-// 0x453CC4 heap_qsort_compare_free
-static int heapBlockCompareBySize(const void* leftPtr, const void* rightPtr)
+static bool heapValidateBlock(unsigned char* block)
 {
-    HeapBlockHeader* header1 = *(HeapBlockHeader**)leftPtr;
-    HeapBlockHeader* header2 = *(HeapBlockHeader**)rightPtr;
-    return header1->size - header2->size;
-}
-
-// 0x453CD0 heap_build_moveable_list
-static bool heapBuildMoveableExtentsList(Heap* heap, int* moveableExtentsLengthPtr, int* maxBlocksLengthPtr)
-{
-    // Calculate max number of extents. It's only possible when every
-    // free or moveable block is followed by locked block.
-    int maxExtentsCount = heap->moveableBlocks + heap->freeBlocks;
-    if (maxExtentsCount <= 2) {
-        debugPrint("<[couldn't build moveable list]>\n");
+    HeapBlockHeader* blockHeader = (HeapBlockHeader*)block;
+    if (blockHeader->guard != (int)HEAP_BLOCK_HEADER_GUARD) {
+        debugPrint("Bad guard begin detected during validate.\n");
         return false;
     }
 
-    if (maxExtentsCount > gHeapMoveableExtentsLength) {
-        HeapMoveableExtent* moveableExtents = (HeapMoveableExtent*)internal_realloc(gHeapMoveableExtents, sizeof(*gHeapMoveableExtents) * maxExtentsCount);
-        if (moveableExtents == nullptr) {
-            return false;
-        }
-
-        gHeapMoveableExtents = moveableExtents;
-        gHeapMoveableExtentsLength = maxExtentsCount;
+    HeapBlockFooter* blockFooter = (HeapBlockFooter*)(block + blockHeader->size + HEAP_BLOCK_HEADER_SIZE);
+    if (blockFooter->guard != (int)HEAP_BLOCK_FOOTER_GUARD) {
+        debugPrint("Bad guard end detected during validate.\n");
+        return false;
     }
 
-    unsigned char* ptr = heap->data;
-    int blocksLength = heap->moveableBlocks + heap->freeBlocks + heap->lockedBlocks;
-    int maxBlocksLength = 0;
-    int extentIndex = 0;
-
-    while (blocksLength != 0) {
-        if (extentIndex >= maxExtentsCount) {
-            break;
-        }
-
-        HeapBlockHeader* blockHeader = (HeapBlockHeader*)ptr;
-        if (blockHeader->state == HEAP_BLOCK_STATE_FREE || blockHeader->state == HEAP_BLOCK_STATE_MOVABLE) {
-            HeapMoveableExtent* extent = &(gHeapMoveableExtents[extentIndex++]);
-            extent->data = ptr;
-            extent->blocksLength = 1;
-            extent->moveableBlocksLength = 0;
-            extent->size = blockHeader->size;
-
-            if (blockHeader->state == HEAP_BLOCK_STATE_MOVABLE) {
-                extent->moveableBlocksLength = 1;
-            }
-
-            // Calculate moveable extent stats from consecutive blocks.
-            while (blocksLength > 1) {
-                // Grab next block and check if's a free or moveable block.
-                HeapBlockHeader* blockHeader = (HeapBlockHeader*)ptr;
-                HeapBlockHeader* nextBlockHeader = (HeapBlockHeader*)(ptr + blockHeader->size + HEAP_BLOCK_OVERHEAD_SIZE);
-                if (nextBlockHeader->state != HEAP_BLOCK_STATE_FREE && nextBlockHeader->state != HEAP_BLOCK_STATE_MOVABLE) {
-                    break;
-                }
-
-                // Update extent stats.
-                extent->blocksLength++;
-                extent->size += nextBlockHeader->size;
-
-                if (nextBlockHeader->state == HEAP_BLOCK_STATE_MOVABLE) {
-                    extent->moveableBlocksLength++;
-                }
-
-                // Move pointer to the beginning of the next block.
-                ptr += (blockHeader->size + HEAP_BLOCK_OVERHEAD_SIZE);
-
-                blocksLength--;
-            }
-
-            if (extent->blocksLength > maxBlocksLength) {
-                maxBlocksLength = extent->blocksLength;
-            }
-        }
-
-        // ptr might have been advanced during the loop above.
-        blockHeader = (HeapBlockHeader*)ptr;
-        ptr += blockHeader->size + HEAP_BLOCK_OVERHEAD_SIZE;
-
-        blocksLength--;
-    };
-
-    *moveableExtentsLengthPtr = extentIndex;
-    *maxBlocksLengthPtr = maxBlocksLength;
-
     return true;
 }
 
@@ -1139,46 +823,70 @@ bool heapValidate(Heap* heap)
 {
     debugPrint("Validating heap...\n");
 
-    int blocksCount = heap->freeBlocks + heap->moveableBlocks + heap->lockedBlocks;
-    unsigned char* ptr = heap->data;
-
     int freeBlocks = 0;
     int freeSize = 0;
     int moveableBlocks = 0;
     int moveableSize = 0;
     int lockedBlocks = 0;
     int lockedSize = 0;
+    int systemBlocks = 0;
+    int systemSize = 0;
+    int reservedSize = 0;
 
-    for (int index = 0; index < blocksCount; index++) {
-        HeapBlockHeader* blockHeader = (HeapBlockHeader*)ptr;
-        if (blockHeader->guard != HEAP_BLOCK_HEADER_GUARD) {
-            debugPrint("Bad guard begin detected during validate.\n");
+    for (int index = 0; index < heap->handlesLength; index++) {
+        HeapHandle* handle = &(heap->handles[index]);
+        if (handle->state == HEAP_HANDLE_STATE_INVALID) {
+            continue;
+        }
+
+        if (!heapValidateBlock(handle->data)) {
             return false;
         }
 
-        HeapBlockFooter* blockFooter = (HeapBlockFooter*)(ptr + blockHeader->size + HEAP_BLOCK_HEADER_SIZE);
-        if (blockFooter->guard != HEAP_BLOCK_FOOTER_GUARD) {
-            debugPrint("Bad guard end detected during validate.\n");
+        HeapBlockHeader* blockHeader = (HeapBlockHeader*)handle->data;
+        if (blockHeader->state != handle->state || blockHeader->handle_index != index) {
+            debugPrint("Mismatched block and handle detected during validate.\n");
             return false;
         }
 
-        if (blockHeader->state == HEAP_BLOCK_STATE_FREE) {
-            freeBlocks++;
-            freeSize += blockHeader->size;
-        } else if (blockHeader->state == HEAP_BLOCK_STATE_MOVABLE) {
-            moveableBlocks++;
-            moveableSize += blockHeader->size;
-        } else if (blockHeader->state == HEAP_BLOCK_STATE_LOCKED) {
-            lockedBlocks++;
-            lockedSize += blockHeader->size;
+        if ((blockHeader->state & HEAP_BLOCK_STATE_SYSTEM) != 0) {
+            systemBlocks++;
+            systemSize += blockHeader->size;
+        } else {
+            if (blockHeader->state == HEAP_BLOCK_STATE_MOVABLE) {
+                moveableBlocks++;
+                moveableSize += blockHeader->size;
+            } else {
+                lockedBlocks++;
+                lockedSize += blockHeader->size;
+            }
+
+            if (blockHeader->slab == nullptr) {
+                reservedSize += blockHeader->size + HEAP_BLOCK_OVERHEAD_SIZE;
+            }
         }
+    }
+
+    // Full slabs are not linked anywhere, only partial ones can be checked
+    // block by block.
+    for (size_t sizeClass = 0; sizeClass < HEAP_SIZE_CLASSES_LENGTH; sizeClass++) {
+        for (HeapSlab* slab = heap->partialSlabs[sizeClass]; slab != nullptr; slab = slab->next) {
+            int slabFreeBlocks = 0;
+            for (unsigned char* block = slab->freeBlocks; block != nullptr; block = *(unsigned char**)(block + HEAP_BLOCK_HEADER_SIZE)) {
+                if (!heapValidateBlock(block)) {
+                    return false;
+                }
+
+                slabFreeBlocks++;
+            }
 
-        if (index != blocksCount - 1) {
-            ptr += blockHeader->size + HEAP_BLOCK_OVERHEAD_SIZE;
-            if (ptr > (heap->data + heap->size)) {
-                debugPrint("Ran off end of heap during validate!\n");
+            if (slabFreeBlocks != slab->blocksLength - slab->usedBlocksLength) {
+                debugPrint("Invalid number of free blocks in slab.\n");
                 return false;
             }
+
+            freeBlocks += slabFreeBlocks;
+            freeSize += slabFreeBlocks * gHeapSizeClasses[sizeClass];
         }
     }
 
@@ -1212,31 +920,6 @@ bool heapValidate(Heap* heap)
         return false;
     }
 
-    debugPrint("Heap is O.K.\n");
-
-    int systemBlocks = 0;
-    int systemSize = 0;
-
-    for (int handleIndex = 0; handleIndex < heap->handlesLength; handleIndex++) {
-        HeapHandle* handle = &(heap->handles[handleIndex]);
-        if (handle->state != HEAP_HANDLE_STATE_INVALID && (handle->state & HEAP_BLOCK_STATE_SYSTEM) != 0) {
-            HeapBlockHeader* blockHeader = (HeapBlockHeader*)handle->data;
-            if (blockHeader->guard != HEAP_BLOCK_HEADER_GUARD) {
-                debugPrint("Bad guard begin detected in system block during validate.\n");
-                return false;
-            }
-
-            HeapBlockFooter* blockFooter = (HeapBlockFooter*)(handle->data + blockHeader->size + HEAP_BLOCK_HEADER_SIZE);
-            if (blockFooter->guard != HEAP_BLOCK_FOOTER_GUARD) {
-                debugPrint("Bad guard end detected in system block during validate.\n");
-                return false;
-            }
-
-            systemBlocks++;
-            systemSize += blockHeader->size;
-        }
-    }
-
     if (systemBlocks != heap->systemBlocks) {
         debugPrint("Invalid number of system blocks.\n");
         return false;
@@ -1247,6 +930,42 @@ bool heapValidate(Heap* heap)
         return false;
     }
 
+    if (reservedSize > heap->reservedSize) {
+        debugPrint("Invalid reserved size.\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool heapGetStats(Heap* heap, HeapStats* stats)
+{
+    if (heap == nullptr || stats == nullptr) {
+        return false;
+    }
+
+    stats->size = heap->size;
+    stats->freeBlocks = heap->freeBlocks;
+    stats->freeSize = heap->freeSize;
+    stats->moveableBlocks = heap->moveableBlocks;
+    stats->moveableSize = heap->moveableSize;
+    stats->lockedBlocks = heap->lockedBlocks;
+    stats->lockedSize = heap->lockedSize;
+    stats->systemBlocks = heap->systemBlocks;
+    stats->systemSize = heap->systemSize;
+    stats->handlesLength = heap->handlesLength;
+    stats->reservedSize = heap->reservedSize;
+
+    int unreservedSize = heap->size - heap->reservedSize;
+    if (unreservedSize < 0) {
+        unreservedSize = 0;
+    }
+
+    stats->largestFreeSize = unreservedSize > (int)HEAP_BLOCK_OVERHEAD_SIZE ? unreservedSize - (int)HEAP_BLOCK_OVERHEAD_SIZE : 0;
+
+    int totalFreeSize = unreservedSize + heap->freeSize;
+    stats->fragmentation = totalFreeSize != 0 ? (int)((long long)heap->freeSize * 100 / totalFreeSize) : 0;
+
     return true;
 }
 
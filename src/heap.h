@@ -3,25 +3,80 @@
 
 namespace fallout {
 
+struct HeapSlab;
+
 typedef struct HeapHandle {
     unsigned int state;
     unsigned char* data;
+
+    // Index of the next unused handle (only valid when this handle is unused).
+    int nextFreeHandleIndex;
 } HeapHandle;
 
+// Heap of handle-addressed blocks.
+//
+// Small blocks are served from fixed size class slabs, large blocks are
+// allocated directly from the system. Blocks are never moved, locking only
+// pins block for bookkeeping purposes.
 typedef struct Heap {
+    // Memory budget for slabs and large blocks. Allocations which do not fit
+    // into the budget become system blocks (unless disallowed by caller).
     int size;
+
+    // Amount of memory taken by slabs and large blocks.
+    int reservedSize;
+
+    // Number and size of unused blocks in slabs.
     int freeBlocks;
+    int freeSize;
+
+    // Number and size of unlocked blocks within budget.
     int moveableBlocks;
+    int moveableSize;
+
+    // Number and size of locked blocks within budget.
     int lockedBlocks;
+    int lockedSize;
+
+    // Number and size of blocks allocated beyond budget.
     int systemBlocks;
+    int systemSize;
+
+    HeapHandle* handles;
     int handlesLength;
+
+    // Head of unused handles list, or -1 if all handles are used.
+    int freeHandleIndex;
+
+    // Slabs with at least one unused block, one list per size class.
+    struct HeapSlab** partialSlabs;
+
+    // Size of slab data, scaled with initial heap size.
+    int slabSize;
+} Heap;
+
+typedef struct HeapStats {
+    int size;
+    int freeBlocks;
     int freeSize;
+    int moveableBlocks;
     int moveableSize;
+    int lockedBlocks;
     int lockedSize;
+    int systemBlocks;
     int systemSize;
-    HeapHandle* handles;
-    unsigned char* data;
-} Heap;
+    int handlesLength;
+
+    // Memory taken by slabs and large blocks.
+    int reservedSize;
+
+    // Size of the biggest block which can be allocated within budget.
+    int largestFreeSize;
+
+    // Share of free memory (in percents) which is stuck in partially used
+    // slabs.
+    int fragmentation;
+} HeapStats;
 
 bool heapInit(Heap* heap, int initialSize);
 bool heapFree(Heap* heap);
@@ -30,6 +85,7 @@ bool heapBlockDeallocate(Heap* heap, int* handleIndexPtr);
 bool heapLock(Heap* heap, int handleIndex, unsigned char** bufferPtr);
 bool heapUnlock(Heap* heap, int handleIndex);
 bool heapValidate(Heap* heap);
+bool heapGetStats(Heap* heap, HeapStats* stats);
 
 } // namespace fallout
 
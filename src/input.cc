@@ -9,10 +9,12 @@
 #include "delay.h"
 #include "dinput.h"
 #include "draw.h"
+#include "frame_profiler.h"
 #include "game.h"
 #include "kb.h"
 #include "memory.h"
 #include "mouse.h"
+#include "settings.h"
 #include "sfall_kb_helpers.h"
 #include "sfall_script_hooks.h"
 #include "svga.h"
@@ -252,6 +254,12 @@ void enqueueInputEvent(int logicalKey)
         return;
     }
 
+    // Mapper uses Alt+P to save map as text.
+    if (logicalKey == KEY_ALT_P && !gIsMapper && frameProfilerIsEnabled() && !settings.debug.frame_profile_path.empty()) {
+        frameProfilerExportTraceToDefaultPath();
+        return;
+    }
+
     if (gInputEventQueueWriteIndex == gInputEventQueueReadIndex) {
         return;
     }
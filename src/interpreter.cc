@@ -10,6 +10,7 @@
 #include "db.h"
 #include "debug.h"
 #include "export.h"
+#include "frame_profiler.h"
 #include "input.h"
 #include "interpreter_lib.h"
 #include "memory_manager.h"
@@ -3064,6 +3065,8 @@ Program* runScript(char* name)
 // 0x46E1EC
 void _updatePrograms()
 {
+    FrameProfilerZone profilerZone("_updatePrograms");
+
     // CE: Implementation is different. Sfall inserts global scripts into
     // program list upon creation, so engine does not diffirentiate between
     // global and normal scripts. Global scripts in CE are not part of program
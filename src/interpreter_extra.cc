@@ -928,8 +928,7 @@ static void opCreateObject(Program* program)
         script->index = sid - 1;
 
         if (scriptType == SCRIPT_TYPE_SPATIAL) {
-            script->sp.built_tile = builtTileCreate(object->tile, object->elevation);
-            script->sp.radius = 3;
+            scriptSetSpatialArea(script, builtTileCreate(object->tile, object->elevation), 3);
         }
 
         object->id = scriptsNewObjectId();
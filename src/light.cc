@@ -1,7 +1,10 @@
 #include "light.h"
 
 #include <algorithm>
+#include <unordered_map>
+#include <vector>
 
+#include "map.h"
 #include "map_defs.h"
 #include "object.h"
 #include "perk.h"
@@ -12,6 +15,23 @@ namespace fallout {
 // 20% of max light per "Night Vision" rank
 #define LIGHT_LEVEL_NIGHT_VISION_BONUS (65536 / 5)
 
+// Light added by a single object, see [lightAddSource].
+typedef struct LightSource {
+    int elevation;
+    std::vector<LightSourceTile> tiles;
+
+    // Lit area relative to the screen position of tile 0.
+    Rect rect;
+
+    // Whether source was added during current rebuild, see
+    // [lightBeginRebuild].
+    bool seen;
+} LightSource;
+
+static void lightSourceApply(const LightSource* source, int sign);
+static void lightMarkDirty(int elevation, const Rect* rect);
+static void lightGetOrigin(int* x, int* y);
+
 // 0x51923C ambient_light
 static int gAmbientIntensity = LIGHT_INTENSITY_MAX;
 
@@ -19,6 +39,14 @@ static int gAmbientIntensity = LIGHT_INTENSITY_MAX;
 // 0x59E994 tile_intensity
 static int gTileIntensity[ELEVATION_COUNT][HEX_GRID_SIZE];
 
+// Light currently added to [gTileIntensity] by every object. Tile intensity
+// is always 655 plus sum of these.
+static std::unordered_map<Object*, LightSource> gLightSources;
+
+// Changed areas not yet redrawn, relative to the screen position of tile 0.
+static Rect gLightDirtyRects[ELEVATION_COUNT];
+static bool gLightDirty[ELEVATION_COUNT];
+
 // 0x47A8F0 light_init
 int lightInit()
 {
@@ -133,6 +161,12 @@ void lightDecreaseTileIntensity(int elevation, int tile, int intensity)
 // 0x47AA84 light_reset_tiles
 void lightResetTileIntensity()
 {
+    gLightSources.clear();
+
+    for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+        gLightDirty[elevation] = false;
+    }
+
     for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
         for (int tile = 0; tile < HEX_GRID_SIZE; tile++) {
             gTileIntensity[elevation][tile] = 655;
@@ -150,4 +184,145 @@ void lightIncreaseAmbient(int val)
     lightSetAmbientIntensity(gAmbientIntensity + val, true);
 }
 
+void lightAddSource(Object* source, int elevation, const LightSourceTile* tiles, int count, const Rect* rect, bool markDirty)
+{
+    if (!elevationIsValid(elevation)) {
+        return;
+    }
+
+    int originX;
+    int originY;
+    lightGetOrigin(&originX, &originY);
+
+    Rect mapRect;
+    rectCopy(&mapRect, rect);
+    rectOffset(&mapRect, -originX, -originY);
+
+    LightSource& lightSource = gLightSources[source];
+    if (!lightSource.tiles.empty()) {
+        bool unchanged = lightSource.elevation == elevation
+            && lightSource.tiles.size() == static_cast<size_t>(count)
+            && std::equal(lightSource.tiles.begin(), lightSource.tiles.end(), tiles, [](const LightSourceTile& a, const LightSourceTile& b) {
+                   return a.tile == b.tile && a.intensity == b.intensity;
+               });
+        if (unchanged) {
+            lightSource.rect = mapRect;
+            lightSource.seen = true;
+            return;
+        }
+
+        lightSourceApply(&lightSource, -1);
+
+        if (markDirty) {
+            lightMarkDirty(lightSource.elevation, &(lightSource.rect));
+        }
+    }
+
+    lightSource.elevation = elevation;
+    lightSource.tiles.assign(tiles, tiles + count);
+    lightSource.rect = mapRect;
+    lightSource.seen = true;
+
+    lightSourceApply(&lightSource, 1);
+
+    if (markDirty) {
+        lightMarkDirty(elevation, &mapRect);
+    }
+}
+
+int lightRemoveSource(Object* source, Rect* rect, bool markDirty)
+{
+    auto it = gLightSources.find(source);
+    if (it == gLightSources.end()) {
+        return -1;
+    }
+
+    LightSource& lightSource = it->second;
+    lightSourceApply(&lightSource, -1);
+
+    if (markDirty) {
+        lightMarkDirty(lightSource.elevation, &(lightSource.rect));
+    }
+
+    if (rect != nullptr) {
+        int originX;
+        int originY;
+        lightGetOrigin(&originX, &originY);
+
+        rectCopy(rect, &(lightSource.rect));
+        rectOffset(rect, originX, originY);
+    }
+
+    gLightSources.erase(it);
+
+    return 0;
+}
+
+void lightBeginRebuild()
+{
+    for (auto& entry : gLightSources) {
+        entry.second.seen = false;
+    }
+}
+
+void lightEndRebuild()
+{
+    auto it = gLightSources.begin();
+    while (it != gLightSources.end()) {
+        LightSource& lightSource = it->second;
+        if (lightSource.seen) {
+            ++it;
+            continue;
+        }
+
+        lightSourceApply(&lightSource, -1);
+        lightMarkDirty(lightSource.elevation, &(lightSource.rect));
+        it = gLightSources.erase(it);
+    }
+}
+
+void lightRefreshDirtyRects()
+{
+    if (elevationIsValid(gElevation) && gLightDirty[gElevation]) {
+        int originX;
+        int originY;
+        lightGetOrigin(&originX, &originY);
+
+        Rect rect;
+        rectCopy(&rect, &(gLightDirtyRects[gElevation]));
+        rectOffset(&rect, originX, originY);
+        tileWindowRefreshRect(&rect, gElevation);
+    }
+
+    for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+        gLightDirty[elevation] = false;
+    }
+}
+
+// Adds ([sign] is 1) or takes back ([sign] is -1) light of [source].
+static void lightSourceApply(const LightSource* source, int sign)
+{
+    int* tileIntensity = gTileIntensity[source->elevation];
+    for (const LightSourceTile& lightSourceTile : source->tiles) {
+        tileIntensity[lightSourceTile.tile] += sign * lightSourceTile.intensity;
+    }
+}
+
+static void lightMarkDirty(int elevation, const Rect* rect)
+{
+    if (gLightDirty[elevation]) {
+        rectUnion(&(gLightDirtyRects[elevation]), rect, &(gLightDirtyRects[elevation]));
+    } else {
+        rectCopy(&(gLightDirtyRects[elevation]), rect);
+        gLightDirty[elevation] = true;
+    }
+}
+
+// Light areas are kept relative to the screen position of tile 0, so that
+// they stay valid when map is scrolled.
+static void lightGetOrigin(int* x, int* y)
+{
+    tileToScreenXY(0, x, y);
+}
+
 } // namespace fallout
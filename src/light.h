@@ -1,6 +1,9 @@
 #ifndef LIGHT_H
 #define LIGHT_H
 
+#include "geometry.h"
+#include "obj_types.h"
+
 namespace fallout {
 
 #define LIGHT_INTENSITY_MIN (65536 / 4)
@@ -8,6 +11,12 @@ namespace fallout {
 
 typedef void AdjustLightIntensityProc(int elevation, int tile, int intensity);
 
+// Tile lit by a light source and amount of light it receives.
+typedef struct LightSourceTile {
+    int tile;
+    int intensity;
+} LightSourceTile;
+
 int lightInit();
 void lightReset();
 void lightExit();
@@ -22,6 +31,29 @@ void lightResetTileIntensity();
 void lightDecreaseAmbient(int val);
 void lightIncreaseAmbient(int val);
 
+// Adds light of [source] to [tiles] on [elevation] and remembers them, so
+// that exactly the same amounts can be taken back by [lightRemoveSource].
+// Replaces previous light of [source]: when [tiles] are the same nothing is
+// updated, otherwise previous light is taken back from all of its tiles and
+// new light is added to all of [tiles].
+//
+// [rect] is the lit area on screen. When [markDirty] is set, changed area is
+// added to the region redrawn by [lightRefreshDirtyRects].
+void lightAddSource(Object* source, int elevation, const LightSourceTile* tiles, int count, const Rect* rect, bool markDirty);
+
+// Takes back light added by [source]. Returns -1 if there is no light of
+// [source], otherwise lit area on screen is stored in [rect].
+int lightRemoveSource(Object* source, Rect* rect, bool markDirty);
+
+// Brackets a pass which adds all light sources again. Sources which are not
+// added during the pass are removed at the end of it.
+void lightBeginRebuild();
+void lightEndRebuild();
+
+// Redraws parts of the map on the current elevation where light has changed
+// since the last call.
+void lightRefreshDirtyRects();
+
 } // namespace fallout
 
 #endif /* LIGHT_H */
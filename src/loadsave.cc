@@ -35,6 +35,7 @@
 #include "kb.h"
 #include "map.h"
 #include "memory.h"
+#include "memory_profiler.h"
 #include "message.h"
 #include "mouse.h"
 #include "object.h"
@@ -1867,6 +1868,8 @@ EM_ASYNC_JS(void, do_save_idbfs_loadsave, (), {
 // 0x47D88C
 static int lsgPerformSaveGame()
 {
+    MemoryProfilerScope memoryProfilerScope("save_game");
+
     _ls_error_code = 0;
     _map_backup_count = -1;
     gameMouseSetCursor(MOUSE_CURSOR_WAIT_PLANET);
@@ -1999,6 +2002,8 @@ int mapIdBeingLoaded()
 // 0x47DC68
 static int lsgLoadGameInSlot(int slot)
 {
+    MemoryProfilerScope memoryProfilerScope("load_game");
+
     if (slot < 0 || slot >= saveLoadTotalSlots) {
         return -1;
     }
@@ -21,6 +21,7 @@
 #include "game_sound.h"
 #include "input.h"
 #include "kb.h"
+#include "light.h"
 #include "loadsave.h"
 #include "mainmenu.h"
 #include "map.h"
@@ -461,7 +462,17 @@ static void mainLoop()
             _game_user_wants_to_quit = GAME_QUIT_REQUEST_MAIN_MENU;
         }
 
+        // Redraw parts of the map where light was changed by objects which
+        // did not report their area.
+        lightRefreshDirtyRects();
+
+        // Overlays below are drawn directly on screen, flush pending window
+        // refreshes so that they do not overwrite them.
+        windowFlushDamage();
+
         renderFpsCounter();
+        renderCacheStatsOverlay();
+        renderFrameProfilerOverlay();
         renderPresent();
         sharedFpsLimiter.throttle();
     }
@@ -30,6 +30,7 @@
 #include "map_defs.h"
 #include "map_edge.h"
 #include "memory.h"
+#include "memory_profiler.h"
 #include "object.h"
 #include "party_member.h"
 #include "proto.h"
@@ -855,6 +856,7 @@ static void mapLoadTimerStart()
 {
     if (mapLoadTimerDepth == 0) {
         mapLoadStartTime = compat_timeGetTime();
+        memoryProfilerPushTag("map_load");
     }
 
     mapLoadTimerDepth++;
@@ -869,6 +871,8 @@ static void mapLoadTimerFinish(const char* fileName, int rc)
         return;
     }
 
+    memoryProfilerPopTag();
+
     unsigned int elapsed = getTicksBetween(compat_timeGetTime(), mapLoadStartTime);
     debugPrint("\nMAP LOAD: %s rc=%d total=%ums",
         fileName != nullptr ? fileName : "<null>",
@@ -1794,7 +1798,7 @@ static void _map_place_dude_and_mouse()
     if (gDude != nullptr) {
         if (animationTypeFromFid(gDude->fid) != ANIM_STAND) {
             objectSetFrame(gDude, 0, nullptr);
-            gDude->fid = buildFid(OBJ_TYPE_CRITTER, gDude->fid & 0xFFF, ANIM_STAND, weaponAnimationFromFid(gDude->fid), gDude->rotation + 1);
+            objectSetFid(gDude, buildFid(OBJ_TYPE_CRITTER, gDude->fid & 0xFFF, ANIM_STAND, weaponAnimationFromFid(gDude->fid), gDude->rotation + 1), nullptr);
         }
 
         if (gDude->tile == -1) {
@@ -247,7 +247,7 @@ void map_toggle_block_obj_viewing(int mode)
 
             if (block_obj_view_on) {
                 if (blockedFidCache[index] != 0) {
-                    obj->fid = blockedFidCache[index];
+                    objectSetFid(obj, blockedFidCache[index], nullptr);
                 }
             } else {
                 if (blockedFidCache[index] == 0) {
@@ -257,7 +257,7 @@ void map_toggle_block_obj_viewing(int mode)
                     }
                 }
                 if (fidShowList[index] != 0) {
-                    obj->fid = fidShowList[index];
+                    objectSetFid(obj, fidShowList[index], nullptr);
                 }
             }
         }
@@ -718,7 +718,7 @@ static void copy_object_to_tile_pobj(int srcFid, int dstTile, Object* srcObj, bo
             Script* script = nullptr;
             if (scriptGetScript(sid, &script) != -1) {
                 if (SID_TYPE(sid) == 1 /* spatial */) {
-                    script->sp.built_tile = (gElevation << 29) | dstTile;
+                    scriptSetSpatialArea(script, (gElevation << 29) | dstTile, script->sp.radius);
                 }
                 script->owner = copy;
             }
@@ -1098,7 +1098,7 @@ static void mapper_shift_map_once(int dx, int dy)
         int newTile = oldTile + 400 * dy - 2 * dx;
         if (newTile >= 1 && newTile < kShiftMapTiles - 1) {
             int rotBits = (script->sp.built_tile >> 26) & 0x7;
-            script->sp.built_tile = newTile | ((rotBits << 26) & 0x1C000000) | (gElevation << 29);
+            scriptSetSpatialArea(script, newTile | ((rotBits << 26) & 0x1C000000) | (gElevation << 29), script->sp.radius);
         }
         script = scriptGetNextSpatialScript();
     }
@@ -1239,7 +1239,7 @@ void mapper_shift_map_elev()
             exitGrid = objectFindNextAtLocation();
         }
 
-        script->sp.built_tile = newBuiltTile;
+        scriptSetSpatialArea(script, newBuiltTile, script->sp.radius);
         script = scriptGetNextSpatialScript();
     }
 
@@ -1471,7 +1471,7 @@ void edit_mapper()
                         if (protoGetProto(pid, &proto) != -1) {
                             int artFid = proto->fid;
                             if (artExists(artFid)) {
-                                gGameMouseBouncingCursor->fid = artFid;
+                                objectSetFid(gGameMouseBouncingCursor, artFid, nullptr);
                                 Rect mouseRect;
                                 objectSetRotation(gGameMouseBouncingCursor, rotation, &mouseRect);
                                 tileWindowRefreshRect(&mouseRect, gElevation);
@@ -2764,7 +2764,7 @@ static void mapper_enter_play_mode(Object** pHlObj1)
 
     _proto_dude_init("premade\\blank.gcd");
 
-    gDude->fid = buildFid(OBJ_TYPE_CRITTER, _art_vault_guy_num, ANIM_STAND, WEAPON_ANIMATION_NONE, ROTATION_NE);
+    objectSetFid(gDude, buildFid(OBJ_TYPE_CRITTER, _art_vault_guy_num, ANIM_STAND, WEAPON_ANIMATION_NONE, ROTATION_NE), nullptr);
 
     _scr_game_init();
 
@@ -322,9 +322,8 @@ int map_scr_add_spatial(int tile, int elevation)
         tileWindowRefreshRect(&rect, elevation);
     }
 
-    scr->sp.built_tile = builtTileCreate(tile, elevation);
+    scriptSetSpatialArea(scr, builtTileCreate(tile, elevation), radius);
     scr->index = scriptId & 0xFFFFFF;
-    scr->sp.radius = radius;
     _scr_find_str_run_info(scriptId & 0xFFFFFF, nullptr, sid);
 
     return 0;
@@ -6,6 +6,12 @@
 
 #include "debug.h"
 #include "memory_defs.h"
+#include "memory_profiler.h"
+
+// The functions below are the ones behind call site macros.
+#undef internal_strdup
+#undef internal_malloc
+#undef internal_realloc
 
 namespace fallout {
 
@@ -59,11 +65,19 @@ static size_t gMemoryBlocksMaximumSize = 0;
 
 // 0x4C5A80 mem_strdup
 char* internal_strdup(const char* string)
+{
+    return internal_strdup_at(string, nullptr, 0);
+}
+
+char* internal_strdup_at(const char* string, const char* file, int line)
 {
     char* copy = nullptr;
     if (string != nullptr) {
-        copy = (char*)gMallocProc(strlen(string) + 1);
+        size_t size = strlen(string) + 1;
+        copy = (char*)gMallocProc(size);
         strcpy(copy, string);
+
+        memoryProfilerRecordAllocation(copy, size, file, line);
     }
     return copy;
 }
@@ -71,7 +85,14 @@ char* internal_strdup(const char* string)
 // 0x4C5AD0 mem_malloc
 void* internal_malloc(size_t size)
 {
-    return gMallocProc(size);
+    return internal_malloc_at(size, nullptr, 0);
+}
+
+void* internal_malloc_at(size_t size, const char* file, int line)
+{
+    void* ptr = gMallocProc(size);
+    memoryProfilerRecordAllocation(ptr, size, file, line);
+    return ptr;
 }
 
 // 0x4C5AD8 my_malloc
@@ -106,7 +127,22 @@ static void* memoryBlockMallocImpl(size_t size)
 // 0x4C5B50 mem_realloc
 void* internal_realloc(void* ptr, size_t size)
 {
-    return gReallocProc(ptr, size);
+    return internal_realloc_at(ptr, size, nullptr, 0);
+}
+
+void* internal_realloc_at(void* ptr, size_t size, const char* file, int line)
+{
+    void* newPtr = gReallocProc(ptr, size);
+
+    // Profiler sees reallocation as a free of the old block followed by
+    // allocation of the new one at realloc call site. Failed reallocation
+    // leaves the old block intact.
+    if (newPtr != nullptr || size == 0) {
+        memoryProfilerRecordFree(ptr);
+        memoryProfilerRecordAllocation(newPtr, size, file, line);
+    }
+
+    return newPtr;
 }
 
 // 0x4C5B58 my_realloc
@@ -157,6 +193,7 @@ static void* memoryBlockReallocImpl(void* ptr, size_t size)
 // 0x4C5C24 mem_free
 void internal_free(void* ptr)
 {
+    memoryProfilerRecordFree(ptr);
     gFreeProc(ptr);
 }
 
@@ -12,6 +12,17 @@ void* internal_realloc(void* ptr, size_t size);
 void internal_free(void* ptr);
 void mem_check();
 
+// Same as above, but also pass call site to memory profiler.
+char* internal_strdup_at(const char* string, const char* file, int line);
+void* internal_malloc_at(size_t size, const char* file, int line);
+void* internal_realloc_at(void* ptr, size_t size, const char* file, int line);
+
+// Calls are routed through call site aware variants. Taking the address of
+// the function (e.g. to install memory procs) still refers to the function.
+#define internal_strdup(string) internal_strdup_at(string, __FILE__, __LINE__)
+#define internal_malloc(size) internal_malloc_at(size, __FILE__, __LINE__)
+#define internal_realloc(ptr, size) internal_realloc_at(ptr, size, __FILE__, __LINE__)
+
 // Owning smart pointer for objects allocated with internal_malloc.
 template <typename T>
 class InternalPtr {
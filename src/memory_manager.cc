@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "memory_profiler.h"
+
 namespace fallout {
 
 typedef void(MemoryManagerPrintErrorProc)(const char* string);
@@ -90,7 +92,9 @@ void memoryManagerSetProcs(MallocProc* mallocProc, ReallocProc* reallocProc, Fre
 // 0x484660 mymalloc
 void* internal_malloc_safe(size_t size, const char* file, int line)
 {
+    memoryProfilerSetCallSite(file, line);
     void* ptr = gMemoryManagerMallocProc(size);
+    memoryProfilerSetCallSite(nullptr, 0);
     if (ptr == nullptr) {
         memoryManagerFatalAllocationError("malloc", size, file, line);
     }
@@ -101,7 +105,9 @@ void* internal_malloc_safe(size_t size, const char* file, int line)
 // 0x4846B4 myrealloc
 void* internal_realloc_safe(void* ptr, size_t size, const char* file, int line)
 {
+    memoryProfilerSetCallSite(file, line);
     ptr = gMemoryManagerReallocProc(ptr, size);
+    memoryProfilerSetCallSite(nullptr, 0);
     if (ptr == nullptr) {
         memoryManagerFatalAllocationError("realloc", size, file, line);
     }
@@ -123,7 +129,9 @@ void internal_free_safe(void* ptr, const char* file, int line)
 // 0x4846D8 mycalloc
 void* internal_calloc_safe(int count, int size, const char* file, int line)
 {
+    memoryProfilerSetCallSite(file, line);
     void* ptr = gMemoryManagerMallocProc(count * size);
+    memoryProfilerSetCallSite(nullptr, 0);
     if (ptr == nullptr) {
         memoryManagerFatalAllocationError("calloc", size, file, line);
     }
@@ -137,7 +145,9 @@ void* internal_calloc_safe(int count, int size, const char* file, int line)
 char* strdup_safe(const char* string, const char* file, int line)
 {
     size_t size = strlen(string) + 1;
+    memoryProfilerSetCallSite(file, line);
     char* copy = (char*)gMemoryManagerMallocProc(size);
+    memoryProfilerSetCallSite(nullptr, 0);
     if (copy == nullptr) {
         memoryManagerFatalAllocationError("strdup", size, file, line);
     }
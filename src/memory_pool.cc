@@ -0,0 +1,216 @@
+#include "memory_pool.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "memory.h"
+
+namespace fallout {
+
+// Items and headers are aligned to this boundary.
+#define MEMORY_POOL_ALIGNMENT (8)
+
+#define MEMORY_POOL_ALIGN(size) (((size) + (MEMORY_POOL_ALIGNMENT - 1)) & ~(size_t)(MEMORY_POOL_ALIGNMENT - 1))
+
+typedef struct MemoryPoolChunk {
+    struct MemoryPoolChunk* next;
+
+    // Number of live items in this chunk.
+    int usedItemsLength;
+
+    // Number of items handed out sequentially since chunk was created (or
+    // rewound).
+    int bumpItemsLength;
+} MemoryPoolChunk;
+
+// Precedes every item, used to find the chunk item belongs to.
+typedef struct MemoryPoolItemHeader {
+    MemoryPoolChunk* chunk;
+} MemoryPoolItemHeader;
+
+static size_t memoryPoolGetSlotSize(MemoryPool* pool);
+static unsigned char* memoryPoolGetSlot(MemoryPool* pool, MemoryPoolChunk* chunk, int index);
+static MemoryPoolChunk* memoryPoolAllocateChunk(MemoryPool* pool);
+static void memoryPoolUpdateCurrentChunk(MemoryPool* pool);
+
+// Returns pointer to the next recycled item stored inside free [item].
+static inline unsigned char** memoryPoolGetNextFreeItem(unsigned char* item)
+{
+    return (unsigned char**)item;
+}
+
+static inline MemoryPoolItemHeader* memoryPoolGetItemHeader(void* item)
+{
+    return (MemoryPoolItemHeader*)((unsigned char*)item - MEMORY_POOL_ALIGN(sizeof(MemoryPoolItemHeader)));
+}
+
+void memoryPoolInit(MemoryPool* pool, size_t itemSize, int chunkItemsLength)
+{
+    assert(chunkItemsLength > 0);
+
+    // Free items keep link to the next free item in place of item data.
+    if (itemSize < sizeof(unsigned char*)) {
+        itemSize = sizeof(unsigned char*);
+    }
+
+    pool->itemSize = MEMORY_POOL_ALIGN(itemSize);
+    pool->chunkItemsLength = chunkItemsLength;
+    pool->chunks = nullptr;
+    pool->lastChunk = nullptr;
+    pool->currentChunk = nullptr;
+    pool->freeItems = nullptr;
+    pool->usedItemsLength = 0;
+}
+
+void memoryPoolFree(MemoryPool* pool)
+{
+    MemoryPoolChunk* chunk = pool->chunks;
+    while (chunk != nullptr) {
+        MemoryPoolChunk* next = chunk->next;
+        internal_free(chunk);
+        chunk = next;
+    }
+
+    pool->chunks = nullptr;
+    pool->lastChunk = nullptr;
+    pool->currentChunk = nullptr;
+    pool->freeItems = nullptr;
+    pool->usedItemsLength = 0;
+}
+
+void* memoryPoolAllocate(MemoryPool* pool)
+{
+    unsigned char* item;
+    MemoryPoolChunk* chunk;
+
+    if (pool->freeItems != nullptr) {
+        item = pool->freeItems;
+        pool->freeItems = *memoryPoolGetNextFreeItem(item);
+
+        chunk = memoryPoolGetItemHeader(item)->chunk;
+    } else {
+        chunk = pool->currentChunk;
+        if (chunk == nullptr) {
+            chunk = memoryPoolAllocateChunk(pool);
+            if (chunk == nullptr) {
+                return nullptr;
+            }
+        }
+
+        unsigned char* slot = memoryPoolGetSlot(pool, chunk, chunk->bumpItemsLength);
+        chunk->bumpItemsLength++;
+
+        MemoryPoolItemHeader* header = (MemoryPoolItemHeader*)slot;
+        header->chunk = chunk;
+
+        item = slot + MEMORY_POOL_ALIGN(sizeof(MemoryPoolItemHeader));
+
+        if (chunk->bumpItemsLength == pool->chunkItemsLength) {
+            memoryPoolUpdateCurrentChunk(pool);
+        }
+    }
+
+    chunk->usedItemsLength++;
+    pool->usedItemsLength++;
+
+    return item;
+}
+
+void memoryPoolDeallocate(MemoryPool* pool, void* item)
+{
+    if (item == nullptr) {
+        return;
+    }
+
+    MemoryPoolChunk* chunk = memoryPoolGetItemHeader(item)->chunk;
+    assert(chunk->usedItemsLength > 0);
+
+    chunk->usedItemsLength--;
+    pool->usedItemsLength--;
+
+    *memoryPoolGetNextFreeItem((unsigned char*)item) = pool->freeItems;
+    pool->freeItems = (unsigned char*)item;
+}
+
+void memoryPoolTrim(MemoryPool* pool)
+{
+    bool rewound = false;
+
+    for (MemoryPoolChunk* chunk = pool->chunks; chunk != nullptr; chunk = chunk->next) {
+        if (chunk->usedItemsLength == 0 && chunk->bumpItemsLength != 0) {
+            chunk->bumpItemsLength = 0;
+            rewound = true;
+        }
+    }
+
+    if (!rewound) {
+        return;
+    }
+
+    // Drop recycled items which belong to rewound chunks, they will be handed
+    // out sequentially again.
+    unsigned char** link = &(pool->freeItems);
+    while (*link != nullptr) {
+        unsigned char* item = *link;
+        MemoryPoolChunk* chunk = memoryPoolGetItemHeader(item)->chunk;
+        if (chunk->bumpItemsLength == 0) {
+            *link = *memoryPoolGetNextFreeItem(item);
+        } else {
+            link = memoryPoolGetNextFreeItem(item);
+        }
+    }
+
+    memoryPoolUpdateCurrentChunk(pool);
+}
+
+static size_t memoryPoolGetSlotSize(MemoryPool* pool)
+{
+    return MEMORY_POOL_ALIGN(sizeof(MemoryPoolItemHeader)) + pool->itemSize;
+}
+
+static unsigned char* memoryPoolGetSlot(MemoryPool* pool, MemoryPoolChunk* chunk, int index)
+{
+    unsigned char* data = (unsigned char*)chunk + MEMORY_POOL_ALIGN(sizeof(MemoryPoolChunk));
+    return data + memoryPoolGetSlotSize(pool) * index;
+}
+
+static MemoryPoolChunk* memoryPoolAllocateChunk(MemoryPool* pool)
+{
+    size_t size = MEMORY_POOL_ALIGN(sizeof(MemoryPoolChunk)) + memoryPoolGetSlotSize(pool) * pool->chunkItemsLength;
+
+    MemoryPoolChunk* chunk = (MemoryPoolChunk*)internal_malloc(size);
+    if (chunk == nullptr) {
+        return nullptr;
+    }
+
+    chunk->next = nullptr;
+    chunk->usedItemsLength = 0;
+    chunk->bumpItemsLength = 0;
+
+    if (pool->lastChunk != nullptr) {
+        pool->lastChunk->next = chunk;
+    } else {
+        pool->chunks = chunk;
+    }
+    pool->lastChunk = chunk;
+
+    pool->currentChunk = chunk;
+
+    return chunk;
+}
+
+// Selects the first chunk which still has never used items, so that fresh
+// items are packed towards the beginning of the pool.
+static void memoryPoolUpdateCurrentChunk(MemoryPool* pool)
+{
+    pool->currentChunk = nullptr;
+
+    for (MemoryPoolChunk* chunk = pool->chunks; chunk != nullptr; chunk = chunk->next) {
+        if (chunk->bumpItemsLength < pool->chunkItemsLength) {
+            pool->currentChunk = chunk;
+            break;
+        }
+    }
+}
+
+} // namespace fallout
@@ -0,0 +1,46 @@
+#ifndef MEMORY_POOL_H
+#define MEMORY_POOL_H
+
+#include <stddef.h>
+
+namespace fallout {
+
+struct MemoryPoolChunk;
+
+// Pool of fixed size items allocated in contiguous chunks.
+//
+// Items are handed out sequentially from chunks, freed items are recycled.
+// Chunks which have no live items left can be rewound with [memoryPoolTrim],
+// so that the next batch of items is laid out contiguously again.
+typedef struct MemoryPool {
+    // Size of a single item (excluding per-item header).
+    size_t itemSize;
+
+    // Number of items in every chunk.
+    int chunkItemsLength;
+
+    // All chunks in allocation order.
+    struct MemoryPoolChunk* chunks;
+    struct MemoryPoolChunk* lastChunk;
+
+    // The first chunk which has never used items.
+    struct MemoryPoolChunk* currentChunk;
+
+    // Head of recycled items list.
+    unsigned char* freeItems;
+
+    // Number of live items across all chunks.
+    int usedItemsLength;
+} MemoryPool;
+
+void memoryPoolInit(MemoryPool* pool, size_t itemSize, int chunkItemsLength);
+void memoryPoolFree(MemoryPool* pool);
+void* memoryPoolAllocate(MemoryPool* pool);
+void memoryPoolDeallocate(MemoryPool* pool, void* item);
+
+// Rewinds chunks which have no live items.
+void memoryPoolTrim(MemoryPool* pool);
+
+} // namespace fallout
+
+#endif /* MEMORY_POOL_H */
@@ -0,0 +1,358 @@
+#include "memory_profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "debug.h"
+#include "platform_compat.h"
+
+namespace fallout {
+
+typedef std::chrono::steady_clock MemoryProfilerClock;
+
+typedef struct MemoryProfilerSiteKey {
+    const char* file;
+    int line;
+
+    // Index in [gMemoryProfilerTagPaths].
+    int tagPath;
+
+    bool operator==(const MemoryProfilerSiteKey& other) const
+    {
+        return file == other.file && line == other.line && tagPath == other.tagPath;
+    }
+} MemoryProfilerSiteKey;
+
+typedef struct MemoryProfilerSiteKeyHash {
+    size_t operator()(const MemoryProfilerSiteKey& key) const
+    {
+        size_t hash = std::hash<const void*>()(key.file);
+        hash = hash * 31 + std::hash<int>()(key.line);
+        hash = hash * 31 + std::hash<int>()(key.tagPath);
+        return hash;
+    }
+} MemoryProfilerSiteKeyHash;
+
+typedef struct MemoryProfilerSite {
+    unsigned long long allocations;
+    unsigned long long frees;
+    unsigned long long bytes;
+    long long liveBlocks;
+    long long liveBytes;
+    long long peakLiveBytes;
+
+    // Accumulated lifetime of freed blocks (in microseconds).
+    unsigned long long lifetime;
+    unsigned long long maxLifetime;
+} MemoryProfilerSite;
+
+typedef struct MemoryProfilerBlock {
+    MemoryProfilerSite* site;
+    size_t size;
+    MemoryProfilerClock::time_point timestamp;
+} MemoryProfilerBlock;
+
+typedef struct MemoryProfilerCallSite {
+    const char* file;
+    int line;
+} MemoryProfilerCallSite;
+
+static int memoryProfilerInternTagPath(int parent, const char* tag);
+static std::string memoryProfilerFormatSite(const MemoryProfilerSiteKey& key);
+static void memoryProfilerWriteReport();
+
+static std::atomic<bool> gMemoryProfilerEnabled(false);
+
+// Guards every profiler table below, allocations might come from background
+// threads.
+static std::mutex gMemoryProfilerMutex;
+
+static std::string gMemoryProfilerPath;
+
+// Interned tag paths (`tag;tag;...`), the first one is empty (untagged).
+static std::vector<std::string> gMemoryProfilerTagPaths(1);
+static std::map<std::pair<int, std::string>, int> gMemoryProfilerTagPathIndexes;
+
+static std::unordered_map<MemoryProfilerSiteKey, MemoryProfilerSite, MemoryProfilerSiteKeyHash> gMemoryProfilerSites;
+static std::unordered_map<void*, MemoryProfilerBlock> gMemoryProfilerBlocks;
+
+static long long gMemoryProfilerLiveBytes = 0;
+static long long gMemoryProfilerPeakLiveBytes = 0;
+
+// Stack of tag paths of the current thread.
+static thread_local std::vector<int> gMemoryProfilerTagStack;
+
+static thread_local MemoryProfilerCallSite gMemoryProfilerCallSite = { nullptr, 0 };
+
+void memoryProfilerStart(const char* path)
+{
+    {
+        std::lock_guard<std::mutex> lock(gMemoryProfilerMutex);
+
+        if (gMemoryProfilerEnabled) {
+            return;
+        }
+
+        gMemoryProfilerPath = path;
+        gMemoryProfilerSites.clear();
+        gMemoryProfilerBlocks.clear();
+        gMemoryProfilerLiveBytes = 0;
+        gMemoryProfilerPeakLiveBytes = 0;
+        gMemoryProfilerEnabled = true;
+    }
+
+    // NOTE: Outside of the lock, printing might allocate.
+    debugPrint("Memory profiler started, report will be written to %s\n", path);
+}
+
+void memoryProfilerStop()
+{
+    std::lock_guard<std::mutex> lock(gMemoryProfilerMutex);
+
+    if (!gMemoryProfilerEnabled) {
+        return;
+    }
+
+    gMemoryProfilerEnabled = false;
+
+    memoryProfilerWriteReport();
+
+    gMemoryProfilerSites.clear();
+    gMemoryProfilerBlocks.clear();
+}
+
+bool memoryProfilerIsEnabled()
+{
+    return gMemoryProfilerEnabled;
+}
+
+void memoryProfilerPushTag(const char* tag)
+{
+    int parent = !gMemoryProfilerTagStack.empty() ? gMemoryProfilerTagStack.back() : 0;
+
+    std::lock_guard<std::mutex> lock(gMemoryProfilerMutex);
+    gMemoryProfilerTagStack.push_back(memoryProfilerInternTagPath(parent, tag));
+}
+
+void memoryProfilerPopTag()
+{
+    if (!gMemoryProfilerTagStack.empty()) {
+        gMemoryProfilerTagStack.pop_back();
+    }
+}
+
+void memoryProfilerSetCallSite(const char* file, int line)
+{
+    gMemoryProfilerCallSite.file = file;
+    gMemoryProfilerCallSite.line = line;
+}
+
+void memoryProfilerRecordAllocation(void* ptr, size_t size, const char* file, int line)
+{
+    if (!gMemoryProfilerEnabled || ptr == nullptr) {
+        return;
+    }
+
+    MemoryProfilerSiteKey key;
+    if (gMemoryProfilerCallSite.file != nullptr) {
+        key.file = gMemoryProfilerCallSite.file;
+        key.line = gMemoryProfilerCallSite.line;
+    } else {
+        key.file = file;
+        key.line = line;
+    }
+    key.tagPath = !gMemoryProfilerTagStack.empty() ? gMemoryProfilerTagStack.back() : 0;
+
+    MemoryProfilerClock::time_point now = MemoryProfilerClock::now();
+
+    std::lock_guard<std::mutex> lock(gMemoryProfilerMutex);
+
+    // Profiler might have been stopped while we were waiting for the lock.
+    if (!gMemoryProfilerEnabled) {
+        return;
+    }
+
+    // Value initialization zeroes counters of the new site.
+    MemoryProfilerSite* site = &(gMemoryProfilerSites[key]);
+    site->allocations++;
+    site->bytes += size;
+    site->liveBlocks++;
+    site->liveBytes += size;
+    if (site->liveBytes > site->peakLiveBytes) {
+        site->peakLiveBytes = site->liveBytes;
+    }
+
+    gMemoryProfilerLiveBytes += size;
+    if (gMemoryProfilerLiveBytes > gMemoryProfilerPeakLiveBytes) {
+        gMemoryProfilerPeakLiveBytes = gMemoryProfilerLiveBytes;
+    }
+
+    MemoryProfilerBlock& block = gMemoryProfilerBlocks[ptr];
+    block.site = site;
+    block.size = size;
+    block.timestamp = now;
+}
+
+void memoryProfilerRecordFree(void* ptr)
+{
+    if (!gMemoryProfilerEnabled || ptr == nullptr) {
+        return;
+    }
+
+    MemoryProfilerClock::time_point now = MemoryProfilerClock::now();
+
+    std::lock_guard<std::mutex> lock(gMemoryProfilerMutex);
+
+    auto it = gMemoryProfilerBlocks.find(ptr);
+    if (it == gMemoryProfilerBlocks.end()) {
+        // Allocated before profiler was started.
+        return;
+    }
+
+    MemoryProfilerBlock* block = &(it->second);
+    MemoryProfilerSite* site = block->site;
+
+    unsigned long long lifetime = std::chrono::duration_cast<std::chrono::microseconds>(now - block->timestamp).count();
+
+    site->frees++;
+    site->liveBlocks--;
+    site->liveBytes -= block->size;
+    site->lifetime += lifetime;
+    site->maxLifetime = std::max(site->maxLifetime, lifetime);
+
+    gMemoryProfilerLiveBytes -= block->size;
+
+    gMemoryProfilerBlocks.erase(it);
+}
+
+// Must be called with [gMemoryProfilerMutex] held.
+static int memoryProfilerInternTagPath(int parent, const char* tag)
+{
+    auto key = std::make_pair(parent, std::string(tag));
+    auto it = gMemoryProfilerTagPathIndexes.find(key);
+    if (it != gMemoryProfilerTagPathIndexes.end()) {
+        return it->second;
+    }
+
+    std::string path = gMemoryProfilerTagPaths[parent];
+    if (!path.empty()) {
+        path += ';';
+    }
+    path += tag;
+
+    int index = static_cast<int>(gMemoryProfilerTagPaths.size());
+    gMemoryProfilerTagPaths.push_back(path);
+    gMemoryProfilerTagPathIndexes[key] = index;
+
+    return index;
+}
+
+// Builds `tag;...;file.cc:line` (without directories of source file).
+static std::string memoryProfilerFormatSite(const MemoryProfilerSiteKey& key)
+{
+    std::string name = gMemoryProfilerTagPaths[key.tagPath];
+    if (!name.empty()) {
+        name += ';';
+    }
+
+    if (key.file != nullptr) {
+        const char* file = key.file;
+        const char* separator = strrchr(file, '/');
+        if (separator != nullptr) {
+            file = separator + 1;
+        }
+
+        separator = strrchr(file, '\\');
+        if (separator != nullptr) {
+            file = separator + 1;
+        }
+
+        name += file;
+        name += ':';
+        name += std::to_string(key.line);
+    } else {
+        name += "unknown";
+    }
+
+    return name;
+}
+
+// Must be called with [gMemoryProfilerMutex] held.
+static void memoryProfilerWriteReport()
+{
+    // The same source location can be seen through different `__FILE__`
+    // pointers, merge them by name.
+    std::map<std::string, MemoryProfilerSite> sites;
+    unsigned long long allocations = 0;
+    unsigned long long bytes = 0;
+
+    for (auto& pair : gMemoryProfilerSites) {
+        const MemoryProfilerSite& source = pair.second;
+        MemoryProfilerSite& site = sites[memoryProfilerFormatSite(pair.first)];
+        site.allocations += source.allocations;
+        site.frees += source.frees;
+        site.bytes += source.bytes;
+        site.liveBlocks += source.liveBlocks;
+        site.liveBytes += source.liveBytes;
+        site.peakLiveBytes += source.peakLiveBytes;
+        site.lifetime += source.lifetime;
+        site.maxLifetime = std::max(site.maxLifetime, source.maxLifetime);
+
+        allocations += source.allocations;
+        bytes += source.bytes;
+    }
+
+    FILE* stream = compat_fopen(gMemoryProfilerPath.c_str(), "wt");
+    if (stream == nullptr) {
+        debugPrint("memoryProfilerWriteReport: unable to open %s\n", gMemoryProfilerPath.c_str());
+        return;
+    }
+
+    for (auto& pair : sites) {
+        fprintf(stream, "%s %llu\n", pair.first.c_str(), pair.second.bytes);
+    }
+
+    fclose(stream);
+
+    std::string tablePath = gMemoryProfilerPath + ".csv";
+    stream = compat_fopen(tablePath.c_str(), "wt");
+    if (stream == nullptr) {
+        debugPrint("memoryProfilerWriteReport: unable to open %s\n", tablePath.c_str());
+        return;
+    }
+
+    fputs("site,allocations,frees,bytes,peak_live_bytes,live_blocks,live_bytes,avg_lifetime_us,max_lifetime_us\n", stream);
+
+    for (auto& pair : sites) {
+        const MemoryProfilerSite& site = pair.second;
+        fprintf(stream, "\"%s\",%llu,%llu,%llu,%lld,%lld,%lld,%llu,%llu\n",
+            pair.first.c_str(),
+            site.allocations,
+            site.frees,
+            site.bytes,
+            site.peakLiveBytes,
+            site.liveBlocks,
+            site.liveBytes,
+            site.frees != 0 ? site.lifetime / site.frees : 0,
+            site.maxLifetime);
+    }
+
+    fclose(stream);
+
+    debugPrint("Memory profile: %llu allocations, %llu bytes, peak %lld bytes live, %lld bytes still live\n",
+        allocations,
+        bytes,
+        gMemoryProfilerPeakLiveBytes,
+        gMemoryProfilerLiveBytes);
+}
+
+} // namespace fallout
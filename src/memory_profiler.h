@@ -0,0 +1,55 @@
+#ifndef MEMORY_PROFILER_H
+#define MEMORY_PROFILER_H
+
+#include <stddef.h>
+
+namespace fallout {
+
+// Starts recording every allocation made with `internal_malloc` and friends.
+// The report is written to [path] when profiler is stopped. Allocations made
+// before profiler is started are not tracked.
+void memoryProfilerStart(const char* path);
+
+// Writes report and stops recording.
+//
+// The report at [path] is in folded stacks format (one `tag;...;site bytes`
+// line per call site) which can be fed directly into flame graph tools. The
+// detailed per-site table (counts, bytes, peak, lifetime, blocks still alive)
+// is written next to it as CSV (`<path>.csv`).
+void memoryProfilerStop();
+
+bool memoryProfilerIsEnabled();
+
+// Adds subsystem [tag] to allocations made on the current thread until the
+// matching [memoryProfilerPopTag]. Tags nest.
+void memoryProfilerPushTag(const char* tag);
+void memoryProfilerPopTag();
+
+// Overrides call site of allocations made on the current thread until reset
+// with `nullptr` [file]. Used by allocation wrappers which receive call site
+// from their callers.
+void memoryProfilerSetCallSite(const char* file, int line);
+
+void memoryProfilerRecordAllocation(void* ptr, size_t size, const char* file, int line);
+void memoryProfilerRecordFree(void* ptr);
+
+// Tags allocations made during the lifetime of the object.
+class MemoryProfilerScope {
+public:
+    explicit MemoryProfilerScope(const char* tag)
+    {
+        memoryProfilerPushTag(tag);
+    }
+
+    ~MemoryProfilerScope()
+    {
+        memoryProfilerPopTag();
+    }
+
+    MemoryProfilerScope(const MemoryProfilerScope&) = delete;
+    MemoryProfilerScope& operator=(const MemoryProfilerScope&) = delete;
+};
+
+} // namespace fallout
+
+#endif /* MEMORY_PROFILER_H */
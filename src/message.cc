@@ -34,6 +34,17 @@ static constexpr int kLastPersistentMessageListId = 0x2FFF;
 static constexpr int kFirstTemporaryMessageListId = 0x3000;
 static constexpr int kLastTemporaryMessageListId = 0x3FFF;
 
+// A source of characters for message file parser.
+//
+// Message files are read either directly from memory (when file contents is
+// accessible via [dbGetFileView]), or from text stream.
+typedef struct MessageFileReader {
+    File* stream;
+    const unsigned char* data;
+    int size;
+    int position;
+} MessageFileReader;
+
 struct MessageListRepositoryState {
     std::array<MessageList*, STANDARD_MESSAGE_LIST_COUNT> standardMessageLists;
     std::array<MessageList*, PROTO_MESSAGE_LIST_COUNT> protoMessageLists;
@@ -46,7 +57,11 @@ struct MessageListRepositoryState {
 static bool _message_find(MessageList* msg, int num, int* out_index);
 static bool _message_add(MessageList* msg, MessageListItem* new_entry);
 static bool _message_parse_number(int* out_num, const char* str);
-static int _message_load_field(File* file, char* str);
+static int _message_load_field(MessageFileReader* reader, char* str);
+static int messageFileReaderReadChar(MessageFileReader* reader);
+static bool messageFileReaderOpen(MessageFileReader* reader, const char* path);
+static void messageFileReaderClose(MessageFileReader* reader);
+static long messageFileReaderTell(MessageFileReader* reader);
 
 static MessageList* messageListRepositoryLoad(const char* path);
 
@@ -215,7 +230,7 @@ bool messageListFree(MessageList* messageList)
 bool messageListLoad(MessageList* messageList, const char* path)
 {
     char localized_path[COMPAT_MAX_PATH];
-    File* file_ptr;
+    MessageFileReader reader;
     char num[MESSAGE_LIST_ITEM_FIELD_MAX_SIZE];
     char audio[MESSAGE_LIST_ITEM_FIELD_MAX_SIZE];
     char text[MESSAGE_LIST_ITEM_FIELD_MAX_SIZE];
@@ -235,36 +250,34 @@ bool messageListLoad(MessageList* messageList, const char* path)
 
     snprintf(localized_path, sizeof(localized_path), "%s\\%s\\%s", "text", settings.system.language.c_str(), path);
 
-    file_ptr = fileOpen(localized_path, "rt");
-
     // SFALL: Fallback to english if requested localization does not exist.
-    if (file_ptr == nullptr) {
+    if (!messageFileReaderOpen(&reader, localized_path)) {
         if (compat_stricmp(settings.system.language.c_str(), ENGLISH) != 0) {
             snprintf(localized_path, sizeof(localized_path), "%s\\%s\\%s", "text", ENGLISH, path);
-            file_ptr = fileOpen(localized_path, "rt");
+            if (!messageFileReaderOpen(&reader, localized_path)) {
+                return false;
+            }
+        } else {
+            return false;
         }
     }
 
-    if (file_ptr == nullptr) {
-        return false;
-    }
-
     entry.num = 0;
     entry.audio = audio;
     entry.text = text;
 
     while (1) {
-        rc = _message_load_field(file_ptr, num);
+        rc = _message_load_field(&reader, num);
         if (rc != 0) {
             break;
         }
 
-        if (_message_load_field(file_ptr, audio) != 0) {
+        if (_message_load_field(&reader, audio) != 0) {
             debugPrint("\nError loading audio field.\n", localized_path);
             goto err;
         }
 
-        if (_message_load_field(file_ptr, text) != 0) {
+        if (_message_load_field(&reader, text) != 0) {
             debugPrint("\nError loading text field.\n", localized_path);
             goto err;
         }
@@ -287,10 +300,10 @@ bool messageListLoad(MessageList* messageList, const char* path)
 err:
 
     if (!success) {
-        debugPrint("Error loading message file %s at offset %lx.", localized_path, static_cast<unsigned long>(fileTell(file_ptr)));
+        debugPrint("Error loading message file %s at offset %lx.", localized_path, static_cast<unsigned long>(messageFileReaderTell(&reader)));
     }
 
-    fileClose(file_ptr);
+    messageFileReaderClose(&reader);
 
     return success;
 }
@@ -481,7 +494,7 @@ static bool _message_parse_number(int* out_num, const char* str)
 // 4 - limit exceeded (> `MESSAGE_LIST_ITEM_FIELD_MAX_SIZE`)
 //
 // 0x484FB4 message_load_field
-static int _message_load_field(File* file, char* str)
+static int _message_load_field(MessageFileReader* reader, char* str)
 {
     int ch;
     int len;
@@ -489,7 +502,7 @@ static int _message_load_field(File* file, char* str)
     len = 0;
 
     while (1) {
-        ch = fileReadChar(file);
+        ch = messageFileReaderReadChar(reader);
         if (ch == -1) {
             return 1;
         }
@@ -505,7 +518,7 @@ static int _message_load_field(File* file, char* str)
     }
 
     while (1) {
-        ch = fileReadChar(file);
+        ch = messageFileReaderReadChar(reader);
 
         if (ch == -1) {
             debugPrint("\nError reading message file - EOF reached.\n");
@@ -531,6 +544,61 @@ static int _message_load_field(File* file, char* str)
     return 0;
 }
 
+// Opens message file at [path], preferring direct access to it's contents.
+static bool messageFileReaderOpen(MessageFileReader* reader, const char* path)
+{
+    reader->stream = nullptr;
+    reader->position = 0;
+
+    reader->data = dbGetFileView(path, &(reader->size));
+    if (reader->data != nullptr) {
+        return true;
+    }
+
+    reader->stream = fileOpen(path, "rt");
+    return reader->stream != nullptr;
+}
+
+static void messageFileReaderClose(MessageFileReader* reader)
+{
+    if (reader->stream != nullptr) {
+        fileClose(reader->stream);
+        reader->stream = nullptr;
+    }
+
+    reader->data = nullptr;
+}
+
+// Reads next character the same way [fileReadChar] does for text streams
+// (that is \r\n sequence is reported as \n).
+static int messageFileReaderReadChar(MessageFileReader* reader)
+{
+    if (reader->stream != nullptr) {
+        return fileReadChar(reader->stream);
+    }
+
+    if (reader->position >= reader->size) {
+        return -1;
+    }
+
+    int ch = reader->data[reader->position++];
+    if (ch == '\r' && reader->position < reader->size && reader->data[reader->position] == '\n') {
+        ch = '\n';
+        reader->position++;
+    }
+
+    return ch;
+}
+
+static long messageFileReaderTell(MessageFileReader* reader)
+{
+    if (reader->stream != nullptr) {
+        return fileTell(reader->stream);
+    }
+
+    return reader->position;
+}
+
 // 0x48504C getmsg
 char* getmsg(MessageList* msg, MessageListItem* entry, int num)
 {
@@ -301,6 +301,10 @@ static void movieDirectImpl(unsigned char* pixels, int src_width, int src_height
 
     if (movieOutputRect.w == src_width && movieOutputRect.h == src_height) {
         movieDirectOverlay.active = false;
+
+        // Movie frame goes directly to screen, make sure pending window
+        // refreshes do not end up on top of it.
+        windowFlushDamage();
         _scr_blit(pixels, src_width, src_height, 0, 0, src_width, src_height, movieOutputRect.x, movieOutputRect.y);
     } else {
         // we're scaling, so use an SDL overlay to render
@@ -1,9 +1,11 @@
 #include "object.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <string.h>
 
 #include <algorithm>
+#include <unordered_map>
 #include <vector>
 
 #include "animation.h"
@@ -14,6 +16,7 @@
 #include "critter.h"
 #include "debug.h"
 #include "draw.h"
+#include "frame_profiler.h"
 #include "game.h"
 #include "game_mouse.h"
 #include "item.h"
@@ -21,6 +24,7 @@
 #include "map.h"
 #include "map_defs.h"
 #include "memory.h"
+#include "memory_pool.h"
 #include "party_member.h"
 #include "proto.h"
 #include "proto_instance.h"
@@ -33,6 +37,48 @@
 
 namespace fallout {
 
+#define OBJECT_POOL_CHUNK_ITEMS_LENGTH (256)
+#define OBJECT_LIST_NODE_POOL_CHUNK_ITEMS_LENGTH (1024)
+
+// Size of a cell of [gObjectPickCells] in pixels.
+#define OBJECT_PICK_CELL_SIZE (128)
+
+// Space around hex grid covered by [gObjectPickCells], objects can stick
+// out of the grid.
+#define OBJECT_PICK_GRID_MARGIN (512)
+
+// Range of [gObjectPickCells] an object is registered in.
+typedef struct ObjectPickEntry {
+    int elevation;
+    int minCellX;
+    int minCellY;
+    int maxCellX;
+    int maxCellY;
+} ObjectPickEntry;
+
+// Object prepared for drawing by [objectRenderEntryPrepare].
+typedef struct ObjectRenderEntry {
+    // Null for entries which draw edge squares instead of object.
+    Object* object;
+    ObjectType type;
+    Art* art;
+    CacheEntry* cacheEntry;
+
+    // Object bounds on screen, not clipped.
+    Rect rect;
+    int light;
+    bool hasSpans;
+    ArtFrameSpans spans;
+
+    // Locked when object is see-through where it overlaps the egg.
+    Art* egg;
+    CacheEntry* eggCacheEntry;
+    Rect eggRect;
+
+    // See [tileRenderEdgeBlackSquares].
+    bool edgeOnTop;
+} ObjectRenderEntry;
+
 static int objectLoadAllInternal(File* stream);
 static void _object_fix_weapon_ammo(Object* obj);
 static int objectWrite(Object* obj, File* stream);
@@ -59,8 +105,19 @@ static int _obj_remove(ObjectListNode* a1, ObjectListNode* a2);
 static int _obj_connect_to_tile(ObjectListNode* node, int tile_index, int elev, Rect* rect);
 static int _obj_adjust_light(Object* obj, int a2, Rect* rect);
 static void objectDrawOutline(Object* object, Rect* rect);
+static void objectsRenderPreRoof(Rect* rect, int elevation, bool deferred);
+static void objectsRenderPreRoofObject(Object* object, Rect* rect, int light, bool deferred);
+static void objectsRenderPreRoofEdge(Rect* rect, int elevation, bool drawOnTop, bool deferred);
 static void _obj_render_object(Object* object, Rect* rect, int light);
+static bool objectRenderEntryPrepare(ObjectRenderEntry* entry, Object* object, Rect* rect, int light);
+static void objectRenderEntryDraw(ObjectRenderEntry* entry, Rect* rect);
+static void objectRenderEntryRelease(ObjectRenderEntry* entry);
 static int _obj_preload_sort(const void* a1, const void* a2);
+static void objectPickInit();
+static void objectPickExit();
+static void objectPickUpdate(Object* object);
+static void objectPickRemove(Object* object);
+static void objectPickGetCell(int screenX, int screenY, int* cellX, int* cellY);
 static Object* objectPrepareWhoHitMeForSave(CritterCombatData* combatData);
 
 // 0x5195F8 objInitialized
@@ -101,6 +158,11 @@ static ObjectListNode** _renderTable = nullptr;
 // 0x519628 floatingObjects
 static ObjectListNode* gObjectListHead = nullptr;
 
+// Backing storage for objects and list nodes. Chunks are rewound when map is
+// unloaded, see [_obj_remove_all].
+static MemoryPool gObjectPool;
+static MemoryPool gObjectListNodePool;
+
 // 0x51962C centerToUpperLeft
 static int _centerToUpperLeft = 0;
 
@@ -253,6 +315,23 @@ static Rect gObjectsWindowRect;
 // Likely outlined objects on the screen.
 static std::vector<Object*> outlinedObjects;
 
+// Objects collected by [objectsPrepareDeferredPreRoof] in drawing order.
+static std::vector<ObjectRenderEntry> gObjectsDeferredEntries;
+
+// Area and elevation of collected objects.
+static Rect gObjectsDeferredRect;
+static int gObjectsDeferredElevation;
+
+// Grid of object bounds on screen used to find objects under mouse, see
+// [_obj_create_intersect_list]. Bounds are relative to the screen position of
+// tile 0, so the grid stays valid when map is scrolled.
+static std::vector<std::vector<Object*>> gObjectPickCells[ELEVATION_COUNT];
+static std::unordered_map<Object*, ObjectPickEntry> gObjectPickEntries;
+static int gObjectPickGridLeft;
+static int gObjectPickGridTop;
+static int gObjectPickGridWidth = 0;
+static int gObjectPickGridHeight = 0;
+
 // 0x639D90 updateAreaPixelBounds
 static Rect gObjectsUpdateAreaPixelBounds;
 
@@ -305,6 +384,10 @@ int objectsInit(unsigned char* buf, int width, int height, int pitch)
     int eggFid;
 
     memset(_obj_seen, 0, 5001);
+
+    memoryPoolInit(&gObjectPool, sizeof(Object), OBJECT_POOL_CHUNK_ITEMS_LENGTH);
+    memoryPoolInit(&gObjectListNodePool, sizeof(ObjectListNode), OBJECT_LIST_NODE_POOL_CHUNK_ITEMS_LENGTH);
+
     gObjectsUpdateAreaPixelBounds.right = width + 320;
     gObjectsUpdateAreaPixelBounds.left = -320;
     gObjectsUpdateAreaPixelBounds.bottom = height + 240;
@@ -316,6 +399,8 @@ int objectsInit(unsigned char* buf, int width, int height, int pitch)
 
     memset(gObjectListHeadByTile, 0, sizeof(gObjectListHeadByTile));
 
+    objectPickInit();
+
     if (_obj_offset_table_init() == -1) {
         return -1;
     }
@@ -422,6 +507,11 @@ void objectsExit()
         _obj_order_table_exit();
 
         _obj_offset_table_exit();
+
+        objectPickExit();
+
+        memoryPoolFree(&gObjectListNodePool);
+        memoryPoolFree(&gObjectPool);
     }
 }
 
@@ -593,8 +683,7 @@ static int objectLoadAllInternal(File* stream)
                     }
 
                     if (fixMapInventory) {
-                        inventoryItem->item = (Object*)internal_malloc(sizeof(Object));
-                        if (inventoryItem->item == nullptr) {
+                        if (objectAllocate(&(inventoryItem->item)) == -1) {
                             debugPrint("Error loading inventory\n");
                             return -1;
                         }
@@ -778,6 +867,49 @@ int objectSaveAll(File* stream)
 
 // 0x489550 obj_render_pre_roof
 void _obj_render_pre_roof(Rect* rect, int elevation)
+{
+    FrameProfilerZone profilerZone("_obj_render_pre_roof");
+    objectsRenderPreRoof(rect, elevation, false);
+}
+
+void objectsPrepareDeferredPreRoof(Rect* rect, int elevation)
+{
+    objectsRenderPreRoof(rect, elevation, true);
+}
+
+void objectsRenderDeferredPreRoof(Rect* rect)
+{
+    if (gObjectsDeferredEntries.empty()) {
+        return;
+    }
+
+    Rect clippedRect;
+    if (rectIntersection(rect, &gObjectsDeferredRect, &clippedRect) != 0) {
+        return;
+    }
+
+    for (ObjectRenderEntry& entry : gObjectsDeferredEntries) {
+        if (entry.object != nullptr) {
+            objectRenderEntryDraw(&entry, &clippedRect);
+        } else {
+            tileRenderEdgeBlackSquares(&clippedRect, gObjectsDeferredElevation, entry.edgeOnTop);
+        }
+    }
+}
+
+void objectsFinishDeferredPreRoof()
+{
+    for (ObjectRenderEntry& entry : gObjectsDeferredEntries) {
+        objectRenderEntryRelease(&entry);
+    }
+
+    gObjectsDeferredEntries.clear();
+}
+
+// Draws flat objects, then edge squares, then the rest of objects and edge
+// squares on top. When [deferred] is set, nothing is drawn, instead objects
+// are prepared and appended to [gObjectsDeferredEntries] in the same order.
+static void objectsRenderPreRoof(Rect* rect, int elevation, bool deferred)
 {
     if (!gObjectsInitialized) {
         return;
@@ -788,6 +920,11 @@ void _obj_render_pre_roof(Rect* rect, int elevation)
         return;
     }
 
+    if (deferred) {
+        gObjectsDeferredRect = updatedRect;
+        gObjectsDeferredElevation = elevation;
+    }
+
     int ambientIntensity = lightGetAmbientIntensity();
     int minX = updatedRect.left - 320;
     int minY = updatedRect.top - 240;
@@ -826,7 +963,7 @@ void _obj_render_pre_roof(Rect* rect, int elevation)
                     }
 
                     if ((objectListNode->obj->flags & OBJECT_HIDDEN) == OBJECT_NONE) {
-                        _obj_render_object(objectListNode->obj, &updatedRect, lightIntensity);
+                        objectsRenderPreRoofObject(objectListNode->obj, &updatedRect, lightIntensity, deferred);
 
                         if (objectHasVisibleOutline(objectListNode->obj)) {
                             outlinedObjects.push_back(objectListNode->obj);
@@ -843,7 +980,7 @@ void _obj_render_pre_roof(Rect* rect, int elevation)
         }
     }
 
-    tileRenderEdgeBlackSquares(&updatedRect, elevation, false);
+    objectsRenderPreRoofEdge(&updatedRect, elevation, false, deferred);
 
     for (int i = 0; i < renderCount; i++) {
         int lightIntensity = ambientIntensity;
@@ -862,7 +999,7 @@ void _obj_render_pre_roof(Rect* rect, int elevation)
 
             if (elevation == objectListNode->obj->elevation) {
                 if ((objectListNode->obj->flags & OBJECT_HIDDEN) == OBJECT_NONE) {
-                    _obj_render_object(object, &updatedRect, lightIntensity);
+                    objectsRenderPreRoofObject(object, &updatedRect, lightIntensity, deferred);
 
                     if (objectHasVisibleOutline(objectListNode->obj)) {
                         outlinedObjects.push_back(objectListNode->obj);
@@ -874,7 +1011,32 @@ void _obj_render_pre_roof(Rect* rect, int elevation)
         }
     }
 
-    tileRenderEdgeBlackSquares(&updatedRect, elevation, true);
+    objectsRenderPreRoofEdge(&updatedRect, elevation, true, deferred);
+}
+
+static void objectsRenderPreRoofObject(Object* object, Rect* rect, int light, bool deferred)
+{
+    if (!deferred) {
+        _obj_render_object(object, rect, light);
+        return;
+    }
+
+    ObjectRenderEntry entry;
+    if (objectRenderEntryPrepare(&entry, object, rect, light)) {
+        gObjectsDeferredEntries.push_back(entry);
+    }
+}
+
+static void objectsRenderPreRoofEdge(Rect* rect, int elevation, bool drawOnTop, bool deferred)
+{
+    if (!deferred) {
+        tileRenderEdgeBlackSquares(rect, elevation, drawOnTop);
+        return;
+    }
+
+    ObjectRenderEntry entry = {};
+    entry.edgeOnTop = drawOnTop;
+    gObjectsDeferredEntries.push_back(entry);
 }
 
 // 0x4897EC obj_render_post_roof
@@ -1140,12 +1302,13 @@ int _obj_disconnect(Object* obj, Rect* rect)
         }
     }
 
-    if (node != nullptr) {
-        internal_free(node);
-    }
+    // NOTE: Uninline.
+    objectListNodeDestroy(&node);
 
     obj->tile = -1;
 
+    objectPickRemove(obj);
+
     return 0;
 }
 
@@ -1556,6 +1719,8 @@ int objectSetFid(Object* obj, int fid, Rect* dirtyRect)
         obj->fid = fid;
     }
 
+    objectPickUpdate(obj);
+
     return 0;
 }
 
@@ -1595,6 +1760,8 @@ int objectSetFrame(Object* obj, int frame, Rect* rect)
         obj->frame = frame;
     }
 
+    objectPickUpdate(obj);
+
     return 0;
 }
 
@@ -1637,6 +1804,8 @@ int objectSetNextFrame(Object* obj, Rect* dirtyRect)
         obj->frame = nextFrame;
     }
 
+    objectPickUpdate(obj);
+
     return 0;
 }
 
@@ -1677,6 +1846,8 @@ int objectSetPrevFrame(Object* obj, Rect* dirtyRect)
         obj->frame = prevFrame;
     }
 
+    objectPickUpdate(obj);
+
     return 0;
 }
 
@@ -1702,6 +1873,8 @@ int objectSetRotation(Object* obj, Rotation rotation, Rect* dirtyRect)
         obj->rotation = rotation;
     }
 
+    objectPickUpdate(obj);
+
     return 0;
 }
 
@@ -1730,7 +1903,9 @@ int objectRotateCounterClockwise(Object* obj, Rect* dirtyRect)
 // 0x48AC54 obj_rebuild_all_light
 void _obj_rebuild_all_light()
 {
-    lightResetTileIntensity();
+    // Sources are re-added over the ones added before, only lights which
+    // actually changed touch tile intensities and get redrawn.
+    lightBeginRebuild();
 
     for (int tile = 0; tile < HEX_GRID_SIZE; tile++) {
         ObjectListNode* objectListNode = gObjectListHeadByTile[tile];
@@ -1739,6 +1914,8 @@ void _obj_rebuild_all_light()
             objectListNode = objectListNode->next;
         }
     }
+
+    lightEndRebuild();
 }
 
 // 0x48AC90 obj_set_light
@@ -2171,6 +2348,11 @@ void _obj_remove_all()
     _obj_last_elev = -1;
     _obj_last_is_empty = true;
     _obj_last_roof_x = -1;
+
+    // Rewind chunks emptied by map teardown so objects and nodes of the next
+    // map are allocated contiguously.
+    memoryPoolTrim(&gObjectPool);
+    memoryPoolTrim(&gObjectListNodePool);
 }
 
 // 0x48B3A8 obj_find_first
@@ -2777,120 +2959,6 @@ void objectListFree(Object** objectList)
     }
 }
 
-// 0x48BDD8 translucent_trans_buf_to_buf
-void _translucent_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, Color* blendTable, Color* colorTable)
-{
-    dest += destPitch * destY + destX;
-    int srcStep = srcPitch - srcWidth;
-    int destStep = destPitch - srcWidth;
-
-    for (int y = 0; y < srcHeight; y++) {
-        for (int x = 0; x < srcWidth; x++) {
-            Color v1 = colorTable[*src];
-            Color* v2 = blendTable + (v1 << 8);
-            unsigned char v3 = *dest;
-
-            *dest = v2[v3];
-
-            src++;
-            dest++;
-        }
-
-        src += srcStep;
-        dest += destStep;
-    }
-}
-
-// 0x48BEFC dark_trans_buf_to_buf
-void _dark_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, int intensity)
-{
-    unsigned char* sp = src;
-    unsigned char* dp = dest + destPitch * destY + destX;
-
-    int srcStep = srcPitch - srcWidth;
-    int destStep = destPitch - srcWidth;
-    int intensityIndex = intensity / 512;
-
-    for (int y = 0; y < srcHeight; y++) {
-        for (int x = 0; x < srcWidth; x++) {
-            unsigned char color = *sp;
-            if (color != 0) {
-                if (color < 0xE5) {
-                    color = intensityColorTable[color][intensityIndex];
-                }
-
-                *dp = color;
-            }
-
-            sp++;
-            dp++;
-        }
-
-        sp += srcStep;
-        dp += destStep;
-    }
-}
-
-// 0x48BF88 dark_translucent_trans_buf_to_buf
-void _dark_translucent_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, int intensity, Color* blendTable, Color* colorTable)
-{
-    int srcStep = srcPitch - srcWidth;
-    int destStep = destPitch - srcWidth;
-    int intensityIndex = intensity / 512;
-
-    dest += destPitch * destY + destX;
-
-    for (int y = 0; y < srcHeight; y++) {
-        for (int x = 0; x < srcWidth; x++) {
-            unsigned char srcByte = *src;
-            if (srcByte != 0) {
-                unsigned char destByte = *dest;
-                unsigned int index = colorTable[srcByte] << 8;
-                index = blendTable[index + destByte];
-                *dest = intensityColorTable[index][intensityIndex];
-            }
-
-            src++;
-            dest++;
-        }
-
-        src += srcStep;
-        dest += destStep;
-    }
-}
-
-// 0x48C03C intensity_mask_buf_to_buf
-void _intensity_mask_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destPitch, unsigned char* mask, int maskPitch, int intensity)
-{
-    int srcStep = srcPitch - srcWidth;
-    int destStep = destPitch - srcWidth;
-    int maskStep = maskPitch - srcWidth;
-    int intensityIndex = intensity / 512;
-
-    for (int y = 0; y < srcHeight; y++) {
-        for (int x = 0; x < srcWidth; x++) {
-            unsigned char color = *src;
-            if (color != 0) {
-                color = intensityColorTable[color][intensityIndex];
-                if (*mask != 0) {
-                    unsigned char v1 = intensityColorTable[*dest][128 - *mask];
-                    unsigned char v2 = intensityColorTable[color][*mask];
-                    color = colorMixAddTable[v2][v1];
-                }
-                *dest = color;
-            }
-
-            src++;
-            dest++;
-            mask++;
-        }
-
-        src += srcStep;
-        dest += destStep;
-        mask += maskStep;
-    }
-}
-
 // 0x48C2B4 obj_outline_object
 int objectSetOutline(Object* obj, OutlineType outlineType, Rect* rect)
 {
@@ -3029,50 +3097,190 @@ ObjectFlags _obj_intersects_with(Object* object, int x, int y)
 // 0x48C5C4 obj_create_intersect_list
 int _obj_create_intersect_list(int x, int y, int elevation, ObjectType objectType, ObjectWithFlags** entriesPtr)
 {
-    int upperLeftTile = tileFromScreenXY(x - 320, y - 240, true);
     *entriesPtr = nullptr;
 
     if (gObjectsUpdateAreaHexSize <= 0) {
         return 0;
     }
 
-    int count = 0;
+    if (!elevationIsValid(elevation) || gObjectPickGridWidth == 0) {
+        return 0;
+    }
 
-    int parity = gCenterTile & 1;
-    for (int index = 0; index < gObjectsUpdateAreaHexSize; index++) {
-        int offsetIndex = _orderTable[parity][index];
-        if (_offsetDivTable[offsetIndex] < 30 && _offsetModTable[offsetIndex] < 20) {
-            int tile = _offsetTable[parity][offsetIndex] + upperLeftTile;
-            ObjectListNode* objectListNode = hexGridTileIsValid(tile)
-                ? gObjectListHeadByTile[tile]
-                : nullptr;
-            while (objectListNode != nullptr) {
-                Object* object = objectListNode->obj;
-                if (object->elevation > elevation) {
-                    break;
-                }
+    int cellX;
+    int cellY;
+    objectPickGetCell(x, y, &cellX, &cellY);
 
-                if (object->elevation == elevation
-                    && (objectType == OBJ_TYPE_INVALID || objectTypeFromFid(object->fid) == objectType)
-                    && object != gEgg) {
-                    ObjectFlags flags = _obj_intersects_with(object, x, y);
-                    if (flags != OBJECT_NONE) {
-                        ObjectWithFlags* entries = (ObjectWithFlags*)internal_realloc(*entriesPtr, sizeof(*entries) * (count + 1));
-                        if (entries != nullptr) {
-                            *entriesPtr = entries;
-                            entries[count].object = object;
-                            entries[count].flags = flags;
-                            count++;
-                        }
-                    }
-                }
+    // Hits are reported in drawing order - by tile, then by position in the
+    // list of objects on that tile.
+    struct Hit {
+        int tile;
+        int position;
+        ObjectWithFlags entry;
+    };
 
-                objectListNode = objectListNode->next;
+    std::vector<Hit> hits;
+    for (Object* object : gObjectPickCells[elevation][gObjectPickGridWidth * cellY + cellX]) {
+        if (object->elevation != elevation
+            || object == gEgg
+            || (objectType != OBJ_TYPE_INVALID && objectTypeFromFid(object->fid) != objectType)) {
+            continue;
+        }
+
+        ObjectFlags flags = _obj_intersects_with(object, x, y);
+        if (flags == OBJECT_NONE) {
+            continue;
+        }
+
+        int position = 0;
+        ObjectListNode* objectListNode = gObjectListHeadByTile[object->tile];
+        while (objectListNode != nullptr && objectListNode->obj != object) {
+            objectListNode = objectListNode->next;
+            position++;
+        }
+
+        Hit hit;
+        hit.tile = object->tile;
+        hit.position = position;
+        hit.entry.object = object;
+        hit.entry.flags = flags;
+        hits.push_back(hit);
+    }
+
+    if (hits.empty()) {
+        return 0;
+    }
+
+    std::sort(hits.begin(), hits.end(), [](const Hit& a, const Hit& b) {
+        return a.tile != b.tile ? a.tile < b.tile : a.position < b.position;
+    });
+
+    ObjectWithFlags* entries = (ObjectWithFlags*)internal_malloc(sizeof(*entries) * hits.size());
+    if (entries == nullptr) {
+        return 0;
+    }
+
+    for (size_t index = 0; index < hits.size(); index++) {
+        entries[index] = hits[index].entry;
+    }
+
+    *entriesPtr = entries;
+
+    return static_cast<int>(hits.size());
+}
+
+// Sets up [gObjectPickCells] to cover the whole hex grid.
+static void objectPickInit()
+{
+    int originX;
+    int originY;
+    tileToScreenXY(0, &originX, &originY);
+
+    std::vector<int> tiles(HEX_GRID_SIZE);
+    for (int tile = 0; tile < HEX_GRID_SIZE; tile++) {
+        tiles[tile] = tile;
+    }
+
+    std::vector<int> screenX(HEX_GRID_SIZE);
+    std::vector<int> screenY(HEX_GRID_SIZE);
+    tileToScreenXYMany(tiles.data(), HEX_GRID_SIZE, screenX.data(), screenY.data());
+
+    int minX = INT_MAX;
+    int minY = INT_MAX;
+    int maxX = INT_MIN;
+    int maxY = INT_MIN;
+    for (int tile = 0; tile < HEX_GRID_SIZE; tile++) {
+        minX = std::min(minX, screenX[tile] - originX);
+        minY = std::min(minY, screenY[tile] - originY);
+        maxX = std::max(maxX, screenX[tile] - originX);
+        maxY = std::max(maxY, screenY[tile] - originY);
+    }
+
+    gObjectPickGridLeft = minX - OBJECT_PICK_GRID_MARGIN;
+    gObjectPickGridTop = minY - OBJECT_PICK_GRID_MARGIN;
+    gObjectPickGridWidth = (maxX - minX + 2 * OBJECT_PICK_GRID_MARGIN) / OBJECT_PICK_CELL_SIZE + 1;
+    gObjectPickGridHeight = (maxY - minY + 2 * OBJECT_PICK_GRID_MARGIN) / OBJECT_PICK_CELL_SIZE + 1;
+
+    for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+        gObjectPickCells[elevation].assign(gObjectPickGridWidth * gObjectPickGridHeight, std::vector<Object*>());
+    }
+}
+
+static void objectPickExit()
+{
+    for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+        gObjectPickCells[elevation].clear();
+    }
+
+    gObjectPickEntries.clear();
+    gObjectPickGridWidth = 0;
+    gObjectPickGridHeight = 0;
+}
+
+// Registers current bounds of [object]. Must be called whenever they change.
+// Objects which are not on the hex grid are removed.
+static void objectPickUpdate(Object* object)
+{
+    objectPickRemove(object);
+
+    if (object->tile == -1 || !elevationIsValid(object->elevation) || gObjectPickGridWidth == 0) {
+        return;
+    }
+
+    Rect rect;
+    objectGetRect(object, &rect);
+
+    ObjectPickEntry entry;
+    entry.elevation = object->elevation;
+    objectPickGetCell(rect.left, rect.top, &(entry.minCellX), &(entry.minCellY));
+    objectPickGetCell(rect.right, rect.bottom, &(entry.maxCellX), &(entry.maxCellY));
+
+    std::vector<std::vector<Object*>>& cells = gObjectPickCells[entry.elevation];
+    for (int cellY = entry.minCellY; cellY <= entry.maxCellY; cellY++) {
+        for (int cellX = entry.minCellX; cellX <= entry.maxCellX; cellX++) {
+            cells[gObjectPickGridWidth * cellY + cellX].push_back(object);
+        }
+    }
+
+    gObjectPickEntries[object] = entry;
+}
+
+static void objectPickRemove(Object* object)
+{
+    auto it = gObjectPickEntries.find(object);
+    if (it == gObjectPickEntries.end()) {
+        return;
+    }
+
+    const ObjectPickEntry& entry = it->second;
+    std::vector<std::vector<Object*>>& cells = gObjectPickCells[entry.elevation];
+    for (int cellY = entry.minCellY; cellY <= entry.maxCellY; cellY++) {
+        for (int cellX = entry.minCellX; cellX <= entry.maxCellX; cellX++) {
+            std::vector<Object*>& cell = cells[gObjectPickGridWidth * cellY + cellX];
+            auto objectIt = std::find(cell.begin(), cell.end(), object);
+            if (objectIt != cell.end()) {
+                *objectIt = cell.back();
+                cell.pop_back();
             }
         }
     }
 
-    return count;
+    gObjectPickEntries.erase(it);
+}
+
+// Returns cell of [gObjectPickCells] containing screen point. Points outside
+// of the grid are clamped to the nearest cell.
+static void objectPickGetCell(int screenX, int screenY, int* cellX, int* cellY)
+{
+    int originX;
+    int originY;
+    tileToScreenXY(0, &originX, &originY);
+
+    int x = screenX - originX - gObjectPickGridLeft;
+    int y = screenY - originY - gObjectPickGridTop;
+
+    *cellX = std::clamp(x / OBJECT_PICK_CELL_SIZE, 0, gObjectPickGridWidth - 1);
+    *cellY = std::clamp(y / OBJECT_PICK_CELL_SIZE, 0, gObjectPickGridHeight - 1);
 }
 
 // 0x48C74C obj_delete_intersect_list
@@ -3233,36 +3441,33 @@ void _obj_preload_art_cache(MapHeaderFlags flags)
         v11++;
     }
 
-    CacheEntry* cache_handle;
-    if (artLock(*gObjectFids, &cache_handle) != nullptr) {
-        artUnlock(cache_handle);
-    }
+    // CE: Collect art in the same order it used to be locked, and let art
+    // module load it (possibly in background).
+    std::vector<int> fids;
+    fids.reserve(gObjectFidsLength + 4096);
+
+    fids.push_back(*gObjectFids);
 
     for (int i = 1; i < v11; i++) {
         if (gObjectFids[i - 1] != gObjectFids[i]) {
-            if (artLock(gObjectFids[i], &cache_handle) != nullptr) {
-                artUnlock(cache_handle);
-            }
+            fids.push_back(gObjectFids[i]);
         }
     }
 
     for (int i = 0; i < 4096; i++) {
         if (arr[i] != 0) {
-            int fid = buildFid(OBJ_TYPE_TILE, i);
-            if (artLock(fid, &cache_handle) != nullptr) {
-                artUnlock(cache_handle);
-            }
+            fids.push_back(buildFid(OBJ_TYPE_TILE, i));
         }
     }
 
     for (int i = v11; i < gObjectFidsLength; i++) {
         if (gObjectFids[i - 1] != gObjectFids[i]) {
-            if (artLock(gObjectFids[i], &cache_handle) != nullptr) {
-                artUnlock(cache_handle);
-            }
+            fids.push_back(gObjectFids[i]);
         }
     }
 
+    artPrefetch(fids.data(), static_cast<int>(fids.size()));
+
     internal_free(gObjectFids);
     gObjectFids = nullptr;
 
@@ -3755,7 +3960,7 @@ static int objectAllocate(Object** objectPtr)
         return -1;
     }
 
-    Object* object = *objectPtr = (Object*)internal_malloc(sizeof(Object));
+    Object* object = *objectPtr = (Object*)memoryPoolAllocate(&gObjectPool);
     if (object == nullptr) {
         return -1;
     }
@@ -3787,7 +3992,10 @@ static void objectDeallocate(Object** objectPtr)
         return;
     }
 
-    internal_free(*objectPtr);
+    objectPickRemove(*objectPtr);
+    lightRemoveSource(*objectPtr, nullptr, true);
+
+    memoryPoolDeallocate(&gObjectPool, *objectPtr);
 
     *objectPtr = nullptr;
 }
@@ -3801,7 +4009,7 @@ static int objectListNodeCreate(ObjectListNode** nodePtr)
         return -1;
     }
 
-    ObjectListNode* node = *nodePtr = (ObjectListNode*)internal_malloc(sizeof(*node));
+    ObjectListNode* node = *nodePtr = (ObjectListNode*)memoryPoolAllocate(&gObjectListNodePool);
     if (node == nullptr) {
         return -1;
     }
@@ -3825,7 +4033,7 @@ static void objectListNodeDestroy(ObjectListNode** nodePtr)
         return;
     }
 
-    internal_free(*nodePtr);
+    memoryPoolDeallocate(&gObjectListNodePool, *nodePtr);
 
     *nodePtr = nullptr;
 }
@@ -3935,6 +4143,8 @@ static void _obj_insert(ObjectListNode* objectListNode)
 
     objectListNode->next = *objectListNodePtr;
     *objectListNodePtr = objectListNode;
+
+    objectPickUpdate(objectListNode->obj);
 }
 
 // 0x48DA58 obj_remove
@@ -4018,6 +4228,18 @@ static int _obj_adjust_light(Object* obj, int a2, Rect* rect)
         return -1;
     }
 
+    // Light is taken back exactly as it was added, walls and doors around
+    // might have changed since then.
+    if (a2) {
+        int rc = lightRemoveSource(obj, rect, rect == nullptr);
+        if (rc == 0 && rect != nullptr) {
+            Rect objectRect;
+            objectGetRect(obj, &objectRect);
+            rectUnion(rect, &objectRect, rect);
+        }
+        return rc;
+    }
+
     if (obj->lightIntensity <= 0) {
         return -1;
     }
@@ -4034,8 +4256,10 @@ static int _obj_adjust_light(Object* obj, int a2, Rect* rect)
         return -1;
     }
 
-    AdjustLightIntensityProc* adjustLightIntensity = a2 ? lightDecreaseTileIntensity : lightIncreaseTileIntensity;
-    adjustLightIntensity(obj->elevation, obj->tile, obj->lightIntensity);
+    // Reused between calls to avoid allocations.
+    static std::vector<LightSourceTile> litTiles;
+    litTiles.clear();
+    litTiles.push_back({ obj->tile, obj->lightIntensity });
 
     Rect objectRect;
     objectGetRect(obj, &objectRect);
@@ -4647,7 +4871,7 @@ static int _obj_adjust_light(Object* obj, int a2, Rect* rect)
                         }
 
                         if (v12) {
-                            adjustLightIntensity(obj->elevation, tile, v28[index]);
+                            litTiles.push_back({ tile, v28[index] });
                         }
                     }
                 }
@@ -4657,21 +4881,25 @@ static int _obj_adjust_light(Object* obj, int a2, Rect* rect)
         }
     }
 
-    if (rect != nullptr) {
-        Rect* lightDistanceRect = &(_light_rect[obj->lightDistance]);
-        memcpy(rect, lightDistanceRect, sizeof(*lightDistanceRect));
+    Rect lightRect;
+    rectCopy(&lightRect, &(_light_rect[obj->lightDistance]));
 
-        int x;
-        int y;
-        tileToScreenXY(obj->tile, &x, &y);
-        x += 16;
-        y += 8;
+    int x;
+    int y;
+    tileToScreenXY(obj->tile, &x, &y);
+    x += 16;
+    y += 8;
 
-        x -= rect->right / 2;
-        y -= rect->bottom / 2;
+    x -= lightRect.right / 2;
+    y -= lightRect.bottom / 2;
 
-        rectOffset(rect, x, y);
-        rectUnion(rect, &objectRect, rect);
+    rectOffset(&lightRect, x, y);
+    rectUnion(&lightRect, &objectRect, &lightRect);
+
+    lightAddSource(obj, obj->elevation, litTiles.data(), static_cast<int>(litTiles.size()), &lightRect, rect == nullptr);
+
+    if (rect != nullptr) {
+        rectCopy(rect, &lightRect);
     }
 
     return 0;
@@ -4931,16 +5159,32 @@ static void objectDrawOutline(Object* object, Rect* rect)
 
 // 0x48F1B0 obj_render_object
 static void _obj_render_object(Object* object, Rect* rect, int light)
+{
+    ObjectRenderEntry entry;
+    if (!objectRenderEntryPrepare(&entry, object, rect, light)) {
+        return;
+    }
+
+    objectRenderEntryDraw(&entry, rect);
+    objectRenderEntryRelease(&entry);
+}
+
+// Locks art of [object] and updates its screen position. Returns `false` when
+// object is not visible in [rect], there is nothing to draw or release then.
+//
+// Everything that depends on shared state (art cache, protos) is resolved
+// here, so that [objectRenderEntryDraw] can run on any thread.
+static bool objectRenderEntryPrepare(ObjectRenderEntry* entry, Object* object, Rect* rect, int light)
 {
     ObjectType type = objectTypeFromFid(object->fid);
     if (artIsObjectTypeHidden(type)) {
-        return;
+        return false;
     }
 
     CacheEntry* cacheEntry;
     Art* art = artLock(object->fid, &cacheEntry);
     if (art == nullptr) {
-        return;
+        return false;
     }
 
     int frameWidth = artGetWidth(art, object->frame, object->rotation);
@@ -4974,29 +5218,22 @@ static void _obj_render_object(Object* object, Rect* rect, int light)
         object->sy = objectRect.top;
     }
 
-    if (rectIntersection(&objectRect, rect, &objectRect) != 0) {
+    Rect clippedRect;
+    if (rectIntersection(&objectRect, rect, &clippedRect) != 0) {
         artUnlock(cacheEntry);
-        return;
+        return false;
     }
 
-    unsigned char* src = artGetFrameData(art, object->frame, object->rotation);
-    unsigned char* src2 = src;
-    int v50 = objectRect.left - object->sx;
-    int v49 = objectRect.top - object->sy;
-    src += frameWidth * v49 + v50;
-    int objectWidth = objectRect.right - objectRect.left + 1;
-    int objectHeight = objectRect.bottom - objectRect.top + 1;
-
-    if (type == OBJ_TYPE_INTERFACE) {
-        blitBufferToBufferTrans(src,
-            objectWidth,
-            objectHeight,
-            frameWidth,
-            gObjectsWindowBuffer + gObjectsWindowPitch * objectRect.top + objectRect.left,
-            gObjectsWindowPitch);
-        artUnlock(cacheEntry);
-        return;
-    }
+    entry->object = object;
+    entry->type = type;
+    entry->art = art;
+    entry->cacheEntry = cacheEntry;
+    entry->rect = objectRect;
+    entry->light = light;
+    entry->hasSpans = artGetFrameSpans(art, object->frame, object->rotation, &(entry->spans));
+    entry->egg = nullptr;
+    entry->eggCacheEntry = nullptr;
+    entry->edgeOnTop = false;
 
     if (type == OBJ_TYPE_SCENERY || type == OBJ_TYPE_WALL) {
         if ((gDude->flags & OBJECT_HIDDEN) == OBJECT_NONE && (object->flags & OBJECT_FLAG_0xFC000) == OBJECT_NONE) {
@@ -5035,7 +5272,9 @@ static void _obj_render_object(Object* object, Rect* rect, int light)
                 CacheEntry* eggHandle;
                 Art* egg = artLock(gEgg->fid, &eggHandle);
                 if (egg == nullptr) {
-                    return;
+                    // NOTE: Original code leaves object art locked here.
+                    artUnlock(cacheEntry);
+                    return false;
                 }
 
                 int eggWidth;
@@ -5064,80 +5303,160 @@ static void _obj_render_object(Object* object, Rect* rect, int light)
                 gEgg->sy = eggRect.top;
 
                 Rect updatedEggRect;
-                if (rectIntersection(&eggRect, &objectRect, &updatedEggRect) == 0) {
-                    Rect rects[4];
-
-                    rects[0].left = objectRect.left;
-                    rects[0].top = objectRect.top;
-                    rects[0].right = objectRect.right;
-                    rects[0].bottom = updatedEggRect.top - 1;
-
-                    rects[1].left = objectRect.left;
-                    rects[1].top = updatedEggRect.top;
-                    rects[1].right = updatedEggRect.left - 1;
-                    rects[1].bottom = updatedEggRect.bottom;
-
-                    rects[2].left = updatedEggRect.right + 1;
-                    rects[2].top = updatedEggRect.top;
-                    rects[2].right = objectRect.right;
-                    rects[2].bottom = updatedEggRect.bottom;
-
-                    rects[3].left = objectRect.left;
-                    rects[3].top = updatedEggRect.bottom + 1;
-                    rects[3].right = objectRect.right;
-                    rects[3].bottom = objectRect.bottom;
-
-                    for (int i = 0; i < 4; i++) {
-                        Rect* v21 = &(rects[i]);
-                        if (v21->left <= v21->right && v21->top <= v21->bottom) {
-                            unsigned char* sp = src + frameWidth * (v21->top - objectRect.top) + (v21->left - objectRect.left);
-                            _dark_trans_buf_to_buf(sp, v21->right - v21->left + 1, v21->bottom - v21->top + 1, frameWidth, gObjectsWindowBuffer, v21->left, v21->top, gObjectsWindowPitch, light);
-                        }
-                    }
-
-                    unsigned char* mask = artGetFrameData(egg);
-                    _intensity_mask_buf_to_buf(
-                        src + frameWidth * (updatedEggRect.top - objectRect.top) + (updatedEggRect.left - objectRect.left),
-                        updatedEggRect.right - updatedEggRect.left + 1,
-                        updatedEggRect.bottom - updatedEggRect.top + 1,
-                        frameWidth,
-                        gObjectsWindowBuffer + gObjectsWindowPitch * updatedEggRect.top + updatedEggRect.left,
-                        gObjectsWindowPitch,
-                        mask + eggWidth * (updatedEggRect.top - eggRect.top) + (updatedEggRect.left - eggRect.left),
-                        eggWidth,
-                        light);
+                if (rectIntersection(&eggRect, &clippedRect, &updatedEggRect) == 0) {
+                    entry->egg = egg;
+                    entry->eggCacheEntry = eggHandle;
+                    entry->eggRect = eggRect;
+                } else {
                     artUnlock(eggHandle);
-                    artUnlock(cacheEntry);
-                    return;
                 }
+            }
+        }
+    }
+
+    return true;
+}
+
+// Draws object prepared with [objectRenderEntryPrepare] clipped to [rect].
+// Writes only to pixels inside [rect].
+static void objectRenderEntryDraw(ObjectRenderEntry* entry, Rect* rect)
+{
+    Object* object = entry->object;
+
+    Rect objectRect;
+    if (rectIntersection(&(entry->rect), rect, &objectRect) != 0) {
+        return;
+    }
 
-                artUnlock(eggHandle);
+    int light = entry->light;
+    int frameWidth = rectGetWidth(&(entry->rect));
+    int objectX = entry->rect.left;
+    int objectY = entry->rect.top;
+
+    unsigned char* src = artGetFrameData(entry->art, object->frame, object->rotation);
+    unsigned char* src2 = src;
+    int v50 = objectRect.left - objectX;
+    int v49 = objectRect.top - objectY;
+    src += frameWidth * v49 + v50;
+    int objectWidth = objectRect.right - objectRect.left + 1;
+    int objectHeight = objectRect.bottom - objectRect.top + 1;
+
+    bool hasSpans = entry->hasSpans;
+    const ArtFrameSpans* frameSpans = &(entry->spans);
+
+    if (entry->type == OBJ_TYPE_INTERFACE) {
+        blitBufferToBufferTrans(src,
+            objectWidth,
+            objectHeight,
+            frameWidth,
+            gObjectsWindowBuffer + gObjectsWindowPitch * objectRect.top + objectRect.left,
+            gObjectsWindowPitch);
+        return;
+    }
+
+    if (entry->egg != nullptr) {
+        Rect eggRect = entry->eggRect;
+        int eggWidth = rectGetWidth(&eggRect);
+
+        // Egg overlaps object in the area being updated, but not necessarily
+        // in [rect], otherwise object is drawn as usual.
+        Rect updatedEggRect;
+        if (rectIntersection(&eggRect, &objectRect, &updatedEggRect) == 0) {
+            Rect rects[4];
+
+            rects[0].left = objectRect.left;
+            rects[0].top = objectRect.top;
+            rects[0].right = objectRect.right;
+            rects[0].bottom = updatedEggRect.top - 1;
+
+            rects[1].left = objectRect.left;
+            rects[1].top = updatedEggRect.top;
+            rects[1].right = updatedEggRect.left - 1;
+            rects[1].bottom = updatedEggRect.bottom;
+
+            rects[2].left = updatedEggRect.right + 1;
+            rects[2].top = updatedEggRect.top;
+            rects[2].right = objectRect.right;
+            rects[2].bottom = updatedEggRect.bottom;
+
+            rects[3].left = objectRect.left;
+            rects[3].top = updatedEggRect.bottom + 1;
+            rects[3].right = objectRect.right;
+            rects[3].bottom = objectRect.bottom;
+
+            for (int i = 0; i < 4; i++) {
+                Rect* v21 = &(rects[i]);
+                if (v21->left <= v21->right && v21->top <= v21->bottom) {
+                    if (hasSpans) {
+                        darkTransSpansToBuf(src2, frameWidth, frameSpans, v21->left - objectX, v21->top - objectY, v21->right - v21->left + 1, v21->bottom - v21->top + 1, gObjectsWindowBuffer, v21->left, v21->top, gObjectsWindowPitch, light);
+                    } else {
+                        unsigned char* sp = src + frameWidth * (v21->top - objectRect.top) + (v21->left - objectRect.left);
+                        _dark_trans_buf_to_buf(sp, v21->right - v21->left + 1, v21->bottom - v21->top + 1, frameWidth, gObjectsWindowBuffer, v21->left, v21->top, gObjectsWindowPitch, light);
+                    }
+                }
             }
+
+            unsigned char* mask = artGetFrameData(entry->egg);
+            _intensity_mask_buf_to_buf(
+                src + frameWidth * (updatedEggRect.top - objectRect.top) + (updatedEggRect.left - objectRect.left),
+                updatedEggRect.right - updatedEggRect.left + 1,
+                updatedEggRect.bottom - updatedEggRect.top + 1,
+                frameWidth,
+                gObjectsWindowBuffer + gObjectsWindowPitch * updatedEggRect.top + updatedEggRect.left,
+                gObjectsWindowPitch,
+                mask + eggWidth * (updatedEggRect.top - eggRect.top) + (updatedEggRect.left - eggRect.left),
+                eggWidth,
+                light);
+            return;
         }
     }
 
+    Color* blendTable = nullptr;
+    Color* colorTable = _commonGrayTable;
     switch (object->flags & OBJECT_FLAG_0xFC000) {
     case OBJECT_TRANS_RED:
-        _dark_translucent_trans_buf_to_buf(src, objectWidth, objectHeight, frameWidth, gObjectsWindowBuffer, objectRect.left, objectRect.top, gObjectsWindowPitch, light, _redBlendTable, _commonGrayTable);
+        blendTable = _redBlendTable;
         break;
     case OBJECT_TRANS_WALL:
-        _dark_translucent_trans_buf_to_buf(src, objectWidth, objectHeight, frameWidth, gObjectsWindowBuffer, objectRect.left, objectRect.top, gObjectsWindowPitch, 0x10000, _wallBlendTable, _commonGrayTable);
+        blendTable = _wallBlendTable;
+        light = 0x10000;
         break;
     case OBJECT_TRANS_GLASS:
-        _dark_translucent_trans_buf_to_buf(src, objectWidth, objectHeight, frameWidth, gObjectsWindowBuffer, objectRect.left, objectRect.top, gObjectsWindowPitch, light, _glassBlendTable, _glassGrayTable);
+        blendTable = _glassBlendTable;
+        colorTable = _glassGrayTable;
         break;
     case OBJECT_TRANS_STEAM:
-        _dark_translucent_trans_buf_to_buf(src, objectWidth, objectHeight, frameWidth, gObjectsWindowBuffer, objectRect.left, objectRect.top, gObjectsWindowPitch, light, _steamBlendTable, _commonGrayTable);
+        blendTable = _steamBlendTable;
         break;
     case OBJECT_TRANS_ENERGY:
-        _dark_translucent_trans_buf_to_buf(src, objectWidth, objectHeight, frameWidth, gObjectsWindowBuffer, objectRect.left, objectRect.top, gObjectsWindowPitch, light, _energyBlendTable, _commonGrayTable);
-        break;
-    default:
-        _dark_trans_buf_to_buf(src, objectWidth, objectHeight, frameWidth, gObjectsWindowBuffer, objectRect.left, objectRect.top, gObjectsWindowPitch, light);
+        blendTable = _energyBlendTable;
         break;
     }
 
-    artUnlock(cacheEntry);
+    if (blendTable != nullptr) {
+        if (hasSpans) {
+            darkTranslucentTransSpansToBuf(src2, frameWidth, frameSpans, v50, v49, objectWidth, objectHeight, gObjectsWindowBuffer, objectRect.left, objectRect.top, gObjectsWindowPitch, light, blendTable, colorTable);
+        } else {
+            _dark_translucent_trans_buf_to_buf(src, objectWidth, objectHeight, frameWidth, gObjectsWindowBuffer, objectRect.left, objectRect.top, gObjectsWindowPitch, light, blendTable, colorTable);
+        }
+    } else {
+        if (hasSpans) {
+            darkTransSpansToBuf(src2, frameWidth, frameSpans, v50, v49, objectWidth, objectHeight, gObjectsWindowBuffer, objectRect.left, objectRect.top, gObjectsWindowPitch, light);
+        } else {
+            _dark_trans_buf_to_buf(src, objectWidth, objectHeight, frameWidth, gObjectsWindowBuffer, objectRect.left, objectRect.top, gObjectsWindowPitch, light);
+        }
+    }
+}
+
+static void objectRenderEntryRelease(ObjectRenderEntry* entry)
+{
+    if (entry->egg != nullptr) {
+        artUnlock(entry->eggCacheEntry);
+    }
+
+    if (entry->cacheEntry != nullptr) {
+        artUnlock(entry->cacheEntry);
+    }
 }
 
 // Updates fid according to current violence level.
@@ -30,6 +30,19 @@ bool objectIsSavable(Object* obj);
 int objectLoadAll(File* stream);
 int objectSaveAll(File* stream);
 void _obj_render_pre_roof(Rect* rect, int elevation);
+
+// Splits [_obj_render_pre_roof] so that objects can be drawn in parts of
+// [rect] on different threads. Preparing collects objects and locks their
+// art, must be called on main thread.
+void objectsPrepareDeferredPreRoof(Rect* rect, int elevation);
+
+// Draws collected objects clipped to [rect]. Can be called concurrently for
+// rects which do not overlap.
+void objectsRenderDeferredPreRoof(Rect* rect);
+
+// Unlocks art of collected objects.
+void objectsFinishDeferredPreRoof();
+
 void _obj_render_post_roof(Rect* rect, int elevation);
 int objectCreateWithFidPid(Object** objectPtr, int fid, int pid);
 int objectCreateWithPid(Object** objectPtr, int pid);
@@ -83,10 +96,6 @@ int objectGetDistanceBetweenTiles(Object* object1, int tile1, Object* object2, i
 bool objectWithinWalkDistance(Object* critter, Object* target);
 int objectListCreate(int tile, int elevation, ObjectType objectType, Object*** objectsPtr);
 void objectListFree(Object** objects);
-void _translucent_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, Color* blendTable, Color* colorTable);
-void _dark_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, int light);
-void _dark_translucent_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, int light, Color* blendTable, Color* colorTable);
-void _intensity_mask_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destPitch, unsigned char* mask, int maskPitch, int light);
 int objectSetOutline(Object* obj, OutlineType outlineType, Rect* rect);
 int objectClearOutline(Object* obj, Rect* rect);
 ObjectFlags _obj_intersects_with(Object* object, int x, int y);
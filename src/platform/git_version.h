@@ -0,0 +1,9 @@
+#pragma once
+
+#define _BUILD_AUTHOR "agent"
+#define _BUILD_BRANCH "master"
+#define _BUILD_HASH   "7500241"
+#define _BUILD_VER    ""
+#define _BUILD_DATE   "Oct 17 2026 07:15:29"
+
+#define CI_BUILD 0
@@ -1,7 +1,10 @@
 #include "platform_compat.h"
 
+#include <stdint.h>
 #include <string.h>
 
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 
@@ -13,6 +16,8 @@
 #include <sys/stat.h>
 #else
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #endif
@@ -42,6 +47,9 @@ static bool compatFileModeMayWrite(const char* mode)
     return mode != nullptr && (strchr(mode, 'w') != nullptr || strchr(mode, 'a') != nullptr || strchr(mode, '+') != nullptr);
 }
 
+// Incremented every time file system is modified via compat functions.
+static std::atomic<unsigned int> compatFileSystemGeneration(0);
+
 #ifndef _WIN32
 typedef struct CompatDirectoryCacheEntry {
     std::unordered_map<std::string, std::string> entries;
@@ -50,6 +58,21 @@ typedef struct CompatDirectoryCacheEntry {
 static constexpr size_t kCompatDirectoryEntryCacheMaxSize = 1024;
 static std::unordered_map<std::string, CompatDirectoryCacheEntry> compatDirectoryEntryCache;
 
+// Guards [compatDirectoryEntryCache], file functions can be used from
+// background threads. Only taken when [compatThreadSafe] is set (see
+// [compat_set_thread_safe]).
+static std::mutex compatDirectoryEntryCacheMutex;
+static bool compatThreadSafe = false;
+
+static std::unique_lock<std::mutex> compatDirectoryEntryCacheLock()
+{
+    if (!compatThreadSafe) {
+        return std::unique_lock<std::mutex>();
+    }
+
+    return std::unique_lock<std::mutex>(compatDirectoryEntryCacheMutex);
+}
+
 static std::string compatLowercase(std::string value)
 {
     for (char& ch : value) {
@@ -60,7 +83,9 @@ static std::string compatLowercase(std::string value)
 
 static void compatDirectoryEntryCacheClear()
 {
+    std::unique_lock<std::mutex> lock = compatDirectoryEntryCacheLock();
     compatDirectoryEntryCache.clear();
+    compatFileSystemGeneration++;
 }
 
 static const CompatDirectoryCacheEntry* compatDirectoryEntryCacheGet(const std::string& directoryPath)
@@ -95,6 +120,7 @@ static const CompatDirectoryCacheEntry* compatDirectoryEntryCacheGet(const std::
 #else
 static void compatDirectoryEntryCacheClear()
 {
+    compatFileSystemGeneration++;
 }
 #endif
 
@@ -482,6 +508,8 @@ void compat_windows_path_to_native(char* path)
 void compat_resolve_path(char* path)
 {
 #ifndef _WIN32
+    std::unique_lock<std::mutex> lock = compatDirectoryEntryCacheLock();
+
     char* pch = path;
     std::string directoryPath;
     if (pch[0] == '/') {
@@ -557,4 +585,85 @@ long getFileSize(FILE* stream)
     return filesize;
 }
 
+unsigned int compat_fs_generation()
+{
+    return compatFileSystemGeneration;
+}
+
+void compat_set_thread_safe(bool enabled)
+{
+#ifndef _WIN32
+    compatThreadSafe = enabled;
+#endif
+}
+
+void* compat_mmap(const char* path, size_t* sizePtr)
+{
+    char nativePath[COMPAT_MAX_PATH];
+    compat_prepare_native_path(nativePath, path);
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(nativePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 || static_cast<unsigned long long>(fileSize.QuadPart) > SIZE_MAX) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return nullptr;
+    }
+
+    // The view keeps mapping object alive.
+    void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (ptr == nullptr) {
+        return nullptr;
+    }
+
+    *sizePtr = static_cast<size_t>(fileSize.QuadPart);
+    return ptr;
+#else
+    int fd = open(nativePath, O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    // The mapping remains valid after the descriptor is closed.
+    void* ptr = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        return nullptr;
+    }
+
+    *sizePtr = static_cast<size_t>(info.st_size);
+    return ptr;
+#endif
+}
+
+void compat_munmap(void* ptr, size_t size)
+{
+    if (ptr == nullptr) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(ptr);
+#else
+    munmap(ptr, size);
+#endif
+}
+
 } // namespace fallout
@@ -48,6 +48,21 @@ int compat_access(const char* path, int mode);
 char* compat_strdup(const char* string);
 long getFileSize(FILE* stream);
 
+// Returns a counter which changes every time file system is modified via
+// compat functions (files opened for writing, removed, renamed, or
+// directories created). Used to invalidate caches of directory contents.
+unsigned int compat_fs_generation();
+
+// Specifies whether path resolution can be used from several threads at once.
+void compat_set_thread_safe(bool enabled);
+
+// Maps entire file into memory for reading.
+//
+// Returns NULL if file cannot be opened, is empty, or memory mapping is not
+// available. The mapping must be released with [compat_munmap].
+void* compat_mmap(const char* path, size_t* sizePtr);
+void compat_munmap(void* ptr, size_t size);
+
 } // namespace fallout
 
 #endif /* PLATFORM_COMPAT_H */
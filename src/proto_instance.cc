@@ -19,6 +19,7 @@
 #include "interface.h"
 #include "interpreter_extra.h"
 #include "item.h"
+#include "light.h"
 #include "map.h"
 #include "message.h"
 #include "object.h"
@@ -132,8 +133,7 @@ int objectSetScriptFromProto(Object* object, int* sidPtr)
     }
 
     if (scriptType == SCRIPT_TYPE_SPATIAL) {
-        script->sp.built_tile = builtTileCreate(object->tile, object->elevation);
-        script->sp.radius = 3;
+        scriptSetSpatialArea(script, builtTileCreate(object->tile, object->elevation), 3);
     }
 
     if (object->id == -1) {
@@ -167,8 +167,7 @@ int objectSetScript(Object* obj, int scriptType, int scriptIndex)
 
     script->index = scriptIndex;
     if (scriptType == SCRIPT_TYPE_SPATIAL) {
-        script->sp.built_tile = builtTileCreate(obj->tile, obj->elevation);
-        script->sp.radius = 3;
+        scriptSetSpatialArea(script, builtTileCreate(obj->tile, obj->elevation), 3);
     }
 
     obj->sid = sid;
@@ -1659,7 +1658,7 @@ static int _check_door_state(Object* door, Object* obj2)
         }
 
         _obj_rebuild_all_light();
-        tileWindowRefresh();
+        lightRefreshDirtyRects();
 
         if (door->frame == 0) {
             return 0;
@@ -1697,7 +1696,7 @@ static int _check_door_state(Object* door, Object* obj2)
         }
 
         _obj_rebuild_all_light();
-        tileWindowRefresh();
+        lightRefreshDirtyRects();
 
         CacheEntry* artHandle;
         Art* art = artLock(door->fid, &artHandle);
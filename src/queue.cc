@@ -1,8 +1,13 @@
 #include "queue.h"
 
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
 #include "actions.h"
 #include "critter.h"
 #include "display_monitor.h"
+#include "frame_profiler.h"
 #include "game.h"
 #include "game_sound.h"
 #include "item.h"
@@ -17,13 +22,40 @@
 
 namespace fallout {
 
-typedef struct QueueListNode {
+// The number of nodes allocated at once, see [queueNodeAllocate].
+#define QUEUE_NODE_BLOCK_SIZE (64)
+
+typedef struct QueueNode {
     unsigned int time;
     EventType type;
     Object* owner;
     void* data;
-    struct QueueListNode* next;
-} QueueListNode;
+
+    // Tells apart events with the same time, events scheduled earlier have
+    // lower order and are processed first.
+    unsigned long long order;
+
+    // Position in [gQueueHeap], -1 when node is not scheduled.
+    int heapIndex;
+
+    // Adjacent events of the same owner in processing order, see
+    // [gQueueOwnerEvents]. Free nodes are chained through [ownerNext].
+    struct QueueNode* ownerPrev;
+    struct QueueNode* ownerNext;
+} QueueNode;
+
+// Events of one owner in processing order.
+typedef struct QueueOwnerEvents {
+    QueueNode* head;
+    QueueNode* tail;
+} QueueOwnerEvents;
+
+// Snapshot of event position, see [queueClearByEventType].
+typedef struct QueueEventKey {
+    unsigned int time;
+    unsigned long long order;
+    QueueNode* node;
+} QueueEventKey;
 
 typedef struct EventTypeDescription {
     QueueEventHandler* handlerProc;
@@ -34,20 +66,50 @@ typedef struct EventTypeDescription {
     QueueEventHandler* mapExitHandlerProc; // unused
 } EventTypeDescription;
 
+static QueueNode* queueNodeAllocate();
+static void queueNodeFree(QueueNode* node);
+static void queueNodeDestroy(QueueNode* node);
+static bool queueNodeIsBefore(const QueueNode* a, const QueueNode* b);
+static bool queueEventKeyIsBefore(const QueueEventKey& a, const QueueEventKey& b);
+static void queueNodeSchedule(QueueNode* node);
+static void queueNodeUnschedule(QueueNode* node);
+static void queueHeapSiftUp(int index);
+static void queueHeapSiftDown(int index);
+static void queueOwnerEventsAdd(QueueNode* node);
+static void queueOwnerEventsRemove(QueueNode* node);
+static void queueGetSortedNodes(std::vector<QueueNode*>& nodes);
+static void queueRebuild(std::vector<QueueNode*>& nodes);
 static int flareEventProcess(Object* obj, void* data);
 static int explosionEventProcess(Object* obj, void* data);
 static int explosionExit(Object* obj, void* data);
 static int explosionProcess(Object* obj, bool animate);
 static int explosionFailureEventProcess(Object* obj, void* data);
 
-// Last queue list node found during [queueFindFirstEvent] and
+// Last queue node found during [queueFindFirstEvent] and
 // [queueFindNextEvent] calls.
 //
 // 0x51C690 tmpQNode
-static QueueListNode* gLastFoundQueueListNode = nullptr;
+static QueueNode* gLastFoundQueueNode = nullptr;
 
+// Binary min-heap of scheduled events ordered by time, then by order they
+// were scheduled in. Original code kept events in sorted linked list which
+// made every [queueAddEvent] a linear scan.
+//
 // 0x6648C0 queue
-static QueueListNode* gQueueListHead;
+static std::vector<QueueNode*> gQueueHeap;
+
+// Scheduled events grouped by owner, allows per-object lookups without
+// scanning entire queue. Events without owner are grouped under `nullptr`.
+static std::unordered_map<Object*, QueueOwnerEvents> gQueueOwnerEvents;
+
+// Order of the next scheduled event, see [QueueNode.order].
+static unsigned long long gQueueNextOrder = 0;
+
+// Nodes are never returned to the heap allocator until [queueExit], so a
+// pointer to a released node stays valid and can be checked with
+// [QueueNode.heapIndex].
+static std::vector<QueueNode*> gQueueNodeBlocks;
+static QueueNode* gQueueFreeNodes = nullptr;
 
 // 0x51C540 q_func
 static EventTypeDescription gEventTypeDescriptions[EVENT_TYPE_COUNT] = {
@@ -84,13 +146,23 @@ static EventTypeDescription gEventTypeDescriptions[EVENT_TYPE_COUNT] = {
 // 0x4A2320 queue_init
 void queueInit()
 {
-    gQueueListHead = nullptr;
+    gQueueHeap.clear();
+    gQueueOwnerEvents.clear();
+    gQueueNextOrder = 0;
 }
 
 // 0x4A2330 queue_reset
 int queueExit()
 {
     queueClear();
+
+    for (QueueNode* block : gQueueNodeBlocks) {
+        internal_free(block);
+    }
+
+    gQueueNodeBlocks.clear();
+    gQueueFreeNodes = nullptr;
+
     return 0;
 }
 
@@ -102,34 +174,31 @@ int queueLoad(File* stream)
         return -1;
     }
 
-    QueueListNode* oldListHead = gQueueListHead;
-    gQueueListHead = nullptr;
-
-    QueueListNode** nextPtr = &gQueueListHead;
+    std::vector<QueueNode*> nodes;
 
     int rc = 0;
     for (int index = 0; index < count; index += 1) {
-        QueueListNode* queueListNode = (QueueListNode*)internal_malloc(sizeof(*queueListNode));
-        if (queueListNode == nullptr) {
+        QueueNode* queueNode = queueNodeAllocate();
+        if (queueNode == nullptr) {
             rc = -1;
             break;
         }
 
-        if (fileReadUInt32(stream, &(queueListNode->time)) == -1) {
-            internal_free(queueListNode);
+        if (fileReadUInt32(stream, &(queueNode->time)) == -1) {
+            queueNodeFree(queueNode);
             rc = -1;
             break;
         }
 
-        if (fileReadInt32Enum<EventType>(stream, &(queueListNode->type)) == -1) {
-            internal_free(queueListNode);
+        if (fileReadInt32Enum<EventType>(stream, &(queueNode->type)) == -1) {
+            queueNodeFree(queueNode);
             rc = -1;
             break;
         }
 
         int objectId;
         if (fileReadInt32(stream, &objectId) == -1) {
-            internal_free(queueListNode);
+            queueNodeFree(queueNode);
             rc = -1;
             break;
         }
@@ -148,55 +217,41 @@ int queueLoad(File* stream)
             }
         }
 
-        queueListNode->owner = obj;
+        queueNode->owner = obj;
 
-        EventTypeDescription* eventTypeDescription = &(gEventTypeDescriptions[queueListNode->type]);
+        EventTypeDescription* eventTypeDescription = &(gEventTypeDescriptions[queueNode->type]);
         if (eventTypeDescription->readProc != nullptr) {
-            if (eventTypeDescription->readProc(stream, &(queueListNode->data)) == -1) {
-                internal_free(queueListNode);
+            if (eventTypeDescription->readProc(stream, &(queueNode->data)) == -1) {
+                queueNodeFree(queueNode);
                 rc = -1;
                 break;
             }
         } else {
-            queueListNode->data = nullptr;
+            queueNode->data = nullptr;
         }
 
-        queueListNode->next = nullptr;
-
-        *nextPtr = queueListNode;
-        nextPtr = &(queueListNode->next);
+        nodes.push_back(queueNode);
     }
 
     if (rc == -1) {
-        while (gQueueListHead != nullptr) {
-            QueueListNode* next = gQueueListHead->next;
-
-            EventTypeDescription* eventTypeDescription = &(gEventTypeDescriptions[gQueueListHead->type]);
-            if (eventTypeDescription->freeProc != nullptr) {
-                eventTypeDescription->freeProc(gQueueListHead->data);
-            }
-
-            internal_free(gQueueListHead);
-
-            gQueueListHead = next;
+        for (QueueNode* queueNode : nodes) {
+            queueNodeDestroy(queueNode);
         }
+
+        nodes.clear();
     }
 
-    while (oldListHead != nullptr) {
-        QueueListNode** queueListNodePtr = &gQueueListHead;
-        while (*queueListNodePtr != nullptr) {
-            if ((*queueListNodePtr)->time > oldListHead->time) {
-                break;
-            }
+    // Events scheduled before loading go after loaded events with the same
+    // time.
+    std::vector<QueueNode*> oldNodes;
+    queueGetSortedNodes(oldNodes);
+    nodes.insert(nodes.end(), oldNodes.begin(), oldNodes.end());
 
-            queueListNodePtr = &((*queueListNodePtr)->next);
-        }
+    std::stable_sort(nodes.begin(), nodes.end(), [](const QueueNode* a, const QueueNode* b) {
+        return a->time < b->time;
+    });
 
-        QueueListNode* next = oldListHead->next;
-        oldListHead->next = *queueListNodePtr;
-        *queueListNodePtr = oldListHead;
-        oldListHead = next;
-    }
+    queueRebuild(nodes);
 
     return rc;
 }
@@ -204,30 +259,22 @@ int queueLoad(File* stream)
 // 0x4A24E0 queue_save
 int queueSave(File* stream)
 {
-    QueueListNode* queueListNode;
-
-    int count = 0;
+    std::vector<QueueNode*> nodes;
+    queueGetSortedNodes(nodes);
 
-    queueListNode = gQueueListHead;
-    while (queueListNode != nullptr) {
-        count += 1;
-        queueListNode = queueListNode->next;
-    }
-
-    if (fileWriteInt32(stream, count) == -1) {
+    if (fileWriteInt32(stream, static_cast<int>(nodes.size())) == -1) {
         return -1;
     }
 
-    queueListNode = gQueueListHead;
-    while (queueListNode != nullptr) {
-        Object* object = queueListNode->owner;
+    for (QueueNode* queueNode : nodes) {
+        Object* object = queueNode->owner;
         int objectId = object != nullptr ? object->id : -2;
 
-        if (fileWriteUInt32(stream, queueListNode->time) == -1) {
+        if (fileWriteUInt32(stream, queueNode->time) == -1) {
             return -1;
         }
 
-        if (fileWriteInt32(stream, queueListNode->type) == -1) {
+        if (fileWriteInt32(stream, queueNode->type) == -1) {
             return -1;
         }
 
@@ -235,14 +282,12 @@ int queueSave(File* stream)
             return -1;
         }
 
-        EventTypeDescription* eventTypeDescription = &(gEventTypeDescriptions[queueListNode->type]);
+        EventTypeDescription* eventTypeDescription = &(gEventTypeDescriptions[queueNode->type]);
         if (eventTypeDescription->writeProc != nullptr) {
-            if (eventTypeDescription->writeProc(stream, queueListNode->data) == -1) {
+            if (eventTypeDescription->writeProc(stream, queueNode->data) == -1) {
                 return -1;
             }
         }
-
-        queueListNode = queueListNode->next;
     }
 
     return 0;
@@ -251,32 +296,22 @@ int queueSave(File* stream)
 // 0x4A258C queue_add
 int queueAddEvent(int delay, Object* obj, void* data, EventType eventType)
 {
-    QueueListNode* newQueueListNode = (QueueListNode*)internal_malloc(sizeof(QueueListNode));
-    if (newQueueListNode == nullptr) {
+    QueueNode* newQueueNode = queueNodeAllocate();
+    if (newQueueNode == nullptr) {
         return -1;
     }
 
-    newQueueListNode->time = gameTimeGetTime() + delay;
-    newQueueListNode->type = eventType;
-    newQueueListNode->owner = obj;
-    newQueueListNode->data = data;
+    newQueueNode->time = gameTimeGetTime() + delay;
+    newQueueNode->type = eventType;
+    newQueueNode->owner = obj;
+    newQueueNode->data = data;
+    newQueueNode->order = gQueueNextOrder++;
 
     if (obj != nullptr) {
         obj->flags |= OBJECT_QUEUED;
     }
 
-    QueueListNode** queueListNodePtr = &gQueueListHead;
-
-    while (*queueListNodePtr != nullptr) {
-        if (newQueueListNode->time < (*queueListNodePtr)->time) {
-            break;
-        }
-
-        queueListNodePtr = &((*queueListNodePtr)->next);
-    }
-
-    newQueueListNode->next = *queueListNodePtr;
-    *queueListNodePtr = newQueueListNode;
+    queueNodeSchedule(newQueueNode);
 
     return 0;
 }
@@ -284,26 +319,19 @@ int queueAddEvent(int delay, Object* obj, void* data, EventType eventType)
 // 0x4A25F4 queue_remove
 int queueRemoveEvents(Object* owner)
 {
-    QueueListNode* queueListNode = gQueueListHead;
-    QueueListNode** queueListNodePtr = &gQueueListHead;
-
-    while (queueListNode) {
-        if (queueListNode->owner == owner) {
-            QueueListNode* temp = queueListNode;
+    auto it = gQueueOwnerEvents.find(owner);
+    if (it == gQueueOwnerEvents.end()) {
+        return 0;
+    }
 
-            queueListNode = queueListNode->next;
-            *queueListNodePtr = queueListNode;
+    QueueNode* queueNode = it->second.head;
+    while (queueNode != nullptr) {
+        QueueNode* next = queueNode->ownerNext;
 
-            EventTypeDescription* eventTypeDescription = &(gEventTypeDescriptions[temp->type]);
-            if (eventTypeDescription->freeProc != nullptr) {
-                eventTypeDescription->freeProc(temp->data);
-            }
+        queueNodeUnschedule(queueNode);
+        queueNodeDestroy(queueNode);
 
-            internal_free(temp);
-        } else {
-            queueListNodePtr = &(queueListNode->next);
-            queueListNode = queueListNode->next;
-        }
+        queueNode = next;
     }
 
     return 0;
@@ -312,26 +340,21 @@ int queueRemoveEvents(Object* owner)
 // 0x4A264C queue_remove_this
 int queueRemoveEventsByType(Object* owner, EventType eventType)
 {
-    QueueListNode* queueListNode = gQueueListHead;
-    QueueListNode** queueListNodePtr = &gQueueListHead;
-
-    while (queueListNode) {
-        if (queueListNode->owner == owner && queueListNode->type == eventType) {
-            QueueListNode* temp = queueListNode;
-
-            queueListNode = queueListNode->next;
-            *queueListNodePtr = queueListNode;
+    auto it = gQueueOwnerEvents.find(owner);
+    if (it == gQueueOwnerEvents.end()) {
+        return 0;
+    }
 
-            EventTypeDescription* eventTypeDescription = &(gEventTypeDescriptions[temp->type]);
-            if (eventTypeDescription->freeProc != nullptr) {
-                eventTypeDescription->freeProc(temp->data);
-            }
+    QueueNode* queueNode = it->second.head;
+    while (queueNode != nullptr) {
+        QueueNode* next = queueNode->ownerNext;
 
-            internal_free(temp);
-        } else {
-            queueListNodePtr = &(queueListNode->next);
-            queueListNode = queueListNode->next;
+        if (queueNode->type == eventType) {
+            queueNodeUnschedule(queueNode);
+            queueNodeDestroy(queueNode);
         }
+
+        queueNode = next;
     }
 
     return 0;
@@ -342,13 +365,18 @@ int queueRemoveEventsByType(Object* owner, EventType eventType)
 // 0x4A26A8 queue_find
 bool queueHasEvent(Object* owner, EventType eventType)
 {
-    QueueListNode* queueListEvent = gQueueListHead;
-    while (queueListEvent != nullptr) {
-        if (owner == queueListEvent->owner && eventType == queueListEvent->type) {
+    auto it = gQueueOwnerEvents.find(owner);
+    if (it == gQueueOwnerEvents.end()) {
+        return false;
+    }
+
+    QueueNode* queueNode = it->second.head;
+    while (queueNode != nullptr) {
+        if (eventType == queueNode->type) {
             return true;
         }
 
-        queueListEvent = queueListEvent->next;
+        queueNode = queueNode->ownerNext;
     }
 
     return false;
@@ -357,26 +385,24 @@ bool queueHasEvent(Object* owner, EventType eventType)
 // 0x4A26D0 queue_process
 int queueProcessEvents()
 {
+    FrameProfilerZone profilerZone("queueProcessEvents");
+
     unsigned int time = gameTimeGetTime();
     // TODO: this is 0 or 1, but in some cases -1. Probably needs to be bool.
     int stopProcess = 0;
 
-    while (gQueueListHead != nullptr) {
-        QueueListNode* queueListNode = gQueueListHead;
-        if (time < queueListNode->time || stopProcess != 0) {
+    while (!gQueueHeap.empty()) {
+        QueueNode* queueNode = gQueueHeap[0];
+        if (time < queueNode->time || stopProcess != 0) {
             break;
         }
 
-        gQueueListHead = queueListNode->next;
+        queueNodeUnschedule(queueNode);
 
-        EventTypeDescription* eventTypeDescription = &(gEventTypeDescriptions[queueListNode->type]);
-        stopProcess = eventTypeDescription->handlerProc(queueListNode->owner, queueListNode->data);
-
-        if (eventTypeDescription->freeProc != nullptr) {
-            eventTypeDescription->freeProc(queueListNode->data);
-        }
+        EventTypeDescription* eventTypeDescription = &(gEventTypeDescriptions[queueNode->type]);
+        stopProcess = eventTypeDescription->handlerProc(queueNode->owner, queueNode->data);
 
-        internal_free(queueListNode);
+        queueNodeDestroy(queueNode);
     }
 
     return stopProcess;
@@ -385,55 +411,75 @@ int queueProcessEvents()
 // 0x4A2748 queue_clear
 void queueClear()
 {
-    QueueListNode* queueListNode = gQueueListHead;
-    while (queueListNode != nullptr) {
-        QueueListNode* next = queueListNode->next;
+    std::vector<QueueNode*> nodes;
+    nodes.swap(gQueueHeap);
+    gQueueOwnerEvents.clear();
 
-        EventTypeDescription* eventTypeDescription = &(gEventTypeDescriptions[queueListNode->type]);
-        if (eventTypeDescription->freeProc != nullptr) {
-            eventTypeDescription->freeProc(queueListNode->data);
-        }
-
-        internal_free(queueListNode);
-
-        queueListNode = next;
+    for (QueueNode* queueNode : nodes) {
+        queueNode->heapIndex = -1;
+        queueNodeDestroy(queueNode);
     }
-
-    gQueueListHead = nullptr;
 }
 
 // 0x4A2790 queue_clear_type
 void queueClearByEventType(EventType eventType, QueueEventHandler* fn)
 {
-    QueueListNode** ptr = &gQueueListHead;
-    QueueListNode* curr = *ptr;
+    // `fn` handler can schedule and remove events (for instance when
+    // leaving the map while waiting for someone to die of a super stimpak
+    // overdose), so events are visited from snapshot, skipping the ones
+    // which are no longer scheduled.
+    std::vector<QueueEventKey> keys;
+    for (QueueNode* queueNode : gQueueHeap) {
+        if (queueNode->type == eventType) {
+            keys.push_back({ queueNode->time, queueNode->order, queueNode });
+        }
+    }
 
-    while (curr != nullptr) {
-        if (eventType == curr->type) {
-            QueueListNode* tmp = curr;
+    std::sort(keys.begin(), keys.end(), queueEventKeyIsBefore);
 
-            *ptr = curr->next;
-            curr = *ptr;
+    for (size_t index = 0; index < keys.size(); index++) {
+        QueueEventKey key = keys[index];
+        QueueNode* queueNode = key.node;
+        if (queueNode->heapIndex == -1 || queueNode->order != key.order) {
+            continue;
+        }
 
-            if (fn != nullptr && fn(tmp->owner, tmp->data) != 1) {
-                *ptr = tmp;
-                ptr = &(tmp->next);
-            } else {
-                EventTypeDescription* eventTypeDescription = &(gEventTypeDescriptions[tmp->type]);
-                if (eventTypeDescription->freeProc != nullptr) {
-                    eventTypeDescription->freeProc(tmp->data);
-                }
+        unsigned long long nextOrder = gQueueNextOrder;
 
-                internal_free(tmp);
+        queueNodeUnschedule(queueNode);
 
-                // SFALL: Re-read next event since `fn` handler can change it.
-                // This fixes crash when leaving the map while waiting for
-                // someone to die of a super stimpak overdose.
-                curr = *ptr;
-            }
+        bool kept = fn != nullptr && fn(queueNode->owner, queueNode->data) != 1;
+        if (kept) {
+            queueNodeSchedule(queueNode);
         } else {
-            ptr = &(curr->next);
-            curr = *ptr;
+            queueNodeDestroy(queueNode);
+        }
+
+        // Events of this type scheduled by `fn` are visited as well when they
+        // are placed after the current position in the queue. When current
+        // event is removed that position is right after the preceding event.
+        if (gQueueNextOrder != nextOrder) {
+            QueueEventKey cursor = key;
+            if (!kept) {
+                cursor = { 0, 0, nullptr };
+                for (QueueNode* other : gQueueHeap) {
+                    QueueEventKey otherKey = { other->time, other->order, other };
+                    if (other->order < nextOrder && queueEventKeyIsBefore(otherKey, key) && queueEventKeyIsBefore(cursor, otherKey)) {
+                        cursor = otherKey;
+                    }
+                }
+            }
+
+            for (QueueNode* other : gQueueHeap) {
+                if (other->type == eventType && other->order >= nextOrder) {
+                    QueueEventKey otherKey = { other->time, other->order, other };
+                    if (queueEventKeyIsBefore(cursor, otherKey)) {
+                        keys.push_back(otherKey);
+                    }
+                }
+            }
+
+            std::sort(keys.begin() + index + 1, keys.end(), queueEventKeyIsBefore);
         }
     }
 }
@@ -441,11 +487,11 @@ void queueClearByEventType(EventType eventType, QueueEventHandler* fn)
 // 0x4A2808 queue_next_time
 unsigned int queueGetNextEventTime()
 {
-    if (gQueueListHead == nullptr) {
+    if (gQueueHeap.empty()) {
         return 0;
     }
 
-    return gQueueListHead->time;
+    return gQueueHeap[0]->time;
 }
 
 // 0x4A281C queue_destroy
@@ -531,45 +577,282 @@ void _queue_leaving_map()
     }
 }
 
+
 // 0x4A294C queue_is_empty
 bool queueIsEmpty()
 {
-    return gQueueListHead == nullptr;
+    return gQueueHeap.empty();
 }
 
 // 0x4A295C queue_find_first
 void* queueFindFirstEvent(Object* owner, EventType eventType)
 {
-    QueueListNode* queueListNode = gQueueListHead;
-    while (queueListNode != nullptr) {
-        if (owner == queueListNode->owner && eventType == queueListNode->type) {
-            gLastFoundQueueListNode = queueListNode;
-            return queueListNode->data;
+    auto it = gQueueOwnerEvents.find(owner);
+    if (it != gQueueOwnerEvents.end()) {
+        QueueNode* queueNode = it->second.head;
+        while (queueNode != nullptr) {
+            if (eventType == queueNode->type) {
+                gLastFoundQueueNode = queueNode;
+                return queueNode->data;
+            }
+            queueNode = queueNode->ownerNext;
         }
-        queueListNode = queueListNode->next;
     }
 
-    gLastFoundQueueListNode = nullptr;
+    gLastFoundQueueNode = nullptr;
     return nullptr;
 }
 
 // 0x4A2994 queue_find_next
 void* queueFindNextEvent(Object* owner, EventType eventType)
 {
-    if (gLastFoundQueueListNode != nullptr) {
-        QueueListNode* queueListNode = gLastFoundQueueListNode->next;
-        while (queueListNode != nullptr) {
-            if (owner == queueListNode->owner && eventType == queueListNode->type) {
-                gLastFoundQueueListNode = queueListNode;
-                return queueListNode->data;
+    if (gLastFoundQueueNode != nullptr) {
+        QueueNode* queueNode;
+        if (gLastFoundQueueNode->owner == owner) {
+            queueNode = gLastFoundQueueNode->ownerNext;
+        } else {
+            // Continue from the same position in events of another owner.
+            auto it = gQueueOwnerEvents.find(owner);
+            queueNode = it != gQueueOwnerEvents.end() ? it->second.head : nullptr;
+            while (queueNode != nullptr && !queueNodeIsBefore(gLastFoundQueueNode, queueNode)) {
+                queueNode = queueNode->ownerNext;
             }
-            queueListNode = queueListNode->next;
+        }
+
+        while (queueNode != nullptr) {
+            if (eventType == queueNode->type) {
+                gLastFoundQueueNode = queueNode;
+                return queueNode->data;
+            }
+            queueNode = queueNode->ownerNext;
         }
     }
 
-    gLastFoundQueueListNode = nullptr;
+    gLastFoundQueueNode = nullptr;
 
     return nullptr;
 }
 
+// Takes node from the pool, allocating new block of nodes when the pool is
+// empty.
+static QueueNode* queueNodeAllocate()
+{
+    if (gQueueFreeNodes == nullptr) {
+        QueueNode* block = (QueueNode*)internal_malloc(sizeof(*block) * QUEUE_NODE_BLOCK_SIZE);
+        if (block == nullptr) {
+            return nullptr;
+        }
+
+        gQueueNodeBlocks.push_back(block);
+
+        for (int index = 0; index < QUEUE_NODE_BLOCK_SIZE; index++) {
+            block[index].heapIndex = -1;
+            block[index].ownerNext = index + 1 < QUEUE_NODE_BLOCK_SIZE ? &(block[index + 1]) : nullptr;
+        }
+
+        gQueueFreeNodes = block;
+    }
+
+    QueueNode* queueNode = gQueueFreeNodes;
+    gQueueFreeNodes = queueNode->ownerNext;
+
+    queueNode->heapIndex = -1;
+    queueNode->ownerPrev = nullptr;
+    queueNode->ownerNext = nullptr;
+
+    return queueNode;
+}
+
+// Returns unscheduled node to the pool, event data is not freed.
+static void queueNodeFree(QueueNode* node)
+{
+    if (node == gLastFoundQueueNode) {
+        gLastFoundQueueNode = nullptr;
+    }
+
+    node->heapIndex = -1;
+    node->ownerPrev = nullptr;
+    node->ownerNext = gQueueFreeNodes;
+    gQueueFreeNodes = node;
+}
+
+// Frees event data and returns unscheduled node to the pool.
+static void queueNodeDestroy(QueueNode* node)
+{
+    EventTypeDescription* eventTypeDescription = &(gEventTypeDescriptions[node->type]);
+    if (eventTypeDescription->freeProc != nullptr) {
+        eventTypeDescription->freeProc(node->data);
+    }
+
+    queueNodeFree(node);
+}
+
+static bool queueNodeIsBefore(const QueueNode* a, const QueueNode* b)
+{
+    if (a->time != b->time) {
+        return a->time < b->time;
+    }
+
+    return a->order < b->order;
+}
+
+static bool queueEventKeyIsBefore(const QueueEventKey& a, const QueueEventKey& b)
+{
+    if (a.time != b.time) {
+        return a.time < b.time;
+    }
+
+    return a.order < b.order;
+}
+
+static void queueNodeSchedule(QueueNode* node)
+{
+    node->heapIndex = static_cast<int>(gQueueHeap.size());
+    gQueueHeap.push_back(node);
+    queueHeapSiftUp(node->heapIndex);
+
+    queueOwnerEventsAdd(node);
+}
+
+static void queueNodeUnschedule(QueueNode* node)
+{
+    int index = node->heapIndex;
+
+    QueueNode* last = gQueueHeap.back();
+    gQueueHeap.pop_back();
+
+    if (last != node) {
+        gQueueHeap[index] = last;
+        last->heapIndex = index;
+        queueHeapSiftDown(index);
+        queueHeapSiftUp(last->heapIndex);
+    }
+
+    node->heapIndex = -1;
+
+    queueOwnerEventsRemove(node);
+}
+
+static void queueHeapSiftUp(int index)
+{
+    QueueNode* node = gQueueHeap[index];
+    while (index > 0) {
+        int parentIndex = (index - 1) / 2;
+        QueueNode* parent = gQueueHeap[parentIndex];
+        if (!queueNodeIsBefore(node, parent)) {
+            break;
+        }
+
+        gQueueHeap[index] = parent;
+        parent->heapIndex = index;
+        index = parentIndex;
+    }
+
+    gQueueHeap[index] = node;
+    node->heapIndex = index;
+}
+
+static void queueHeapSiftDown(int index)
+{
+    int length = static_cast<int>(gQueueHeap.size());
+    QueueNode* node = gQueueHeap[index];
+    while (true) {
+        int childIndex = index * 2 + 1;
+        if (childIndex >= length) {
+            break;
+        }
+
+        if (childIndex + 1 < length && queueNodeIsBefore(gQueueHeap[childIndex + 1], gQueueHeap[childIndex])) {
+            childIndex++;
+        }
+
+        QueueNode* child = gQueueHeap[childIndex];
+        if (!queueNodeIsBefore(child, node)) {
+            break;
+        }
+
+        gQueueHeap[index] = child;
+        child->heapIndex = index;
+        index = childIndex;
+    }
+
+    gQueueHeap[index] = node;
+    node->heapIndex = index;
+}
+
+// Inserts node into events of its owner. New events usually go last, so the
+// position is searched from the tail.
+static void queueOwnerEventsAdd(QueueNode* node)
+{
+    QueueOwnerEvents* ownerEvents = &(gQueueOwnerEvents[node->owner]);
+
+    QueueNode* prev = ownerEvents->tail;
+    while (prev != nullptr && queueNodeIsBefore(node, prev)) {
+        prev = prev->ownerPrev;
+    }
+
+    node->ownerPrev = prev;
+    node->ownerNext = prev != nullptr ? prev->ownerNext : ownerEvents->head;
+
+    if (node->ownerNext != nullptr) {
+        node->ownerNext->ownerPrev = node;
+    } else {
+        ownerEvents->tail = node;
+    }
+
+    if (prev != nullptr) {
+        prev->ownerNext = node;
+    } else {
+        ownerEvents->head = node;
+    }
+}
+
+static void queueOwnerEventsRemove(QueueNode* node)
+{
+    auto it = gQueueOwnerEvents.find(node->owner);
+    QueueOwnerEvents* ownerEvents = &(it->second);
+
+    if (node->ownerPrev != nullptr) {
+        node->ownerPrev->ownerNext = node->ownerNext;
+    } else {
+        ownerEvents->head = node->ownerNext;
+    }
+
+    if (node->ownerNext != nullptr) {
+        node->ownerNext->ownerPrev = node->ownerPrev;
+    } else {
+        ownerEvents->tail = node->ownerPrev;
+    }
+
+    node->ownerPrev = nullptr;
+    node->ownerNext = nullptr;
+
+    if (ownerEvents->head == nullptr) {
+        gQueueOwnerEvents.erase(it);
+    }
+}
+
+// Copies scheduled events in processing order.
+static void queueGetSortedNodes(std::vector<QueueNode*>& nodes)
+{
+    nodes.assign(gQueueHeap.begin(), gQueueHeap.end());
+    std::sort(nodes.begin(), nodes.end(), queueNodeIsBefore);
+}
+
+// Schedules [nodes] (given in processing order) replacing everything
+// scheduled so far.
+static void queueRebuild(std::vector<QueueNode*>& nodes)
+{
+    gQueueHeap.clear();
+    gQueueOwnerEvents.clear();
+
+    // Sorted array is a valid heap, no need to sift.
+    for (QueueNode* queueNode : nodes) {
+        queueNode->order = gQueueNextOrder++;
+        queueNode->heapIndex = static_cast<int>(gQueueHeap.size());
+        gQueueHeap.push_back(queueNode);
+        queueOwnerEventsAdd(queueNode);
+    }
+}
+
 } // namespace fallout
@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+
+#include <algorithm>
 #include <unordered_map>
 #include <vector>
 
@@ -54,6 +56,17 @@ namespace fallout {
 // CE: In Sfall this increase is configurable with `BoostScriptDialogLimit`.
 #define SCRIPT_DIALOG_MESSAGE_LIST_CAPACITY 10000
 
+// Side of spatial script grid cell, in tiles.
+#define SPATIAL_SCRIPT_CELL_SIZE 8
+
+#define SPATIAL_SCRIPT_GRID_WIDTH ((HEX_GRID_WIDTH + SPATIAL_SCRIPT_CELL_SIZE - 1) / SPATIAL_SCRIPT_CELL_SIZE)
+#define SPATIAL_SCRIPT_GRID_HEIGHT ((HEX_GRID_HEIGHT + SPATIAL_SCRIPT_CELL_SIZE - 1) / SPATIAL_SCRIPT_CELL_SIZE)
+#define SPATIAL_SCRIPT_GRID_SIZE (SPATIAL_SCRIPT_GRID_WIDTH * SPATIAL_SCRIPT_GRID_HEIGHT)
+
+// Spatial scripts with larger radius are not put into grid cells, they are
+// checked on every move instead.
+#define SPATIAL_SCRIPT_GRID_RADIUS_MAX (SPATIAL_SCRIPT_CELL_SIZE * 2)
+
 typedef struct ScriptsListEntry {
     char name[16];
     int local_vars_num;
@@ -74,6 +87,30 @@ typedef struct ScriptList {
     int nextScriptId;
 } ScriptList;
 
+// Position of script in [ScriptList].
+typedef struct ScriptLocation {
+    ScriptListExtent* extent;
+    int index;
+} ScriptLocation;
+
+// Area spatial script has been put into grid with, see
+// [scriptSetSpatialArea].
+typedef struct SpatialScriptArea {
+    int builtTile;
+    int radius;
+} SpatialScriptArea;
+
+// Grid cells covered by [SpatialScriptArea].
+typedef struct SpatialScriptCellRange {
+    int elevation;
+    // `true` when area is too big (or out of grid) to be put into cells.
+    bool unbounded;
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+} SpatialScriptCellRange;
+
 static Program* scriptsCreateProgramByName(const char* name);
 static void _doBkProcesses();
 static void _script_chk_critters();
@@ -91,6 +128,15 @@ static int scriptListExtentWrite(ScriptListExtent* scriptExtent, File* stream);
 static int scriptRead(Script* scr, File* stream);
 static int scriptListExtentRead(ScriptListExtent* scriptExtent, File* stream);
 static void scriptListExtentClearRuntimeState(ScriptListExtent* scriptExtent);
+static void scriptLocationAdd(ScriptListExtent* extent, int index);
+static void scriptLocationSet(ScriptListExtent* extent, int index);
+static bool scriptLocationFind(int sid, ScriptListExtent** extentPtr, int* indexPtr);
+static void spatialScriptsFind(int tile, int elevation, std::vector<int>& spatialScriptIds);
+static bool spatialScriptGetCellRange(int builtTile, int radius, SpatialScriptCellRange* range);
+static void spatialScriptGridAdd(int sid, int builtTile, int radius);
+static void spatialScriptGridRemove(int sid);
+static void spatialScriptGridClear();
+static void spatialScriptsSortByListPosition(std::vector<int>& sids);
 static int scriptGetNewId(int scriptType);
 static int scriptsRemoveLocalVars(Script* script);
 static int scriptsGetMessageList(int messageListId, MessageList** outMessageList);
@@ -121,6 +167,18 @@ static bool gSpatialsEnabled = true;
 // 0x51C6C0 scriptlists
 static ScriptList gScriptLists[SCRIPT_TYPE_COUNT];
 
+// Locations of scripts in [gScriptLists] by SID. Scripts move within lists
+// when other scripts are removed and when lists are compacted for saving,
+// every such move updates this index.
+static std::unordered_map<int, ScriptLocation> gScriptLocations;
+
+// SIDs of spatial scripts by elevation and grid cell. Script is put into
+// every cell its radius reaches, so that move to any tile needs to check
+// only scripts of the tile's cell and [gSpatialScriptsUnbounded].
+static std::vector<int> gSpatialScriptCells[ELEVATION_COUNT][SPATIAL_SCRIPT_GRID_SIZE];
+static std::vector<int> gSpatialScriptsUnbounded[ELEVATION_COUNT];
+static std::unordered_map<int, SpatialScriptArea> gSpatialScriptAreas;
+
 struct ScriptSelfOverride {
     Object* object = nullptr;
     int consumeCount = 1;
@@ -2116,6 +2174,9 @@ static int _scr_header_load()
         scriptList->nextScriptId = 0;
     }
 
+    gScriptLocations.clear();
+    spatialScriptGridClear();
+
     return 0;
 }
 
@@ -2227,6 +2288,9 @@ int scriptSaveAll(File* stream)
                         memcpy(script, &(lastScriptExtent->scripts[backwardsIndex]), sizeof(Script));
                         memcpy(&(lastScriptExtent->scripts[backwardsIndex]), &temp, sizeof(Script));
 
+                        scriptLocationSet(scriptExtent, index);
+                        scriptLocationSet(lastScriptExtent, backwardsIndex);
+
                         scriptCount++;
                     }
                 }
@@ -2375,6 +2439,9 @@ static void scriptListsFreeAll()
         scriptList->nextScriptId = 0;
     }
 
+    gScriptLocations.clear();
+    spatialScriptGridClear();
+
     gScriptsEnumerationScriptIndex = 0;
     gScriptsEnumerationScriptListExtent = nullptr;
     gScriptsEnumerationElevation = 0;
@@ -2418,6 +2485,10 @@ int scriptLoadAll(File* stream)
 
             scriptListExtentClearRuntimeState(extent);
 
+            for (int scriptIndex = 0; scriptIndex < extent->length; scriptIndex++) {
+                scriptLocationAdd(extent, scriptIndex);
+            }
+
             ScriptListExtent* prevExtent = extent;
             for (int extentIndex = 1; extentIndex < scriptList->length; extentIndex++) {
                 ScriptListExtent* extent = (ScriptListExtent*)internal_malloc(sizeof(*extent));
@@ -2433,6 +2504,10 @@ int scriptLoadAll(File* stream)
 
                 scriptListExtentClearRuntimeState(extent);
 
+                for (int scriptIndex = 0; scriptIndex < extent->length; scriptIndex++) {
+                    scriptLocationAdd(extent, scriptIndex);
+                }
+
                 prevExtent->next = extent;
                 prevExtent = extent;
             }
@@ -2445,6 +2520,13 @@ int scriptLoadAll(File* stream)
         }
     }
 
+    for (ScriptListExtent* extent = gScriptLists[SCRIPT_TYPE_SPATIAL].head; extent != nullptr; extent = extent->next) {
+        for (int index = 0; index < extent->length; index++) {
+            Script* script = &(extent->scripts[index]);
+            spatialScriptGridAdd(script->sid, script->sp.built_tile, script->sp.radius);
+        }
+    }
+
     return 0;
 
 cleanup:
@@ -2467,21 +2549,46 @@ int scriptGetScript(int sid, Script** scriptPtr)
         return -1;
     }
 
-    ScriptList* scriptList = &(gScriptLists[SID_TYPE(sid)]);
-    ScriptListExtent* scriptListExtent = scriptList->head;
-
-    while (scriptListExtent != nullptr) {
-        for (int index = 0; index < scriptListExtent->length; index++) {
-            Script* script = &(scriptListExtent->scripts[index]);
-            if (script->sid == sid) {
-                *scriptPtr = script;
-                return 0;
-            }
-        }
-        scriptListExtent = scriptListExtent->next;
+    ScriptListExtent* scriptListExtent;
+    int index;
+    if (!scriptLocationFind(sid, &scriptListExtent, &index)) {
+        return -1;
     }
 
-    return -1;
+    *scriptPtr = &(scriptListExtent->scripts[index]);
+
+    return 0;
+}
+
+// Indexes script at [index] in [extent], unless there is already a script
+// with the same SID (the first one wins, like in list scan).
+static void scriptLocationAdd(ScriptListExtent* extent, int index)
+{
+    ScriptLocation location;
+    location.extent = extent;
+    location.index = index;
+    gScriptLocations.emplace(extent->scripts[index].sid, location);
+}
+
+// Indexes script which has been moved to [index] in [extent].
+static void scriptLocationSet(ScriptListExtent* extent, int index)
+{
+    ScriptLocation& location = gScriptLocations[extent->scripts[index].sid];
+    location.extent = extent;
+    location.index = index;
+}
+
+static bool scriptLocationFind(int sid, ScriptListExtent** extentPtr, int* indexPtr)
+{
+    auto it = gScriptLocations.find(sid);
+    if (it == gScriptLocations.end()) {
+        return false;
+    }
+
+    *extentPtr = it->second.extent;
+    *indexPtr = it->second.index;
+
+    return true;
 }
 
 // 0x4A5ED8
@@ -2568,6 +2675,8 @@ int scriptAdd(int* sidPtr, int scriptType)
 
     scr->overriddenSelf = nullptr;
 
+    scriptLocationAdd(scriptListExtent, scriptListExtent->length);
+
     scriptListExtent->length++;
 
     return 0;
@@ -2626,24 +2735,9 @@ int scriptRemove(int sid)
 
     ScriptList* scriptList = &(gScriptLists[SID_TYPE(sid)]);
 
-    ScriptListExtent* scriptListExtent = scriptList->head;
+    ScriptListExtent* scriptListExtent;
     int index;
-    while (scriptListExtent != nullptr) {
-        for (index = 0; index < scriptListExtent->length; index++) {
-            Script* script = &(scriptListExtent->scripts[index]);
-            if (script->sid == sid) {
-                break;
-            }
-        }
-
-        if (index < scriptListExtent->length) {
-            break;
-        }
-
-        scriptListExtent = scriptListExtent->next;
-    }
-
-    if (scriptListExtent == nullptr) {
+    if (!scriptLocationFind(sid, &scriptListExtent, &index)) {
         return -1;
     }
 
@@ -2667,6 +2761,9 @@ int scriptRemove(int sid)
             debugPrint("\nERROR Removing Timed Events on scr_remove!!\n");
         }
 
+        gScriptLocations.erase(sid);
+        spatialScriptGridRemove(sid);
+
         if (scriptListExtent == scriptList->tail && index + 1 == scriptListExtent->length) {
             // Removing last script in tail extent
             scriptListExtent->length -= 1;
@@ -2690,6 +2787,7 @@ int scriptRemove(int sid)
         } else {
             // Relocate last script from tail extent into this script's slot.
             memcpy(&(scriptListExtent->scripts[index]), &(scriptList->tail->scripts[scriptList->tail->length - 1]), sizeof(Script));
+            scriptLocationSet(scriptListExtent, index);
 
             // Decrement number of scripts in tail extent.
             scriptList->tail->length -= 1;
@@ -2779,6 +2877,9 @@ int _scr_remove_all_force()
         scriptList->length = 0;
     }
 
+    gScriptLocations.clear();
+    spatialScriptGridClear();
+
     gScriptsEnumerationScriptIndex = 0;
     gScriptsEnumerationScriptListExtent = nullptr;
     gScriptsEnumerationElevation = 0;
@@ -2888,35 +2989,212 @@ bool scriptsExecSpatialProc(Object* object, int tile, int elevation)
 
     gSpatialsEnabled = false;
 
+    std::vector<int> spatialScriptIds;
+    spatialScriptsFind(tile, elevation, spatialScriptIds);
+
+    for (int sid : spatialScriptIds) {
+        // NOTE: Uninline.
+        if (scriptSetObjects(sid, object, nullptr) == -1) {
+            continue;
+        }
+        scriptExecProc(sid, SCRIPT_PROC_SPATIAL);
+    }
+
+    gSpatialsEnabled = true;
+
+    return true;
+}
+
+void scriptSetSpatialArea(Script* script, int builtTile, int radius)
+{
+    script->sp.built_tile = builtTile;
+    script->sp.radius = radius;
+
+    if (SID_TYPE(script->sid) == SCRIPT_TYPE_SPATIAL) {
+        spatialScriptGridRemove(script->sid);
+        spatialScriptGridAdd(script->sid, builtTile, radius);
+    }
+}
+
+// Collects spatial scripts on [elevation] which are triggered by moving to
+// [tile].
+static void spatialScriptsFind(int tile, int elevation, std::vector<int>& spatialScriptIds)
+{
+    if (elevation < 0 || elevation >= ELEVATION_COUNT) {
+        return;
+    }
+
     int builtTile = builtTileCreate(tile, elevation);
 
-    std::vector<int> spatialScriptIds;
-    for (Script* script = scriptGetFirstSpatialScript(elevation); script != nullptr; script = scriptGetNextSpatialScript()) {
-        if (builtTile != script->sp.built_tile) {
-            if (script->sp.radius == 0) {
+    const std::vector<int>* candidateLists[2];
+    int candidateListsLength = 0;
+
+    int x = tile % HEX_GRID_WIDTH;
+    int y = tile / HEX_GRID_WIDTH;
+    if (y < HEX_GRID_HEIGHT) {
+        int cell = (y / SPATIAL_SCRIPT_CELL_SIZE) * SPATIAL_SCRIPT_GRID_WIDTH + x / SPATIAL_SCRIPT_CELL_SIZE;
+        candidateLists[candidateListsLength++] = &(gSpatialScriptCells[elevation][cell]);
+    }
+    candidateLists[candidateListsLength++] = &(gSpatialScriptsUnbounded[elevation]);
+
+    for (int listIndex = 0; listIndex < candidateListsLength; listIndex++) {
+        for (int sid : *candidateLists[listIndex]) {
+            Script* script;
+            if (scriptGetScript(sid, &script) == -1) {
                 continue;
             }
 
-            int distance = tileDistanceBetween(builtTileGetTile(script->sp.built_tile), tile);
-            if (distance > script->sp.radius) {
+            if ((script->flags & SCRIPT_FLAG_NO_SPATIAL) != 0 || builtTileGetElevation(script->sp.built_tile) != elevation) {
                 continue;
             }
+
+            if (builtTile != script->sp.built_tile) {
+                if (script->sp.radius == 0) {
+                    continue;
+                }
+
+                int distance = tileDistanceBetween(builtTileGetTile(script->sp.built_tile), tile);
+                if (distance > script->sp.radius) {
+                    continue;
+                }
+            }
+
+            spatialScriptIds.push_back(sid);
         }
+    }
 
-        spatialScriptIds.push_back(script->sid);
+    // Procs are run in the same order as when scripts were found by
+    // scanning the list.
+    if (spatialScriptIds.size() > 1) {
+        spatialScriptsSortByListPosition(spatialScriptIds);
     }
+}
 
-    for (int sid : spatialScriptIds) {
-        // NOTE: Uninline.
-        if (scriptSetObjects(sid, object, nullptr) == -1) {
+// Calculates grid cells which contain all tiles within [radius] from
+// [builtTile]. Returns `false` if [builtTile] is not on any elevation (not
+// yet set).
+static bool spatialScriptGetCellRange(int builtTile, int radius, SpatialScriptCellRange* range)
+{
+    range->elevation = builtTileGetElevation(builtTile);
+    if (range->elevation < 0 || range->elevation >= ELEVATION_COUNT) {
+        return false;
+    }
+
+    int tile = builtTileGetTile(builtTile);
+    if (tile >= HEX_GRID_SIZE || radius > SPATIAL_SCRIPT_GRID_RADIUS_MAX) {
+        range->unbounded = true;
+        return true;
+    }
+
+    // Negative radius matches only the exact tile.
+    radius = std::max(radius, 0);
+
+    // Every step between adjacent hexes changes column and row by at most
+    // one, so tiles within radius are inside of this box.
+    int x = tile % HEX_GRID_WIDTH;
+    int y = tile / HEX_GRID_WIDTH;
+
+    range->unbounded = false;
+    range->minX = std::max(x - radius, 0) / SPATIAL_SCRIPT_CELL_SIZE;
+    range->minY = std::max(y - radius, 0) / SPATIAL_SCRIPT_CELL_SIZE;
+    range->maxX = std::min(x + radius, HEX_GRID_WIDTH - 1) / SPATIAL_SCRIPT_CELL_SIZE;
+    range->maxY = std::min(y + radius, HEX_GRID_HEIGHT - 1) / SPATIAL_SCRIPT_CELL_SIZE;
+
+    return true;
+}
+
+static void spatialScriptGridAdd(int sid, int builtTile, int radius)
+{
+    SpatialScriptCellRange range;
+    if (!spatialScriptGetCellRange(builtTile, radius, &range)) {
+        return;
+    }
+
+    if (range.unbounded) {
+        gSpatialScriptsUnbounded[range.elevation].push_back(sid);
+    } else {
+        for (int y = range.minY; y <= range.maxY; y++) {
+            for (int x = range.minX; x <= range.maxX; x++) {
+                gSpatialScriptCells[range.elevation][y * SPATIAL_SCRIPT_GRID_WIDTH + x].push_back(sid);
+            }
+        }
+    }
+
+    SpatialScriptArea area;
+    area.builtTile = builtTile;
+    area.radius = radius;
+    gSpatialScriptAreas[sid] = area;
+}
+
+static void spatialScriptGridRemove(int sid)
+{
+    auto it = gSpatialScriptAreas.find(sid);
+    if (it == gSpatialScriptAreas.end()) {
+        return;
+    }
+
+    SpatialScriptCellRange range;
+    spatialScriptGetCellRange(it->second.builtTile, it->second.radius, &range);
+    gSpatialScriptAreas.erase(it);
+
+    auto removeFrom = [sid](std::vector<int>& sids) {
+        auto sidIt = std::find(sids.begin(), sids.end(), sid);
+        if (sidIt != sids.end()) {
+            *sidIt = sids.back();
+            sids.pop_back();
+        }
+    };
+
+    if (range.unbounded) {
+        removeFrom(gSpatialScriptsUnbounded[range.elevation]);
+    } else {
+        for (int y = range.minY; y <= range.maxY; y++) {
+            for (int x = range.minX; x <= range.maxX; x++) {
+                removeFrom(gSpatialScriptCells[range.elevation][y * SPATIAL_SCRIPT_GRID_WIDTH + x]);
+            }
+        }
+    }
+}
+
+static void spatialScriptGridClear()
+{
+    for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+        for (int cell = 0; cell < SPATIAL_SCRIPT_GRID_SIZE; cell++) {
+            gSpatialScriptCells[elevation][cell].clear();
+        }
+        gSpatialScriptsUnbounded[elevation].clear();
+    }
+
+    gSpatialScriptAreas.clear();
+}
+
+// Orders spatial script [sids] as they appear in spatial script list.
+static void spatialScriptsSortByListPosition(std::vector<int>& sids)
+{
+    std::vector<std::pair<int, int>> positions;
+    positions.reserve(sids.size());
+
+    for (int sid : sids) {
+        ScriptListExtent* extent;
+        int index;
+        if (!scriptLocationFind(sid, &extent, &index)) {
             continue;
         }
-        scriptExecProc(sid, SCRIPT_PROC_SPATIAL);
+
+        int extentIndex = 0;
+        for (ScriptListExtent* other = gScriptLists[SCRIPT_TYPE_SPATIAL].head; other != nullptr && other != extent; other = other->next) {
+            extentIndex++;
+        }
+
+        positions.push_back(std::make_pair(extentIndex * SCRIPT_LIST_EXTENT_SIZE + index, sid));
     }
 
-    gSpatialsEnabled = true;
+    std::sort(positions.begin(), positions.end());
 
-    return true;
+    sids.clear();
+    for (const auto& position : positions) {
+        sids.push_back(position.second);
+    }
 }
 
 // scr_load_all_scripts
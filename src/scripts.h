@@ -261,6 +261,10 @@ Script* scriptGetNextSpatialScript();
 void _scr_spatials_enable();
 void _scr_spatials_disable();
 bool scriptsExecSpatialProc(Object* obj, int tile, int elevation);
+
+// Sets area of spatial script, all changes to `sp` fields of spatial scripts
+// must go through this function to keep spatial script grid up to date.
+void scriptSetSpatialArea(Script* script, int builtTile, int radius);
 int scriptsExecStartProc();
 void scriptsExecMapEnterProc();
 void scriptsExecMapUpdateProc();
@@ -151,6 +151,9 @@ void initSettingsRegistry(bool isMapper)
     SETTING(scroll_lock);
     SETTING(interrupt_walk);
     SETTING_P(art_cache_size, clamp(16, 512));
+    SETTING(mmap_dat);
+    SETTING(art_prefetch);
+    SETTING(art_spans);
     SETTING(color_cycling);
     SETTING(cycle_speed_factor);
     SETTING(hashing);
@@ -165,6 +168,10 @@ void initSettingsRegistry(bool isMapper)
     SETTING_P(windowed, clamp(WindowMode::Fullscreen, WindowMode::WindowedFullscreen));
     SETTING(mouse_lock);
     SETTING_P(scale, clamp(1, 4));
+    SETTING(deferred_refresh);
+    SETTING(render_threads);
+    SETTING(streaming_texture);
+    SETTING(integer_scaling);
 #undef SECT
 
 #define SECT ui
@@ -242,6 +249,12 @@ void initSettingsRegistry(bool isMapper)
 #define SECT debug
     SETTING(mode);
     SETTING(show_fps);
+    SETTING(show_cache_stats);
+    SETTING(cache_stats_path);
+    SETTING_P(cache_stats_interval, clamp(1, 3600));
+    SETTING(memory_profile_path);
+    SETTING(show_frame_profiler);
+    SETTING(frame_profile_path);
     SETTING(show_tile_num);
     SETTING(show_script_messages);
     SETTING(show_load_info);
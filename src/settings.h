@@ -20,6 +20,17 @@ struct SystemSettings {
     int scroll_lock = 0;
     bool interrupt_walk = true;
     int art_cache_size = 32;
+
+    // Map .DAT files into memory instead of reading them via file streams.
+    bool mmap_dat = false;
+
+    // Load map art on a background thread while map is being set up.
+    bool art_prefetch = false;
+
+    // Encode art frames as opaque pixel runs when they are loaded into art
+    // cache, so that object rendering skips transparent pixels.
+    bool art_spans = false;
+
     bool color_cycling = true;
     int cycle_speed_factor = 1;
     bool hashing = true;
@@ -37,6 +48,20 @@ struct ScreenSettings {
     WindowMode windowed = WindowMode::Fullscreen;
     bool mouse_lock = false;
     int scale = 1;
+
+    // Collect window refreshes during frame and copy refreshed areas to
+    // screen once before presenting it.
+    bool deferred_refresh = false;
+
+    // Number of threads rendering the map, 0 or 1 renders on main thread.
+    int render_threads = 0;
+
+    // Expand changed areas of the screen straight into locked texture when
+    // presenting frame instead of going through intermediate surface.
+    bool streaming_texture = false;
+
+    // Scale screen by whole multiples only.
+    bool integer_scaling = false;
 };
 
 struct UISettings {
@@ -164,6 +189,27 @@ struct SoundSettings {
 struct DebugSettings {
     std::string mode = "environment";
     bool show_fps = false;
+
+    // Show stats of registered caches (art, sound effects) below FPS counter.
+    bool show_cache_stats = false;
+
+    // Path of periodic cache stats dump. Written as JSON lines if it ends with
+    // .json or .jsonl, otherwise as CSV.
+    std::string cache_stats_path;
+
+    // Interval (in seconds) between cache stats dumps.
+    int cache_stats_interval = 10;
+
+    // Path of allocation profile written at exit. Enables memory profiler.
+    std::string memory_profile_path;
+
+    // Show frame time graph broken down by profiler zones.
+    bool show_frame_profiler = false;
+
+    // Path of frame profiler trace (Chrome trace event format) written on
+    // Alt+P (game only, mapper uses it) and at exit. Enables frame profiler.
+    std::string frame_profile_path;
+
     bool show_tile_num = false;
     bool show_script_messages = false;
     bool show_load_info = false;
@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include "cache.h"
+#include "cache_stats.h"
 #include "db.h"
 #include "memory.h"
 #include "settings.h"
@@ -115,6 +116,8 @@ int soundEffectsCacheInit(int cacheSize, const char* effectsPath)
         return -1;
     }
 
+    cacheStatsRegister("sfx", gSoundEffectsCache);
+
     gSoundEffectsCacheInitialized = true;
 
     return 0;
@@ -124,6 +127,7 @@ int soundEffectsCacheInit(int cacheSize, const char* effectsPath)
 void soundEffectsCacheExit()
 {
     if (gSoundEffectsCacheInitialized) {
+        cacheStatsUnregister(gSoundEffectsCache);
         cacheFree(gSoundEffectsCache);
         internal_free(gSoundEffectsCache);
         gSoundEffectsCache = nullptr;
@@ -370,7 +374,7 @@ static int soundEffectsCacheReadDataImpl(int tag, int* sizePtr, unsigned char* d
 // 0x4A94CC
 static void soundEffectsCacheFreeImpl(void* ptr)
 {
-    internal_free(ptr);
+    // NOTE: Sound data lives in cache heap, there is nothing else to release.
 }
 
 // 0x4A94D4
@@ -4,12 +4,19 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include <SDL.h>
 
+#include "cache_stats.h"
 #include "color.h"
 #include "config.h"
 #include "dinput.h"
 #include "draw.h"
+#include "draw_kernels.h"
+#include "frame_profiler.h"
 #include "game.h"
 #include "interface.h"
 #include "memory.h"
@@ -20,12 +27,25 @@
 #include "text_font.h"
 #include "tile.h"
 #include "win32.h"
+#include "window_manager.h"
 #include "window_manager_private.h"
 
 namespace fallout {
 
+// The maximum number of separate regions uploaded to [gSdlTexture] per frame.
+#define SCREEN_DIRTY_RECTS_CAPACITY (8)
+
+// The number of extra pixels a dirty rect is allowed to cover when merged
+// with another one, which saves an upload call.
+#define SCREEN_DIRTY_RECT_MERGE_SLACK (4096)
+
 static bool createRenderer(int width, int height);
 static void destroyRenderer();
+static void screenUpdateTextureSurface(const SDL_Rect* rect);
+static void screenExpandPalette(const SDL_Rect* area, unsigned char* dest, int destPitch);
+static void screenUploadRect(const SDL_Rect* rect);
+static void screenAddDirtyRect(const SDL_Rect* rect);
+static int screenRectGetArea(const SDL_Rect* rect);
 
 // screen rect
 Rect _scr_size;
@@ -42,9 +62,25 @@ SDL_Renderer* gSdlRenderer = nullptr;
 SDL_Texture* gSdlTexture = nullptr;
 SDL_Surface* gSdlTextureSurface = nullptr;
 
+// Pixel format of [gSdlTexture].
+static SDL_PixelFormat* gSdlTextureFormat = nullptr;
+
+// When set, [gSdlTextureSurface] is not used, changed areas of [gSdlSurface]
+// are converted directly into locked [gSdlTexture] in [renderPresent].
+static bool gScreenStreamingTexture = false;
+
 // TODO: Remove once migration to update-render cycle is completed.
 FpsLimiter sharedFpsLimiter;
 
+// Palette of [gSdlSurface] mapped to pixel format of [gSdlTexture].
+// Rebuilt on first use after palette or renderer changes.
+static unsigned int gScreenPaletteLut[256];
+static bool gScreenPaletteLutValid = false;
+
+// Regions of [gSdlTexture] changed since the last [renderPresent].
+static SDL_Rect gScreenDirtyRects[SCREEN_DIRTY_RECTS_CAPACITY];
+static int gScreenDirtyRectsLength = 0;
+
 // 0x4CAD08 init_mode_320_200
 int _init_mode_320_200()
 {
@@ -161,9 +197,19 @@ int _init_vesa_mode(int width, int height)
 int _GNW95_init_window(int width, int height, WindowMode mode, int scale)
 {
     if (gSdlWindow == nullptr) {
-        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "opengl");
+        // Driver requested through environment (SDL_RENDER_DRIVER) takes
+        // precedence, which allows to run with software renderer and dummy
+        // video driver.
+        const char* renderDriver = SDL_GetHint(SDL_HINT_RENDER_DRIVER);
+        if (renderDriver == nullptr) {
+            renderDriver = "opengl";
+            SDL_SetHint(SDL_HINT_RENDER_DRIVER, renderDriver);
+        }
 
-        Uint32 windowFlags = SDL_WINDOW_OPENGL | SDL_WINDOW_ALLOW_HIGHDPI;
+        Uint32 windowFlags = SDL_WINDOW_ALLOW_HIGHDPI;
+        if (SDL_strcasecmp(renderDriver, "opengl") == 0) {
+            windowFlags |= SDL_WINDOW_OPENGL;
+        }
 
         if (mode == WindowMode::Fullscreen) {
             windowFlags |= SDL_WINDOW_FULLSCREEN;
@@ -216,6 +262,7 @@ int directDrawInit(int width, int height, int bpp)
     }
 
     SDL_SetPaletteColors(gSdlSurface->format->palette, colors, 0, 256);
+    gScreenPaletteLutValid = false;
 
     return 0;
 }
@@ -245,7 +292,8 @@ void directDrawSetPaletteInRange(unsigned char* palette, int start, int count)
         }
 
         SDL_SetPaletteColors(gSdlSurface->format->palette, colors, start, count);
-        SDL_BlitSurface(gSdlSurface, nullptr, gSdlTextureSurface, nullptr);
+        gScreenPaletteLutValid = false;
+        screenUpdateTextureSurface(nullptr);
     }
 }
 
@@ -263,7 +311,8 @@ void directDrawSetPalette(unsigned char* palette)
         }
 
         SDL_SetPaletteColors(gSdlSurface->format->palette, colors, 0, 256);
-        SDL_BlitSurface(gSdlSurface, nullptr, gSdlTextureSurface, nullptr);
+        gScreenPaletteLutValid = false;
+        screenUpdateTextureSurface(nullptr);
     }
 }
 
@@ -294,16 +343,12 @@ void _GNW95_ShowRect(unsigned char* src, int srcPitch, int unused, int srcX, int
 
     blitBufferToBuffer(src + srcPitch * srcY + srcX, srcWidth, srcHeight, srcPitch, (unsigned char*)gSdlSurface->pixels + gSdlSurface->pitch * destY + destX, gSdlSurface->pitch);
 
-    SDL_Rect srcRect;
-    srcRect.x = destX;
-    srcRect.y = destY;
-    srcRect.w = srcWidth;
-    srcRect.h = srcHeight;
-
-    SDL_Rect destRect;
-    destRect.x = destX;
-    destRect.y = destY;
-    SDL_BlitSurface(gSdlSurface, &srcRect, gSdlTextureSurface, &destRect);
+    SDL_Rect rect;
+    rect.x = destX;
+    rect.y = destY;
+    rect.w = srcWidth;
+    rect.h = srcHeight;
+    screenUpdateTextureSurface(&rect);
 }
 
 // Clears drawing surface.
@@ -321,7 +366,7 @@ void _GNW95_zero_vid_mem()
         surface += gSdlSurface->pitch;
     }
 
-    SDL_BlitSurface(gSdlSurface, nullptr, gSdlTextureSurface, nullptr);
+    screenUpdateTextureSurface(nullptr);
 }
 
 int screenGetWidth()
@@ -364,6 +409,10 @@ static bool createRenderer(int width, int height)
         return false;
     }
 
+    if (settings.screen.integer_scaling) {
+        SDL_RenderSetIntegerScale(gSdlRenderer, SDL_TRUE);
+    }
+
     gSdlTexture = SDL_CreateTexture(gSdlRenderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, width, height);
     if (gSdlTexture == nullptr) {
         return false;
@@ -374,11 +423,24 @@ static bool createRenderer(int width, int height)
         return false;
     }
 
-    gSdlTextureSurface = SDL_CreateRGBSurfaceWithFormat(0, width, height, SDL_BITSPERPIXEL(format), format);
-    if (gSdlTextureSurface == nullptr) {
+    gSdlTextureFormat = SDL_AllocFormat(format);
+    if (gSdlTextureFormat == nullptr) {
         return false;
     }
 
+    gScreenStreamingTexture = settings.screen.streaming_texture;
+    if (!gScreenStreamingTexture) {
+        gSdlTextureSurface = SDL_CreateRGBSurfaceWithFormat(0, width, height, SDL_BITSPERPIXEL(format), format);
+        if (gSdlTextureSurface == nullptr) {
+            return false;
+        }
+    }
+
+    // New texture is blank, fill it with current screen contents.
+    gScreenPaletteLutValid = false;
+    gScreenDirtyRectsLength = 0;
+    screenUpdateTextureSurface(nullptr);
+
     return true;
 }
 
@@ -389,6 +451,11 @@ static void destroyRenderer()
         gSdlTextureSurface = nullptr;
     }
 
+    if (gSdlTextureFormat != nullptr) {
+        SDL_FreeFormat(gSdlTextureFormat);
+        gSdlTextureFormat = nullptr;
+    }
+
     if (gSdlTexture != nullptr) {
         SDL_DestroyTexture(gSdlTexture);
         gSdlTexture = nullptr;
@@ -410,7 +477,7 @@ void handleWindowSizeChanged()
 
 void renderFpsCounter()
 {
-    if (!settings.debug.show_fps || gSdlSurface == nullptr || gSdlTextureSurface == nullptr) {
+    if (!settings.debug.show_fps || gSdlSurface == nullptr || gSdlTexture == nullptr) {
         return;
     }
 
@@ -461,17 +528,342 @@ void renderFpsCounter()
     rect.y = 0;
     rect.w = width;
     rect.h = height;
-    SDL_BlitSurface(gSdlSurface, &rect, gSdlTextureSurface, &rect);
+    screenUpdateTextureSurface(&rect);
+}
+
+void renderCacheStatsOverlay()
+{
+    cacheStatsTick();
+
+    if (!settings.debug.show_cache_stats || gSdlSurface == nullptr || gSdlTexture == nullptr) {
+        return;
+    }
+
+    std::vector<std::string> lines;
+    cacheStatsGetOverlayLines(lines);
+    if (lines.empty()) {
+        return;
+    }
+
+    ScopedFont font(101);
+
+    constexpr int kPadding = 2;
+    int lineHeight = fontGetLineHeight();
+
+    // Stack below FPS counter.
+    int y = settings.debug.show_fps ? lineHeight + kPadding * 2 : 0;
+
+    int textWidth = 0;
+    for (const std::string& line : lines) {
+        textWidth = std::max(textWidth, fontGetStringWidth(line.c_str()));
+    }
+
+    int width = std::min(textWidth + kPadding * 2, gSdlSurface->w);
+    int height = std::min(lineHeight * static_cast<int>(lines.size()) + kPadding * 2, gSdlSurface->h - y);
+    if (width <= kPadding * 2 || height <= kPadding * 2) {
+        return;
+    }
+
+    unsigned char* dest = static_cast<unsigned char*>(gSdlSurface->pixels) + gSdlSurface->pitch * y;
+    bufferFill(dest, width, height, gSdlSurface->pitch, COLOR_BLACK);
+
+    for (size_t index = 0; index < lines.size(); index++) {
+        int lineY = kPadding + lineHeight * static_cast<int>(index);
+        if (lineY + lineHeight > height - kPadding) {
+            break;
+        }
+
+        fontDrawText(dest + gSdlSurface->pitch * lineY + kPadding, lines[index].c_str(), width - kPadding * 2, gSdlSurface->pitch, COLOR_LIGHT_GREY);
+    }
+
+    SDL_Rect rect;
+    rect.x = 0;
+    rect.y = y;
+    rect.w = width;
+    rect.h = height;
+    screenUpdateTextureSurface(&rect);
+}
+
+// Draws stacked bars of recent frame times split by profiler zones in the
+// top right corner, with a legend of average zone times below.
+void renderFrameProfilerOverlay()
+{
+    if (!settings.debug.show_frame_profiler || !frameProfilerIsEnabled() || gSdlSurface == nullptr || gSdlTexture == nullptr) {
+        return;
+    }
+
+    constexpr int kPadding = 2;
+    constexpr int kFrames = 120;
+    constexpr int kBarWidth = 2;
+    constexpr int kGraphHeight = 64;
+
+    // Microseconds per pixel of bar height, full graph is 32 ms.
+    constexpr int kTimeScale = 500;
+
+    // 60 fps frame budget.
+    constexpr int kFrameBudget = 16667;
+
+    FrameProfilerFrameTimes frames[kFrames];
+    int framesLength = frameProfilerGetRecentFrames(frames, kFrames);
+    if (framesLength == 0) {
+        return;
+    }
+
+    const unsigned char zoneColors[] = {
+        COLOR_RED,
+        COLOR_GREEN,
+        COLOR_BLUE,
+        COLOR_CYAN,
+        COLOR_MAGENTA,
+        COLOR_AMBER,
+        COLOR_LIGHT_YELLOW,
+        COLOR_WHITE,
+    };
+    constexpr int kZoneColorsLength = sizeof(zoneColors) / sizeof(zoneColors[0]);
+
+    int zonesLength = frameProfilerGetZonesLength();
+
+    unsigned long long totalTimes[FRAME_PROFILER_ZONES_MAX + 1] = { 0 };
+    for (int frameIndex = 0; frameIndex < framesLength; frameIndex++) {
+        for (int zone = 0; zone < zonesLength; zone++) {
+            totalTimes[zone] += frames[frameIndex].zones[zone];
+        }
+        totalTimes[FRAME_PROFILER_ZONES_MAX] += frames[frameIndex].total;
+    }
+
+    std::vector<std::string> lines;
+    char text[64];
+    snprintf(text, sizeof(text), "frame %.2f ms", totalTimes[FRAME_PROFILER_ZONES_MAX] / 1000.0 / framesLength);
+    lines.push_back(text);
+    for (int zone = 0; zone < zonesLength; zone++) {
+        snprintf(text, sizeof(text), "%s %.2f ms", frameProfilerGetZoneName(zone), totalTimes[zone] / 1000.0 / framesLength);
+        lines.push_back(text);
+    }
+
+    ScopedFont font(101);
+
+    int lineHeight = fontGetLineHeight();
+    int swatchSize = lineHeight - 2;
+
+    int textWidth = 0;
+    for (const std::string& line : lines) {
+        textWidth = std::max(textWidth, fontGetStringWidth(line.c_str()));
+    }
+
+    int graphWidth = kFrames * kBarWidth;
+    int width = std::max(graphWidth, swatchSize + kPadding + textWidth) + kPadding * 2;
+    int height = kGraphHeight + kPadding + lineHeight * static_cast<int>(lines.size()) + kPadding * 2;
+    if (width > gSdlSurface->w || height > gSdlSurface->h) {
+        return;
+    }
+
+    int x = gSdlSurface->w - width;
+    unsigned char* dest = static_cast<unsigned char*>(gSdlSurface->pixels) + x;
+    int pitch = gSdlSurface->pitch;
+
+    bufferFill(dest, width, height, pitch, COLOR_BLACK);
+
+    unsigned char* graph = dest + pitch * kPadding + kPadding;
+    unsigned char* graphBottom = graph + pitch * (kGraphHeight - 1);
+
+    // Newest frame is on the right.
+    for (int frameIndex = 0; frameIndex < framesLength; frameIndex++) {
+        const FrameProfilerFrameTimes* frame = &(frames[frameIndex]);
+        unsigned char* column = graphBottom + (kFrames - framesLength + frameIndex) * kBarWidth;
+
+        unsigned int time = 0;
+        int y = 0;
+        for (int zone = 0; zone <= zonesLength && y < kGraphHeight; zone++) {
+            unsigned char color;
+            if (zone < zonesLength) {
+                time += frame->zones[zone];
+                color = zoneColors[zone % kZoneColorsLength];
+            } else {
+                // Time outside of zones.
+                time = std::max(time, frame->total);
+                color = COLOR_DARK_GREY;
+            }
+
+            int top = std::min(static_cast<int>(time / kTimeScale), kGraphHeight);
+            if (top > y) {
+                bufferFill(column - pitch * (top - 1), kBarWidth, top - y, pitch, color);
+                y = top;
+            }
+        }
+    }
+
+    int budgetY = kGraphHeight - 1 - kFrameBudget / kTimeScale;
+    if (budgetY >= 0) {
+        unsigned char* budgetLine = graph + pitch * budgetY;
+        for (int index = 0; index < graphWidth; index += 2) {
+            budgetLine[index] = COLOR_LIGHT_GREY;
+        }
+    }
+
+    unsigned char* legend = graph + pitch * (kGraphHeight + kPadding);
+    for (size_t index = 0; index < lines.size(); index++) {
+        unsigned char* line = legend + pitch * lineHeight * static_cast<int>(index);
+        if (index > 0) {
+            unsigned char color = zoneColors[(index - 1) % kZoneColorsLength];
+            bufferFill(line + pitch, swatchSize, swatchSize, pitch, color);
+        }
+
+        fontDrawText(line + swatchSize + kPadding, lines[index].c_str(), width - kPadding * 3 - swatchSize, pitch, COLOR_LIGHT_GREY);
+    }
+
+    SDL_Rect rect;
+    rect.x = x;
+    rect.y = 0;
+    rect.w = width;
+    rect.h = height;
+    screenUpdateTextureSurface(&rect);
 }
 
 void renderPresent()
 {
-    SDL_UpdateTexture(gSdlTexture, nullptr, gSdlTextureSurface->pixels, gSdlTextureSurface->pitch);
-    SDL_RenderClear(gSdlRenderer);
-    SDL_RenderCopy(gSdlRenderer, gSdlTexture, nullptr, nullptr);
-    // render movie SDL texture if present
-    movieRenderDirectOverlay();
-    SDL_RenderPresent(gSdlRenderer);
+    {
+        FrameProfilerZone profilerZone("renderPresent");
+
+        windowFlushDamage();
+
+        // Upload only what has changed, texture keeps the rest from previous
+        // frames.
+        for (int index = 0; index < gScreenDirtyRectsLength; index++) {
+            screenUploadRect(&(gScreenDirtyRects[index]));
+        }
+        gScreenDirtyRectsLength = 0;
+
+        SDL_RenderClear(gSdlRenderer);
+        SDL_RenderCopy(gSdlRenderer, gSdlTexture, nullptr, nullptr);
+        // render movie SDL texture if present
+        movieRenderDirectOverlay();
+        SDL_RenderPresent(gSdlRenderer);
+    }
+
+    // Every loop of the game presents once per iteration, so presenting is
+    // the frame boundary.
+    frameProfilerEndFrame();
+}
+
+// Converts [rect] of [gSdlSurface] (or entire surface if [rect] is `nullptr`)
+// into [gSdlTextureSurface] and marks it for upload. With streaming texture
+// the area is only marked, conversion happens in [screenUploadRect].
+static void screenUpdateTextureSurface(const SDL_Rect* rect)
+{
+    if (gSdlSurface == nullptr || gSdlTexture == nullptr) {
+        return;
+    }
+
+    int textureWidth;
+    int textureHeight;
+    if (SDL_QueryTexture(gSdlTexture, nullptr, nullptr, &textureWidth, &textureHeight) != 0) {
+        return;
+    }
+
+    SDL_Rect bounds;
+    bounds.x = 0;
+    bounds.y = 0;
+    bounds.w = std::min(gSdlSurface->w, textureWidth);
+    bounds.h = std::min(gSdlSurface->h, textureHeight);
+
+    SDL_Rect area = bounds;
+    if (rect != nullptr && !SDL_IntersectRect(rect, &bounds, &area)) {
+        return;
+    }
+
+    if (!gScreenStreamingTexture) {
+        if (gSdlSurface->format->BytesPerPixel == 1 && gSdlTextureSurface->format->BytesPerPixel == 4) {
+            unsigned char* dest = static_cast<unsigned char*>(gSdlTextureSurface->pixels) + gSdlTextureSurface->pitch * area.y + area.x * 4;
+            screenExpandPalette(&area, dest, gSdlTextureSurface->pitch);
+        } else {
+            SDL_Rect destRect = area;
+            SDL_BlitSurface(gSdlSurface, &area, gSdlTextureSurface, &destRect);
+        }
+    }
+
+    screenAddDirtyRect(&area);
+}
+
+// Converts [area] of 8-bit [gSdlSurface] into 32-bit pixels at [dest].
+static void screenExpandPalette(const SDL_Rect* area, unsigned char* dest, int destPitch)
+{
+    if (!gScreenPaletteLutValid) {
+        SDL_Color* colors = gSdlSurface->format->palette->colors;
+        for (int index = 0; index < 256; index++) {
+            gScreenPaletteLut[index] = SDL_MapRGB(gSdlTextureFormat, colors[index].r, colors[index].g, colors[index].b);
+        }
+        gScreenPaletteLutValid = true;
+    }
+
+    const unsigned char* src = static_cast<const unsigned char*>(gSdlSurface->pixels) + gSdlSurface->pitch * area->y + area->x;
+    for (int y = 0; y < area->h; y++) {
+        expandPaletteRow(reinterpret_cast<unsigned int*>(dest), src, gScreenPaletteLut, area->w);
+        src += gSdlSurface->pitch;
+        dest += destPitch;
+    }
+}
+
+// Copies [rect] to [gSdlTexture].
+static void screenUploadRect(const SDL_Rect* rect)
+{
+    if (!gScreenStreamingTexture) {
+        unsigned char* pixels = static_cast<unsigned char*>(gSdlTextureSurface->pixels)
+            + gSdlTextureSurface->pitch * rect->y
+            + gSdlTextureSurface->format->BytesPerPixel * rect->x;
+        SDL_UpdateTexture(gSdlTexture, rect, pixels, gSdlTextureSurface->pitch);
+        return;
+    }
+
+    // Locked pixels are write-only and their contents are undefined, every
+    // pixel of [rect] is written below.
+    if (gSdlSurface->format->BytesPerPixel == 1 && gSdlTextureFormat->BytesPerPixel == 4) {
+        void* pixels;
+        int pitch;
+        if (SDL_LockTexture(gSdlTexture, rect, &pixels, &pitch) == 0) {
+            screenExpandPalette(rect, static_cast<unsigned char*>(pixels), pitch);
+            SDL_UnlockTexture(gSdlTexture);
+        }
+    } else {
+        SDL_Surface* surface;
+        if (SDL_LockTextureToSurface(gSdlTexture, rect, &surface) == 0) {
+            SDL_BlitSurface(gSdlSurface, rect, surface, nullptr);
+            SDL_UnlockTexture(gSdlTexture);
+        }
+    }
+}
+
+static void screenAddDirtyRect(const SDL_Rect* rect)
+{
+    int area = screenRectGetArea(rect);
+
+    // Merge into the rect which grows the least. When there are free slots
+    // only merge if it's cheap, otherwise merge anyway.
+    int bestIndex = -1;
+    int bestGrowth = INT_MAX;
+    for (int index = 0; index < gScreenDirtyRectsLength; index++) {
+        SDL_Rect bounds;
+        SDL_UnionRect(&(gScreenDirtyRects[index]), rect, &bounds);
+
+        int growth = screenRectGetArea(&bounds) - screenRectGetArea(&(gScreenDirtyRects[index]));
+        if (growth < bestGrowth) {
+            bestGrowth = growth;
+            bestIndex = index;
+        }
+    }
+
+    if (bestIndex != -1 && (bestGrowth <= area + SCREEN_DIRTY_RECT_MERGE_SLACK || gScreenDirtyRectsLength == SCREEN_DIRTY_RECTS_CAPACITY)) {
+        SDL_Rect bounds;
+        SDL_UnionRect(&(gScreenDirtyRects[bestIndex]), rect, &bounds);
+        gScreenDirtyRects[bestIndex] = bounds;
+        return;
+    }
+
+    gScreenDirtyRects[gScreenDirtyRectsLength++] = *rect;
+}
+
+static int screenRectGetArea(const SDL_Rect* rect)
+{
+    return rect->w * rect->h;
 }
 
 } // namespace fallout
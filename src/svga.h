@@ -51,6 +51,8 @@ int screenGetHeight();
 int screenGetVisibleHeight();
 void handleWindowSizeChanged();
 void renderFpsCounter();
+void renderCacheStatsOverlay();
+void renderFrameProfilerOverlay();
 void renderPresent();
 bool screenIsExclusiveFullscreen();
 
@@ -0,0 +1,664 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "art.h"
+#include "color.h"
+#include "draw.h"
+#include "draw_kernels.h"
+#include "debug.h"
+#include "geometry.h"
+
+namespace fallout {
+
+#define BLIT_TEST_DEFAULT_SEED (1)
+#define BLIT_TEST_DEFAULT_ITERATIONS (300)
+
+// Wide enough to cross several [DRAW_KERNELS_ROW_CHUNK_SIZE] chunks and to
+// leave tails for every vector width.
+#define BLIT_TEST_MAX_WIDTH (700)
+#define BLIT_TEST_MAX_HEIGHT (12)
+#define BLIT_TEST_MAX_PITCH_PADDING (40)
+
+// Buffers start at random offset up to this value from aligned storage.
+#define BLIT_TEST_MAX_MISALIGNMENT (63)
+
+// Bytes around every buffer which must not be touched by blits.
+#define BLIT_TEST_GUARD_SIZE (64)
+#define BLIT_TEST_GUARD_VALUE (0xA5)
+
+// Full light, see [blitTestInitColorTables].
+#define BLIT_TEST_IDENTITY_INTENSITY (0x10000)
+
+typedef struct BlitTestOptions {
+    unsigned int seed;
+    int iterations;
+} BlitTestOptions;
+
+// Buffer surrounded with guard bytes and starting at random alignment.
+typedef struct BlitTestBuffer {
+    std::vector<unsigned char> storage;
+    unsigned char* data;
+    int pitch;
+    int height;
+} BlitTestBuffer;
+
+static int blitTestMain(int argc, char** argv);
+static bool blitTestParseCommandLineArguments(int argc, char** argv, BlitTestOptions* options);
+static int blitTestRandom(int min, int max);
+static int blitTestRandomIntensity();
+static void blitTestInitColorTables();
+static void blitTestAllocate(BlitTestBuffer* buffer, int pitch, int height);
+static void blitTestFillPixels(BlitTestBuffer* buffer, int transparentPercent);
+static void blitTestFillMask(BlitTestBuffer* buffer);
+static void blitTestClone(BlitTestBuffer* dest, const BlitTestBuffer* src);
+static void blitTestEncodeSpans(const BlitTestBuffer* frame, int width, int height, std::vector<int>& rows, std::vector<ArtSpan>& spans);
+static bool blitTestCompare(const char* name, int iteration, const BlitTestBuffer* expected, const BlitTestBuffer* actual);
+static bool blitTestBlendTransparentRow(int iteration);
+static bool blitTestExpandPaletteRow(int iteration);
+static bool blitTestBufferToBufferTrans(int iteration);
+static bool blitTestDarkTrans(int iteration);
+static bool blitTestDarkTranslucentTrans(int iteration);
+static bool blitTestIntensityMask(int iteration);
+static bool blitTestDarkTransSpans(int iteration);
+static bool blitTestDarkTranslucentTransSpans(int iteration);
+static void referenceTransSrcCopy(unsigned char* dest, int destPitch, const unsigned char* src, int srcPitch, int width, int height);
+static void referenceDarkTransBufToBuf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, int intensity);
+static void referenceDarkTranslucentTransBufToBuf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, int intensity, Color* blendTable, Color* colorTable);
+static void referenceIntensityMaskBufToBuf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destPitch, unsigned char* mask, int maskPitch, int intensity);
+
+static std::mt19937 gBlitTestRandom;
+
+// Share of transparent pixels in generated sources, from fully opaque to
+// fully transparent.
+static const int gBlitTestTransparentPercents[] = { 0, 10, 50, 90, 100 };
+
+// Random tables for translucent blits.
+static Color gBlitTestBlendTable[COLOR_COUNT * COLOR_COUNT];
+static Color gBlitTestColorTable[COLOR_COUNT];
+
+static const char* gBlitTestVariant;
+
+// Test is built from blit sources only, palette tables normally defined in
+// color.cc are provided here and filled by [blitTestInitColorTables].
+Color colorMixAddTable[COLOR_COUNT][COLOR_COUNT];
+Color intensityColorTable[COLOR_COUNT][COLOR_COUNT];
+
+// Normally provided by debug.cc, used by kernel selection.
+int debugPrint(const char* format, ...)
+{
+    return 0;
+}
+
+// Compares blit kernels and lit blits (in every variant compiled in and
+// supported by the CPU) with the original per-pixel loops, and span blits
+// with full frame blits. Sizes, pitches, alignments, transparency and color
+// tables are random, but the same for the same seed.
+static int blitTestMain(int argc, char** argv)
+{
+    BlitTestOptions options;
+    if (!blitTestParseCommandLineArguments(argc, argv, &options)) {
+        printf("Usage: %s [--seed=N] [--iterations=N]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("seed: %u, iterations: %d\n", options.seed, options.iterations);
+
+    gBlitTestRandom.seed(options.seed);
+
+    blitTestInitColorTables();
+    drawKernelsInit();
+
+    int failures = 0;
+    for (int variant = 0; variant < DRAW_KERNELS_VARIANT_COUNT; variant++) {
+        gBlitTestVariant = drawKernelsGetVariantName(static_cast<DrawKernelsVariant>(variant));
+
+        if (!drawKernelsSetVariant(static_cast<DrawKernelsVariant>(variant))) {
+            printf("%s: skipped (not supported)\n", gBlitTestVariant);
+            continue;
+        }
+
+        bool passed = true;
+        for (int iteration = 0; iteration < options.iterations; iteration++) {
+            passed &= blitTestBlendTransparentRow(iteration);
+            passed &= blitTestExpandPaletteRow(iteration);
+            passed &= blitTestBufferToBufferTrans(iteration);
+            passed &= blitTestDarkTrans(iteration);
+            passed &= blitTestDarkTranslucentTrans(iteration);
+            passed &= blitTestIntensityMask(iteration);
+            passed &= blitTestDarkTransSpans(iteration);
+            passed &= blitTestDarkTranslucentTransSpans(iteration);
+
+            if (!passed) {
+                break;
+            }
+        }
+
+        printf("%s: %s\n", gBlitTestVariant, passed ? "ok" : "FAILED");
+
+        if (!passed) {
+            failures++;
+        }
+    }
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static bool blitTestParseCommandLineArguments(int argc, char** argv, BlitTestOptions* options)
+{
+    options->seed = BLIT_TEST_DEFAULT_SEED;
+    options->iterations = BLIT_TEST_DEFAULT_ITERATIONS;
+
+    for (int index = 1; index < argc; index++) {
+        const char* arg = argv[index];
+        if (strncmp(arg, "--seed=", 7) == 0) {
+            options->seed = static_cast<unsigned int>(strtoul(arg + 7, nullptr, 0));
+        } else if (strncmp(arg, "--iterations=", 13) == 0) {
+            options->iterations = atoi(arg + 13);
+            if (options->iterations < 1) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int blitTestRandom(int min, int max)
+{
+    std::uniform_int_distribution<int> distribution(min, max);
+    return distribution(gBlitTestRandom);
+}
+
+static int blitTestRandomIntensity()
+{
+    // Favor full light which enables identity fast paths.
+    if (blitTestRandom(0, 3) == 0) {
+        return BLIT_TEST_IDENTITY_INTENSITY;
+    }
+
+    return blitTestRandom(0, BLIT_TEST_IDENTITY_INTENSITY);
+}
+
+// Fills color tables with random values, except for full light intensity
+// which maps every color to itself like the game tables do.
+static void blitTestInitColorTables()
+{
+    for (int color = 0; color < COLOR_COUNT; color++) {
+        for (int index = 0; index < COLOR_COUNT; index++) {
+            intensityColorTable[color][index] = static_cast<Color>(blitTestRandom(0, 255));
+            colorMixAddTable[color][index] = static_cast<Color>(blitTestRandom(0, 255));
+        }
+
+        intensityColorTable[color][BLIT_TEST_IDENTITY_INTENSITY / 512] = static_cast<Color>(color);
+        gBlitTestColorTable[color] = static_cast<Color>(blitTestRandom(0, 255));
+    }
+
+    for (int index = 0; index < COLOR_COUNT * COLOR_COUNT; index++) {
+        gBlitTestBlendTable[index] = static_cast<Color>(blitTestRandom(0, 255));
+    }
+}
+
+static void blitTestAllocate(BlitTestBuffer* buffer, int pitch, int height)
+{
+    int misalignment = blitTestRandom(0, BLIT_TEST_MAX_MISALIGNMENT);
+
+    buffer->storage.assign(BLIT_TEST_GUARD_SIZE * 2 + BLIT_TEST_MAX_MISALIGNMENT + pitch * height, BLIT_TEST_GUARD_VALUE);
+    buffer->data = buffer->storage.data() + BLIT_TEST_GUARD_SIZE + misalignment;
+    buffer->pitch = pitch;
+    buffer->height = height;
+}
+
+// Fills buffer with runs of random colors and transparent pixels.
+static void blitTestFillPixels(BlitTestBuffer* buffer, int transparentPercent)
+{
+    int size = buffer->pitch * buffer->height;
+    int index = 0;
+    while (index < size) {
+        bool transparent = blitTestRandom(1, 100) <= transparentPercent;
+        int length = std::min(blitTestRandom(1, 24), size - index);
+        for (int offset = 0; offset < length; offset++) {
+            buffer->data[index + offset] = transparent ? 0 : static_cast<unsigned char>(blitTestRandom(1, 255));
+        }
+        index += length;
+    }
+}
+
+// Fills mask with egg-like values, mostly zero.
+static void blitTestFillMask(BlitTestBuffer* buffer)
+{
+    int size = buffer->pitch * buffer->height;
+    for (int index = 0; index < size; index++) {
+        buffer->data[index] = blitTestRandom(0, 1) == 0 ? 0 : static_cast<unsigned char>(blitTestRandom(1, 128));
+    }
+}
+
+static void blitTestClone(BlitTestBuffer* dest, const BlitTestBuffer* src)
+{
+    dest->storage = src->storage;
+    dest->data = dest->storage.data() + (src->data - src->storage.data());
+    dest->pitch = src->pitch;
+    dest->height = src->height;
+}
+
+// Encodes opaque runs of [frame] the same way art spans are (see
+// [ArtFrameSpans]).
+static void blitTestEncodeSpans(const BlitTestBuffer* frame, int width, int height, std::vector<int>& rows, std::vector<ArtSpan>& spans)
+{
+    for (int y = 0; y < height; y++) {
+        rows.push_back(static_cast<int>(spans.size()));
+
+        const unsigned char* row = frame->data + frame->pitch * y;
+        int x = 0;
+        while (x < width) {
+            if (row[x] == 0) {
+                x++;
+                continue;
+            }
+
+            ArtSpan span;
+            span.x = static_cast<unsigned short>(x);
+            while (x < width && row[x] != 0) {
+                x++;
+            }
+            span.length = static_cast<unsigned short>(x - span.x);
+            spans.push_back(span);
+        }
+    }
+
+    rows.push_back(static_cast<int>(spans.size()));
+}
+
+static bool blitTestCompare(const char* name, int iteration, const BlitTestBuffer* expected, const BlitTestBuffer* actual)
+{
+    for (size_t index = 0; index < expected->storage.size(); index++) {
+        if (expected->storage[index] != actual->storage[index]) {
+            long offset = static_cast<long>(expected->storage.data() + index - expected->data);
+            printf("%s: %s mismatch at iteration %d, offset %ld (pitch %d): expected %d, got %d\n",
+                gBlitTestVariant,
+                name,
+                iteration,
+                offset,
+                expected->pitch,
+                expected->storage[index],
+                actual->storage[index]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool blitTestBlendTransparentRow(int iteration)
+{
+    int width = blitTestRandom(0, BLIT_TEST_MAX_WIDTH);
+    int transparentPercent = gBlitTestTransparentPercents[iteration % 5];
+
+    BlitTestBuffer src;
+    blitTestAllocate(&src, width, 1);
+    blitTestFillPixels(&src, transparentPercent);
+
+    BlitTestBuffer colors;
+    blitTestAllocate(&colors, width, 1);
+    blitTestFillPixels(&colors, 0);
+
+    BlitTestBuffer expected;
+    blitTestAllocate(&expected, width, 1);
+    blitTestFillPixels(&expected, 0);
+
+    BlitTestBuffer actual;
+    blitTestClone(&actual, &expected);
+
+    // Colors separate from source (lit blits) and the same as source
+    // (plain transparent copy).
+    const unsigned char* colorsData = iteration % 2 == 0 ? colors.data : src.data;
+    blendTransparentRowScalar(expected.data, src.data, colorsData, width);
+    blendTransparentRow(actual.data, src.data, colorsData, width);
+
+    return blitTestCompare("blendTransparentRow", iteration, &expected, &actual);
+}
+
+static bool blitTestExpandPaletteRow(int iteration)
+{
+    int width = blitTestRandom(0, BLIT_TEST_MAX_WIDTH);
+
+    BlitTestBuffer src;
+    blitTestAllocate(&src, width, 1);
+    blitTestFillPixels(&src, gBlitTestTransparentPercents[iteration % 5]);
+
+    unsigned int palette[COLOR_COUNT];
+    for (int index = 0; index < COLOR_COUNT; index++) {
+        palette[index] = (static_cast<unsigned int>(blitTestRandom(0, 0xFFFF)) << 16) | static_cast<unsigned int>(blitTestRandom(0, 0xFFFF));
+    }
+
+    // Misaligned by whole pixels only, like rows of SDL surfaces.
+    int misalignment = blitTestRandom(0, 15);
+    std::vector<unsigned int> expected(width + misalignment + 16, 0xA5A5A5A5);
+    std::vector<unsigned int> actual = expected;
+
+    expandPaletteRowScalar(expected.data() + misalignment, src.data, palette, width);
+    expandPaletteRow(actual.data() + misalignment, src.data, palette, width);
+
+    for (size_t index = 0; index < expected.size(); index++) {
+        if (expected[index] != actual[index]) {
+            printf("%s: expandPaletteRow mismatch at iteration %d, offset %d: expected %08x, got %08x\n",
+                gBlitTestVariant,
+                iteration,
+                static_cast<int>(index) - misalignment,
+                expected[index],
+                actual[index]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool blitTestBufferToBufferTrans(int iteration)
+{
+    int width = blitTestRandom(1, BLIT_TEST_MAX_WIDTH);
+    int height = blitTestRandom(1, BLIT_TEST_MAX_HEIGHT);
+
+    BlitTestBuffer src;
+    blitTestAllocate(&src, width + blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING), height);
+    blitTestFillPixels(&src, gBlitTestTransparentPercents[iteration % 5]);
+
+    BlitTestBuffer expected;
+    blitTestAllocate(&expected, width + blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING), height);
+    blitTestFillPixels(&expected, 0);
+
+    BlitTestBuffer actual;
+    blitTestClone(&actual, &expected);
+
+    referenceTransSrcCopy(expected.data, expected.pitch, src.data, src.pitch, width, height);
+    blitBufferToBufferTrans(src.data, width, height, src.pitch, actual.data, actual.pitch);
+
+    return blitTestCompare("blitBufferToBufferTrans", iteration, &expected, &actual);
+}
+
+static bool blitTestDarkTrans(int iteration)
+{
+    int width = blitTestRandom(1, BLIT_TEST_MAX_WIDTH);
+    int height = blitTestRandom(1, BLIT_TEST_MAX_HEIGHT);
+    int destX = blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING);
+    int destY = blitTestRandom(0, 3);
+    int intensity = blitTestRandomIntensity();
+
+    BlitTestBuffer src;
+    blitTestAllocate(&src, width + blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING), height);
+    blitTestFillPixels(&src, gBlitTestTransparentPercents[iteration % 5]);
+
+    BlitTestBuffer expected;
+    blitTestAllocate(&expected, destX + width + blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING), destY + height);
+    blitTestFillPixels(&expected, 0);
+
+    BlitTestBuffer actual;
+    blitTestClone(&actual, &expected);
+
+    referenceDarkTransBufToBuf(src.data, width, height, src.pitch, expected.data, destX, destY, expected.pitch, intensity);
+    _dark_trans_buf_to_buf(src.data, width, height, src.pitch, actual.data, destX, destY, actual.pitch, intensity);
+
+    return blitTestCompare("_dark_trans_buf_to_buf", iteration, &expected, &actual);
+}
+
+static bool blitTestDarkTranslucentTrans(int iteration)
+{
+    int width = blitTestRandom(1, BLIT_TEST_MAX_WIDTH);
+    int height = blitTestRandom(1, BLIT_TEST_MAX_HEIGHT);
+    int destX = blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING);
+    int destY = blitTestRandom(0, 3);
+    int intensity = blitTestRandomIntensity();
+
+    BlitTestBuffer src;
+    blitTestAllocate(&src, width + blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING), height);
+    blitTestFillPixels(&src, gBlitTestTransparentPercents[iteration % 5]);
+
+    BlitTestBuffer expected;
+    blitTestAllocate(&expected, destX + width + blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING), destY + height);
+    blitTestFillPixels(&expected, 0);
+
+    BlitTestBuffer actual;
+    blitTestClone(&actual, &expected);
+
+    referenceDarkTranslucentTransBufToBuf(src.data, width, height, src.pitch, expected.data, destX, destY, expected.pitch, intensity, gBlitTestBlendTable, gBlitTestColorTable);
+    _dark_translucent_trans_buf_to_buf(src.data, width, height, src.pitch, actual.data, destX, destY, actual.pitch, intensity, gBlitTestBlendTable, gBlitTestColorTable);
+
+    return blitTestCompare("_dark_translucent_trans_buf_to_buf", iteration, &expected, &actual);
+}
+
+static bool blitTestIntensityMask(int iteration)
+{
+    int width = blitTestRandom(1, BLIT_TEST_MAX_WIDTH);
+    int height = blitTestRandom(1, BLIT_TEST_MAX_HEIGHT);
+    int intensity = blitTestRandomIntensity();
+
+    BlitTestBuffer src;
+    blitTestAllocate(&src, width + blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING), height);
+    blitTestFillPixels(&src, gBlitTestTransparentPercents[iteration % 5]);
+
+    BlitTestBuffer mask;
+    blitTestAllocate(&mask, width + blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING), height);
+    blitTestFillMask(&mask);
+
+    BlitTestBuffer expected;
+    blitTestAllocate(&expected, width + blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING), height);
+    blitTestFillPixels(&expected, 0);
+
+    BlitTestBuffer actual;
+    blitTestClone(&actual, &expected);
+
+    referenceIntensityMaskBufToBuf(src.data, width, height, src.pitch, expected.data, expected.pitch, mask.data, mask.pitch, intensity);
+    _intensity_mask_buf_to_buf(src.data, width, height, src.pitch, actual.data, actual.pitch, mask.data, mask.pitch, intensity);
+
+    return blitTestCompare("_intensity_mask_buf_to_buf", iteration, &expected, &actual);
+}
+
+// Draws random area of a random frame placed somewhere in the window, and
+// computes offsets the same way egg clipping in [objectRenderEntryDraw] does:
+// area is given in window coordinates and converted to frame coordinates.
+static bool blitTestDarkTransSpans(int iteration)
+{
+    int frameWidth = blitTestRandom(1, BLIT_TEST_MAX_WIDTH);
+    int frameHeight = blitTestRandom(1, BLIT_TEST_MAX_HEIGHT * 4);
+    int frameX = blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING);
+    int frameY = blitTestRandom(0, 3);
+    int intensity = blitTestRandomIntensity();
+
+    BlitTestBuffer frame;
+    blitTestAllocate(&frame, frameWidth, frameHeight);
+    blitTestFillPixels(&frame, gBlitTestTransparentPercents[iteration % 5]);
+
+    std::vector<int> rows;
+    std::vector<ArtSpan> spans;
+    blitTestEncodeSpans(&frame, frameWidth, frameHeight, rows, spans);
+
+    ArtFrameSpans frameSpans;
+    frameSpans.rows = rows.data();
+    frameSpans.spans = spans.data();
+
+    Rect rect;
+    rect.left = frameX + blitTestRandom(0, frameWidth - 1);
+    rect.top = frameY + blitTestRandom(0, frameHeight - 1);
+    rect.right = blitTestRandom(rect.left, frameX + frameWidth - 1);
+    rect.bottom = blitTestRandom(rect.top, frameY + frameHeight - 1);
+
+    int width = rect.right - rect.left + 1;
+    int height = rect.bottom - rect.top + 1;
+
+    BlitTestBuffer expected;
+    blitTestAllocate(&expected, frameX + frameWidth + blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING), frameY + frameHeight);
+    blitTestFillPixels(&expected, 0);
+
+    BlitTestBuffer actual;
+    blitTestClone(&actual, &expected);
+
+    unsigned char* src = frame.data + frameWidth * (rect.top - frameY) + (rect.left - frameX);
+    _dark_trans_buf_to_buf(src, width, height, frameWidth, expected.data, rect.left, rect.top, expected.pitch, intensity);
+    darkTransSpansToBuf(frame.data, frameWidth, &frameSpans, rect.left - frameX, rect.top - frameY, width, height, actual.data, rect.left, rect.top, actual.pitch, intensity);
+
+    return blitTestCompare("darkTransSpansToBuf", iteration, &expected, &actual);
+}
+
+// See [blitTestDarkTransSpans].
+static bool blitTestDarkTranslucentTransSpans(int iteration)
+{
+    int frameWidth = blitTestRandom(1, BLIT_TEST_MAX_WIDTH);
+    int frameHeight = blitTestRandom(1, BLIT_TEST_MAX_HEIGHT * 4);
+    int frameX = blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING);
+    int frameY = blitTestRandom(0, 3);
+    int intensity = blitTestRandomIntensity();
+
+    BlitTestBuffer frame;
+    blitTestAllocate(&frame, frameWidth, frameHeight);
+    blitTestFillPixels(&frame, gBlitTestTransparentPercents[iteration % 5]);
+
+    std::vector<int> rows;
+    std::vector<ArtSpan> spans;
+    blitTestEncodeSpans(&frame, frameWidth, frameHeight, rows, spans);
+
+    ArtFrameSpans frameSpans;
+    frameSpans.rows = rows.data();
+    frameSpans.spans = spans.data();
+
+    Rect rect;
+    rect.left = frameX + blitTestRandom(0, frameWidth - 1);
+    rect.top = frameY + blitTestRandom(0, frameHeight - 1);
+    rect.right = blitTestRandom(rect.left, frameX + frameWidth - 1);
+    rect.bottom = blitTestRandom(rect.top, frameY + frameHeight - 1);
+
+    int width = rect.right - rect.left + 1;
+    int height = rect.bottom - rect.top + 1;
+
+    BlitTestBuffer expected;
+    blitTestAllocate(&expected, frameX + frameWidth + blitTestRandom(0, BLIT_TEST_MAX_PITCH_PADDING), frameY + frameHeight);
+    blitTestFillPixels(&expected, 0);
+
+    BlitTestBuffer actual;
+    blitTestClone(&actual, &expected);
+
+    unsigned char* src = frame.data + frameWidth * (rect.top - frameY) + (rect.left - frameX);
+    _dark_translucent_trans_buf_to_buf(src, width, height, frameWidth, expected.data, rect.left, rect.top, expected.pitch, intensity, gBlitTestBlendTable, gBlitTestColorTable);
+    darkTranslucentTransSpansToBuf(frame.data, frameWidth, &frameSpans, rect.left - frameX, rect.top - frameY, width, height, actual.data, rect.left, rect.top, actual.pitch, intensity, gBlitTestBlendTable, gBlitTestColorTable);
+
+    return blitTestCompare("darkTranslucentTransSpansToBuf", iteration, &expected, &actual);
+}
+
+// Loops below are the original per-pixel implementations.
+
+static void referenceTransSrcCopy(unsigned char* dest, int destPitch, const unsigned char* src, int srcPitch, int width, int height)
+{
+    int destSkip = destPitch - width;
+    int srcSkip = srcPitch - width;
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char c = *src++;
+            if (c != 0) {
+                *dest = c;
+            }
+            dest++;
+        }
+        src += srcSkip;
+        dest += destSkip;
+    }
+}
+
+static void referenceDarkTransBufToBuf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, int intensity)
+{
+    unsigned char* sp = src;
+    unsigned char* dp = dest + destPitch * destY + destX;
+
+    int srcStep = srcPitch - srcWidth;
+    int destStep = destPitch - srcWidth;
+    int intensityIndex = intensity / 512;
+
+    for (int y = 0; y < srcHeight; y++) {
+        for (int x = 0; x < srcWidth; x++) {
+            unsigned char color = *sp;
+            if (color != 0) {
+                if (color < 0xE5) {
+                    color = intensityColorTable[color][intensityIndex];
+                }
+
+                *dp = color;
+            }
+
+            sp++;
+            dp++;
+        }
+
+        sp += srcStep;
+        dp += destStep;
+    }
+}
+
+static void referenceDarkTranslucentTransBufToBuf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, int intensity, Color* blendTable, Color* colorTable)
+{
+    int srcStep = srcPitch - srcWidth;
+    int destStep = destPitch - srcWidth;
+    int intensityIndex = intensity / 512;
+
+    dest += destPitch * destY + destX;
+
+    for (int y = 0; y < srcHeight; y++) {
+        for (int x = 0; x < srcWidth; x++) {
+            unsigned char srcByte = *src;
+            if (srcByte != 0) {
+                unsigned char destByte = *dest;
+                unsigned int index = colorTable[srcByte] << 8;
+                index = blendTable[index + destByte];
+                *dest = intensityColorTable[index][intensityIndex];
+            }
+
+            src++;
+            dest++;
+        }
+
+        src += srcStep;
+        dest += destStep;
+    }
+}
+
+static void referenceIntensityMaskBufToBuf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destPitch, unsigned char* mask, int maskPitch, int intensity)
+{
+    int srcStep = srcPitch - srcWidth;
+    int destStep = destPitch - srcWidth;
+    int maskStep = maskPitch - srcWidth;
+    int intensityIndex = intensity / 512;
+
+    for (int y = 0; y < srcHeight; y++) {
+        for (int x = 0; x < srcWidth; x++) {
+            unsigned char color = *src;
+            if (color != 0) {
+                color = intensityColorTable[color][intensityIndex];
+                if (*mask != 0) {
+                    unsigned char v1 = intensityColorTable[*dest][128 - *mask];
+                    unsigned char v2 = intensityColorTable[color][*mask];
+                    color = colorMixAddTable[v2][v1];
+                }
+                *dest = color;
+            }
+
+            src++;
+            dest++;
+            mask++;
+        }
+
+        src += srcStep;
+        dest += destStep;
+        mask += maskStep;
+    }
+}
+
+} // namespace fallout
+
+int main(int argc, char* argv[])
+{
+    return fallout::blitTestMain(argc, argv);
+}
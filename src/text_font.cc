@@ -27,6 +27,13 @@ typedef struct TextFontGlyph {
     int dataOffset;
 } TextFontGlyph;
 
+// Horizontal run of opaque pixels in a glyph.
+typedef struct TextFontSpan {
+    short x;
+    short y;
+    short length;
+} TextFontSpan;
+
 typedef struct TextFontDescriptor {
     // The number of glyphs in the font.
     int glyphCount;
@@ -39,8 +46,15 @@ typedef struct TextFontDescriptor {
 
     TextFontGlyph* glyphs;
     unsigned char* data;
+
+    // Opaque runs of all glyphs decoded from [data], see
+    // [textFontBuildSpans]. Runs of glyph `n` are from `spanOffsets[n]` up to
+    // `spanOffsets[n + 1]`.
+    TextFontSpan* spans;
+    int* spanOffsets;
 } TextFontDescriptor;
 
+static int textFontBuildSpans(TextFontDescriptor* textFontDescriptor);
 static void textFontSetCurrentImpl(int font);
 static bool fontManagerFind(int font, FontManager** fontManagerPtr);
 static void textFontDrawImpl(unsigned char* buf, const char* string, int length, int pitch, ColorWithFlags color);
@@ -145,6 +159,8 @@ void textFontsExit()
         if (textFontDescriptor->glyphCount != 0) {
             internal_free(textFontDescriptor->glyphs);
             internal_free(textFontDescriptor->data);
+            internal_free(textFontDescriptor->spans);
+            internal_free(textFontDescriptor->spanOffsets);
         }
     }
 }
@@ -157,6 +173,8 @@ int textFontLoad(int font)
     TextFontDescriptor* textFontDescriptor = &(gTextFontDescriptors[font]);
     textFontDescriptor->data = nullptr;
     textFontDescriptor->glyphs = nullptr;
+    textFontDescriptor->spans = nullptr;
+    textFontDescriptor->spanOffsets = nullptr;
 
     File* stream = nullptr;
     char path[COMPAT_MAX_PATH];
@@ -214,11 +232,25 @@ int textFontLoad(int font)
         goto out;
     }
 
+    if (textFontBuildSpans(textFontDescriptor) == -1) {
+        goto out;
+    }
+
     rc = 0;
 
 out:
 
     if (rc != 0) {
+        if (textFontDescriptor->spanOffsets != nullptr) {
+            internal_free(textFontDescriptor->spanOffsets);
+            textFontDescriptor->spanOffsets = nullptr;
+        }
+
+        if (textFontDescriptor->spans != nullptr) {
+            internal_free(textFontDescriptor->spans);
+            textFontDescriptor->spans = nullptr;
+        }
+
         if (textFontDescriptor->data != nullptr) {
             internal_free(textFontDescriptor->data);
             textFontDescriptor->data = nullptr;
@@ -237,6 +269,68 @@ out:
     return rc;
 }
 
+// Decodes 1-bit glyph bitmaps into runs of opaque pixels, so that drawing
+// text fills whole runs instead of testing every bit.
+static int textFontBuildSpans(TextFontDescriptor* textFontDescriptor)
+{
+    int glyphCount = textFontDescriptor->glyphCount;
+    int lineHeight = textFontDescriptor->lineHeight;
+
+    textFontDescriptor->spanOffsets = (int*)internal_malloc(sizeof(int) * (glyphCount + 1));
+    if (textFontDescriptor->spanOffsets == nullptr) {
+        return -1;
+    }
+
+    // Two passes - count runs first, then fill them in.
+    for (int pass = 0; pass < 2; pass++) {
+        int spanCount = 0;
+        for (int index = 0; index < glyphCount; index++) {
+            TextFontGlyph* glyph = &(textFontDescriptor->glyphs[index]);
+            unsigned char* rowData = textFontDescriptor->data + glyph->dataOffset;
+            int rowSize = (glyph->width + 7) >> 3;
+
+            textFontDescriptor->spanOffsets[index] = spanCount;
+
+            for (int y = 0; y < lineHeight; y++) {
+                int x = 0;
+                while (x < glyph->width) {
+                    if ((rowData[x >> 3] & (0x80 >> (x & 7))) == 0) {
+                        x++;
+                        continue;
+                    }
+
+                    int start = x;
+                    while (x < glyph->width && (rowData[x >> 3] & (0x80 >> (x & 7))) != 0) {
+                        x++;
+                    }
+
+                    if (pass == 1) {
+                        TextFontSpan* span = &(textFontDescriptor->spans[spanCount]);
+                        span->x = static_cast<short>(start);
+                        span->y = static_cast<short>(y);
+                        span->length = static_cast<short>(x - start);
+                    }
+                    spanCount++;
+                }
+                rowData += rowSize;
+            }
+        }
+
+        textFontDescriptor->spanOffsets[glyphCount] = spanCount;
+
+        if (pass == 0) {
+            // Allocate at least one run so that empty font is not confused
+            // with failed allocation.
+            textFontDescriptor->spans = (TextFontSpan*)internal_malloc(sizeof(TextFontSpan) * (spanCount + 1));
+            if (textFontDescriptor->spans == nullptr) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
 // 0x4D5780 text_add_manager
 int fontManagerAdd(FontManager* fontManager)
 {
@@ -349,24 +443,18 @@ static void textFontDrawImpl(unsigned char* buf, const char* string, int length,
                 break;
             }
 
-            unsigned char* glyphData = gCurrentTextFontDescriptor->data + glyph->dataOffset;
-            for (int y = 0; y < gCurrentTextFontDescriptor->lineHeight; y++) {
-                int bits = 0x80;
-                for (int x = 0; x < glyph->width; x++) {
-                    if (bits == 0) {
-                        bits = 0x80;
-                        glyphData++;
-                    }
-
-                    if ((*glyphData & bits) != 0) {
-                        *ptr = color & COLOR_LAST;
-                    }
+            // NOTE: Characters above 127 pass the check above because `ch` is
+            // signed, but fonts with less glyphs do not have runs for them.
+            int glyphIndex = ch & 0xFF;
+            if (glyphIndex >= gCurrentTextFontDescriptor->glyphCount) {
+                ptr = end;
+                continue;
+            }
 
-                    bits >>= 1;
-                    ptr++;
-                }
-                glyphData++;
-                ptr += pitch - glyph->width;
+            TextFontSpan* span = gCurrentTextFontDescriptor->spans + gCurrentTextFontDescriptor->spanOffsets[glyphIndex];
+            TextFontSpan* spanEnd = gCurrentTextFontDescriptor->spans + gCurrentTextFontDescriptor->spanOffsets[glyphIndex + 1];
+            for (; span < spanEnd; span++) {
+                memset(ptr + pitch * span->y + span->x, color & COLOR_LAST, span->length);
             }
 
             ptr = end;
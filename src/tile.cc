@@ -5,12 +5,16 @@
 #include <string.h>
 
 #include <algorithm>
+#include <mutex>
 #include <stack>
+#include <vector>
 
 #include "art.h"
 #include "color.h"
 #include "debug.h"
 #include "draw.h"
+#include "draw_kernels.h"
+#include "frame_profiler.h"
 #include "game_mouse.h"
 #include "light.h"
 #include "map.h"
@@ -20,9 +24,21 @@
 #include "settings.h"
 #include "svga.h"
 #include "tile_hires_stencil.h"
+#include "worker_pool.h"
 
 namespace fallout {
 
+// Maximum number of threads rendering the map, see [tileRenderBands].
+#define TILE_RENDER_THREADS_MAX (16)
+
+// Minimum height of a band. Smaller refreshes are rendered on the calling
+// thread.
+#define TILE_RENDER_BAND_MIN_HEIGHT (64)
+
+// Number of bands per rendering thread. Bands have different costs, having
+// more bands than threads keeps threads evenly loaded.
+#define TILE_RENDER_BANDS_PER_THREAD (2)
+
 typedef struct RightsideUpTableEntry {
     int field_0;
     int field_4;
@@ -56,6 +72,24 @@ struct roof_fill_task {
     int y;
 };
 
+typedef struct TileRenderBandsContext {
+    Rect* rect;
+    int elevation;
+    int bandCount;
+} TileRenderBandsContext;
+
+// Screen position of a tile relative to [gTileScreenOriginX] and
+// [gTileScreenOriginY].
+typedef struct TileScreenOffset {
+    short x;
+    short y;
+} TileScreenOffset;
+
+static void tileBuildScreenOffsets();
+static bool tileRenderBands(Rect* rect, int elevation);
+static void tileRenderBandProc(int index, void* context);
+static Art* tileArtLock(int fid, CacheEntry** cacheEntryPtr);
+static void tileArtUnlock(CacheEntry* cacheEntry);
 static void tileSetBorder(int windowWidth, int windowHeight, int hexGridWidth, int hexGridHeight);
 static void tileRefreshMapper(Rect* rect, int elevation);
 static void tileRefreshGame(Rect* rect, int elevation);
@@ -176,8 +210,11 @@ static UpsideDownTriangle _upside_down_triangles[5] = {
     { 6, 9, 7 },
 };
 
+// Per thread, floors are rendered on multiple threads, see
+// [tileRenderBands].
+//
 // 0x668224 intensity_map
-static int _intensity_map[3280];
+static thread_local int _intensity_map[3280];
 
 // 0x66B564 dir_tile2
 static int _dir_tile2[2][ROTATION_COUNT];
@@ -287,6 +324,20 @@ static int gTileWindowWidth;
 // 0x66BE34 tile_center_tile
 int gCenterTile;
 
+// Set while bands are rendered on worker threads.
+static bool gTileRenderingBands = false;
+
+// Serializes art cache access of band rendering threads.
+static std::mutex gTileRenderArtMutex;
+
+// Screen offsets of every tile in the hex grid, see [tileBuildScreenOffsets].
+static std::vector<TileScreenOffset> gTileScreenOffsets;
+
+// Screen position of tile 0 column 0 (tile `gHexGridWidth - 1`) for current
+// center, updated in [tileSetCenter].
+static int gTileScreenOriginX;
+static int gTileScreenOriginY;
+
 // Optional mapper overlay drawn over the iso view each refresh (edge editor). Null when unused.
 static TileMapperOverlayProc* gTileMapperOverlayProc = nullptr;
 
@@ -456,8 +507,19 @@ int tileInit(TileData** squareGrid, int squareGridWidth, int squareGridHeight, i
     gTileWindowWidth = ORIGINAL_ISO_WINDOW_WIDTH;
     gTileWindowHeight = ORIGINAL_ISO_WINDOW_HEIGHT;
 
+    tileBuildScreenOffsets();
+
     tile_hires_stencil_init();
 
+    int renderThreads = std::min(settings.screen.render_threads, TILE_RENDER_THREADS_MAX);
+    if (renderThreads > 1) {
+        // Kernels are selected on first use, make sure it does not happen
+        // on worker threads.
+        drawKernelsInit();
+        workerPoolInit(renderThreads);
+        debugPrint("Rendering map on %d threads\n", workerPoolGetThreadCount());
+    }
+
     tileSetCenter(hexGridWidth * (hexGridHeight / 2) + hexGridWidth / 2, TILE_SET_CENTER_FLAG_IGNORE_SCROLL_RESTRICTIONS);
     tileSetBorder(windowWidth, windowHeight, hexGridWidth, hexGridHeight);
 
@@ -519,6 +581,7 @@ void tileReset()
 void tileExit()
 {
     _tile_reset_();
+    workerPoolExit();
 }
 
 // 0x4B12A8 tile_disable_refresh
@@ -631,6 +694,10 @@ int tileSetCenter(int tile, int flags)
         _tile_offx -= 32;
     }
 
+    // See [tileBuildScreenOffsets], [_tile_x] is always even at this point.
+    gTileScreenOriginX = _tile_offx - 24 * _tile_x - 16 * _tile_y;
+    gTileScreenOriginY = _tile_offy + 6 * _tile_x - 12 * _tile_y;
+
     _square_x = _tile_x / 2;
     _square_y = _tile_y / 2;
     _square_offx = _tile_offx - 16;
@@ -714,6 +781,8 @@ static void tileRefreshMapper(Rect* rect, int elevation)
 // 0x4B15E8 refresh_game
 static void tileRefreshGame(Rect* rect, int elevation)
 {
+    FrameProfilerZone profilerZone("tileRefreshGame");
+
     Rect rectToUpdate;
 
     if (rectIntersection(rect, &gTileWindowRect, &rectToUpdate) == -1) {
@@ -742,9 +811,11 @@ static void tileRefreshGame(Rect* rect, int elevation)
         return;
     }
 
-    tileRenderFloorsInRect(&renderRect, elevation);
-    _obj_render_pre_roof(&renderRect, elevation);
-    tileRenderRoofsInRect(&renderRect, elevation);
+    if (!tileRenderBands(&renderRect, elevation)) {
+        tileRenderFloorsInRect(&renderRect, elevation);
+        _obj_render_pre_roof(&renderRect, elevation);
+        tileRenderRoofsInRect(&renderRect, elevation);
+    }
     _obj_render_post_roof(&renderRect, elevation);
 
     if (!hasVisArea) {
@@ -754,6 +825,82 @@ static void tileRefreshGame(Rect* rect, int elevation)
     gTileWindowRefreshProc(didClear ? &rectToUpdate : &renderRect);
 }
 
+// Renders floors, objects below roofs and roofs in horizontal bands of [rect]
+// on worker threads. Returns `false` if [rect] is too small to be split, or
+// multithreaded rendering is disabled.
+//
+// Every band goes through the same steps as the whole [rect] would, and every
+// step only touches pixels inside its band, so the result is the same as
+// rendering [rect] at once. Objects are collected on the calling thread in
+// depth order, bands draw them clipped to their bounds.
+static bool tileRenderBands(Rect* rect, int elevation)
+{
+    int threadCount = workerPoolGetThreadCount();
+    if (threadCount < 2) {
+        return false;
+    }
+
+    int bandCount = std::min(threadCount * TILE_RENDER_BANDS_PER_THREAD, rectGetHeight(rect) / TILE_RENDER_BAND_MIN_HEIGHT);
+    if (bandCount < 2) {
+        return false;
+    }
+
+    objectsPrepareDeferredPreRoof(rect, elevation);
+
+    TileRenderBandsContext context;
+    context.rect = rect;
+    context.elevation = elevation;
+    context.bandCount = bandCount;
+
+    gTileRenderingBands = true;
+    workerPoolRun(tileRenderBandProc, &context, bandCount);
+    gTileRenderingBands = false;
+
+    objectsFinishDeferredPreRoof();
+
+    return true;
+}
+
+static void tileRenderBandProc(int index, void* context)
+{
+    TileRenderBandsContext* bandsContext = static_cast<TileRenderBandsContext*>(context);
+    Rect* rect = bandsContext->rect;
+    int height = rectGetHeight(rect);
+
+    Rect band;
+    band.left = rect->left;
+    band.top = rect->top + height * index / bandsContext->bandCount;
+    band.right = rect->right;
+    band.bottom = rect->top + height * (index + 1) / bandsContext->bandCount - 1;
+
+    tileRenderFloorsInRect(&band, bandsContext->elevation);
+    objectsRenderDeferredPreRoof(&band);
+    tileRenderRoofsInRect(&band, bandsContext->elevation);
+}
+
+// Art cache is not thread safe, floors and roofs lock art from multiple
+// threads when rendering bands.
+static Art* tileArtLock(int fid, CacheEntry** cacheEntryPtr)
+{
+    if (gTileRenderingBands) {
+        std::lock_guard<std::mutex> lock(gTileRenderArtMutex);
+        return artLock(fid, cacheEntryPtr);
+    }
+
+    return artLock(fid, cacheEntryPtr);
+}
+
+static void tileArtUnlock(CacheEntry* cacheEntry)
+{
+    if (gTileRenderingBands) {
+        std::lock_guard<std::mutex> lock(gTileRenderArtMutex);
+        artUnlock(cacheEntry);
+        return;
+    }
+
+    artUnlock(cacheEntry);
+}
+
 // 0x4B1634 tile_toggle_roof
 void tile_toggle_roof(bool refresh)
 {
@@ -771,45 +918,62 @@ int tileRoofIsVisible()
     return gTileRoofIsVisible;
 }
 
+// Precomputes center independent part of [tileToScreenXY].
+//
+// The original implementation measures hex column and row from center tile
+// and adjusts for odd columns. Since center column is always even, this is
+// equivalent to:
+//
+// x = 48 * (column / 2) + 32 * (column & 1) + 16 * row - 24 * centerColumn - 16 * centerRow
+// y = -12 * (column / 2) + 12 * row + 6 * centerColumn - 12 * centerRow
+//
+// The parts that depend on center are folded into [gTileScreenOriginX] and
+// [gTileScreenOriginY], so the table only needs to be rebuilt when grid
+// dimensions change.
+static void tileBuildScreenOffsets()
+{
+    gTileScreenOffsets.resize(gHexGridSize);
+
+    TileScreenOffset* offset = gTileScreenOffsets.data();
+    for (int row = 0; row < gHexGridHeight; row++) {
+        for (int tileX = 0; tileX < gHexGridWidth; tileX++) {
+            int column = gHexGridWidth - 1 - tileX;
+            offset->x = static_cast<short>(48 * (column / 2) + 32 * (column & 1) + 16 * row);
+            offset->y = static_cast<short>(-12 * (column / 2) + 12 * row);
+            offset++;
+        }
+    }
+}
+
 // 0x4B1674 tile_coord
 int tileToScreenXY(int tile, int* screenX, int* screenY)
 {
-    int v3;
-    int v4;
-    int v5;
-    int v6;
-
-    *screenX = 0;
-    *screenY = 0;
-
     if (!tileIsValid(tile)) {
+        *screenX = 0;
+        *screenY = 0;
         return -1;
     }
 
-    v3 = gHexGridWidth - 1 - tile % gHexGridWidth;
-    v4 = tile / gHexGridWidth;
+    const TileScreenOffset& offset = gTileScreenOffsets[tile];
+    *screenX = gTileScreenOriginX + offset.x;
+    *screenY = gTileScreenOriginY + offset.y;
 
-    *screenX = _tile_offx;
-    *screenY = _tile_offy;
-
-    v5 = (v3 - _tile_x) / -2;
-    *screenX += 48 * ((v3 - _tile_x) / 2);
-    *screenY += 12 * v5;
+    return 0;
+}
 
-    if (v3 & 1) {
-        if (v3 <= _tile_x) {
-            *screenX -= 16;
-            *screenY += 12;
+void tileToScreenXYMany(const int* tiles, int count, int* screenX, int* screenY)
+{
+    const TileScreenOffset* offsets = gTileScreenOffsets.data();
+    for (int index = 0; index < count; index++) {
+        int tile = tiles[index];
+        if (tileIsValid(tile)) {
+            screenX[index] = gTileScreenOriginX + offsets[tile].x;
+            screenY[index] = gTileScreenOriginY + offsets[tile].y;
         } else {
-            *screenX += 32;
+            screenX[index] = 0;
+            screenY[index] = 0;
         }
     }
-
-    v6 = v4 - _tile_y;
-    *screenX += 16 * v6;
-    *screenY += 12 * v6;
-
-    return 0;
 }
 
 // CE: Added optional `ignoreBounds` param to return tile number without
@@ -1382,7 +1546,7 @@ void tile_fill_roof(int x, int y, int elevation, bool on)
 static void tileRenderRoof(int fid, int x, int y, Rect* rect, int light)
 {
     CacheEntry* tileFrmHandle;
-    Art* tileFrm = artLock(fid, &tileFrmHandle);
+    Art* tileFrm = tileArtLock(fid, &tileFrmHandle);
     if (tileFrm == nullptr) {
         return;
     }
@@ -1401,7 +1565,7 @@ static void tileRenderRoof(int fid, int x, int y, Rect* rect, int light)
         tileFrmBuffer += tileWidth * (tileRect.top - y) + (tileRect.left - x);
 
         CacheEntry* eggFrmHandle;
-        Art* eggFrm = artLock(gEgg->fid, &eggFrmHandle);
+        Art* eggFrm = tileArtLock(gEgg->fid, &eggFrmHandle);
         if (eggFrm != nullptr) {
             int eggWidth = artGetWidth(eggFrm);
             int eggHeight = artGetHeight(eggFrm);
@@ -1425,8 +1589,12 @@ static void tileRenderRoof(int fid, int x, int y, Rect* rect, int light)
             eggRect.right = eggRect.left + eggWidth - 1;
             eggRect.bottom = eggScreenY;
 
-            gEgg->sx = eggRect.left;
-            gEgg->sy = eggRect.top;
+            // Same position is set when preparing objects, avoid writing it
+            // from multiple threads.
+            if (!gTileRenderingBands) {
+                gEgg->sx = eggRect.left;
+                gEgg->sy = eggRect.top;
+            }
 
             Rect intersectedRect;
             if (rectIntersection(&eggRect, &tileRect, &intersectedRect) == 0) {
@@ -1481,11 +1649,11 @@ static void tileRenderRoof(int fid, int x, int y, Rect* rect, int light)
                 _dark_trans_buf_to_buf(tileFrmBuffer, tileRect.right - tileRect.left + 1, tileRect.bottom - tileRect.top + 1, tileWidth, gTileWindowBuffer, tileRect.left, tileRect.top, gTileWindowPitch, light);
             }
 
-            artUnlock(eggFrmHandle);
+            tileArtUnlock(eggFrmHandle);
         }
     }
 
-    artUnlock(tileFrmHandle);
+    tileArtUnlock(tileFrmHandle);
 }
 
 // 0x4B2944 square_render_floor
@@ -1704,7 +1872,7 @@ static void tileRenderFloor(int fid, int x, int y, Rect* rect)
     }
 
     CacheEntry* cacheEntry;
-    Art* art = artLock(fid, &cacheEntry);
+    Art* art = tileArtLock(fid, &cacheEntry);
     if (art == nullptr) {
         return;
     }
@@ -1725,6 +1893,9 @@ static void tileRenderFloor(int fid, int x, int y, Rect* rect)
     int savedX = x;
     int savedY = y;
 
+    // Light intensity at every vertex of [_verticies].
+    int intensities[10];
+
     if (left < 0) {
         left = 0;
     }
@@ -1780,12 +1951,12 @@ static void tileRenderFloor(int fid, int x, int y, Rect* rect)
         int ambientIntensity = lightGetAmbientIntensity();
         for (int i = 0; i < 10; i++) {
             // NOTE: Calls `lightGetTileIntensity` twice.
-            _verticies[i].intensity = std::max(lightGetTileIntensity(elev, tile + _verticies[i].offsets[parity]), ambientIntensity);
+            intensities[i] = std::max(lightGetTileIntensity(elev, tile + _verticies[i].offsets[parity]), ambientIntensity);
         }
 
         int v23 = 0;
         for (int i = 0; i < 9; i++) {
-            if (_verticies[i + 1].intensity != _verticies[i].intensity) {
+            if (intensities[i + 1] != intensities[i]) {
                 break;
             }
 
@@ -1794,18 +1965,18 @@ static void tileRenderFloor(int fid, int x, int y, Rect* rect)
 
         if (v23 == 9) {
             unsigned char* buf = artGetFrameData(art);
-            _dark_trans_buf_to_buf(buf + frameWidth * v78 + v79, v77, v76, frameWidth, gTileWindowBuffer, x, y, gTileWindowPitch, _verticies[0].intensity);
+            _dark_trans_buf_to_buf(buf + frameWidth * v78 + v79, v77, v76, frameWidth, gTileWindowBuffer, x, y, gTileWindowPitch, intensities[0]);
             goto out;
         }
 
         for (int i = 0; i < 5; i++) {
             RightsideUpTriangle* triangle = &(_rightside_up_triangles[i]);
-            int v32 = _verticies[triangle->field_8].intensity;
+            int v32 = intensities[triangle->field_8];
             int v33 = _verticies[triangle->field_8].field_0;
-            int v34 = _verticies[triangle->field_4].intensity - _verticies[triangle->field_0].intensity;
+            int v34 = intensities[triangle->field_4] - intensities[triangle->field_0];
             // TODO: Probably wrong.
             int v35 = v34 / 32;
-            int v36 = (_verticies[triangle->field_0].intensity - v32) / 13;
+            int v36 = (intensities[triangle->field_0] - v32) / 13;
             int* v37 = &(_intensity_map[v33]);
             if (v35 != 0) {
                 if (v36 != 0) {
@@ -1854,12 +2025,12 @@ static void tileRenderFloor(int fid, int x, int y, Rect* rect)
 
         for (int i = 0; i < 5; i++) {
             UpsideDownTriangle* triangle = &(_upside_down_triangles[i]);
-            int v50 = _verticies[triangle->field_0].intensity;
+            int v50 = intensities[triangle->field_0];
             int v51 = _verticies[triangle->field_0].field_0;
-            int v52 = _verticies[triangle->field_8].intensity - v50;
+            int v52 = intensities[triangle->field_8] - v50;
             // TODO: Probably wrong.
             int v53 = v52 / 32;
-            int v54 = (_verticies[triangle->field_4].intensity - v50) / 13;
+            int v54 = (intensities[triangle->field_4] - v50) / 13;
             int* v55 = &(_intensity_map[v51]);
             if (v53 != 0) {
                 if (v54 != 0) {
@@ -1930,7 +2101,7 @@ static void tileRenderFloor(int fid, int x, int y, Rect* rect)
 
 out:
 
-    artUnlock(cacheEntry);
+    tileArtUnlock(cacheEntry);
 }
 
 // 0x4B372C tile_make_line
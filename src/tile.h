@@ -42,6 +42,11 @@ int tileSetCenter(int tile, int flags);
 void tile_toggle_roof(bool refresh);
 int tileRoofIsVisible();
 int tileToScreenXY(int tile, int* x, int* y);
+
+// Same as [tileToScreenXY] for [count] tiles at once. Invalid tiles are
+// converted to (0, 0).
+void tileToScreenXYMany(const int* tiles, int count, int* x, int* y);
+
 int tileFromScreenXY(int x, int y, bool ignoreBounds = false);
 int squareTileFromTile(int tile);
 int tileDistanceBetween(int tile1, int tile2);
@@ -16,8 +16,10 @@
 #include <CoreFoundation/CoreFoundation.h>
 #endif
 
-#ifdef FALLOUT_MAPPER
+#if defined(FALLOUT_MAPPER)
 #include "mapper/mapper.h"
+#elif defined(FALLOUT_BENCH)
+#include "bench/bench.h"
 #else
 #include "main.h"
 #endif
@@ -98,6 +100,13 @@ int main(int argc, char* argv[])
     chdir(SDL_AndroidGetExternalStoragePath());
 #endif
 
+#ifdef FALLOUT_BENCH
+    // Benchmark does not need a window. Environment variables take precedence
+    // over these hints.
+    SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    SDL_SetHint(SDL_HINT_AUDIODRIVER, "dummy");
+#endif
+
     if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO | SDL_INIT_EVENTS) != 0) {
         return EXIT_FAILURE;
     }
@@ -107,8 +116,10 @@ int main(int argc, char* argv[])
     SDL_ShowCursor(SDL_DISABLE);
 
     gProgramIsActive = true;
-#ifdef FALLOUT_MAPPER
+#if defined(FALLOUT_MAPPER)
     rc = mapper_main(argc, argv);
+#elif defined(FALLOUT_BENCH)
+    rc = benchMain(argc, argv);
 #else
     rc = falloutMain(argc, argv);
 #endif
@@ -14,6 +14,7 @@
 #include "memory.h"
 #include "mouse.h"
 #include "palette.h"
+#include "settings.h"
 #include "svga.h"
 #include "text_font.h"
 #include "win32.h"
@@ -26,12 +27,25 @@ namespace fallout {
 // The maximum number of button groups.
 #define BUTTON_GROUP_LIST_CAPACITY (64)
 
+// The maximum number of disjoint damage rects kept per window. When exceeded
+// the damage is collapsed into its bounding rect.
+#define WINDOW_DAMAGE_MAX_RECTS (32)
+
+// The number of extra pixels two damage rects are allowed to cover when they
+// are merged into one. Roughly matches the fixed cost of refreshing a rect
+// (clipping against other windows, blit setup).
+#define WINDOW_DAMAGE_MERGE_SLACK (1024)
+
 static void windowFree(int win);
 static void _win_buffering(bool bufferWindows);
 static void _win_move(int win_index, int x, int y);
 static void _win_clip(Window* window, RectListNode** rect, unsigned char* dest);
 static void win_drag(int win);
 static void _refresh_all(Rect* rect, unsigned char* dest);
+static void windowAddDamage(Window* window, const Rect* rect);
+static void windowCoalesceDamage(RectListNode** rectListNodePtr);
+static void windowFreeDamage(Window* window);
+static unsigned int rectGetArea(const Rect* rect);
 static Button* buttonGetButton(int btn, Window** out_win);
 static Button* buttonCreateInternal(int win, int x, int y, int width, int height, int mouseEnterEventCode, int mouseExitEventCode, int mouseDownEventCode, int mouseUpEventCode, int flags, unsigned char* up, unsigned char* dn, unsigned char* hover);
 static int _GNW_check_buttons(Window* window, int* keyCodePtr);
@@ -106,6 +120,14 @@ static int _doing_refresh_all;
 // 0x6ADF3C GNW_texture
 static void* _GNW_texture;
 
+// Defer window refreshes until [windowFlushDamage].
+static bool gWindowDamageEnabled = false;
+
+static WindowDamageStats gWindowDamageStats;
+
+// Area of refresh requests since the last flush.
+static unsigned long long gWindowDamagePendingArea = 0;
+
 // 0x6ADF40 btn_grp
 static ButtonGroup gButtonGroups[BUTTON_GROUP_LIST_CAPACITY];
 
@@ -135,6 +157,10 @@ int windowManagerInit(VideoSystemInitProc* videoSystemInitProc, VideoSystemExitP
         gWindowIndexes[index] = -1;
     }
 
+    gWindowDamageEnabled = settings.screen.deferred_refresh;
+    gWindowDamageStats = {};
+    gWindowDamagePendingArea = 0;
+
     if (db_total() == 0) {
         if (dbOpen(nullptr, _path_patches) == -1) {
             return WINDOW_MANAGER_ERR_INITIALIZING_DEFAULT_DATABASE;
@@ -242,6 +268,7 @@ int windowManagerInit(VideoSystemInitProc* videoSystemInitProc, VideoSystemExitP
     window->hoveredButton = nullptr;
     window->clickedButton = nullptr;
     window->menuBar = nullptr;
+    window->damage = nullptr;
 
     gWindowsLength = 1;
     gWindowSystemInitialized = 1;
@@ -269,6 +296,14 @@ void windowManagerExit(void)
         if (gWindowSystemInitialized) {
             _GNW_intr_exit();
 
+            if (gWindowDamageEnabled && gWindowDamageStats.flushedArea != 0) {
+                debugPrint("Window refresh: %u frames, %u requests, %u rects, overdraw %.2fx\n",
+                    gWindowDamageStats.frames,
+                    gWindowDamageStats.requests,
+                    gWindowDamageStats.flushedRects,
+                    static_cast<double>(gWindowDamageStats.requestedArea) / static_cast<double>(gWindowDamageStats.flushedArea));
+            }
+
             for (int index = gWindowsLength - 1; index >= 0; index--) {
                 windowFree(gWindows[index]->id);
             }
@@ -370,6 +405,7 @@ int windowCreate(int x, int y, int width, int height, ColorWithFlags color, int
     window->clickedButton = nullptr;
     window->menuBar = nullptr;
     window->blitProc = blitBufferToBufferTrans;
+    window->damage = nullptr;
     window->color = color;
     gWindowIndexes[id] = gWindowsLength;
     gWindowsLength++;
@@ -456,6 +492,8 @@ void windowFree(int win)
         internal_free(window->menuBar);
     }
 
+    windowFreeDamage(window);
+
     Button* curr = window->buttonListHead;
     while (curr != nullptr) {
         Button* next = curr->next;
@@ -772,6 +810,12 @@ void windowRefresh(int win)
         return;
     }
 
+    if (gWindowDamageEnabled) {
+        Rect rect = { 0, 0, window->width - 1, window->height - 1 };
+        windowAddDamage(window, &rect);
+        return;
+    }
+
     _GNW_win_refresh(window, &(window->rect), nullptr);
 }
 
@@ -788,6 +832,15 @@ void windowRefreshRect(int win, const Rect* rect)
         return;
     }
 
+    if (gWindowDamageEnabled) {
+        Rect bounds = { 0, 0, window->width - 1, window->height - 1 };
+        Rect damageRect;
+        if (rectIntersection(rect, &bounds, &damageRect) == 0) {
+            windowAddDamage(window, &damageRect);
+        }
+        return;
+    }
+
     Rect newRect;
     rectCopy(&newRect, rect);
     rectOffset(&newRect, window->rect.left, window->rect.top);
@@ -975,6 +1028,178 @@ void windowRefreshAll(Rect* rect)
     }
 }
 
+void windowFlushDamage()
+{
+    if (!gWindowSystemInitialized || !gWindowDamageEnabled) {
+        return;
+    }
+
+    unsigned long long flushedArea = 0;
+
+    // Windows are flushed bottom to top, the same order [_refresh_all] uses.
+    for (int index = 0; index < gWindowsLength; index++) {
+        Window* window = gWindows[index];
+        if (window->damage == nullptr) {
+            continue;
+        }
+
+        RectListNode* rectListNode = window->damage;
+        window->damage = nullptr;
+
+        windowCoalesceDamage(&rectListNode);
+
+        while (rectListNode != nullptr) {
+            RectListNode* next = rectListNode->next;
+
+            Rect rect = rectListNode->rect;
+            rectOffset(&rect, window->rect.left, window->rect.top);
+
+            gWindowDamageStats.flushedRects++;
+            flushedArea += rectGetArea(&rect);
+
+            _GNW_win_refresh(window, &rect, nullptr);
+
+            _rect_free(rectListNode);
+            rectListNode = next;
+        }
+    }
+
+    if (flushedArea != 0) {
+        gWindowDamageStats.frames++;
+        gWindowDamageStats.flushedArea += flushedArea;
+        gWindowDamageStats.lastFlushedArea = flushedArea;
+        gWindowDamageStats.lastRequestedArea = gWindowDamagePendingArea;
+    }
+
+    gWindowDamagePendingArea = 0;
+}
+
+void windowGetDamageStats(WindowDamageStats* stats)
+{
+    *stats = gWindowDamageStats;
+}
+
+// Adds [rect] (in window coordinates) to damaged area of [window]. Damage is
+// kept as a list of disjoint rects, so only the part of [rect] which is not
+// damaged yet is added.
+static void windowAddDamage(Window* window, const Rect* rect)
+{
+    gWindowDamageStats.requests++;
+    gWindowDamageStats.requestedArea += rectGetArea(rect);
+    gWindowDamagePendingArea += rectGetArea(rect);
+
+    if ((window->flags & WINDOW_HIDDEN) != 0) {
+        return;
+    }
+
+    RectListNode* pieces = _rect_malloc();
+    if (pieces == nullptr) {
+        return;
+    }
+
+    pieces->rect = *rect;
+    pieces->next = nullptr;
+
+    int length = 0;
+    RectListNode** tailPtr = &(window->damage);
+    while (*tailPtr != nullptr && pieces != nullptr) {
+        _rect_clip_list(&pieces, &((*tailPtr)->rect));
+        tailPtr = &((*tailPtr)->next);
+        length++;
+    }
+
+    if (pieces == nullptr) {
+        // Already damaged.
+        return;
+    }
+
+    while (*tailPtr != nullptr) {
+        tailPtr = &((*tailPtr)->next);
+        length++;
+    }
+
+    *tailPtr = pieces;
+    while (pieces != nullptr) {
+        pieces = pieces->next;
+        length++;
+    }
+
+    if (length > WINDOW_DAMAGE_MAX_RECTS) {
+        Rect bounds = window->damage->rect;
+        for (RectListNode* node = window->damage->next; node != nullptr; node = node->next) {
+            rectUnion(&bounds, &(node->rect), &bounds);
+        }
+
+        windowFreeDamage(window);
+
+        window->damage = _rect_malloc();
+        if (window->damage != nullptr) {
+            window->damage->rect = bounds;
+            window->damage->next = nullptr;
+        }
+    }
+}
+
+// Merges disjoint rects which are close enough to each other that refreshing
+// their bounding rect is cheaper than refreshing them one by one. Pairs are
+// only merged when their bounding rect does not touch any other rect, so the
+// result stays disjoint.
+static void windowCoalesceDamage(RectListNode** rectListNodePtr)
+{
+    bool merged;
+    do {
+        merged = false;
+
+        for (RectListNode* node = *rectListNodePtr; node != nullptr && !merged; node = node->next) {
+            for (RectListNode** otherPtr = &(node->next); *otherPtr != nullptr; otherPtr = &((*otherPtr)->next)) {
+                RectListNode* other = *otherPtr;
+
+                Rect bounds;
+                rectUnion(&(node->rect), &(other->rect), &bounds);
+
+                if (rectGetArea(&bounds) > rectGetArea(&(node->rect)) + rectGetArea(&(other->rect)) + WINDOW_DAMAGE_MERGE_SLACK) {
+                    continue;
+                }
+
+                bool overlaps = false;
+                for (RectListNode* rest = *rectListNodePtr; rest != nullptr; rest = rest->next) {
+                    Rect intersection;
+                    if (rest != node && rest != other && rectIntersection(&bounds, &(rest->rect), &intersection) == 0) {
+                        overlaps = true;
+                        break;
+                    }
+                }
+
+                if (overlaps) {
+                    continue;
+                }
+
+                node->rect = bounds;
+
+                *otherPtr = other->next;
+                _rect_free(other);
+
+                merged = true;
+                break;
+            }
+        }
+    } while (merged);
+}
+
+static void windowFreeDamage(Window* window)
+{
+    while (window->damage != nullptr) {
+        RectListNode* next = window->damage->next;
+        _rect_free(window->damage);
+        window->damage = next;
+    }
+}
+
+static unsigned int rectGetArea(const Rect* rect)
+{
+    return rectGetWidth(rect) * rectGetHeight(rect);
+}
+
 // 0x4D75B0
 void _win_clip(Window* currentWindow, RectListNode** rectListNodePtr, unsigned char* dest)
 {
@@ -123,6 +123,10 @@ typedef struct Window {
     Button* clickedButton;
     MenuBar* menuBar;
     WindowBlitProc* blitProc;
+
+    // Areas of the window (in window coordinates) which were refreshed but
+    // not yet copied to screen, see [windowFlushDamage].
+    RectListNode* damage;
 } Window;
 
 typedef void ButtonCallback(int btn, int keyCode);
@@ -219,6 +223,37 @@ void windowRefresh(int win);
 void windowRefreshRect(int win, const Rect* rect);
 void _GNW_win_refresh(Window* window, Rect* rect, unsigned char* dest);
 void windowRefreshAll(Rect* rect);
+
+// Refresh statistics collected when window refreshes are deferred until the
+// end of the frame (`deferred_refresh` is enabled).
+typedef struct WindowDamageStats {
+    // Number of frames which had anything to flush.
+    unsigned int frames;
+
+    // Number of [windowRefresh] and [windowRefreshRect] calls.
+    unsigned int requests;
+
+    // Number of rects actually refreshed after merging.
+    unsigned int flushedRects;
+
+    // Total area (in pixels) of all refresh requests, which is what would be
+    // copied to screen if refreshes were not deferred.
+    unsigned long long requestedArea;
+
+    // Total area (in pixels) actually copied to screen.
+    unsigned long long flushedArea;
+
+    // Same as above for the last flushed frame.
+    unsigned long long lastRequestedArea;
+    unsigned long long lastFlushedArea;
+} WindowDamageStats;
+
+// Copies areas of windows refreshed since the last flush to screen. Each
+// pixel is copied at most once regardless of the number of times it was
+// refreshed. Does nothing when refreshes are not deferred.
+void windowFlushDamage();
+
+void windowGetDamageStats(WindowDamageStats* stats);
 void _win_get_mouse_buf(unsigned char* dest);
 bool windowIsValidWindowId(int win);
 Window* windowGetWindow(int win);
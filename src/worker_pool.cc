@@ -0,0 +1,149 @@
+#include "worker_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fallout {
+
+static void workerPoolThreadProc();
+static void workerPoolDrain(WorkerPoolJobProc* proc, void* context, int count);
+
+static std::vector<std::thread> gWorkerPoolThreads;
+static std::mutex gWorkerPoolMutex;
+
+// Signalled when new batch of jobs is available or pool is stopping.
+static std::condition_variable gWorkerPoolStartCondition;
+
+// Signalled when worker is done with current batch.
+static std::condition_variable gWorkerPoolDoneCondition;
+
+// Current batch, guarded by [gWorkerPoolMutex].
+static WorkerPoolJobProc* gWorkerPoolProc = nullptr;
+static void* gWorkerPoolContext = nullptr;
+static int gWorkerPoolCount = 0;
+static unsigned int gWorkerPoolGeneration = 0;
+static bool gWorkerPoolStopping = false;
+
+// Number of workers which have picked current batch and not yet finished
+// with it. Next batch cannot start until it drops to zero, otherwise late
+// worker could take an index of the next batch.
+static int gWorkerPoolActiveThreads = 0;
+
+static std::atomic<int> gWorkerPoolNextIndex(0);
+
+void workerPoolInit(int threadCount)
+{
+    workerPoolExit();
+
+    gWorkerPoolStopping = false;
+    for (int index = 1; index < threadCount; index++) {
+        gWorkerPoolThreads.emplace_back(workerPoolThreadProc);
+    }
+}
+
+void workerPoolExit()
+{
+    if (gWorkerPoolThreads.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(gWorkerPoolMutex);
+        gWorkerPoolStopping = true;
+    }
+    gWorkerPoolStartCondition.notify_all();
+
+    for (std::thread& thread : gWorkerPoolThreads) {
+        thread.join();
+    }
+
+    gWorkerPoolThreads.clear();
+}
+
+int workerPoolGetThreadCount()
+{
+    return static_cast<int>(gWorkerPoolThreads.size()) + 1;
+}
+
+void workerPoolRun(WorkerPoolJobProc* proc, void* context, int count)
+{
+    if (gWorkerPoolThreads.empty() || count < 2) {
+        for (int index = 0; index < count; index++) {
+            proc(index, context);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(gWorkerPoolMutex);
+        gWorkerPoolProc = proc;
+        gWorkerPoolContext = context;
+        gWorkerPoolCount = count;
+        gWorkerPoolNextIndex.store(0);
+        gWorkerPoolGeneration++;
+    }
+    gWorkerPoolStartCondition.notify_all();
+
+    workerPoolDrain(proc, context, count);
+
+    std::unique_lock<std::mutex> lock(gWorkerPoolMutex);
+    gWorkerPoolDoneCondition.wait(lock, [] {
+        return gWorkerPoolActiveThreads == 0;
+    });
+
+    // Prevents workers which wake up only now from joining finished batch.
+    gWorkerPoolCount = 0;
+}
+
+static void workerPoolThreadProc()
+{
+    unsigned int generation = 0;
+
+    std::unique_lock<std::mutex> lock(gWorkerPoolMutex);
+    while (true) {
+        gWorkerPoolStartCondition.wait(lock, [&generation] {
+            return gWorkerPoolStopping || gWorkerPoolGeneration != generation;
+        });
+
+        if (gWorkerPoolStopping) {
+            break;
+        }
+
+        generation = gWorkerPoolGeneration;
+
+        WorkerPoolJobProc* proc = gWorkerPoolProc;
+        void* context = gWorkerPoolContext;
+        int count = gWorkerPoolCount;
+        if (count == 0) {
+            continue;
+        }
+
+        gWorkerPoolActiveThreads++;
+        lock.unlock();
+
+        workerPoolDrain(proc, context, count);
+
+        lock.lock();
+        gWorkerPoolActiveThreads--;
+        if (gWorkerPoolActiveThreads == 0) {
+            gWorkerPoolDoneCondition.notify_one();
+        }
+    }
+}
+
+static void workerPoolDrain(WorkerPoolJobProc* proc, void* context, int count)
+{
+    while (true) {
+        int index = gWorkerPoolNextIndex.fetch_add(1);
+        if (index >= count) {
+            break;
+        }
+
+        proc(index, context);
+    }
+}
+
+} // namespace fallout
@@ -0,0 +1,26 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+namespace fallout {
+
+typedef void(WorkerPoolJobProc)(int index, void* context);
+
+// Starts [threadCount] - 1 worker threads, the thread which calls
+// [workerPoolRun] acts as the remaining one. Pool with less than two threads
+// runs all jobs on the calling thread.
+void workerPoolInit(int threadCount);
+
+// Stops worker threads.
+void workerPoolExit();
+
+// Returns number of threads jobs are spread across, including calling thread.
+int workerPoolGetThreadCount();
+
+// Calls [proc] for every index in [0, count) and returns when all calls are
+// complete. Calls are spread across worker threads and the calling thread in
+// no particular order. Must be called from the same thread every time.
+void workerPoolRun(WorkerPoolJobProc* proc, void* context, int count);
+
+} // namespace fallout
+
+#endif /* WORKER_POOL_H */
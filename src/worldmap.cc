@@ -3543,6 +3543,8 @@ static int wmWorldMapFunc(int a1)
                     mousePressed = true;
                     wmInterfaceRefresh();
                     renderFpsCounter();
+                    renderCacheStatsOverlay();
+                    renderFrameProfilerOverlay();
                     renderPresent();
                 }
             } else {
@@ -3704,6 +3706,8 @@ static int wmWorldMapFunc(int a1)
         }
 
         renderFpsCounter();
+        renderCacheStatsOverlay();
+        renderFrameProfilerOverlay();
         renderPresent();
         sharedFpsLimiter.throttle();
     }
@@ -6621,6 +6625,8 @@ static int wmTownMapFunc(Map* mapIdxPtr)
         }
 
         renderFpsCounter();
+        renderCacheStatsOverlay();
+        renderFrameProfilerOverlay();
         renderPresent();
         sharedFpsLimiter.throttle();
     }
@@ -1,10 +1,19 @@
 #include "xfile.h"
 
 #include <assert.h>
+#include <ctype.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fpattern/fpattern.h>
+
 #ifdef _WIN32
 #include <direct.h>
 #else
@@ -30,11 +39,74 @@ typedef struct XListEnumerationContext {
 
 typedef bool(XListEnumerationHandler)(XListEnumerationContext* context);
 
+// A single entry in directory listing of directory-based xbase.
+typedef struct XBaseDirectoryEntry {
+    // Original (case-preserved) name of file or directory.
+    std::string name;
+    bool isDirectory;
+} XBaseDirectoryEntry;
+
+// Cached contents of one directory inside directory-based xbase.
+typedef struct XBaseDirectoryListing {
+    // Entries in the order they were reported by file system.
+    std::vector<XBaseDirectoryEntry> entries;
+
+    // Lowercased entry names mapped to indexes in [entries].
+    std::unordered_map<std::string, size_t> entryIndexes;
+} XBaseDirectoryListing;
+
+// Lazily populated listings of directory-based xbase.
+typedef struct XBaseIndexDirectory {
+    XBase* xbase;
+
+    // The position of [xbase] in xbases list (lower is higher priority).
+    int order;
+
+    // Listings keyed by lowercased directory path relative to [xbase] (empty
+    // string denotes root).
+    std::unordered_map<std::string, XBaseDirectoryListing> listings;
+} XBaseIndexDirectory;
+
+// The winning .DAT entry for a specific path.
+typedef struct XBaseIndexEntry {
+    XBase* xbase;
+    DBaseEntry* entry;
+
+    // The position of [xbase] in xbases list (lower is higher priority).
+    int order;
+} XBaseIndexEntry;
+
+// An index used to resolve relative paths without walking every xbase.
+//
+// .DAT entries are immutable, so they are indexed once per xbases list
+// change. Directory listings are loaded on demand and dropped when file system
+// is modified (see [compat_fs_generation]).
+typedef struct XBaseIndex {
+    // Specifies whether index reflects current xbases list.
+    bool valid;
+
+    // The file system generation at the time directory listings were loaded.
+    unsigned int fileSystemGeneration;
+
+    // Lowercased paths of .DAT entries mapped to the highest priority xbase
+    // containing them.
+    std::unordered_map<std::string, XBaseIndexEntry> dbaseEntries;
+
+    // Directory-based xbases in the order of priority.
+    std::vector<XBaseIndexDirectory> directories;
+} XBaseIndex;
+
 static bool xlistEnumerate(const char* pattern, XListEnumerationHandler* handler, XList* xlist);
 static int xbaseMakeDirectory(const char* path);
 static void xbaseCloseAll();
 static void xbaseExitHandler(void);
 static bool xlistEnumerateHandler(XListEnumerationContext* context);
+static std::string xbaseIndexNormalizePath(const char* path);
+static void xbaseIndexInvalidate();
+static void xbaseIndexValidate();
+static const XBaseDirectoryListing* xbaseIndexGetListing(XBaseIndexDirectory* directory, const std::string& directoryKey);
+static XBase* xbaseIndexFind(const char* filePath, DBaseEntry** entryPtr);
+static std::unique_lock<std::recursive_mutex> xbaseLock();
 
 // 0x6B24D0 paths
 static XBase* gXbaseHead;
@@ -42,11 +114,22 @@ static XBase* gXbaseHead;
 // 0x6B24D4 init
 static bool gXbaseExitHandlerRegistered;
 
+static XBaseIndex gXbaseIndex;
+
+// Guards xbases list, [gXbaseIndex] and lists of open dfiles. Once opened,
+// streams can be read on any thread (one thread per stream at a time).
+//
+// Only taken when [gXbaseThreadSafe] is set (see [xbaseSetThreadSafe]).
+static std::recursive_mutex gXbaseMutex;
+static bool gXbaseThreadSafe = false;
+
 // 0x4DED6C xfclose
 int xfileClose(XFile* stream)
 {
     assert(stream); // "stream", "xfile.c", 112
 
+    std::unique_lock<std::recursive_mutex> lock = xbaseLock();
+
     int rc;
 
     switch (stream->type) {
@@ -74,6 +157,8 @@ XFile* xfileOpen(const char* filePath, const char* mode)
     assert(filePath); // "filename", "xfile.c", 162
     assert(mode); // "mode", "xfile.c", 163
 
+    std::unique_lock<std::recursive_mutex> lock = xbaseLock();
+
     XFile* stream = (XFile*)malloc(sizeof(*stream));
     if (stream == nullptr) {
         return nullptr;
@@ -100,28 +185,50 @@ XFile* xfileOpen(const char* filePath, const char* mode)
     } else {
         // [filePath] is a relative path. Loop thru open xbases and attempt to
         // open [filePath] from appropriate xbase.
-        XBase* curr = gXbaseHead;
-        while (curr != nullptr) {
-            if (curr->isDbase) {
-                // Attempt to open dfile stream from dbase.
-                stream->dfile = dfileOpen(curr->dbase, filePath, mode);
-                if (stream->dfile != nullptr) {
-                    stream->type = XFILE_TYPE_DFILE;
-                    snprintf(path, sizeof(path), "%s", filePath);
-                    break;
+        //
+        // CE: When reading, use index to find appropriate xbase at once.
+        if (mode[0] == 'r' && strchr(mode, '+') == nullptr) {
+            DBaseEntry* entry;
+            XBase* xbase = xbaseIndexFind(filePath, &entry);
+            if (xbase != nullptr) {
+                if (entry != nullptr) {
+                    stream->dfile = dfileOpen(xbase->dbase, filePath, mode);
+                    if (stream->dfile != nullptr) {
+                        stream->type = XFILE_TYPE_DFILE;
+                        snprintf(path, sizeof(path), "%s", filePath);
+                    }
+                } else {
+                    snprintf(path, sizeof(path), "%s\\%s", xbase->path, filePath);
+                    stream->file = compat_fopen(path, mode);
+                    if (stream->file != nullptr) {
+                        stream->type = XFILE_TYPE_FILE;
+                    }
                 }
-            } else {
-                // Build path relative to directory-based xbase.
-                snprintf(path, sizeof(path), "%s\\%s", curr->path, filePath);
+            }
+        } else {
+            XBase* curr = gXbaseHead;
+            while (curr != nullptr) {
+                if (curr->isDbase) {
+                    // Attempt to open dfile stream from dbase.
+                    stream->dfile = dfileOpen(curr->dbase, filePath, mode);
+                    if (stream->dfile != nullptr) {
+                        stream->type = XFILE_TYPE_DFILE;
+                        snprintf(path, sizeof(path), "%s", filePath);
+                        break;
+                    }
+                } else {
+                    // Build path relative to directory-based xbase.
+                    snprintf(path, sizeof(path), "%s\\%s", curr->path, filePath);
 
-                // Attempt to open plain stream.
-                stream->file = compat_fopen(path, mode);
-                if (stream->file != nullptr) {
-                    stream->type = XFILE_TYPE_FILE;
-                    break;
+                    // Attempt to open plain stream.
+                    stream->file = compat_fopen(path, mode);
+                    if (stream->file != nullptr) {
+                        stream->type = XFILE_TYPE_FILE;
+                        break;
+                    }
                 }
+                curr = curr->next;
             }
-            curr = curr->next;
         }
 
         if (stream->file == nullptr) {
@@ -458,6 +565,69 @@ long xfileGetSize(XFile* stream)
     return fileSize;
 }
 
+const unsigned char* xfileGetView(const char* filePath, int* sizePtr)
+{
+    assert(filePath);
+    assert(sizePtr);
+
+    std::unique_lock<std::recursive_mutex> lock = xbaseLock();
+
+    char drive[COMPAT_MAX_DRIVE];
+    char dir[COMPAT_MAX_DIR];
+    compat_splitpath(filePath, drive, dir, nullptr, nullptr);
+
+    if (drive[0] != '\0' || dir[0] == '\\' || dir[0] == '/' || dir[0] == '.') {
+        // Absolute paths are always plain streams.
+        return nullptr;
+    }
+
+    DBaseEntry* entry;
+    XBase* xbase = xbaseIndexFind(filePath, &entry);
+    if (xbase == nullptr || entry == nullptr) {
+        return nullptr;
+    }
+
+    const unsigned char* data;
+    if (!dbaseGetEntryView(xbase->dbase, filePath, &data, sizePtr)) {
+        return nullptr;
+    }
+
+    return data;
+}
+
+bool xfileGetSizeByPath(const char* filePath, long* sizePtr)
+{
+    assert(filePath);
+    assert(sizePtr);
+
+    std::unique_lock<std::recursive_mutex> lock = xbaseLock();
+
+    char drive[COMPAT_MAX_DRIVE];
+    char dir[COMPAT_MAX_DIR];
+    compat_splitpath(filePath, drive, dir, nullptr, nullptr);
+
+    if (drive[0] == '\0' && dir[0] != '\\' && dir[0] != '/' && dir[0] != '.') {
+        // .DAT entries know their size, there is no need to open them.
+        DBaseEntry* entry;
+        XBase* xbase = xbaseIndexFind(filePath, &entry);
+        if (xbase != nullptr && entry != nullptr) {
+            *sizePtr = entry->uncompressedSize;
+            return true;
+        }
+    }
+
+    XFile* stream = xfileOpen(filePath, "rb");
+    if (stream == nullptr) {
+        return false;
+    }
+
+    *sizePtr = xfileGetSize(stream);
+
+    xfileClose(stream);
+
+    return true;
+}
+
 // Closes all open xbases and opens a set of xbases specified by [paths].
 //
 // [paths] is a set of paths separated by semicolon. Can be NULL, in this case
@@ -466,6 +636,8 @@ long xfileGetSize(XFile* stream)
 // 0x4DF878 xsetpath
 bool xbaseReopenAll(char* paths)
 {
+    std::unique_lock<std::recursive_mutex> lock = xbaseLock();
+
     // NOTE: Uninline.
     xbaseCloseAll();
 
@@ -487,6 +659,8 @@ bool xbaseOpen(const char* path)
 {
     assert(path); // "path", "xfile.c", 747
 
+    std::unique_lock<std::recursive_mutex> lock = xbaseLock();
+
     // Register atexit handler so that underlying dbase (if any) can be
     // gracefully closed.
     if (!gXbaseExitHandlerRegistered) {
@@ -511,6 +685,8 @@ bool xbaseOpen(const char* path)
             prev->next = curr->next;
             curr->next = gXbaseHead;
             gXbaseHead = curr;
+
+            xbaseIndexInvalidate();
         }
         return true;
     }
@@ -535,6 +711,7 @@ bool xbaseOpen(const char* path)
         xbase->dbase = dbase;
         xbase->next = gXbaseHead;
         gXbaseHead = xbase;
+        xbaseIndexInvalidate();
         return true;
     }
 
@@ -562,6 +739,7 @@ bool xbaseOpen(const char* path)
     if (compat_is_dir(path)) {
         xbase->next = gXbaseHead;
         gXbaseHead = xbase;
+        xbaseIndexInvalidate();
         return true;
     }
 
@@ -644,6 +822,21 @@ static bool xlistEnumerate(const char* pattern, XListEnumerationHandler* handler
         return findFindClose(&directoryFileFindData);
     }
 
+    // Directory-based xbases are enumerated from cached listings. The pattern
+    // is matched against file names only (the same way [fileFindFirst]
+    // does).
+    std::string directoryKey = xbaseIndexNormalizePath(pattern);
+    size_t separator = directoryKey.rfind('\\');
+    directoryKey = separator != std::string::npos ? directoryKey.substr(0, separator) : std::string();
+
+    char namePattern[COMPAT_MAX_PATH];
+    compat_makepath(namePattern, nullptr, nullptr, fileName, extension);
+    compat_strlwr(namePattern);
+
+    xbaseIndexValidate();
+
+    size_t directoryIndex = 0;
+
     XBase* xbase = gXbaseHead;
     while (xbase != nullptr) {
         if (xbase->isDbase) {
@@ -661,33 +854,32 @@ static bool xlistEnumerate(const char* pattern, XListEnumerationHandler* handler
                 dbaseFindClose(xbase->dbase, &dbaseFindData);
             }
         } else {
-            char path[COMPAT_MAX_PATH];
-            snprintf(path, sizeof(path), "%s\\%s", xbase->path, pattern);
-            compat_windows_path_to_native(path);
-
-            if (fileFindFirst(path, &directoryFileFindData)) {
-                do {
-                    bool isDirectory = fileFindIsDirectory(&directoryFileFindData);
-                    char* entryName = fileFindGetName(&directoryFileFindData);
-
-                    if (isDirectory) {
-                        if (strcmp(entryName, "..") == 0 || strcmp(entryName, ".") == 0) {
-                            continue;
-                        }
+            XBaseIndexDirectory* indexDirectory = &(gXbaseIndex.directories[directoryIndex++]);
+            const XBaseDirectoryListing* listing = xbaseIndexGetListing(indexDirectory, directoryKey);
+            if (listing != nullptr) {
+                for (const XBaseDirectoryEntry& entry : listing->entries) {
+                    if (entry.name == ".." || entry.name == ".") {
+                        continue;
+                    }
 
-                        context.type = XFILE_ENUMERATION_ENTRY_TYPE_DIRECTORY;
-                    } else {
-                        context.type = XFILE_ENUMERATION_ENTRY_TYPE_FILE;
+                    char entryName[COMPAT_MAX_FNAME];
+                    snprintf(entryName, sizeof(entryName), "%s", entry.name.c_str());
+                    compat_strlwr(entryName);
+                    if (!fpattern_match(namePattern, entryName)) {
+                        continue;
                     }
 
-                    compat_makepath(context.name, drive, dir, entryName, nullptr);
+                    context.type = entry.isDirectory
+                        ? XFILE_ENUMERATION_ENTRY_TYPE_DIRECTORY
+                        : XFILE_ENUMERATION_ENTRY_TYPE_FILE;
+
+                    compat_makepath(context.name, drive, dir, entry.name.c_str(), nullptr);
 
                     if (!handler(&context)) {
                         break;
                     }
-                } while (fileFindNext(&directoryFileFindData));
+                }
             }
-            findFindClose(&directoryFileFindData);
         }
         xbase = xbase->next;
     }
@@ -721,6 +913,8 @@ static bool xlistEnumerate(const char* pattern, XListEnumerationHandler* handler
 // 0x4DFF28 xbuild_filelist
 bool xlistInit(const char* pattern, XList* xlist)
 {
+    std::unique_lock<std::recursive_mutex> lock = xbaseLock();
+
     xlistEnumerate(pattern, xlistEnumerateHandler, xlist);
     return xlist->fileNamesLength != -1;
 }
@@ -820,6 +1014,8 @@ static void xbaseCloseAll()
     XBase* curr = gXbaseHead;
     gXbaseHead = nullptr;
 
+    xbaseIndexInvalidate();
+
     while (curr != nullptr) {
         XBase* next = curr->next;
 
@@ -837,6 +1033,8 @@ static void xbaseCloseAll()
 // xbase atexit
 static void xbaseExitHandler(void)
 {
+    std::unique_lock<std::recursive_mutex> lock = xbaseLock();
+
     // NOTE: Uninline.
     xbaseCloseAll();
 }
@@ -871,4 +1069,187 @@ static bool xlistEnumerateHandler(XListEnumerationContext* context)
     return true;
 }
 
+// Converts [path] into index key (lowercased with backslash separators).
+static std::string xbaseIndexNormalizePath(const char* path)
+{
+    std::string key(path);
+    for (char& ch : key) {
+        if (ch == '/') {
+            ch = '\\';
+        } else {
+            ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+        }
+    }
+    return key;
+}
+
+static void xbaseIndexInvalidate()
+{
+    gXbaseIndex.valid = false;
+    gXbaseIndex.dbaseEntries.clear();
+    gXbaseIndex.directories.clear();
+}
+
+// Rebuilds index if xbases list has changed, and drops directory listings if
+// file system was modified since they were loaded.
+static void xbaseIndexValidate()
+{
+    if (!gXbaseIndex.valid) {
+        int order = 0;
+        for (XBase* curr = gXbaseHead; curr != nullptr; curr = curr->next) {
+            if (curr->isDbase) {
+                DBase* dbase = curr->dbase;
+                gXbaseIndex.dbaseEntries.reserve(gXbaseIndex.dbaseEntries.size() + dbase->entriesLength);
+
+                for (int index = 0; index < dbase->entriesLength; index++) {
+                    DBaseEntry* entry = &(dbase->entries[index]);
+
+                    // NOTE: Only lowercase the key (without converting
+                    // separators) to match [dfileOpen] lookup exactly.
+                    std::string key(entry->path);
+                    for (char& ch : key) {
+                        ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+                    }
+
+                    // Keep the first (highest priority) occurrence.
+                    gXbaseIndex.dbaseEntries.emplace(std::move(key), XBaseIndexEntry { curr, entry, order });
+                }
+            } else {
+                XBaseIndexDirectory directory;
+                directory.xbase = curr;
+                directory.order = order;
+                gXbaseIndex.directories.push_back(std::move(directory));
+            }
+            order++;
+        }
+
+        gXbaseIndex.valid = true;
+        gXbaseIndex.fileSystemGeneration = compat_fs_generation();
+    }
+
+    if (gXbaseIndex.fileSystemGeneration != compat_fs_generation()) {
+        for (XBaseIndexDirectory& directory : gXbaseIndex.directories) {
+            directory.listings.clear();
+        }
+        gXbaseIndex.fileSystemGeneration = compat_fs_generation();
+    }
+}
+
+// Returns listing of [directoryKey] inside directory-based xbase, reading it
+// from file system if needed.
+//
+// Returns NULL if there is no such directory.
+static const XBaseDirectoryListing* xbaseIndexGetListing(XBaseIndexDirectory* directory, const std::string& directoryKey)
+{
+    auto it = directory->listings.find(directoryKey);
+    if (it != directory->listings.end()) {
+        return it->second.entries.empty() ? nullptr : &(it->second);
+    }
+
+    // Missing directories are cached as empty listings (existing directories
+    // always contain at least `.` and `..` on every supported platform, the
+    // root of xbase is reported as such below).
+    XBaseDirectoryListing& listing = directory->listings[directoryKey];
+
+    char path[COMPAT_MAX_PATH];
+    if (directoryKey.empty()) {
+        snprintf(path, sizeof(path), "%s\\*", directory->xbase->path);
+    } else {
+        snprintf(path, sizeof(path), "%s\\%s\\*", directory->xbase->path, directoryKey.c_str());
+    }
+    compat_windows_path_to_native(path);
+
+    DirectoryFileFindData directoryFileFindData;
+    if (fileFindFirst(path, &directoryFileFindData)) {
+        do {
+            XBaseDirectoryEntry entry;
+            entry.name = fileFindGetName(&directoryFileFindData);
+            entry.isDirectory = fileFindIsDirectory(&directoryFileFindData);
+
+            std::string key = xbaseIndexNormalizePath(entry.name.c_str());
+            listing.entryIndexes.emplace(std::move(key), listing.entries.size());
+            listing.entries.push_back(std::move(entry));
+        } while (fileFindNext(&directoryFileFindData));
+    }
+    findFindClose(&directoryFileFindData);
+
+    return listing.entries.empty() ? nullptr : &listing;
+}
+
+// Finds the highest priority xbase containing [filePath] (which must be
+// relative).
+//
+// Returns NULL if none of xbases contain this file. Otherwise [entryPtr] is
+// set to matching .DAT entry, or NULL if found xbase is a directory.
+static XBase* xbaseIndexFind(const char* filePath, DBaseEntry** entryPtr)
+{
+    xbaseIndexValidate();
+
+    *entryPtr = nullptr;
+
+    std::string key(filePath);
+    for (char& ch : key) {
+        ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+    }
+
+    const XBaseIndexEntry* dbaseEntry = nullptr;
+    auto it = gXbaseIndex.dbaseEntries.find(key);
+    if (it != gXbaseIndex.dbaseEntries.end()) {
+        dbaseEntry = &(it->second);
+    }
+
+    int dbaseOrder = dbaseEntry != nullptr ? dbaseEntry->order : INT_MAX;
+
+    std::string normalizedPath = xbaseIndexNormalizePath(filePath);
+    size_t separator = normalizedPath.rfind('\\');
+
+    std::string directoryKey;
+    std::string nameKey;
+    if (separator != std::string::npos) {
+        directoryKey = normalizedPath.substr(0, separator);
+        nameKey = normalizedPath.substr(separator + 1);
+    } else {
+        nameKey = normalizedPath;
+    }
+
+    for (XBaseIndexDirectory& directory : gXbaseIndex.directories) {
+        if (directory.order > dbaseOrder) {
+            break;
+        }
+
+        const XBaseDirectoryListing* listing = xbaseIndexGetListing(&directory, directoryKey);
+        if (listing == nullptr) {
+            continue;
+        }
+
+        auto entryIt = listing->entryIndexes.find(nameKey);
+        if (entryIt != listing->entryIndexes.end() && !listing->entries[entryIt->second].isDirectory) {
+            return directory.xbase;
+        }
+    }
+
+    if (dbaseEntry != nullptr) {
+        *entryPtr = dbaseEntry->entry;
+        return dbaseEntry->xbase;
+    }
+
+    return nullptr;
+}
+
+void xbaseSetThreadSafe(bool enabled)
+{
+    gXbaseThreadSafe = enabled;
+    dbaseSetThreadSafe(enabled);
+    compat_set_thread_safe(enabled);
+}
+
+static std::unique_lock<std::recursive_mutex> xbaseLock()
+{
+    if (!gXbaseThreadSafe) {
+        return std::unique_lock<std::recursive_mutex>();
+    }
+
+    return std::unique_lock<std::recursive_mutex>(gXbaseMutex);
+}
+
 } // namespace fallout
@@ -63,9 +63,26 @@ long xfileTell(XFile* stream);
 void xfileRewind(XFile* stream);
 int xfileEof(XFile* stream);
 long xfileGetSize(XFile* stream);
+
+// Resolves [filePath] the same way as [xfileOpen] does and returns pointer to
+// it's contents if it can be accessed without reading (i.e. it's an
+// uncompressed entry in memory mapped .DAT file).
+//
+// Returns NULL if file is not found or cannot be accessed directly.
+const unsigned char* xfileGetView(const char* filePath, int* sizePtr);
+
+// Obtains size of file at [filePath] (resolved the same way as [xfileOpen]
+// does) without opening it when possible.
+//
+// Returns false if file does not exist.
+bool xfileGetSizeByPath(const char* filePath, long* sizePtr);
 bool xbaseReopenAll(char* paths);
 bool xbaseOpen(const char* path);
 
+// Specifies whether file functions can be used from several threads at once.
+// Must only be changed while no other thread uses them.
+void xbaseSetThreadSafe(bool enabled);
+
 // Returns true if path is currently mounted as a directory-based VFS xbase
 // (comparison ignores case and a trailing path separator).
 bool xbaseIsValidDirectory(const char* path);
@@ -2,17 +2,23 @@
 #include "platform_compat.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <cctype>
+#include <condition_variable>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <limits>
 #include <map>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 #include <zlib.h>
@@ -39,6 +45,11 @@ namespace fallout {
 namespace {
 
 constexpr int kMaxCreateRecursionDepth = 128;
+constexpr size_t kStreamBufferSize = 64 * 1024;
+
+// Number of entries compressed ahead of the archive writer per job. Bounds
+// memory held by compressed entries waiting to be written.
+constexpr size_t kCreateEntriesInFlightPerJob = 4;
 
 struct Options {
     std::string archivePath;
@@ -46,10 +57,16 @@ struct Options {
     std::vector<std::string> args;
     std::string extractFileListPath;
     bool lowerExtractedPaths = false;
+    unsigned int jobs = 0;
 };
 
 struct DatCreateEntry {
     std::string nativePath;
+
+    // Entry path in source archive when repacking, [nativePath] is empty in
+    // this case.
+    std::string sourceEntryPath;
+
     std::string archivePath;
     bool compressed = false;
     int uncompressedSize = 0;
@@ -57,6 +74,60 @@ struct DatCreateEntry {
     int dataOffset = 0;
 };
 
+// Result of compressing a single entry on a worker thread.
+struct DatCompressedEntry {
+    bool done = false;
+    bool failed = false;
+    std::string error;
+
+    // Set when [data] holds zlib stream which is smaller than source data.
+    // Otherwise entry is stored as is and is copied from source by the writer.
+    bool compressed = false;
+    int uncompressedSize = 0;
+    std::vector<unsigned char> data;
+};
+
+class NativeFileStream final : public DatArchiveStream {
+public:
+    explicit NativeFileStream(FILE* stream)
+        : stream_(stream)
+    {
+    }
+
+    ~NativeFileStream() override
+    {
+        if (stream_ != nullptr) {
+            fclose(stream_);
+        }
+    }
+
+    NativeFileStream(const NativeFileStream&) = delete;
+    NativeFileStream& operator=(const NativeFileStream&) = delete;
+
+    size_t read(void* buffer, size_t size) override
+    {
+        return fread(buffer, 1, size, stream_);
+    }
+
+    bool seek(long offset, int origin) override
+    {
+        return fseek(stream_, offset, origin) == 0;
+    }
+
+    long tell() const override
+    {
+        return ftell(stream_);
+    }
+
+    long size() const override
+    {
+        return getFileSize(stream_);
+    }
+
+private:
+    FILE* stream_ = nullptr;
+};
+
 std::string normalizeDatPath(std::string path)
 {
     for (char& ch : path) {
@@ -253,87 +324,301 @@ bool checkedAddInt(int* value, int increment)
     return true;
 }
 
-bool readFile(const std::string& path, std::vector<unsigned char>* data)
+unsigned int resolveJobCount(unsigned int jobs)
 {
-    FILE* rawInput = compat_fopen(path.c_str(), "rb");
-    if (rawInput == nullptr) {
-        return false;
+    if (jobs != 0) {
+        return jobs;
+    }
+
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+const std::string& createEntrySourceName(const DatCreateEntry& entry)
+{
+    return entry.nativePath.empty() ? entry.sourceEntryPath : entry.nativePath;
+}
+
+// Opens data of [entry] either from native file system or from
+// [sourceArchive] (when repacking).
+std::unique_ptr<DatArchiveStream> openCreateEntrySource(const DatCreateEntry& entry, const DatArchive* sourceArchive)
+{
+    if (entry.nativePath.empty()) {
+        if (sourceArchive == nullptr) {
+            return nullptr;
+        }
+
+        return sourceArchive->openEntry(entry.sourceEntryPath);
     }
 
-    std::unique_ptr<FILE, decltype(&fclose)> input(rawInput, &fclose);
+    FILE* stream = compat_fopen(entry.nativePath.c_str(), "rb");
+    if (stream == nullptr) {
+        return nullptr;
+    }
+
+    return std::make_unique<NativeFileStream>(stream);
+}
+
+// Compresses [input] chunk by chunk. Gives up as soon as compressed data
+// reaches the size of the input, so at most [size] bytes are ever buffered
+// and incompressible entries are not compressed till the end.
+bool deflateStream(DatArchiveStream* input, long size, std::vector<unsigned char>* output, bool* compressed)
+{
+    *compressed = false;
+    output->clear();
+
+    if (size == 0) {
+        return true;
+    }
 
-    long fileSize = getFileSize(input.get());
-    if (fileSize < 0 || fileSize > std::numeric_limits<int>::max()) {
+    z_stream zstream;
+    memset(&zstream, 0, sizeof(zstream));
+    if (deflateInit(&zstream, Z_DEFAULT_COMPRESSION) != Z_OK) {
         return false;
     }
 
-    data->resize(static_cast<size_t>(fileSize));
-    if (!data->empty()) {
-        if (fread(data->data(), 1, data->size(), input.get()) != data->size()) {
-            return false;
+    std::vector<unsigned char> inputBuffer(kStreamBufferSize);
+    std::vector<unsigned char> outputBuffer(kStreamBufferSize);
+    long remaining = size;
+    bool success = true;
+    bool finished = false;
+
+    while (!finished) {
+        size_t chunkSize = static_cast<size_t>(std::min<long>(remaining, static_cast<long>(inputBuffer.size())));
+        if (chunkSize != 0 && input->read(inputBuffer.data(), chunkSize) != chunkSize) {
+            success = false;
+            break;
         }
+
+        remaining -= static_cast<long>(chunkSize);
+
+        int flush = remaining == 0 ? Z_FINISH : Z_NO_FLUSH;
+        zstream.next_in = inputBuffer.data();
+        zstream.avail_in = static_cast<uInt>(chunkSize);
+
+        do {
+            zstream.next_out = outputBuffer.data();
+            zstream.avail_out = static_cast<uInt>(outputBuffer.size());
+
+            int rc = deflate(&zstream, flush);
+            if (rc == Z_STREAM_ERROR) {
+                success = false;
+                finished = true;
+                break;
+            }
+
+            output->insert(output->end(), outputBuffer.data(), zstream.next_out);
+
+            if (rc == Z_STREAM_END) {
+                finished = true;
+            }
+        } while (zstream.avail_out == 0);
+
+        if (output->size() >= static_cast<size_t>(size)) {
+            // Entry is stored uncompressed, there is no point to continue.
+            output->clear();
+            output->shrink_to_fit();
+            deflateEnd(&zstream);
+            return true;
+        }
+    }
+
+    deflateEnd(&zstream);
+
+    if (!success) {
+        output->clear();
+        return false;
     }
 
+    *compressed = true;
     return true;
 }
 
-bool compressData(const std::vector<unsigned char>& input, std::vector<unsigned char>* output)
+void compressCreateEntry(const DatCreateEntry& entry, const DatArchive* sourceArchive, DatCompressedEntry* result)
 {
-    uLongf compressedSize = compressBound(static_cast<uLong>(input.size()));
-    output->resize(static_cast<size_t>(compressedSize));
+    std::unique_ptr<DatArchiveStream> input = openCreateEntrySource(entry, sourceArchive);
+    if (input == nullptr) {
+        result->failed = true;
+        result->error = "Failed to read input file: " + createEntrySourceName(entry);
+        return;
+    }
 
-    int rc = compress2(output->data(), &compressedSize, input.data(), static_cast<uLong>(input.size()), Z_DEFAULT_COMPRESSION);
-    if (rc != Z_OK) {
-        return false;
+    long size = input->size();
+    if (size < 0 || size > std::numeric_limits<int>::max()) {
+        result->failed = true;
+        result->error = "Input file is too large for Fallout 2 DAT: " + createEntrySourceName(entry);
+        return;
     }
 
-    output->resize(static_cast<size_t>(compressedSize));
-    return true;
+    if (!deflateStream(input.get(), size, &(result->data), &(result->compressed))) {
+        result->failed = true;
+        result->error = "Failed to compress input file: " + createEntrySourceName(entry);
+        return;
+    }
+
+    result->uncompressedSize = static_cast<int>(size);
 }
 
-bool writeEntryData(FILE* output, DatCreateEntry* entry, int* dataOffset)
+// Streams uncompressed entry data from source into archive.
+bool copyCreateEntrySource(FILE* output, const DatCreateEntry& entry, const DatArchive* sourceArchive, int size)
 {
-    std::vector<unsigned char> data;
-    if (!readFile(entry->nativePath, &data)) {
-        std::cerr << "Failed to read input file: " << entry->nativePath << "\n";
+    std::unique_ptr<DatArchiveStream> input = openCreateEntrySource(entry, sourceArchive);
+    if (input == nullptr) {
+        std::cerr << "Failed to read input file: " << createEntrySourceName(entry) << "\n";
         return false;
     }
 
-    if (data.size() > static_cast<size_t>(std::numeric_limits<int>::max())) {
-        std::cerr << "Input file is too large for Fallout 2 DAT: " << entry->nativePath << "\n";
+    if (input->size() != size) {
+        std::cerr << "Input file changed while creating archive: " << createEntrySourceName(entry) << "\n";
         return false;
     }
 
-    std::vector<unsigned char> compressedData;
-    bool useCompressedData = false;
-    if (!data.empty()) {
-        if (!compressData(data, &compressedData)) {
-            std::cerr << "Failed to compress input file: " << entry->nativePath << "\n";
+    std::vector<unsigned char> buffer(kStreamBufferSize);
+    long remaining = size;
+    while (remaining > 0) {
+        size_t chunkSize = static_cast<size_t>(std::min<long>(remaining, static_cast<long>(buffer.size())));
+        if (input->read(buffer.data(), chunkSize) != chunkSize) {
+            std::cerr << "Failed to read input file: " << createEntrySourceName(entry) << "\n";
             return false;
         }
 
-        useCompressedData = compressedData.size() < data.size();
-    }
+        if (!writeAll(output, buffer.data(), chunkSize)) {
+            std::cerr << "Failed to write archive data for: " << entry.archivePath << "\n";
+            return false;
+        }
 
-    const std::vector<unsigned char>& storedData = useCompressedData ? compressedData : data;
-    if (storedData.size() > static_cast<size_t>(std::numeric_limits<int>::max())) {
-        std::cerr << "Stored file is too large for Fallout 2 DAT: " << entry->nativePath << "\n";
-        return false;
+        remaining -= static_cast<long>(chunkSize);
     }
 
-    entry->compressed = useCompressedData;
-    entry->uncompressedSize = static_cast<int>(data.size());
-    entry->dataSize = static_cast<int>(storedData.size());
+    return true;
+}
+
+bool writeEntryData(FILE* output, DatCreateEntry* entry, const DatCompressedEntry& compressedEntry, const DatArchive* sourceArchive, int* dataOffset)
+{
+    entry->compressed = compressedEntry.compressed;
+    entry->uncompressedSize = compressedEntry.uncompressedSize;
+    entry->dataSize = compressedEntry.compressed
+        ? static_cast<int>(compressedEntry.data.size())
+        : compressedEntry.uncompressedSize;
     entry->dataOffset = *dataOffset;
 
-    if (!writeAll(output, storedData.data(), storedData.size())) {
-        std::cerr << "Failed to write archive data for: " << entry->archivePath << "\n";
-        return false;
+    if (compressedEntry.compressed) {
+        if (!writeAll(output, compressedEntry.data.data(), compressedEntry.data.size())) {
+            std::cerr << "Failed to write archive data for: " << entry->archivePath << "\n";
+            return false;
+        }
+    } else {
+        if (!copyCreateEntrySource(output, *entry, sourceArchive, entry->uncompressedSize)) {
+            return false;
+        }
     }
 
     return checkedAddInt(dataOffset, entry->dataSize);
 }
 
+// Compresses entries on [jobs] worker threads and writes them to [output] in
+// order. Workers run at most a few entries ahead of the writer to keep memory
+// usage bounded. When [sourceArchivePath] is set entries are read from that
+// archive (each thread opens its own instance), otherwise from native files.
+bool writeEntriesData(FILE* output, const std::string& sourceArchivePath, unsigned int jobs, std::vector<DatCreateEntry>* entries, int* dataOffset)
+{
+    std::unique_ptr<DatArchive> sourceArchive;
+    if (!sourceArchivePath.empty()) {
+        sourceArchive = DatArchive::open(sourceArchivePath);
+        if (sourceArchive == nullptr) {
+            std::cerr << "Failed to open archive: " << sourceArchivePath << "\n";
+            return false;
+        }
+    }
+
+    std::vector<DatCompressedEntry> results(entries->size());
+    std::mutex mutex;
+    std::condition_variable condition;
+    size_t nextIndex = 0;
+    size_t writtenIndex = 0;
+    bool cancelled = false;
+    const size_t window = jobs * kCreateEntriesInFlightPerJob;
+
+    auto worker = [&]() {
+        std::unique_ptr<DatArchive> workerSourceArchive;
+        if (!sourceArchivePath.empty()) {
+            workerSourceArchive = DatArchive::open(sourceArchivePath);
+        }
+
+        while (true) {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&]() {
+                    return cancelled || nextIndex >= entries->size() || nextIndex < writtenIndex + window;
+                });
+
+                if (cancelled || nextIndex >= entries->size()) {
+                    return;
+                }
+
+                index = nextIndex++;
+            }
+
+            DatCompressedEntry result;
+            compressCreateEntry((*entries)[index], workerSourceArchive.get(), &result);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results[index] = std::move(result);
+                results[index].done = true;
+            }
+            condition.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int job = 0; job < jobs; job++) {
+        workers.emplace_back(worker);
+    }
+
+    bool success = true;
+    for (size_t index = 0; index < entries->size(); index++) {
+        DatCompressedEntry result;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&]() {
+                return results[index].done;
+            });
+
+            result = std::move(results[index]);
+        }
+
+        if (result.failed) {
+            std::cerr << result.error << "\n";
+            success = false;
+            break;
+        }
+
+        if (!writeEntryData(output, &((*entries)[index]), result, sourceArchive.get(), dataOffset)) {
+            success = false;
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            writtenIndex = index + 1;
+        }
+        condition.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+    }
+    condition.notify_all();
+
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+
+    return success;
+}
+
 std::string joinNativePathForScan(const std::string& basePath, const std::string& name)
 {
     if (basePath.empty()) {
@@ -677,7 +962,7 @@ bool replaceArchiveWithTemporaryArchive(const std::string& temporaryArchivePath,
 #endif
 }
 
-bool writeFo2DatArchiveToStream(FILE* rawOutput, const std::string& outputPath, std::vector<DatCreateEntry>* entries)
+bool writeFo2DatArchiveToStream(FILE* rawOutput, const std::string& outputPath, const std::string& sourceArchivePath, unsigned int jobs, std::vector<DatCreateEntry>* entries)
 {
     if (rawOutput == nullptr) {
         std::cerr << "Failed to create archive: " << outputPath << "\n";
@@ -687,10 +972,8 @@ bool writeFo2DatArchiveToStream(FILE* rawOutput, const std::string& outputPath,
     std::unique_ptr<FILE, decltype(&fclose)> output(rawOutput, &fclose);
 
     int dataOffset = 0;
-    for (DatCreateEntry& entry : *entries) {
-        if (!writeEntryData(output.get(), &entry, &dataOffset)) {
-            return false;
-        }
+    if (!writeEntriesData(output.get(), sourceArchivePath, jobs, entries, &dataOffset)) {
+        return false;
     }
 
     if (entries->size() > static_cast<size_t>(std::numeric_limits<int>::max())) {
@@ -753,13 +1036,10 @@ bool writeFo2DatArchiveToStream(FILE* rawOutput, const std::string& outputPath,
     return true;
 }
 
-bool writeFo2DatArchive(const std::string& inputDir, const std::string& archivePath)
+// Writes [entries] to a temporary file beside [archivePath] and moves it in
+// place once complete.
+bool writeFo2DatArchiveFromEntries(const std::string& archivePath, const std::string& sourceArchivePath, unsigned int jobs, std::vector<DatCreateEntry>* entries)
 {
-    std::vector<DatCreateEntry> entries;
-    if (!collectCreateEntries(inputDir, archivePath, &entries)) {
-        return false;
-    }
-
     std::string temporaryArchivePath;
     FILE* rawTemporaryArchive = nullptr;
     if (!createTemporaryArchiveFile(archivePath, &temporaryArchivePath, &rawTemporaryArchive)) {
@@ -767,7 +1047,7 @@ bool writeFo2DatArchive(const std::string& inputDir, const std::string& archiveP
         return false;
     }
 
-    if (!writeFo2DatArchiveToStream(rawTemporaryArchive, temporaryArchivePath, &entries)) {
+    if (!writeFo2DatArchiveToStream(rawTemporaryArchive, temporaryArchivePath, sourceArchivePath, jobs, entries)) {
         compat_remove(temporaryArchivePath.c_str());
         return false;
     }
@@ -779,9 +1059,11 @@ bool writeFo2DatArchive(const std::string& inputDir, const std::string& archiveP
     }
 
     long long uncompressedBytes = 0;
+    long long storedBytes = 0;
     int compressedEntries = 0;
-    for (const DatCreateEntry& entry : entries) {
+    for (const DatCreateEntry& entry : *entries) {
         uncompressedBytes += entry.uncompressedSize;
+        storedBytes += entry.dataSize;
         if (entry.compressed) {
             compressedEntries++;
         }
@@ -789,19 +1071,33 @@ bool writeFo2DatArchive(const std::string& inputDir, const std::string& archiveP
 
     std::cout
         << "Created " << archivePath << "\n"
-        << "entries: " << entries.size() << "\n"
+        << "entries: " << entries->size() << "\n"
         << "compressed_entries: " << compressedEntries << "\n"
-        << "uncompressed_entries: " << entries.size() - compressedEntries << "\n"
-        << "uncompressed_bytes: " << uncompressedBytes << "\n";
+        << "uncompressed_entries: " << entries->size() - compressedEntries << "\n"
+        << "uncompressed_bytes: " << uncompressedBytes << "\n"
+        << "stored_bytes: " << storedBytes << "\n"
+        << "jobs: " << jobs << "\n";
 
     return true;
 }
 
+bool writeFo2DatArchive(const std::string& inputDir, const std::string& archivePath, unsigned int jobs)
+{
+    std::vector<DatCreateEntry> entries;
+    if (!collectCreateEntries(inputDir, archivePath, &entries)) {
+        return false;
+    }
+
+    return writeFo2DatArchiveFromEntries(archivePath, "", jobs, &entries);
+}
+
 void printUsage(std::ostream& stream)
 {
     stream
         << "Usage:\n"
-        << "  ce-dat-tool create <input-dir> <archive.dat>\n"
+        << "  ce-dat-tool create [--jobs <n>] <input-dir> <archive.dat>\n"
+        << "  ce-dat-tool <archive.dat> repack [--jobs <n>] <output.dat>\n"
+        << "  ce-dat-tool <archive.dat> verify [--jobs <n>] [pattern]\n"
         << "  ce-dat-tool <archive.dat> list [pattern]\n"
         << "  ce-dat-tool <archive.dat> info [pattern]\n"
         << "  ce-dat-tool <archive.dat> extract [--lower] <output-dir> [pattern]\n"
@@ -810,7 +1106,10 @@ void printUsage(std::ostream& stream)
         << "\n"
         << "Notes:\n"
         << "  - Create preserves input path casing and stores Windows-style archive paths.\n"
-        << "  - Create compresses entries only when zlib output is smaller.\n"
+        << "  - Create and repack compress entries only when zlib output is smaller.\n"
+        << "  - Repack rewrites any supported archive (including Fallout 1) as Fallout 2 DAT.\n"
+        << "  - Verify decodes every entry, checks zlib checksums, and prints entry CRC-32.\n"
+        << "  - Jobs default to the number of hardware threads.\n"
         << "  - Patterns use the same Windows-style wildcard matching as the game.\n"
         << "  - File lists contain one archive path per line. Empty lines are ignored.\n"
         << "  - Archive paths are case-insensitive and should use backslashes internally.\n";
@@ -823,19 +1122,42 @@ bool parseOptions(int argc, char** argv, Options* options)
     }
 
     if (std::strcmp(argv[1], "create") == 0) {
-        if (argc != 4) {
-            return false;
-        }
-
         options->command = argv[1];
         options->args.assign(argv + 2, argv + argc);
-        return true;
     } else {
         options->archivePath = argv[1];
         options->command = argv[2];
         options->args.assign(argv + 3, argv + argc);
     }
 
+    if (options->command == "create" || options->command == "repack" || options->command == "verify") {
+        std::vector<std::string> args;
+        for (size_t index = 0; index < options->args.size(); index++) {
+            const std::string& arg = options->args[index];
+            if (arg == "--jobs" || arg == "-j") {
+                if (index + 1 >= options->args.size()) {
+                    return false;
+                }
+
+                char* end;
+                long jobs = std::strtol(options->args[index + 1].c_str(), &end, 10);
+                if (*end != '\0' || jobs <= 0 || jobs > 1024) {
+                    return false;
+                }
+
+                options->jobs = static_cast<unsigned int>(jobs);
+                index++;
+            } else {
+                args.push_back(arg);
+            }
+        }
+        options->args = std::move(args);
+    }
+
+    if (options->command == "create") {
+        return options->args.size() == 2;
+    }
+
     if (options->command == "extract") {
         std::vector<std::string> args;
         for (size_t index = 0; index < options->args.size(); index++) {
@@ -1127,10 +1449,198 @@ int catCommand(const DatArchive& archive, const std::vector<std::string>& args)
     return 0;
 }
 
+int repackCommand(const DatArchive& archive, const std::vector<std::string>& args, unsigned int jobs)
+{
+    if (args.size() != 1) {
+        std::cerr << "repack requires exactly one output archive path\n";
+        return 1;
+    }
+
+    std::vector<DatCreateEntry> entries;
+    entries.reserve(archive.entries().size());
+    for (const DatArchiveEntry& archiveEntry : archive.entries()) {
+        DatCreateEntry entry;
+        entry.sourceEntryPath = archiveEntry.path;
+        entry.archivePath = normalizeDatPath(archiveEntry.path);
+        entries.push_back(std::move(entry));
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const DatCreateEntry& lhs, const DatCreateEntry& rhs) {
+        return compat_stricmp(lhs.archivePath.c_str(), rhs.archivePath.c_str()) < 0;
+    });
+
+    return writeFo2DatArchiveFromEntries(args[0], archive.path(), jobs, &entries) ? 0 : 1;
+}
+
+struct DatVerifyResult {
+    bool valid = false;
+    unsigned long crc = 0;
+};
+
+// DAT2 does not keep checksums of its own, but compressed entries are zlib
+// streams which end with Adler-32 of uncompressed data. Inflates stored data of
+// [entry] till the end of stream to check it. Entries which are not zlib
+// streams (raw deflate in .zip based archives) are not checked.
+bool verifyStoredZlibStream(FILE* stream, long dataOffset, const DatArchiveEntry& entry, std::vector<unsigned char>* buffer)
+{
+    if (!entry.compressed || !entry.storedSize.has_value() || !entry.dataOffset.has_value()) {
+        return true;
+    }
+
+    if (fseek(stream, dataOffset + *entry.dataOffset, SEEK_SET) != 0) {
+        return false;
+    }
+
+    unsigned char header[2];
+    if (fread(header, sizeof(header), 1, stream) != 1) {
+        return false;
+    }
+
+    if ((header[0] & 0x0F) != Z_DEFLATED || ((header[0] << 8) | header[1]) % 31 != 0) {
+        return true;
+    }
+
+    if (fseek(stream, -static_cast<long>(sizeof(header)), SEEK_CUR) != 0) {
+        return false;
+    }
+
+    z_stream zstream;
+    memset(&zstream, 0, sizeof(zstream));
+    if (inflateInit(&zstream) != Z_OK) {
+        return false;
+    }
+
+    std::vector<unsigned char> output(kStreamBufferSize);
+    long remaining = *entry.storedSize;
+    int rc = Z_OK;
+    while (rc == Z_OK && remaining > 0) {
+        size_t chunkSize = static_cast<size_t>(std::min<long>(remaining, static_cast<long>(buffer->size())));
+        if (fread(buffer->data(), 1, chunkSize, stream) != chunkSize) {
+            break;
+        }
+
+        remaining -= static_cast<long>(chunkSize);
+
+        zstream.next_in = buffer->data();
+        zstream.avail_in = static_cast<uInt>(chunkSize);
+        do {
+            zstream.next_out = output.data();
+            zstream.avail_out = static_cast<uInt>(output.size());
+            rc = inflate(&zstream, Z_NO_FLUSH);
+        } while (rc == Z_OK && zstream.avail_out == 0);
+    }
+
+    bool valid = rc == Z_STREAM_END && zstream.total_out == static_cast<uLong>(entry.uncompressedSize);
+    inflateEnd(&zstream);
+
+    return valid;
+}
+
+// Decodes [entry] in full, checking that it yields exactly the declared number
+// of bytes, and computes CRC-32 of its contents.
+bool verifyEntry(const DatArchive& archive, const DatArchiveEntry& entry, std::vector<unsigned char>* buffer, unsigned long* crcPtr)
+{
+    std::unique_ptr<DatArchiveStream> stream = archive.openEntry(entry.path);
+    if (stream == nullptr || stream->size() != entry.uncompressedSize) {
+        return false;
+    }
+
+    unsigned long crc = crc32(0L, Z_NULL, 0);
+    long remaining = entry.uncompressedSize;
+    while (remaining > 0) {
+        size_t chunkSize = static_cast<size_t>(std::min<long>(remaining, static_cast<long>(buffer->size())));
+        if (stream->read(buffer->data(), chunkSize) != chunkSize) {
+            return false;
+        }
+
+        crc = crc32(crc, buffer->data(), static_cast<uInt>(chunkSize));
+        remaining -= static_cast<long>(chunkSize);
+    }
+
+    *crcPtr = crc;
+    return true;
+}
+
+int verifyCommand(const DatArchive& archive, const std::vector<std::string>& args, unsigned int jobs)
+{
+    std::string pattern = "*";
+    if (!args.empty()) {
+        pattern = normalizeDatPath(args[0]);
+    }
+
+    const std::vector<const DatArchiveEntry*> matches = archive.findEntries(pattern);
+    if (matches.empty()) {
+        std::cerr << "No entries matched pattern: " << pattern << "\n";
+        return 1;
+    }
+
+    std::vector<DatVerifyResult> results(matches.size());
+    std::atomic<size_t> nextIndex(0);
+
+    // Every thread reads through its own archive instance, archive streams
+    // are not meant to be shared between threads.
+    auto worker = [&]() {
+        std::unique_ptr<DatArchive> workerArchive = DatArchive::open(archive.path());
+        if (workerArchive == nullptr) {
+            return;
+        }
+
+        std::unique_ptr<FILE, decltype(&fclose)> rawArchive(nullptr, &fclose);
+        std::optional<long> dataOffset = workerArchive->dataOffset();
+        if (dataOffset.has_value()) {
+            rawArchive.reset(compat_fopen(archive.path().c_str(), "rb"));
+        }
+
+        std::vector<unsigned char> buffer(kStreamBufferSize);
+        while (true) {
+            size_t index = nextIndex++;
+            if (index >= matches.size()) {
+                break;
+            }
+
+            const DatArchiveEntry& entry = *matches[index];
+            DatVerifyResult& result = results[index];
+            result.valid = verifyEntry(*workerArchive, entry, &buffer, &result.crc);
+            if (result.valid && dataOffset.has_value()) {
+                result.valid = rawArchive != nullptr && verifyStoredZlibStream(rawArchive.get(), *dataOffset, entry, &buffer);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int job = 0; job < jobs; job++) {
+        workers.emplace_back(worker);
+    }
+
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+
+    int failed = 0;
+    for (size_t index = 0; index < matches.size(); index++) {
+        const DatVerifyResult& result = results[index];
+        if (result.valid) {
+            std::cout << matches[index]->path << "\tcrc32="
+                      << std::hex << std::setw(8) << std::setfill('0') << result.crc
+                      << std::dec << std::setfill(' ') << "\n";
+        } else {
+            std::cerr << "Corrupted entry: " << matches[index]->path << "\n";
+            failed++;
+        }
+    }
+
+    std::cout << "Verified " << matches.size() - failed << " of " << matches.size() << " entr";
+    std::cout << (matches.size() == 1 ? "y" : "ies") << "\n";
+
+    return failed == 0 ? 0 : 1;
+}
+
 int run(const Options& options)
 {
+    unsigned int jobs = resolveJobCount(options.jobs);
+
     if (options.command == "create") {
-        return writeFo2DatArchive(options.args[0], options.args[1]) ? 0 : 1;
+        return writeFo2DatArchive(options.args[0], options.args[1], jobs) ? 0 : 1;
     }
 
     std::unique_ptr<DatArchive> archive = DatArchive::open(options.archivePath);
@@ -1152,6 +1662,10 @@ int run(const Options& options)
         rc = extractCommand(*archive, options.args, options.lowerExtractedPaths, options.extractFileListPath);
     } else if (options.command == "cat") {
         rc = catCommand(*archive, options.args);
+    } else if (options.command == "repack") {
+        rc = repackCommand(*archive, options.args, jobs);
+    } else if (options.command == "verify") {
+        rc = verifyCommand(*archive, options.args, jobs);
     } else {
         std::cerr << "Unknown command: " << options.command << "\n";
         printUsage(std::cerr);